@@ -1,5 +1,13 @@
 import time
 import ssl
+import json
+import struct
+import asyncio
+import argparse
+from array import array
+import hashlib
+import os
+from concurrent.futures import ThreadPoolExecutor
 import pandas as pd
 import pvlib
 from pvlib import location as pvlocation, modelchain, pvsystem
@@ -14,6 +22,21 @@ UNIT_ID = 255
 SEND_PERIOD_SEC = 10
 EXCEL_PATH = "weather_washingtonDC_2016.xlsx"  
 
+# Lazy precompute: series is computed in chunks ahead of the send cursor and
+# each chunk is persisted to CACHE_DIR, keyed on the inputs (see cache_key())
+CACHE_DIR = ".pv_cache"
+CHUNK_SIZE = 168        # timesteps per chunk (1 week of hourly data)
+PREFETCH_CHUNKS = 2     # chunks computed ahead of the chunk being sent
+
+# PV system definition (part of the cache key)
+MODULE_NAME = "Znshine_PV_Tech_ZXP6_72_295_P"
+INVERTER_NAME = "ABB__MICRO_0_3_I_OUTD_US_208__208V_"
+TEMP_MODEL = ("sapm", "open_rack_glass_glass")
+LATITUDE = 38.9072
+LONGITUDE = -77.0369
+SURFACE_TILT = 35
+SURFACE_AZIMUTH = 180
+
 
 def u16(x: int) -> int:
     return max(0, min(65535, int(x)))
@@ -25,6 +48,19 @@ def pack_u32_to_2x_u16(u32: int):
     return hi, lo
 
 
+def encode_registers(ts, row) -> list:
+    """Encode one timestep into the 8-register telemetry block"""
+    regs = [0] * 8
+    regs[0] = u16(round(row["P_ac"]))
+    regs[1] = u16(round(row["P_dc"]))
+    regs[2] = u16(round(row["V_dc"] * 10))
+    regs[3] = u16(round(row["I_dc"] * 100))
+    regs[4] = u16(round(row["G"]))
+    regs[5] = u16(round(row["T_cell"] * 10))
+    regs[6], regs[7] = pack_u32_to_2x_u16(int(ts.timestamp()))
+    return regs
+
+
 # ----------------------------
 # PVLIB PIPELINE
 # ----------------------------
@@ -69,33 +105,35 @@ def build_weather_df(excel_path: str) -> pd.DataFrame:
     return weather_df
 
 
-def precompute_pv_timeseries(weather_df: pd.DataFrame) -> pd.DataFrame:
+def build_model_chain() -> modelchain.ModelChain:
     cec_modules = pvlib.pvsystem.retrieve_sam("cecmod")
     cec_inverters = pvlib.pvsystem.retrieve_sam("cecinverter")
-    module = cec_modules["Znshine_PV_Tech_ZXP6_72_295_P"]
-    inverter = cec_inverters["ABB__MICRO_0_3_I_OUTD_US_208__208V_"]
+    module = cec_modules[MODULE_NAME]
+    inverter = cec_inverters[INVERTER_NAME]
 
-    temp_params = pvlib.temperature.TEMPERATURE_MODEL_PARAMETERS["sapm"]["open_rack_glass_glass"]
+    temp_params = pvlib.temperature.TEMPERATURE_MODEL_PARAMETERS[TEMP_MODEL[0]][TEMP_MODEL[1]]
 
     loc = pvlocation.Location(
-        latitude=38.9072,
-        longitude=-77.0369,
+        latitude=LATITUDE,
+        longitude=LONGITUDE,
         name="Washington DC",
         altitude=0,
         tz="US/Eastern",
     )
 
     system = pvsystem.PVSystem(
-        surface_tilt=35,
-        surface_azimuth=180,
+        surface_tilt=SURFACE_TILT,
+        surface_azimuth=SURFACE_AZIMUTH,
         module_parameters=module,
         inverter_parameters=inverter,
         temperature_model_parameters=temp_params,
     )
 
-    mc = modelchain.ModelChain(system, loc, aoi_model="physical")
+    return modelchain.ModelChain(system, loc, aoi_model="physical")
 
-    # Run once on the full dataframe
+
+def run_model_chain(mc: modelchain.ModelChain, weather_df: pd.DataFrame) -> pd.DataFrame:
+    # Every timestep is independent, so this works on any slice of the year
     mc.run_model(weather=weather_df)
 
     # AC power
@@ -132,20 +170,320 @@ def precompute_pv_timeseries(weather_df: pd.DataFrame) -> pd.DataFrame:
     return out
 
 
-def main():
-    print("Loading weather file...")
-    weather_df = build_weather_df(EXCEL_PATH)
+def precompute_pv_timeseries(weather_df: pd.DataFrame) -> pd.DataFrame:
+    # Run once on the full dataframe
+    return run_model_chain(build_model_chain(), weather_df)
+
 
-    print("Running pvlib ModelChain (one-time precompute)...")
-    series = precompute_pv_timeseries(weather_df)
+# ----------------------------
+# LAZY CHUNKED SERIES + CACHE
+# ----------------------------
+def cache_key(excel_path: str, chunk_size: int) -> str:
+    """Hash of everything the computed series depends on"""
+    h = hashlib.sha256()
+    with open(excel_path, "rb") as f:
+        h.update(f.read())
+    h.update(repr((
+        pvlib.__version__, MODULE_NAME, INVERTER_NAME, TEMP_MODEL,
+        LATITUDE, LONGITUDE, SURFACE_TILT, SURFACE_AZIMUTH, chunk_size,
+    )).encode())
+    return h.hexdigest()[:16]
+
+
+class LazyPVSeries:
+    """
+    PV series computed chunk by chunk ahead of the send cursor.
+
+    Chunks are loaded from CACHE_DIR when present, otherwise computed on a
+    single worker thread (Excel file and ModelChain are only loaded on the
+    first cache miss) and written back. With a warm cache, row(0) returns
+    without touching pandas' Excel reader or pvlib.
+    """
+
+    def __init__(self, excel_path=EXCEL_PATH, cache_dir=CACHE_DIR,
+                 chunk_size=CHUNK_SIZE, prefetch=PREFETCH_CHUNKS):
+        self.excel_path = excel_path
+        self.cache_dir = cache_dir
+        self.chunk_size = chunk_size
+        self.prefetch = prefetch
+        self.key = cache_key(excel_path, chunk_size)
+        self._weather = None
+        self._mc = None
+        self._chunks = {}
+        self._executor = ThreadPoolExecutor(max_workers=1)
+        os.makedirs(cache_dir, exist_ok=True)
+        self.length = self._load_length()
+
+    def _path(self, name: str) -> str:
+        return os.path.join(self.cache_dir, f"{self.key}_{name}")
+
+    def _load_length(self) -> int:
+        try:
+            with open(self._path("meta.json")) as f:
+                return int(json.load(f)["length"])
+        except (OSError, ValueError, KeyError):
+            length = len(self._weather_df())
+            with open(self._path("meta.json"), "w") as f:
+                json.dump({"length": length, "chunk_size": self.chunk_size}, f)
+            return length
+
+    def _weather_df(self) -> pd.DataFrame:
+        if self._weather is None:
+            path = self._path("weather.pkl")
+            if os.path.exists(path):
+                self._weather = pd.read_pickle(path)
+            else:
+                print("Loading weather file...")
+                self._weather = build_weather_df(self.excel_path)
+                self._weather.to_pickle(path)
+        return self._weather
+
+    def _compute_chunk(self, c: int):
+        """Load or compute chunk c and encode its register blocks (worker thread)"""
+        path = self._path(f"chunk{c:04d}.pkl")
+        if os.path.exists(path):
+            chunk = pd.read_pickle(path)
+        else:
+            if self._mc is None:
+                self._mc = build_model_chain()
+            start = c * self.chunk_size
+            chunk = run_model_chain(self._mc, self._weather_df().iloc[start:start + self.chunk_size])
+
+            # Write-then-rename so an interrupted run never leaves a torn chunk
+            chunk.to_pickle(path + ".tmp")
+            os.replace(path + ".tmp", path)
+        return chunk, [encode_registers(ts, row) for ts, row in chunk.iterrows()]
+
+    def row(self, i: int):
+        """Return (timestamp, row) for timestep i, scheduling prefetch of later chunks"""
+        c, j = self._schedule(i)
+        chunk, _ = self._chunks[c].result()
+        return chunk.index[j], chunk.iloc[j]
+
+    def registers(self, i: int) -> list:
+        """Return the encoded 8-register block for timestep i"""
+        c, j = self._schedule(i)
+        _, encoded = self._chunks[c].result()
+        return encoded[j]
+
+    async def registers_async(self, i: int) -> list:
+        """registers() without blocking the event loop while chunk i is computed"""
+        c, j = self._schedule(i)
+        future = self._chunks[c]
+        if not future.done():
+            await asyncio.wrap_future(future)
+        _, encoded = future.result()
+        return encoded[j]
+
+    def _schedule(self, i: int):
+        """Submit chunk i and the prefetch window; return (chunk number, row in chunk)"""
+        n_chunks = (self.length + self.chunk_size - 1) // self.chunk_size
+        c = (i % self.length) // self.chunk_size
+
+        for k in range(self.prefetch + 1):
+            ck = (c + k) % n_chunks
+            if ck not in self._chunks:
+                self._chunks[ck] = self._executor.submit(self._compute_chunk, ck)
+
+        # Keep only the current chunk and the prefetch window in memory
+        window = {(c + k) % n_chunks for k in range(self.prefetch + 1)}
+        for ck in list(self._chunks):
+            if ck not in window:
+                del self._chunks[ck]
+
+        return c, (i % self.length) - c * self.chunk_size
+
+    def close(self):
+        self._executor.shutdown(wait=False, cancel_futures=True)
 
-    print(f"Generated {len(series)} timesteps. Starting Modbus TLS client...")
 
+# ----------------------------
+# ASYNC PIPELINED REPLAY
+# ----------------------------
+# Hand-built Modbus/TCP FC16 ADUs over an asyncio TLS stream: requests are
+# matched to responses by transaction id, so up to `window` writes can be in
+# flight at once (the blocking pymodbus client waits one RTT per sample).
+FC16_REQUEST = struct.Struct(">HHHBBHHB8H")
+RESPONSE_TIMEOUT_SEC = 2.0      # Unanswered write counts as lost (frees its window slot)
+MBAP_HEADER = struct.Struct(">HHHB")
+
+
+def percentile(sorted_values, pct: float) -> float:
+    if not sorted_values:
+        return 0.0
+    k = min(len(sorted_values) - 1, int(round(pct / 100.0 * (len(sorted_values) - 1))))
+    return sorted_values[k]
+
+
+async def run_async(series, host, port, unit_id, rate, window, count, quiet, sslctx,
+                    timeout=RESPONSE_TIMEOUT_SEC):
+    """
+    Open-loop replay with a bounded in-flight window.
+
+    rate > 0: request k is scheduled at t0 + k/rate regardless of responses
+              (latency is measured from the scheduled time, so a stalled
+              server shows up in the percentiles instead of lowering the rate)
+    rate = 0: send as fast as the window allows (closed loop)
+
+    A request without a response after `timeout` seconds counts as lost and
+    frees its window slot; a dropped connection ends the run.
+    """
+    reader, writer = await asyncio.open_connection(host, port, ssl=sslctx, server_hostname=None)
+    print(f"Connected to Modbus TLS server {host}:{port} (async, window={window}, "
+          f"rate={'max' if rate <= 0 else f'{rate:g}/s'})")
+
+    loop = asyncio.get_running_loop()
+    slots = asyncio.Semaphore(window)
+    pending = {}                # tid -> (reference time, deadline timer)
+    latencies = array("d")
+    stats = {"sent": 0, "ok": 0, "errors": 0, "expired": 0}
+    done = asyncio.Event()
+    stop = asyncio.ensure_future(done.wait())
+
+    def finish_one():
+        slots.release()
+        if count and stats["ok"] + stats["errors"] + stats["expired"] >= count:
+            done.set()
+
+    def expire(tid):
+        pending.pop(tid, None)
+        stats["expired"] += 1
+        if not quiet:
+            print(f"No response: tid={tid}")
+        finish_one()
+
+    async def receive():
+        try:
+            while True:
+                header = await reader.readexactly(MBAP_HEADER.size)
+                tid, _, length, _ = MBAP_HEADER.unpack(header)
+                pdu = await reader.readexactly(length - 1)
+                entry = pending.pop(tid, None)
+                if entry is None:
+                    continue
+                t_ref, timer = entry
+                timer.cancel()
+                latencies.append(loop.time() - t_ref)
+                if pdu[0] & 0x80:
+                    stats["errors"] += 1
+                    if not quiet:
+                        print(f"Modbus exception response: tid={tid} code={pdu[1]}")
+                else:
+                    stats["ok"] += 1
+                finish_one()
+        except (asyncio.IncompleteReadError, ConnectionError) as e:
+            print(f"Connection lost: {e}")
+            done.set()
+
+    receiver = asyncio.create_task(receive())
+    t0 = loop.time()
+    i = 0
+    try:
+        while not done.is_set() and (not count or i < count):
+            t_sched = t0 + i / rate if rate > 0 else None
+            if t_sched is not None:
+                delay = t_sched - loop.time()
+                if delay > 0:
+                    await asyncio.sleep(delay)
+
+            if slots.locked():
+                # Window full: wait for a response or a deadline, unless the run ends first
+                acquire = asyncio.ensure_future(slots.acquire())
+                await asyncio.wait((acquire, stop), return_when=asyncio.FIRST_COMPLETED)
+                if not acquire.done():
+                    acquire.cancel()
+                    break
+            else:
+                await slots.acquire()
+            regs = await series.registers_async(i)
+            tid = i & 0xFFFF
+            t_ref = t_sched if t_sched is not None else loop.time()
+            pending[tid] = (t_ref, loop.call_at(loop.time() + timeout, expire, tid))
+            writer.write(FC16_REQUEST.pack(tid, 0, 23, unit_id, 16, 0, 8, 16, *regs))
+            stats["sent"] += 1
+            if not quiet:
+                print(f"tid={tid} sent registers: {regs}")
+            i += 1
+
+            # Let the transport flush without awaiting every write
+            if writer.transport.get_write_buffer_size() > 64 * 1024:
+                await writer.drain()
+
+        await writer.drain()
+        if count:
+            # Every outstanding request is answered or expires within `timeout`
+            await asyncio.wait_for(asyncio.shield(stop), timeout=timeout + 1.0)
+    except asyncio.TimeoutError:
+        print(f"Timed out waiting for {len(pending)} outstanding responses")
+    except ConnectionError as e:
+        print(f"Connection lost: {e}")
+    finally:
+        elapsed = loop.time() - t0
+        receiver.cancel()
+        stop.cancel()
+        for _, timer in pending.values():
+            timer.cancel()
+        writer.close()
+
+        lat_ms = sorted(v * 1000.0 for v in latencies)
+        completed = stats["ok"] + stats["errors"]
+        print("=" * 60)
+        print(f"Sent: {stats['sent']}  OK: {stats['ok']}  Errors: {stats['errors']}  "
+              f"Lost: {stats['sent'] - completed}")
+        print(f"Elapsed: {elapsed:.2f}s  Achieved rate: {completed / elapsed if elapsed else 0.0:.1f} writes/s")
+        print(f"Latency (ms): p50={percentile(lat_ms, 50):.2f} p90={percentile(lat_ms, 90):.2f} "
+              f"p99={percentile(lat_ms, 99):.2f} p99.9={percentile(lat_ms, 99.9):.2f} "
+              f"max={lat_ms[-1] if lat_ms else 0.0:.2f}")
+        print("=" * 60)
+
+
+def build_ssl_context() -> ssl.SSLContext:
     sslctx = ssl.create_default_context()
     sslctx.check_hostname = False
     sslctx.verify_mode = ssl.CERT_NONE 
+    return sslctx
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(description="system_v1 Modbus TLS PV replay client")
+    parser.add_argument("--host", default=SERVER_IP)
+    parser.add_argument("--port", type=int, default=PORT)
+    parser.add_argument("--unit-id", type=int, default=UNIT_ID)
+    parser.add_argument("--async", dest="use_async", action="store_true",
+                        help="pipelined asyncio replay (stress test) instead of one sample per SEND_PERIOD_SEC")
+    parser.add_argument("--rate", type=float, default=0.0,
+                        help="async: open-loop target rate in writes/s (0 = as fast as the window allows)")
+    parser.add_argument("--window", type=int, default=16,
+                        help="async: maximum writes in flight")
+    parser.add_argument("--count", type=int, default=0,
+                        help="async: number of writes to send (0 = until Ctrl+C)")
+    parser.add_argument("--timeout", type=float, default=RESPONSE_TIMEOUT_SEC,
+                        help="async: seconds before an unanswered write counts as lost")
+    parser.add_argument("--quiet", action="store_true",
+                        help="async: no per-sample output, summary only")
+    return parser.parse_args()
+
+
+def main():
+    args = parse_args()
+    series = LazyPVSeries()
+
+    print(f"PV series: {series.length} timesteps, chunks of {series.chunk_size} "
+          f"(cache: {series.cache_dir}/{series.key}_*). Starting Modbus TLS client...")
+
+    sslctx = build_ssl_context()
+
+    if args.use_async:
+        try:
+            asyncio.run(run_async(series, args.host, args.port, args.unit_id, args.rate,
+                                  args.window, args.count, args.quiet, sslctx, args.timeout))
+        except KeyboardInterrupt:
+            print("Stopping...")
+        finally:
+            series.close()
+        return
 
-    client = ModbusTlsClient(host=SERVER_IP, port=PORT, sslctx=sslctx)
+    client = ModbusTlsClient(host=args.host, port=args.port, sslctx=sslctx)
 
     if not client.connect():
         raise ConnectionError("Failed to connect to Modbus TLS server")
@@ -165,18 +503,8 @@ def main():
     try:
         i = 0
         while True:
-            row = series.iloc[i]
-            ts = series.index[i]  # pandas Timestamp with tz
-            unix_s = int(ts.timestamp())
-
-            regs = [0] * 8
-            regs[0] = u16(round(row["P_ac"]))
-            regs[1] = u16(round(row["P_dc"]))
-            regs[2] = u16(round(row["V_dc"] * 10))
-            regs[3] = u16(round(row["I_dc"] * 100))
-            regs[4] = u16(round(row["G"]))
-            regs[5] = u16(round(row["T_cell"] * 10))
-            regs[6], regs[7] = pack_u32_to_2x_u16(unix_s)
+            ts, row = series.row(i)  # pandas Timestamp with tz
+            regs = encode_registers(ts, row)
 
             print(
                 f"{ts} | Pac={row['P_ac']:.1f}W Pdc={row['P_dc']:.1f}W "
@@ -185,7 +513,7 @@ def main():
             )
 
             try:
-                wr = client.write_registers(address=0, values=regs, device_id=UNIT_ID)
+                wr = client.write_registers(address=0, values=regs, device_id=args.unit_id)
                 if wr.isError():
                     print("Modbus write error:", wr)
                 else:
@@ -194,7 +522,7 @@ def main():
                 print("Modbus exception:", e)
 
             # advance timestep
-            i = (i + 1) % len(series)
+            i = (i + 1) % series.length
 
             time.sleep(SEND_PERIOD_SEC)
 
@@ -203,6 +531,7 @@ def main():
 
     finally:
         client.close()
+        series.close()
         print("Connection closed")
 
 
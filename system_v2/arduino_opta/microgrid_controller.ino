@@ -12,18 +12,37 @@
  * Challenge: Opta must maintain TWO simultaneous Modbus TCP client connections
  *
  * Register Mapping:
- *   FROM RPI#1 (8 registers):
+ *   FROM RPI#1 (8 registers + generation):
  *     0: P_ac, 1: P_dc, 2: V_dc (scaled×10), 3: I_dc (scaled×100),
- *     4: G, 5: T_cell (scaled×10), 6: Timestamp_high, 7: Timestamp_low
+ *     4: G, 5: T_cell (scaled×10), 6: Timestamp_high, 7: Timestamp_low,
+ *     8: Frame generation (unchanged → cycle skips processing and RPI#2 write)
  *
  *   TO RPI#2 (5 registers - subset):
  *     0: P_ac, 1: V_dc (scaled), 2: I_dc (scaled), 3: G, 4: Timestamp_low
  *
  * Why subset? Focus on critical measurements for SIPROTEC relay
+ *
+ * Local Modbus TCP server (port LOCAL_SERVER_PORT, separate RTOS thread):
+ *   Serves the latest process image and cycle statistics from RAM so SCADA
+ *   and other readers never add load to RPI#1. The client cycle only
+ *   publishes a snapshot under a mutex; it never waits on server clients.
+ *     0-7:   registers_rpi1          8-12:  registers_rpi2
+ *     13-14: totalReads (u32)        15-16: totalWrites (u32)
+ *     17-18: totalErrors (u32)       19:    last cycle time (ms)
+ *     20-21: uptime (s, u32)         22:    link status (bit0 RPI#1, bit1 RPI#2)
+ *     23:    snapshot sequence (increments every cycle)
+ *     24-27: clock offset to RPI#1 (µs, i64: RPI#1 monotonic - Opta clock)
+ *     28-29: RTT of the offset sample (µs, u32)
+ *
+ * Time service: every TIME_SYNC_INTERVAL_MS the Opta reads RPI#1's time
+ * registers (FC03 0x2000, monotonic + UTC ns) TIME_SYNC_SAMPLES times and
+ * keeps the lowest-RTT sample: offset = T_rpi1 - (t1 + t4) / 2. Local time
+ * + offset is RPI#1's monotonic clock, the timebase shared with the ESP32.
  */
 
 #include <Ethernet.h>
 #include <ArduinoModbus.h>
+#include <mbed.h>
 
 // =============================================================================
 // CONFIGURATION
@@ -43,11 +62,31 @@ const int RPI1_UNIT_ID = 1;
 // RPI#2 Configuration (Substation Gateway)
 IPAddress rpi2_ip(192, 168, 2, 200);
 const int RPI2_PORT = 502;
-const int RPI2_UNIT_ID = 1;
+const int RPI2_UNIT_ID = 1;  // Unique per controller when several Optas share RPI#2 (MODBUS_CONTROLLERS)
 
 // Timing Configuration
 const unsigned long POLL_INTERVAL_MS = 1000;  // Poll every 1 second
 
+// Long-poll: RPI#1 holds the read until a new frame arrives (or timeout), so the
+// cycle runs within milliseconds of each ESP32 frame and idles otherwise.
+// POLL_INTERVAL_MS is then only used as back-off after errors.
+const bool RPI1_LONG_POLL = true;
+const uint16_t RPI1_LONGPOLL_BASE = 0x1000;           // Must match LONGPOLL_BASE on RPI#1
+const unsigned long RPI1_LONGPOLL_TIMEOUT_MS = 5000;  // Server-side hold time
+
+// Time Service (clock offset to RPI#1, see rpi1/time_service.py)
+const bool TIME_SYNC_ENABLED = true;
+const uint16_t RPI1_TIME_SERVICE_BASE = 0x2000;       // Must match TIME_SERVICE_BASE on RPI#1
+const unsigned long TIME_SYNC_INTERVAL_MS = 60000;
+const int TIME_SYNC_SAMPLES = 8;                      // Exchanges per sync (lowest RTT kept)
+
+// Local Modbus Server Configuration (read-only process image for SCADA)
+const bool LOCAL_SERVER_ENABLED = true;
+const int LOCAL_SERVER_PORT = 502;
+const int LOCAL_SERVER_UNIT_ID = 1;
+const int LOCAL_SERVER_MAX_CLIENTS = 4;      // One ModbusTCPServer per reader
+const int LOCAL_SERVER_REGISTERS = 30;
+
 // =============================================================================
 // GLOBAL VARIABLES
 // =============================================================================
@@ -62,6 +101,8 @@ ModbusTCPClient modbusRPI2(ethClient2);
 
 // Data storage
 uint16_t registers_rpi1[8];  // 8 registers from RPI#1
+uint16_t rpi1_generation = 0;       // Frame generation (RPI#1 register 8)
+uint16_t last_generation = 0;       // Generation of the last forwarded frame
 uint16_t registers_rpi2[5];  // 5 registers to RPI#2
 
 // Connection status
@@ -72,7 +113,26 @@ bool rpi2_connected = false;
 unsigned long totalReads = 0;
 unsigned long totalWrites = 0;
 unsigned long totalErrors = 0;
+unsigned long totalSkipped = 0;   // Cycles without a new frame
 unsigned long lastStatsTime = 0;
+unsigned long lastCycleMs = 0;
+
+// Clock offset to RPI#1 (valid after the first successful sync)
+bool clockSynced = false;
+int64_t clockOffsetUs = 0;          // RPI#1 monotonic µs - localMicros64()
+uint32_t clockRttUs = 0;
+unsigned long lastTimeSyncTime = 0;
+unsigned long totalTimeSyncs = 0;
+
+// Local server: snapshot published by the client cycle, served by serverThread
+EthernetServer localEthServer(LOCAL_SERVER_PORT);
+ModbusTCPServer localServers[LOCAL_SERVER_MAX_CLIENTS];
+EthernetClient localClients[LOCAL_SERVER_MAX_CLIENTS];
+rtos::Thread serverThread(osPriorityBelowNormal, 4096);
+rtos::Mutex snapshotMutex;
+uint16_t snapshot[LOCAL_SERVER_REGISTERS];
+uint16_t snapshotSeq = 0;
+unsigned long localRequests = 0;
 
 // =============================================================================
 // SETUP FUNCTION
@@ -115,6 +175,13 @@ void setup() {
   Serial.print(":");
   Serial.println(RPI2_PORT);
 
+  if (LOCAL_SERVER_ENABLED) {
+    Serial.print("  Local server:       ");
+    Serial.print(Ethernet.localIP());
+    Serial.print(":");
+    Serial.println(LOCAL_SERVER_PORT);
+  }
+
   Serial.print("\n  Poll interval: ");
   Serial.print(POLL_INTERVAL_MS / 1000);
   Serial.println(" seconds");
@@ -123,7 +190,12 @@ void setup() {
   Serial.println("Starting dual Modbus client operation...");
   Serial.println("================================================================================\n");
 
+  if (LOCAL_SERVER_ENABLED) {
+    startLocalServer();
+  }
+
   lastStatsTime = millis();
+  lastTimeSyncTime = millis() - TIME_SYNC_INTERVAL_MS;  // First sync in the first cycle
 }
 
 // =============================================================================
@@ -131,34 +203,60 @@ void setup() {
 // =============================================================================
 
 void loop() {
+  unsigned long cycleStart = millis();
+  bool cycleOk = false;
+
   // Maintain Ethernet link
   Ethernet.maintain();
+  localMicros64();  // Keeps the 64-bit clock extension current
 
   // 1. READ from RPI#1
   if (readFromRPI1()) {
     totalReads++;
 
-    // 2. PROCESS data
-    prepareDataForRPI2();
-
-    // 3. WRITE to RPI#2
-    if (writeToRPI2()) {
-      totalWrites++;
+    if (rpi1_generation == 0 || rpi1_generation == last_generation) {
+      // No new frame from the ESP32 since the last cycle
+      totalSkipped++;
+      cycleOk = true;
     } else {
-      totalErrors++;
+      // 2. PROCESS data
+      prepareDataForRPI2();
+
+      // 3. WRITE to RPI#2
+      if (writeToRPI2()) {
+        totalWrites++;
+        last_generation = rpi1_generation;
+        cycleOk = true;
+      } else {
+        totalErrors++;
+      }
     }
   } else {
     totalErrors++;
   }
 
+  // Clock offset to RPI#1 (between long-polls, same connection)
+  if (TIME_SYNC_ENABLED && rpi1_connected && millis() - lastTimeSyncTime >= TIME_SYNC_INTERVAL_MS) {
+    lastTimeSyncTime = millis();
+    syncClockRPI1();
+  }
+
+  // 4. PUBLISH process image to local server (non-blocking for readers)
+  lastCycleMs = millis() - cycleStart;
+  if (LOCAL_SERVER_ENABLED) {
+    publishSnapshot();
+  }
+
   // Print statistics every 60 seconds
   if (millis() - lastStatsTime >= 60000) {
     printStatistics();
     lastStatsTime = millis();
   }
 
-  // Wait before next poll
-  delay(POLL_INTERVAL_MS);
+  // Wait before next poll (long-poll: the read itself waits, back off only on errors)
+  if (!RPI1_LONG_POLL || !cycleOk) {
+    delay(POLL_INTERVAL_MS);
+  }
 }
 
 // =============================================================================
@@ -166,7 +264,7 @@ void loop() {
 // =============================================================================
 
 /**
- * Read 8 registers from RPI#1 (Smart Meter)
+ * Read 8 registers + frame generation from RPI#1 (Smart Meter)
  */
 bool readFromRPI1() {
   // Connect if not connected
@@ -176,12 +274,18 @@ bool readFromRPI1() {
       Serial.println("FAILED");
       return false;
     }
+    if (RPI1_LONG_POLL) {
+      // Response may be held by RPI#1 for up to RPI1_LONGPOLL_TIMEOUT_MS
+      modbusRPI1.setTimeout(RPI1_LONGPOLL_TIMEOUT_MS + 1000);
+    }
     rpi1_connected = true;
     Serial.println("OK");
   }
 
-  // Read 8 holding registers starting at address 0
-  if (!modbusRPI1.requestFrom(RPI1_UNIT_ID, HOLDING_REGISTERS, 0, 8)) {
+  // Read 9 holding registers (frame + generation in one request). Long-poll
+  // address carries the low byte of the last forwarded generation.
+  uint16_t start = RPI1_LONG_POLL ? RPI1_LONGPOLL_BASE + (last_generation & 0xFF) : 0;
+  if (!modbusRPI1.requestFrom(RPI1_UNIT_ID, HOLDING_REGISTERS, start, 9)) {
     Serial.print("✗ Read from RPI#1 failed: ");
     Serial.println(modbusRPI1.lastError());
     rpi1_connected = false;
@@ -192,6 +296,11 @@ bool readFromRPI1() {
   for (int i = 0; i < 8; i++) {
     registers_rpi1[i] = modbusRPI1.read();
   }
+  rpi1_generation = modbusRPI1.read();
+
+  if (rpi1_generation == last_generation) {
+    return true;  // Unchanged frame, nothing to decode
+  }
 
   // Decode and print (for debugging)
   float P_ac = registers_rpi1[0] * 1.0;
@@ -211,7 +320,66 @@ bool readFromRPI1() {
   Serial.print("  G:      "); Serial.print(G, 1); Serial.println(" W/m²");
   Serial.print("  T_cell: "); Serial.print(T_cell, 1); Serial.println(" °C");
   Serial.print("  Time:   "); Serial.println(timestamp);
+  Serial.print("  Gen:    "); Serial.println(rpi1_generation);
+
+  return true;
+}
+
+/**
+ * micros() extended to 64 bits (wraps every ~71 minutes otherwise)
+ *
+ * Called every cycle, far more often than the wrap period.
+ */
+uint64_t localMicros64() {
+  static uint32_t last = 0;
+  static uint64_t high = 0;
+  uint32_t now = micros();
+  if (now < last) {
+    high += 1ULL << 32;
+  }
+  last = now;
+  return high | now;
+}
+
+/**
+ * NTP-style offset estimate against the RPI#1 time service
+ *
+ * Each exchange gives offset = T_rpi1 - (t1 + t4) / 2 with an error of at
+ * most RTT / 2; the exchange with the lowest RTT is kept.
+ */
+bool syncClockRPI1() {
+  bool have = false;
+  int64_t bestOffset = 0;
+  uint32_t bestRtt = 0;
+
+  for (int s = 0; s < TIME_SYNC_SAMPLES; s++) {
+    uint64_t t1 = localMicros64();
+    if (!modbusRPI1.requestFrom(RPI1_UNIT_ID, HOLDING_REGISTERS, RPI1_TIME_SERVICE_BASE, 8)) {
+      Serial.print("✗ Time service read failed: ");
+      Serial.println(modbusRPI1.lastError());
+      rpi1_connected = false;
+      return false;
+    }
+    uint64_t t4 = localMicros64();
+
+    uint64_t monoNs = 0;
+    for (int i = 0; i < 4; i++) {
+      monoNs = (monoNs << 16) | (uint16_t)modbusRPI1.read();
+    }
+    // UTC registers (4-7) are not used: the Opta has no UTC clock to correct
+
+    uint32_t rtt = (uint32_t)(t4 - t1);
+    if (!have || rtt < bestRtt) {
+      bestOffset = (int64_t)(monoNs / 1000) - (int64_t)(t1 + (t4 - t1) / 2);
+      bestRtt = rtt;
+      have = true;
+    }
+  }
 
+  clockOffsetUs = bestOffset;
+  clockRttUs = bestRtt;
+  clockSynced = true;
+  totalTimeSyncs++;
   return true;
 }
 
@@ -270,6 +438,112 @@ bool writeToRPI2() {
   return true;
 }
 
+// =============================================================================
+// LOCAL MODBUS SERVER
+// =============================================================================
+
+/**
+ * Configure server instances and start the server thread
+ */
+void startLocalServer() {
+  for (int i = 0; i < LOCAL_SERVER_MAX_CLIENTS; i++) {
+    localServers[i].begin(LOCAL_SERVER_UNIT_ID);
+    localServers[i].configureHoldingRegisters(0, LOCAL_SERVER_REGISTERS);
+  }
+  localEthServer.begin();
+  serverThread.start(localServerTask);
+}
+
+/**
+ * Copy the current process image and statistics into the shared snapshot
+ *
+ * Called once per client cycle; the mutex is only held for the copy.
+ */
+void publishSnapshot() {
+  uint32_t uptime = millis() / 1000;
+
+  snapshotMutex.lock();
+  for (int i = 0; i < 8; i++) {
+    snapshot[i] = registers_rpi1[i];
+  }
+  for (int i = 0; i < 5; i++) {
+    snapshot[8 + i] = registers_rpi2[i];
+  }
+  snapshot[13] = totalReads >> 16;
+  snapshot[14] = totalReads & 0xFFFF;
+  snapshot[15] = totalWrites >> 16;
+  snapshot[16] = totalWrites & 0xFFFF;
+  snapshot[17] = totalErrors >> 16;
+  snapshot[18] = totalErrors & 0xFFFF;
+  snapshot[19] = lastCycleMs > 0xFFFF ? 0xFFFF : lastCycleMs;
+  snapshot[20] = uptime >> 16;
+  snapshot[21] = uptime & 0xFFFF;
+  snapshot[22] = (rpi1_connected ? 0x01 : 0x00) | (rpi2_connected ? 0x02 : 0x00);
+  snapshot[24] = ((uint64_t)clockOffsetUs >> 48) & 0xFFFF;
+  snapshot[25] = ((uint64_t)clockOffsetUs >> 32) & 0xFFFF;
+  snapshot[26] = ((uint64_t)clockOffsetUs >> 16) & 0xFFFF;
+  snapshot[27] = (uint64_t)clockOffsetUs & 0xFFFF;
+  snapshot[28] = clockRttUs >> 16;
+  snapshot[29] = clockRttUs & 0xFFFF;
+  snapshot[23] = ++snapshotSeq;
+  snapshotMutex.unlock();
+}
+
+/**
+ * Server thread: accept readers and answer requests from the snapshot
+ *
+ * Each connected reader gets its own ModbusTCPServer instance (ArduinoModbus
+ * serves one client per instance). Registers are refreshed from the snapshot
+ * only when its sequence has advanced.
+ */
+void localServerTask() {
+  uint16_t servedSeq[LOCAL_SERVER_MAX_CLIENTS] = { 0 };
+
+  while (true) {
+    // Accept new readers into a free slot (mbed core: available() returns
+    // newly accepted connections only)
+    EthernetClient newClient = localEthServer.available();
+    if (newClient) {
+      int slot = -1;
+      for (int i = 0; i < LOCAL_SERVER_MAX_CLIENTS; i++) {
+        if (!localClients[i].connected()) {
+          slot = i;
+          break;
+        }
+      }
+      if (slot >= 0) {
+        localClients[slot] = newClient;
+        localServers[slot].accept(localClients[slot]);
+        servedSeq[slot] = 0;
+      } else {
+        newClient.stop();  // All slots busy
+      }
+    }
+
+    for (int i = 0; i < LOCAL_SERVER_MAX_CLIENTS; i++) {
+      if (!localClients[i].connected()) {
+        continue;
+      }
+
+      // Refresh this instance's registers if a new snapshot is available
+      snapshotMutex.lock();
+      if (servedSeq[i] != snapshotSeq) {
+        for (int r = 0; r < LOCAL_SERVER_REGISTERS; r++) {
+          localServers[i].holdingRegisterWrite(r, snapshot[r]);
+        }
+        servedSeq[i] = snapshotSeq;
+      }
+      snapshotMutex.unlock();
+
+      if (localServers[i].poll()) {
+        localRequests++;
+      }
+    }
+
+    rtos::ThisThread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
 /**
  * Print statistics summary
  */
@@ -283,13 +557,37 @@ void printStatistics() {
   Serial.println(totalWrites);
   Serial.print("  Total Errors:              ");
   Serial.println(totalErrors);
+  Serial.print("  Skipped (unchanged frame): ");
+  Serial.println(totalSkipped);
 
-  if (totalReads > 0) {
-    float successRate = (float)totalWrites / totalReads * 100.0;
+  if (totalReads > totalSkipped) {
+    float successRate = (float)totalWrites / (totalReads - totalSkipped) * 100.0;
     Serial.print("  Success Rate:              ");
     Serial.print(successRate, 1);
     Serial.println("%");
   }
 
+  if (TIME_SYNC_ENABLED && clockSynced) {
+    Serial.print("  Clock Offset to RPI#1:     ");
+    Serial.print((double)clockOffsetUs / 1000.0, 3);
+    Serial.print(" ms (RTT ");
+    Serial.print(clockRttUs);
+    Serial.print(" us, syncs: ");
+    Serial.print(totalTimeSyncs);
+    Serial.println(")");
+  }
+
+  if (LOCAL_SERVER_ENABLED) {
+    int readers = 0;
+    for (int i = 0; i < LOCAL_SERVER_MAX_CLIENTS; i++) {
+      if (localClients[i].connected()) readers++;
+    }
+    Serial.print("  Local Server Requests:     ");
+    Serial.print(localRequests);
+    Serial.print(" (");
+    Serial.print(readers);
+    Serial.println(" readers)");
+  }
+
   Serial.println("========================================\n");
 }
@@ -5,10 +5,18 @@ This script:
 1. Loads weather data from Excel file
 2. Runs pvlib ModelChain to simulate PV system
 3. Generates C header file with PV data array for ESP32
-
-Output: pv_data.h containing struct array stored in PROGMEM (Flash memory)
+4. Exports fixed-point PV model coefficients and a compact input stream for
+   the on-device model (PV_SOURCE_MODEL in esp32/include/config.h), and
+   validates the integer model against the ModelChain output
+
+Output:
+  pv_data.h          - struct array stored in PROGMEM (Flash memory)
+  pv_input.h         - packed 6-byte irradiance/temperature records (model mode)
+  pv_model_coeffs.h  - module/inverter/temperature coefficients (model mode)
 """
 
+import math
+import numpy as np
 import pandas as pd
 import pvlib
 from pvlib import location as pvlocation, modelchain, pvsystem
@@ -17,6 +25,15 @@ import os
 # Configuration
 EXCEL_PATH = "../../weather_washingtonDC_2016.xlsx"
 OUTPUT_PATH = "output/pv_data.h"
+MODEL_INPUT_PATH = "output/pv_input.h"
+MODEL_COEFFS_PATH = "output/pv_model_coeffs.h"
+
+# Fixed-point model LUT grids (must match esp32/include/pv_model.h)
+WIND_LUT_SIZE = 256        # wind codes 0..255 (m/s × 10)
+IRR_LUT_STEP = 50          # W/m²
+IRR_LUT_SIZE = 31          # 0..1500 W/m²
+INV_LUT_STEP = 0.05        # fraction of P_dco
+INV_LUT_SIZE = 25          # 0..1.2 × P_dco
 
 # Encoding functions (same as system_v1)
 def u16(x: int) -> int:
@@ -77,12 +94,8 @@ def build_weather_df(excel_path: str) -> pd.DataFrame:
     return weather_df
 
 
-def precompute_pv_timeseries(weather_df: pd.DataFrame) -> pd.DataFrame:
-    """
-    Run pvlib ModelChain to simulate PV system output.
-
-    Copied from system_v1/modbus_client_tls.py:72-132
-    """
+def load_pv_components():
+    """Module, inverter and temperature model parameters used by the simulation"""
     cec_modules = pvlib.pvsystem.retrieve_sam("cecmod")
     cec_inverters = pvlib.pvsystem.retrieve_sam("cecinverter")
     module = cec_modules["Znshine_PV_Tech_ZXP6_72_295_P"]
@@ -90,6 +103,19 @@ def precompute_pv_timeseries(weather_df: pd.DataFrame) -> pd.DataFrame:
 
     temp_params = pvlib.temperature.TEMPERATURE_MODEL_PARAMETERS["sapm"]["open_rack_glass_glass"]
 
+    return module, inverter, temp_params
+
+
+def precompute_pv_timeseries(weather_df: pd.DataFrame) -> pd.DataFrame:
+    """
+    Run pvlib ModelChain to simulate PV system output.
+
+    Copied from system_v1/modbus_client_tls.py:72-132
+    Additionally keeps the model inputs (POA, effective irradiance, ambient
+    temperature, wind) needed by the on-device model.
+    """
+    module, inverter, temp_params = load_pv_components()
+
     loc = pvlocation.Location(
         latitude=38.9072,
         longitude=-77.0369,
@@ -130,6 +156,10 @@ def precompute_pv_timeseries(weather_df: pd.DataFrame) -> pd.DataFrame:
         # fallback if not produced
         tcell = pd.Series(0.0, index=pac.index)
 
+    # Model inputs (on-device model)
+    poa = mc.results.total_irrad["poa_global"].reindex(pac.index).fillna(0.0)
+    e_eff = mc.results.effective_irradiance.reindex(pac.index).fillna(0.0)
+
     out = pd.DataFrame(
         {
             "P_ac": pac.astype(float),
@@ -138,6 +168,10 @@ def precompute_pv_timeseries(weather_df: pd.DataFrame) -> pd.DataFrame:
             "I_dc": idc.astype(float),
             "G": G.astype(float),
             "T_cell": tcell.astype(float),
+            "POA": poa.astype(float),
+            "E_eff": e_eff.astype(float),
+            "T_air": weather_df["temp_air"].reindex(pac.index).fillna(0.0).astype(float),
+            "WS": weather_df["wind_speed"].reindex(pac.index).fillna(0.0).astype(float),
         },
         index=pac.index,
     )
@@ -150,7 +184,7 @@ def generate_c_header(series: pd.DataFrame, output_path: str):
     Generate C header file with PV data array for ESP32.
 
     Format:
-    - struct PVSample with 7 fields (P_ac, P_dc, V_dc, I_dc, G, T_cell, timestamp)
+    - PVSample records (pv_sample.h: P_ac, P_dc, V_dc, I_dc, G, T_cell, timestamp)
     - const array stored in PROGMEM (Flash memory)
     - Register encoding applied (V_dc×10, I_dc×100, T_cell×10)
     """
@@ -164,7 +198,8 @@ def generate_c_header(series: pd.DataFrame, output_path: str):
         f.write("#define PV_DATA_H\n\n")
 
         # Includes
-        f.write("#include <Arduino.h>\n\n")
+        f.write("#include <Arduino.h>\n")
+        f.write("#include \"pv_sample.h\"\n\n")
 
         # Documentation
         f.write("/**\n")
@@ -181,17 +216,6 @@ def generate_c_header(series: pd.DataFrame, output_path: str):
         f.write(" * Memory usage: ~{} KB\n".format(len(series) * 14 // 1024))
         f.write(" */\n\n")
 
-        # Struct definition
-        f.write("struct PVSample {\n")
-        f.write("    uint16_t P_ac;      // AC Power (W)\n")
-        f.write("    uint16_t P_dc;      // DC Power (W)\n")
-        f.write("    uint16_t V_dc;      // DC Voltage (V × 10)\n")
-        f.write("    uint16_t I_dc;      // DC Current (A × 100)\n")
-        f.write("    uint16_t G;         // Irradiance (W/m²)\n")
-        f.write("    uint16_t T_cell;    // Cell Temperature (°C × 10)\n")
-        f.write("    uint32_t timestamp; // Unix seconds\n")
-        f.write("};\n\n")
-
         # Array size constant
         f.write(f"const uint16_t PV_DATA_COUNT = {len(series)};\n\n")
 
@@ -224,6 +248,255 @@ def generate_c_header(series: pd.DataFrame, output_path: str):
     print(f"✓ Output: {output_path}")
 
 
+# ----------------------------
+# ON-DEVICE FIXED-POINT MODEL
+# ----------------------------
+def cdiv(a: int, b: int) -> int:
+    """C integer division (truncates toward zero)"""
+    q = abs(a) // abs(b)
+    return q if (a >= 0) == (b >= 0) else -q
+
+
+def fit_model_coefficients(module, inverter, temp_params) -> dict:
+    """
+    Derive fixed-point coefficients for the on-device model.
+
+    Module: CEC single-diode model evaluated on an irradiance grid at 25 °C
+    (relative efficiency and V_mp ratio) plus linear temperature coefficients.
+    Inverter: Sandia efficiency curve evaluated at nominal DC voltage.
+    """
+    def mpp(e, t):
+        params = pvsystem.calcparams_cec(
+            effective_irradiance=np.asarray(e, dtype=float),
+            temp_cell=t,
+            alpha_sc=module["alpha_sc"],
+            a_ref=module["a_ref"],
+            I_L_ref=module["I_L_ref"],
+            I_o_ref=module["I_o_ref"],
+            R_sh_ref=module["R_sh_ref"],
+            R_s=module["R_s"],
+            Adjust=module["Adjust"],
+        )
+        sd = pvsystem.singlediode(*params)
+        return np.asarray(sd["p_mp"], dtype=float), np.asarray(sd["v_mp"], dtype=float)
+
+    # Reference point (STC) and temperature coefficients
+    p_ref, v_ref = mpp([1000.0], 25.0)
+    p_hot, v_hot = mpp([1000.0], 50.0)
+    pdc0 = float(p_ref[0])
+    vmp_ref = float(v_ref[0])
+    gamma = (float(p_hot[0]) / pdc0 - 1.0) / 25.0
+    beta_vmp = (float(v_hot[0]) / vmp_ref - 1.0) / 25.0
+
+    # Irradiance dependence at 25 °C (grid point 0 evaluated at 1 W/m²)
+    e_grid = np.maximum(np.arange(IRR_LUT_SIZE) * IRR_LUT_STEP, 1.0)
+    p_grid, v_grid = mpp(e_grid, 25.0)
+    k_irr = p_grid / (pdc0 * e_grid / 1000.0)
+    v_irr = v_grid / vmp_ref
+
+    # SAPM temperature model: exp(a + b·WS) over wind codes (m/s × 10)
+    wind = np.arange(WIND_LUT_SIZE) / 10.0
+    wind_lut = np.exp(temp_params["a"] + temp_params["b"] * wind)
+
+    # Inverter efficiency curve
+    pdco = float(inverter["Pdco"])
+    x_grid = np.maximum(np.arange(INV_LUT_SIZE) * INV_LUT_STEP, INV_LUT_STEP)
+    pac_grid = pvlib.inverter.sandia(float(inverter["Vdco"]), x_grid * pdco, inverter)
+    eta = np.clip(np.asarray(pac_grid, dtype=float) / (x_grid * pdco), 0.0, 1.0)
+
+    def q(values, frac_bits):
+        scaled = np.round(np.asarray(values) * (1 << frac_bits)).astype(int)
+        if scaled.min() < 0 or scaled.max() > 0xFFFF:
+            raise ValueError(f"coefficient out of uint16 Q{frac_bits} range")
+        return [int(v) for v in scaled]
+
+    return {
+        "pdc0_mw": int(round(pdc0 * 1000)),
+        "gamma_ppm": int(round(gamma * 1e6)),
+        "vmp_ref_mv": int(round(vmp_ref * 1000)),
+        "beta_vmp_ppm": int(round(beta_vmp * 1e6)),
+        "irr_step": IRR_LUT_STEP,
+        "k_irr_q15": q(k_irr, 15),
+        "v_irr_q15": q(v_irr, 15),
+        "delta_t_x10": int(round(temp_params["deltaT"] * 10)),
+        "wind_q20": q(wind_lut, 20),
+        "paco_mw": int(round(float(inverter["Paco"]) * 1000)),
+        "pdco_mw": int(round(pdco * 1000)),
+        "pso_mw": int(round(float(inverter["Pso"]) * 1000)),
+        "eta_q15": q(eta, 15),
+    }
+
+
+def pack_model_input(series: pd.DataFrame) -> list:
+    """Pack model inputs into 6-byte records (layout: PVInputSample in pv_model.h)"""
+    records = []
+    for _, row in series.iterrows():
+        poa = max(0, min(0xFFF, int(round(row["POA"]))))
+        ghi = max(0, min(0xFFF, int(round(row["G"]))))
+        iam = 255 if row["POA"] <= 0 else max(0, min(255, int(round(row["E_eff"] / row["POA"] * 255))))
+        t_air = max(-128, min(127, int(round(row["T_air"] * 2))))
+        wind = max(0, min(255, int(round(row["WS"] * 10))))
+        packed = poa | (ghi << 12)
+        records.append((packed & 0xFF, (packed >> 8) & 0xFF, (packed >> 16) & 0xFF, iam, t_air & 0xFF, wind))
+    return records
+
+
+def fixed_point_model(p: dict, rec) -> tuple:
+    """
+    Python mirror of pvModelCompute() (esp32/src/pv_model.cpp).
+
+    Returns register-encoded (P_ac, P_dc, V_dc, I_dc, G, T_cell).
+    """
+    def interp(lut, x_q16):
+        i = x_q16 >> 16
+        if i >= len(lut) - 1:
+            return lut[-1]
+        return lut[i] + (((lut[i + 1] - lut[i]) * (x_q16 & 0xFFFF)) >> 16)
+
+    def clamp(v):
+        return max(0, min(65535, v))
+
+    packed = rec[0] | (rec[1] << 8) | (rec[2] << 16)
+    poa = packed & 0xFFF
+    ghi = packed >> 12
+    eff = poa * rec[3] // 255
+    t_air = rec[4] - 256 if rec[4] > 127 else rec[4]
+    tair_x10 = t_air * 5
+
+    tm_x10 = tair_x10 + ((poa * p["wind_q20"][rec[5]] * 10) >> 20)
+    tc_x10 = tm_x10 + cdiv(poa * p["delta_t_x10"], 1000)
+    dt_x10 = tc_x10 - 250
+
+    pdc_mw = vmp_mv = imp_ma = 0
+    if eff > 0:
+        x_q16 = (eff << 16) // p["irr_step"]
+        pdc = p["pdc0_mw"] * eff // 1000
+        pdc = (pdc * interp(p["k_irr_q15"], x_q16)) >> 15
+        pdc = cdiv(pdc * (1000000 + cdiv(p["gamma_ppm"] * dt_x10, 10)), 1000000)
+        pdc_mw = max(0, pdc)
+
+        vmp = (p["vmp_ref_mv"] * interp(p["v_irr_q15"], x_q16)) >> 15
+        vmp = cdiv(vmp * (1000000 + cdiv(p["beta_vmp_ppm"] * dt_x10, 10)), 1000000)
+        vmp_mv = max(0, vmp)
+
+        if vmp_mv > 0:
+            imp_ma = pdc_mw * 1000 // vmp_mv
+
+    pac_mw = 0
+    if pdc_mw > p["pso_mw"]:
+        load_q16 = ((pdc_mw << 16) * 20) // p["pdco_mw"]
+        pac_mw = min((pdc_mw * interp(p["eta_q15"], load_q16)) >> 15, p["paco_mw"])
+
+    return (
+        clamp((pac_mw + 500) // 1000),
+        clamp((pdc_mw + 500) // 1000),
+        clamp((vmp_mv + 50) // 100),
+        clamp((imp_ma + 5) // 10),
+        clamp(ghi),
+        clamp(tc_x10),
+    )
+
+
+def validate_fixed_point_model(series: pd.DataFrame, params: dict, records: list):
+    """Compare the integer model against the pvlib ModelChain output (register units)"""
+    reference = np.column_stack([
+        np.clip(np.round(series["P_ac"]), 0, 65535),
+        np.clip(np.round(series["P_dc"]), 0, 65535),
+        np.clip(np.round(series["V_dc"] * 10), 0, 65535),
+        np.clip(np.round(series["I_dc"] * 100), 0, 65535),
+        np.clip(np.round(series["G"]), 0, 65535),
+        np.clip(np.round(series["T_cell"] * 10), 0, 65535),
+    ])
+    model = np.array([fixed_point_model(params, rec) for rec in records], dtype=float)
+    err = model - reference
+
+    names = ["P_ac (W)", "P_dc (W)", "V_dc (V×10)", "I_dc (A×100)", "G (W/m²)", "T_cell (°C×10)"]
+    for i, name in enumerate(names):
+        print(f"   {name:15s} MAE={np.abs(err[:, i]).mean():7.2f}  max={np.abs(err[:, i]).max():7.1f}")
+
+    e_ref = reference[:, 0].sum() / 1000.0
+    e_model = model[:, 0].sum() / 1000.0
+    print(f"   Annual AC energy: pvlib={e_ref:.1f} kWh  model={e_model:.1f} kWh "
+          f"({(e_model - e_ref) / e_ref * 100 if e_ref else 0.0:+.2f}%)")
+
+
+def generate_model_headers(series: pd.DataFrame, params: dict, records: list,
+                           input_path: str, coeffs_path: str):
+    """
+    Generate headers for the on-device model.
+
+    pv_input.h:        packed input stream (PROGMEM) + implicit timestamps
+    pv_model_coeffs.h: PVModelParams defaults (PROGMEM, copied to RAM at boot)
+    """
+    print(f"Generating model input header: {input_path}")
+    os.makedirs(os.path.dirname(input_path), exist_ok=True)
+
+    start = int(series.index[0].timestamp())
+    step = int((series.index[1] - series.index[0]).total_seconds())
+
+    with open(input_path, 'w') as f:
+        f.write("#ifndef PV_INPUT_H\n")
+        f.write("#define PV_INPUT_H\n\n")
+        f.write("#include <Arduino.h>\n")
+        f.write("#include \"pv_model.h\"\n\n")
+        f.write("/**\n")
+        f.write(" * Compact PV model input stream for ESP32 solar inverter simulator\n")
+        f.write(" * \n")
+        f.write(" * Generated from weather_washingtonDC_2016.xlsx (POA transposition by pvlib)\n")
+        f.write(" * Record layout: see PVInputSample in pv_model.h\n")
+        f.write(" * Timestamps are implicit: PV_INPUT_START + index × PV_INPUT_STEP_S\n")
+        f.write(" * Total samples: {}\n".format(len(records)))
+        f.write(" * Memory usage: ~{} KB\n".format(len(records) * 6 // 1024))
+        f.write(" */\n\n")
+        f.write(f"const uint16_t PV_INPUT_COUNT = {len(records)};\n")
+        f.write(f"const uint32_t PV_INPUT_START = {start}UL;\n")
+        f.write(f"const uint32_t PV_INPUT_STEP_S = {step}UL;\n\n")
+        f.write("#ifdef PV_INPUT_IMPLEMENTATION\n")
+        f.write("const PVInputSample PV_INPUT[] PROGMEM = {\n")
+        for rec in records:
+            f.write("    {{" + ", ".join(str(b) for b in rec) + "}},\n")
+        f.write("};\n")
+        f.write("#endif // PV_INPUT_IMPLEMENTATION\n\n")
+        f.write("#endif // PV_INPUT_H\n")
+
+    print(f"Generating model coefficients header: {coeffs_path}")
+
+    def lut(values):
+        return "{" + ", ".join(str(v) for v in values) + "}"
+
+    with open(coeffs_path, 'w') as f:
+        f.write("#ifndef PV_MODEL_COEFFS_H\n")
+        f.write("#define PV_MODEL_COEFFS_H\n\n")
+        f.write("#include <Arduino.h>\n")
+        f.write("#include \"pv_model.h\"\n\n")
+        f.write("/**\n")
+        f.write(" * Fixed-point PV model coefficients (defaults for pvModelParams)\n")
+        f.write(" * \n")
+        f.write(" * Module: Znshine_PV_Tech_ZXP6_72_295_P (CEC single-diode fit)\n")
+        f.write(" * Inverter: ABB MICRO_0_3_I_OUTD_US_208 (Sandia efficiency curve)\n")
+        f.write(" * Temperature model: SAPM open_rack_glass_glass\n")
+        f.write(" */\n\n")
+        f.write("const PVModelParams PV_MODEL_DEFAULTS PROGMEM = {\n")
+        f.write(f"    {params['pdc0_mw']},  // pdc0_mw\n")
+        f.write(f"    {params['gamma_ppm']},  // gamma_ppm\n")
+        f.write(f"    {params['vmp_ref_mv']},  // vmp_ref_mv\n")
+        f.write(f"    {params['beta_vmp_ppm']},  // beta_vmp_ppm\n")
+        f.write(f"    {params['irr_step']},  // irr_step\n")
+        f.write(f"    {lut(params['k_irr_q15'])},  // k_irr_q15\n")
+        f.write(f"    {lut(params['v_irr_q15'])},  // v_irr_q15\n")
+        f.write(f"    {params['delta_t_x10']},  // delta_t_x10\n")
+        f.write(f"    {lut(params['wind_q20'])},  // wind_q20\n")
+        f.write(f"    {params['paco_mw']},  // paco_mw\n")
+        f.write(f"    {params['pdco_mw']},  // pdco_mw\n")
+        f.write(f"    {params['pso_mw']},  // pso_mw\n")
+        f.write(f"    {lut(params['eta_q15'])},  // eta_q15\n")
+        f.write("};\n\n")
+        f.write("#endif // PV_MODEL_COEFFS_H\n")
+
+    print(f"✓ Input stream: {len(records) * 6} bytes ({len(records) * 6 // 1024} KB) "
+          f"vs table {len(records) * 16} bytes")
+
+
 def main():
     print("=" * 80)
     print("ESP32 PV Data Generator")
@@ -255,8 +528,19 @@ def main():
     print(f"\n4. Generating C header file...")
     generate_c_header(series, OUTPUT_PATH)
 
-    print(f"\n5. Next Steps:")
+    print(f"\n5. Exporting on-device model (coefficients + input stream)...")
+    module, inverter, temp_params = load_pv_components()
+    params = fit_model_coefficients(module, inverter, temp_params)
+    records = pack_model_input(series)
+    generate_model_headers(series, params, records, MODEL_INPUT_PATH, MODEL_COEFFS_PATH)
+
+    print(f"\n6. Validating fixed-point model against pvlib (register units):")
+    validate_fixed_point_model(series, params, records)
+
+    print(f"\n7. Next Steps:")
     print(f"   - Copy {OUTPUT_PATH} to system_v2/esp32/include/pv_data.h")
+    print(f"   - Model mode: copy {MODEL_INPUT_PATH} and {MODEL_COEFFS_PATH} to system_v2/esp32/include/")
+    print(f"     and set PV_SOURCE_MODEL true in config.h")
     print(f"   - Use in ESP32 firmware: #include \"pv_data.h\"")
     print(f"   - Access samples: memcpy_P(&sample, &PV_DATA[index], sizeof(PVSample))")
 
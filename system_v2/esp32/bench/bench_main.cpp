@@ -0,0 +1,377 @@
+/**
+ * ESP32 On-Target Micro-Benchmarks (PlatformIO env: esp32bench)
+ *
+ * Times the per-sample hot path of the inverter simulator on the real chip
+ * with the CPU cycle counter (CCOUNT), so optimisations are measured on the
+ * MCU instead of estimated from host runs.
+ *
+ * Benchmarks:
+ *   sample_fetch     memcpy_P of one PVSample from Flash (PV_DATA table only)
+ *   model_compute    PROGMEM input fetch + pvModelCompute() (PV_SOURCE_MODEL only)
+ *   profile_decode   PVSample → engineering units (float), as in the debug path
+ *   register_encode  PVSample → 8 Modbus holding registers
+ *   tls_record_enc   AES-128-GCM record protection of the 8-register FC16 ADU
+ *                    (TLS 1.2 record: 5-byte header, 8-byte explicit nonce, 16-byte tag)
+ *   modbus_loopback  writeHreg of 8 registers to a ModbusIP server on 127.0.0.1
+ *   tls_handshake_*  Full TLS handshake with RPI#1 (needs WiFi + running server),
+ *                    per server authentication mode:
+ *                      none   no verification (previous default)
+ *                      pin    no path validation + SPKI SHA-256 pin (tls_pin.h)
+ *                      chain  X.509 path validation against TLS_SERVER_CERT
+ *
+ * Output (one line per benchmark, after a "BENCH_BEGIN" header):
+ *   BENCH,<name>,<iterations>,<min_cycles>,<median_cycles>,<mean_cycles>,<median_ns>
+ *   BENCH_END
+ *
+ * Usage:
+ *   pio run -e esp32bench --target upload && pio device monitor -e esp32bench
+ */
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <ModbusIP_ESP8266.h>
+#include "mbedtls/gcm.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/net_sockets.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/ctr_drbg.h"
+#include "config.h"
+#include "tls_cert.h"
+#include "tls_pin.h"
+
+#if PV_SOURCE_MODEL
+#include "pv_model.h"
+#include "pv_input.h"
+#define PV_SAMPLE_COUNT PV_INPUT_COUNT
+#else
+#include "pv_data.h"
+#define PV_SAMPLE_COUNT PV_DATA_COUNT
+#endif
+
+#define BENCH_ITERATIONS 1000
+#define BENCH_LOOPBACK_ITERATIONS 200
+#define BENCH_HANDSHAKE_ITERATIONS 20
+#define BENCH_WIFI_TIMEOUT_MS 15000
+
+static uint32_t samples[BENCH_ITERATIONS];
+static uint32_t overheadCycles = 0;
+
+// Keeps results observable so the compiler cannot drop the benchmarked work
+static volatile uint32_t sink;
+
+static inline uint32_t cycles() {
+    return ESP.getCycleCount();
+}
+
+static int compareU32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Sort samples, subtract timer overhead and print one result line
+ */
+static void report(const char* name, int n) {
+    uint64_t sum = 0;
+    for (int i = 0; i < n; i++) {
+        samples[i] = samples[i] > overheadCycles ? samples[i] - overheadCycles : 0;
+        sum += samples[i];
+    }
+    qsort(samples, n, sizeof(uint32_t), compareU32);
+
+    uint32_t median = samples[n / 2];
+    uint32_t mhz = ESP.getCpuFreqMHz();
+    Serial.printf("BENCH,%s,%d,%u,%u,%u,%u\n", name, n, samples[0], median,
+                  (uint32_t)(sum / n), (uint32_t)((uint64_t)median * 1000 / mhz));
+}
+
+/**
+ * Time fn(i) once per iteration
+ */
+template <typename F>
+static void run(const char* name, int n, F fn) {
+    for (int i = 0; i < n; i++) {
+        uint32_t start = cycles();
+        fn(i);
+        samples[i] = cycles() - start;
+    }
+    report(name, n);
+}
+
+static void fetchSample(int i, PVSample* out) {
+#if PV_SOURCE_MODEL
+    pvModelCompute(&pvModelParams, (i * 97) % PV_SAMPLE_COUNT, out);
+#else
+    memcpy_P(out, &PV_DATA[(i * 97) % PV_SAMPLE_COUNT], sizeof(PVSample));
+#endif
+}
+
+static void encodeRegisters(const PVSample& sample, uint16_t* registers) {
+    registers[0] = sample.P_ac;
+    registers[1] = sample.P_dc;
+    registers[2] = sample.V_dc;
+    registers[3] = sample.I_dc;
+    registers[4] = sample.G;
+    registers[5] = sample.T_cell;
+    registers[6] = (sample.timestamp >> 16) & 0xFFFF;
+    registers[7] = sample.timestamp & 0xFFFF;
+}
+
+static void benchCalibrate() {
+    // Cost of the timing itself (two CCOUNT reads)
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        uint32_t start = cycles();
+        samples[i] = cycles() - start;
+    }
+    qsort(samples, BENCH_ITERATIONS, sizeof(uint32_t), compareU32);
+    overheadCycles = samples[0];
+    Serial.printf("BENCH_OVERHEAD,%u\n", overheadCycles);
+}
+
+static void benchSampleFetch() {
+#if !PV_SOURCE_MODEL
+    PVSample sample;
+    run("sample_fetch", BENCH_ITERATIONS, [&](int i) {
+        memcpy_P(&sample, &PV_DATA[(i * 97) % PV_SAMPLE_COUNT], sizeof(PVSample));
+        sink = sample.timestamp;
+    });
+#else
+    // PV_INPUT is private to pv_model.cpp: the 6-byte fetch is timed as part of the model
+    PVSample sample;
+    run("model_compute", BENCH_ITERATIONS, [&](int i) {
+        pvModelCompute(&pvModelParams, (i * 97) % PV_SAMPLE_COUNT, &sample);
+        sink = sample.P_ac;
+    });
+#endif
+}
+
+static void benchProfileDecode() {
+    PVSample sample;
+    fetchSample(4000, &sample);
+    run("profile_decode", BENCH_ITERATIONS, [&](int i) {
+        volatile float v = sample.V_dc / 10.0f;
+        volatile float a = sample.I_dc / 100.0f;
+        volatile float t = sample.T_cell / 10.0f;
+        (void)v; (void)a; (void)t;
+    });
+}
+
+static void benchRegisterEncode() {
+    PVSample sample;
+    uint16_t registers[8];
+    fetchSample(4000, &sample);
+    run("register_encode", BENCH_ITERATIONS, [&](int i) {
+        sample.timestamp += i;
+        encodeRegisters(sample, registers);
+        sink = registers[7];
+    });
+}
+
+static void benchTlsRecord() {
+    // FC16 ADU for 8 registers: MBAP (7) + FC/addr/count/bytes (6) + data (16)
+    uint8_t adu[29];
+    memset(adu, 0x5A, sizeof(adu));
+    uint8_t out[sizeof(adu)];
+    uint8_t tag[16];
+    uint8_t key[16] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 };
+    uint8_t aad[13] = { 0 };      // seq_num (8) + type + version (2) + length (2)
+    uint8_t nonce[12] = { 0 };    // implicit IV (4) + explicit nonce (8)
+
+    mbedtls_gcm_context gcm;
+    mbedtls_gcm_init(&gcm);
+    mbedtls_gcm_setkey(&gcm, MBEDTLS_CIPHER_ID_AES, key, 128);
+
+    run("tls_record_enc", BENCH_ITERATIONS, [&](int i) {
+        nonce[11] = i & 0xFF;
+        aad[7] = i & 0xFF;
+        mbedtls_gcm_crypt_and_tag(&gcm, MBEDTLS_GCM_ENCRYPT, sizeof(adu), nonce, sizeof(nonce),
+                                  aad, sizeof(aad), adu, out, sizeof(tag), tag);
+        sink = tag[0];
+    });
+
+    mbedtls_gcm_free(&gcm);
+}
+
+static volatile bool loopbackDone = false;
+
+static bool onLoopbackWrite(Modbus::ResultCode event, uint16_t transactionId, void* data) {
+    loopbackDone = true;
+    return true;
+}
+
+static void benchModbusLoopback() {
+    // TCP/IP stack needs a started interface; loopback works without an AP
+    WiFi.mode(WIFI_STA);
+
+    ModbusIP server;
+    ModbusIP client;
+    server.server();
+    server.addHreg(0, 0, 8);
+    client.client();
+
+    IPAddress loopback(127, 0, 0, 1);
+    unsigned long deadline = millis() + 2000;
+    while (!client.isConnected(loopback) && millis() < deadline) {
+        client.connect(loopback);
+        server.task();
+        client.task();
+        delay(10);
+    }
+    if (!client.isConnected(loopback)) {
+        Serial.println("BENCH_SKIP,modbus_loopback,connect failed");
+        return;
+    }
+
+    uint16_t registers[8] = { 250, 260, 485, 536, 850, 456, 0x6580, 0x1234 };
+    run("modbus_loopback", BENCH_LOOPBACK_ITERATIONS, [&](int i) {
+        loopbackDone = false;
+        registers[7] = i;
+        client.writeHreg(loopback, 0, registers, 8, onLoopbackWrite, MODBUS_UNIT_ID);
+        while (!loopbackDone) {
+            server.task();
+            client.task();
+        }
+    });
+
+    client.disconnect(loopback);
+}
+
+static mbedtls_entropy_context entropy;
+static mbedtls_ctr_drbg_context drbg;
+
+/**
+ * The bench has no wall-clock time (no NTP): accept validity-period
+ * failures so the chain mode still measures parsing + signature checks
+ */
+static int ignoreClockFlags(void* ctx, mbedtls_x509_crt* crt, int depth, uint32_t* flags) {
+    *flags &= ~(MBEDTLS_X509_BADCERT_FUTURE | MBEDTLS_X509_BADCERT_EXPIRED);
+    return 0;
+}
+
+/**
+ * One TLS client configuration per server authentication mode
+ */
+static void setupTlsConfig(mbedtls_ssl_config* conf, mbedtls_x509_crt* ca) {
+    mbedtls_ssl_config_init(conf);
+    mbedtls_ssl_config_defaults(conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                MBEDTLS_SSL_PRESET_DEFAULT);
+    mbedtls_ssl_conf_rng(conf, mbedtls_ctr_drbg_random, &drbg);
+    if (ca != nullptr) {
+        mbedtls_ssl_conf_ca_chain(conf, ca, nullptr);
+        mbedtls_ssl_conf_authmode(conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+        mbedtls_ssl_conf_verify(conf, ignoreClockFlags, nullptr);
+    } else {
+        mbedtls_ssl_conf_authmode(conf, MBEDTLS_SSL_VERIFY_NONE);
+    }
+}
+
+/**
+ * Time BENCH_HANDSHAKE_ITERATIONS fresh handshakes (TCP connect not included)
+ */
+static void runHandshakes(const char* name, mbedtls_ssl_config* conf, bool pin) {
+    char port[6];
+    snprintf(port, sizeof(port), "%u", RPI1_PORT);
+
+    for (int i = 0; i < BENCH_HANDSHAKE_ITERATIONS; i++) {
+        mbedtls_net_context net;
+        mbedtls_ssl_context ssl;
+        mbedtls_net_init(&net);
+        mbedtls_ssl_init(&ssl);
+        mbedtls_ssl_setup(&ssl, conf);
+        mbedtls_ssl_set_hostname(&ssl, TLS_SERVER_NAME);
+
+        int ret = mbedtls_net_connect(&net, RPI1_IP, port, MBEDTLS_NET_PROTO_TCP);
+        if (ret == 0) {
+            mbedtls_ssl_set_bio(&ssl, &net, mbedtls_net_send, mbedtls_net_recv, nullptr);
+
+            uint32_t start = cycles();
+            do {
+                ret = mbedtls_ssl_handshake(&ssl);
+            } while (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE);
+            if (ret == 0 && pin && !tlsPinMatches(mbedtls_ssl_get_peer_cert(&ssl), TLS_SERVER_SPKI_SHA256)) {
+                ret = -1;
+            }
+            samples[i] = cycles() - start;
+
+            mbedtls_ssl_close_notify(&ssl);
+        }
+
+        mbedtls_ssl_free(&ssl);
+        mbedtls_net_free(&net);
+
+        if (ret != 0) {
+            Serial.printf("BENCH_SKIP,%s,handshake failed (%d)\n", name, ret);
+            return;
+        }
+        delay(50);  // Let RPI#1 tear down the previous connection
+    }
+    report(name, BENCH_HANDSHAKE_ITERATIONS);
+}
+
+static void benchTlsHandshake() {
+    WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+    unsigned long deadline = millis() + BENCH_WIFI_TIMEOUT_MS;
+    while (WiFi.status() != WL_CONNECTED && millis() < deadline) {
+        delay(100);
+    }
+    if (WiFi.status() != WL_CONNECTED) {
+        Serial.println("BENCH_SKIP,tls_handshake,WiFi not connected");
+        return;
+    }
+
+    mbedtls_entropy_init(&entropy);
+    mbedtls_ctr_drbg_init(&drbg);
+    mbedtls_ctr_drbg_seed(&drbg, mbedtls_entropy_func, &entropy, nullptr, 0);
+
+    mbedtls_x509_crt ca;
+    mbedtls_x509_crt_init(&ca);
+    mbedtls_x509_crt_parse(&ca, (const unsigned char*)TLS_SERVER_CERT, strlen(TLS_SERVER_CERT) + 1);
+
+    mbedtls_ssl_config noVerify;
+    mbedtls_ssl_config chain;
+    setupTlsConfig(&noVerify, nullptr);
+    setupTlsConfig(&chain, &ca);
+
+    runHandshakes("tls_handshake_none", &noVerify, false);
+    runHandshakes("tls_handshake_pin", &noVerify, true);
+    runHandshakes("tls_handshake_chain", &chain, false);
+
+    // Pin check alone (peer certificate parsed from tls_cert.h)
+    run("tls_pin_check", BENCH_ITERATIONS, [&](int i) {
+        sink = tlsPinMatches(&ca, TLS_SERVER_SPKI_SHA256);
+    });
+
+    mbedtls_ssl_config_free(&chain);
+    mbedtls_ssl_config_free(&noVerify);
+    mbedtls_x509_crt_free(&ca);
+    mbedtls_ctr_drbg_free(&drbg);
+    mbedtls_entropy_free(&entropy);
+}
+
+void setup() {
+    Serial.begin(DEBUG_BAUD_RATE);
+    delay(1000);
+
+#if PV_SOURCE_MODEL
+    pvModelLoadDefaults(&pvModelParams);
+#endif
+
+    Serial.printf("BENCH_BEGIN,cpu_mhz=%u,source=%s,samples=%u\n", ESP.getCpuFreqMHz(),
+                  PV_SOURCE_MODEL ? "model" : "table", (unsigned)PV_SAMPLE_COUNT);
+    Serial.println("BENCH_HEADER,name,iterations,min_cycles,median_cycles,mean_cycles,median_ns");
+
+    benchCalibrate();
+    benchSampleFetch();
+    benchProfileDecode();
+    benchRegisterEncode();
+    benchTlsRecord();
+    benchModbusLoopback();
+    benchTlsHandshake();
+
+    Serial.println("BENCH_END");
+}
+
+void loop() {
+    delay(1000);
+}
@@ -18,18 +18,52 @@
 #define MODBUS_UNIT_ID 1            // Modbus device ID (RPI#1 uses unit-id 1)
 
 // TLS Configuration
-#define TLS_SKIP_VERIFICATION true  // Skip certificate verification (testing mode)
-                                     // Set to false in production with valid CA cert
+#define TLS_VERIFY_NONE 0           // No server authentication (testing only)
+#define TLS_VERIFY_PIN 1            // Server public key must match TLS_SERVER_SPKI_SHA256 (tls_pin.h)
+#define TLS_VERIFY_CHAIN 2          // Full X.509 validation against TLS_SERVER_CERT
+#define TLS_VERIFY_MODE TLS_VERIFY_PIN
+#define TLS_SERVER_NAME "modbus-server"  // CN of the certificate in tls_cert.h
+
+// Transport Selection
+#define MODBUS_TRANSPORT_DTLS false   // true: Modbus/UDP over DTLS 1.2 (modbus_dtls.h)
+                                      // false: Modbus over TLS/TCP (ModbusTLS)
+#define RPI1_DTLS_PORT 802            // UDP port of the RPI#1 DTLS server
+#define DTLS_ACK_TIMEOUT_MS 300       // Wait for write response before retransmitting
+#define DTLS_RETRY_COUNT 5            // Transmissions per frame
+#define DTLS_MAX_FAILED_FRAMES 3      // Unacknowledged frames in a row before re-handshaking
+#define DTLS_HANDSHAKE_MIN_MS 500     // Handshake retransmission timer (doubles up to max)
+#define DTLS_HANDSHAKE_MAX_MS 8000
+#ifndef MODBUS_TRANSPORT_TLS13        // Set by env:esp32tls13 (needs mbedTLS 3.6, core 3.x)
+#define MODBUS_TRANSPORT_TLS13 false  // true: sequenced Modbus over TLS 1.3 (modbus_tls13.h)
+#endif
+#define RPI1_TLS13_PORT 803           // TCP port of the RPI#1 TLS 1.3 server
+#define TLS13_EARLY_DATA true         // Send the first frame after a reconnect as 0-RTT early data
+#define TLS13_RESPONSE_TIMEOUT_MS 3000
 
 // Data Transmission Configuration
 #define SEND_INTERVAL_MS 10000        // 10 seconds between samples
 #define PV_DATA_LOOP true             // Loop through data when reaching end
 
+// PV Data Source
+#define PV_SOURCE_MODEL false         // true: on-device fixed-point model (pv_input.h, ~52 KB)
+                                      // false: replay precomputed table (pv_data.h, ~140 KB)
+
 // Connection Configuration
 #define WIFI_RETRY_DELAY_MS 5000      // Delay between WiFi reconnection attempts
 #define MODBUS_CONNECT_TIMEOUT_MS 10000  // Modbus connection timeout
 #define MODBUS_RETRY_COUNT 3          // Number of retries for Modbus writes
 
+// Runtime Profiling (rtos_stats.h)
+#define RTOS_STATS_ENABLED true       // Publish CPU/stack/heap status block to RPI#1
+#define RTOS_STATS_INTERVAL_MS 60000  // Collection period (CPU % averaged over it)
+
+// Time Service (time_sync.h): clock offset to RPI#1, ModbusTLS transport only
+#define TIME_SYNC_ENABLED true        // Estimate offset to RPI#1 and write a clock report
+#define TIME_SYNC_INTERVAL_MS 60000   // One burst per interval (first burst after connect)
+#define TIME_SYNC_SAMPLES 8           // Exchanges per burst (lowest RTT kept)
+#define TIME_SYNC_TIMEOUT_MS 1000     // Per exchange: a slower response is not used as a sample
+#define CLOCK_REPORT_REGISTER 40      // Clock report block on RPI#1 (6 registers)
+
 // Debug Configuration
 #define DEBUG_ENABLED true            // Enable serial debug output
 #define DEBUG_BAUD_RATE 115200        // Serial monitor baud rate
@@ -0,0 +1,99 @@
+#ifndef MODBUS_DTLS_H
+#define MODBUS_DTLS_H
+
+#include <Arduino.h>
+#include "mbedtls/ssl.h"
+#include "mbedtls/net_sockets.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/x509_crt.h"
+
+/**
+ * Modbus/UDP client secured with DTLS 1.2 (mbedTLS)
+ *
+ * Alternative to ModbusTLS for lossy WiFi: every telemetry frame is one
+ * independent datagram, so a lost packet only delays that frame (no
+ * head-of-line blocking), and a WiFi blip does not tear down the DTLS
+ * session (UDP has no connection state to lose).
+ *
+ * Framing: MBAP header + PDU per datagram (Modbus/UDP). The MBAP
+ * transaction id carries an application-level frame sequence number:
+ * retransmissions reuse it, and RPI#1 acknowledges duplicates or stale
+ * frames without applying them again (idempotent writes).
+ */
+
+struct DTLSTimer {
+    unsigned long start;
+    uint32_t intMs;
+    uint32_t finMs;
+};
+
+class ModbusDTLSClient {
+public:
+    ModbusDTLSClient();
+    ~ModbusDTLSClient();
+
+    /**
+     * Set server address and server authentication
+     * caPem: PEM certificate for X.509 path validation, or nullptr
+     * pinSha256: SPKI SHA-256 pin checked after the handshake (tls_pin.h), or nullptr
+     * Neither set: no server authentication (testing only)
+     */
+    void begin(const char* host, uint16_t port, const char* caPem, const uint8_t* pinSha256 = nullptr);
+
+    /**
+     * Open the UDP socket and run the DTLS handshake (resumes the previous
+     * session if the server still has it)
+     */
+    bool connect();
+
+    /**
+     * FC16 write with retransmission; seq identifies the frame
+     * count must be 1..123 (false otherwise, nothing is sent).
+     * Returns true once RPI#1 acknowledged the frame (or a duplicate of it).
+     * After DTLS_MAX_FAILED_FRAMES unacknowledged frames in a row the session
+     * is considered dead (server restarted or expired it without a
+     * close_notify getting through): isConnected() turns false and the next
+     * connect() offers the session for resumption.
+     */
+    bool writeRegisters(uint8_t unitId, uint16_t address, const uint16_t* values,
+                        uint16_t count, uint16_t seq);
+
+    void close();
+    bool isConnected() const { return _connected; }
+
+    // Statistics
+    uint32_t lastHandshakeMs() const { return _lastHandshakeMs; }
+    uint32_t lastWriteMs() const { return _lastWriteMs; }
+    unsigned long handshakes() const { return _handshakes; }
+    unsigned long retransmissions() const { return _retransmissions; }
+
+private:
+    static void timerSet(void* ctx, uint32_t intMs, uint32_t finMs);
+    static int timerGet(void* ctx);
+
+    const char* _host;
+    char _port[6];
+    bool _verify;
+    const uint8_t* _pin;
+    bool _initialized;
+    bool _connected;
+    bool _haveSession;
+    uint8_t _failedFrames;
+
+    mbedtls_net_context _net;
+    mbedtls_ssl_context _ssl;
+    mbedtls_ssl_config _conf;
+    mbedtls_ssl_session _session;
+    mbedtls_entropy_context _entropy;
+    mbedtls_ctr_drbg_context _drbg;
+    mbedtls_x509_crt _ca;
+    DTLSTimer _timer;
+
+    uint32_t _lastHandshakeMs;
+    uint32_t _lastWriteMs;
+    unsigned long _handshakes;
+    unsigned long _retransmissions;
+};
+
+#endif // MODBUS_DTLS_H
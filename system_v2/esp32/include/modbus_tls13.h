@@ -0,0 +1,94 @@
+#ifndef MODBUS_TLS13_H
+#define MODBUS_TLS13_H
+
+#include <Arduino.h>
+#include "mbedtls/ssl.h"
+#include "mbedtls/net_sockets.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/x509_crt.h"
+
+/**
+ * Sequenced Modbus/TCP client over TLS 1.3 with PSK resumption (mbedTLS 3.6)
+ *
+ * Keeps the NewSessionTicket of the last connection. After a WiFi blip
+ * the reconnect is a PSK resumption (no certificate, no signature) and,
+ * when the ticket allows it, the pending telemetry frame is sent as 0-RTT
+ * early data in the first flight together with the ClientHello.
+ *
+ * Early data can be replayed by an attacker, so every request is made
+ * idempotent: the MBAP transaction id carries the frame sequence number
+ * and RPI#1 applies a sequence at most once per peer (rpi1/tls13_server.py).
+ * If the server does not accept early data the frame is sent normally
+ * right after the handshake.
+ *
+ * Requires an ESP32 core built with MBEDTLS_SSL_PROTO_TLS1_3 (env:esp32tls13).
+ */
+
+class ModbusTLS13Client {
+public:
+    ModbusTLS13Client();
+    ~ModbusTLS13Client();
+
+    /**
+     * Set server address and server authentication
+     * caPem: PEM certificate for X.509 path validation, or nullptr
+     * pinSha256: SPKI SHA-256 pin checked after full handshakes (tls_pin.h), or nullptr
+     */
+    void begin(const char* host, uint16_t port, const char* caPem, const uint8_t* pinSha256 = nullptr);
+
+    /**
+     * Full or resumed handshake without early data
+     */
+    bool connect();
+
+    /**
+     * FC16 write; seq identifies the frame, count must be 1..123
+     * Reconnects if needed, sending the request as early data when possible.
+     * Returns true once RPI#1 acknowledged the frame (or a duplicate of it)
+     */
+    bool writeRegisters(uint8_t unitId, uint16_t address, const uint16_t* values,
+                        uint16_t count, uint16_t seq);
+
+    void close();
+    bool isConnected() const { return _connected; }
+    bool canResume() const { return _haveSession; }
+
+    // Statistics
+    uint32_t lastHandshakeMs() const { return _lastHandshakeMs; }
+    uint32_t lastWriteMs() const { return _lastWriteMs; }
+    bool lastOfferedTicket() const { return _lastOfferedTicket; }
+    unsigned long handshakes() const { return _handshakes; }
+    unsigned long ticketOffers() const { return _ticketOffers; }        // Handshakes offering a ticket
+    unsigned long earlyDataFrames() const { return _earlyDataFrames; }  // Frames accepted as 0-RTT
+
+private:
+    bool handshake(const uint8_t* earlyData, size_t earlyLen, size_t* earlySent);
+    bool writeAll(const uint8_t* data, size_t len);
+    void saveSession();
+
+    const char* _host;
+    char _port[6];
+    bool _verify;
+    const uint8_t* _pin;
+    bool _initialized;
+    bool _connected;
+    bool _haveSession;
+    bool _lastOfferedTicket;
+
+    mbedtls_net_context _net;
+    mbedtls_ssl_context _ssl;
+    mbedtls_ssl_config _conf;
+    mbedtls_ssl_session _session;
+    mbedtls_entropy_context _entropy;
+    mbedtls_ctr_drbg_context _drbg;
+    mbedtls_x509_crt _ca;
+
+    uint32_t _lastHandshakeMs;
+    uint32_t _lastWriteMs;
+    unsigned long _handshakes;
+    unsigned long _ticketOffers;
+    unsigned long _earlyDataFrames;
+};
+
+#endif // MODBUS_TLS13_H
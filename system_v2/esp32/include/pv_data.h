@@ -2,6 +2,7 @@
 #define PV_DATA_H
 
 #include <Arduino.h>
+#include "pv_sample.h"
 
 /**
  * Pre-processed PV simulation data for ESP32 solar inverter simulator
@@ -17,16 +18,6 @@
  * Memory usage: ~120 KB
  */
 
-struct PVSample {
-    uint16_t P_ac;      // AC Power (W)
-    uint16_t P_dc;      // DC Power (W)
-    uint16_t V_dc;      // DC Voltage (V × 10)
-    uint16_t I_dc;      // DC Current (A × 100)
-    uint16_t G;         // Irradiance (W/m²)
-    uint16_t T_cell;    // Cell Temperature (°C × 10)
-    uint32_t timestamp; // Unix seconds
-};
-
 const uint16_t PV_DATA_COUNT = 8784;
 
 const PVSample PV_DATA[] PROGMEM = {
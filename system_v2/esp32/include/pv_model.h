@@ -0,0 +1,96 @@
+#ifndef PV_MODEL_H
+#define PV_MODEL_H
+
+#include <Arduino.h>
+#include "pv_sample.h"
+
+/**
+ * On-device fixed-point PV model
+ *
+ * Alternative to replaying the precomputed PV_DATA table: the ESP32 computes
+ * P_dc, V_dc, I_dc, P_ac and T_cell from a compact irradiance/temperature
+ * input stream (pv_input.h) using coefficients exported by
+ * data_preparation/generate_esp32_data.py (pv_model_coeffs.h).
+ *
+ * Model (integer arithmetic only):
+ *   - Cell temperature: SAPM  T_m = E·exp(a + b·WS) + T_a,  T_c = T_m + E/1000·ΔT
+ *     (exp(a + b·WS) tabulated over the 256 wind codes)
+ *   - DC power: PVWatts form  P_dc = P_dc0·E/1000·k_irr(E)·(1 + γ·(T_c − 25))
+ *     where k_irr(E) is the CEC single-diode relative efficiency at 25 °C
+ *   - DC voltage: V_mp = V_mp,ref·v_irr(E)·(1 + β·(T_c − 25)),  I_mp = P_dc / V_mp
+ *   - AC power: Sandia inverter efficiency curve η(P_dc / P_dco), clipped at P_aco
+ *
+ * Parameters live in RAM (pvModelParams) so they can be changed at runtime.
+ */
+
+#if !__has_include("pv_input.h") || !__has_include("pv_model_coeffs.h")
+#error "PV_SOURCE_MODEL needs include/pv_input.h and include/pv_model_coeffs.h: run data_preparation/generate_esp32_data.py and copy them from output/"
+#endif
+
+// Packed 6-byte input record stored in PROGMEM (see pv_input.h)
+//   bytes 0-2: POA global irradiance [11:0] | GHI [23:12] (W/m²)
+//   byte 3:    effective/global irradiance ratio (×255, AOI losses)
+//   byte 4:    ambient temperature (°C × 2, signed)
+//   byte 5:    wind speed (m/s × 10)
+struct PVInputSample {
+    uint8_t b[6];
+};
+
+// Lookup table sizes (must match pv_model_coeffs.h)
+#define PV_MODEL_WIND_LUT_SIZE 256
+#define PV_MODEL_IRR_LUT_SIZE 31    // 0..1500 W/m², 50 W/m² steps
+#define PV_MODEL_INV_LUT_SIZE 25    // 0..1.2 × P_dco, 0.05 steps
+
+struct PVModelParams {
+    // Module (CEC single-diode fit)
+    int32_t pdc0_mw;          // DC rating at STC (mW)
+    int32_t gamma_ppm;        // Power temperature coefficient (ppm/°C)
+    int32_t vmp_ref_mv;       // V_mp at STC (mV)
+    int32_t beta_vmp_ppm;     // V_mp temperature coefficient (ppm/°C)
+    uint16_t irr_step;        // Irradiance LUT step (W/m²)
+    uint16_t k_irr_q15[PV_MODEL_IRR_LUT_SIZE];  // Relative efficiency (Q15)
+    uint16_t v_irr_q15[PV_MODEL_IRR_LUT_SIZE];  // V_mp / V_mp,ref (Q15)
+
+    // Temperature model (SAPM)
+    int32_t delta_t_x10;      // ΔT (°C × 10)
+    uint16_t wind_q20[PV_MODEL_WIND_LUT_SIZE];  // exp(a + b·WS) (Q20)
+
+    // Inverter (Sandia)
+    int32_t paco_mw;          // AC rating (mW)
+    int32_t pdco_mw;          // DC input at AC rating (mW)
+    int32_t pso_mw;           // Self-consumption / turn-on threshold (mW)
+    uint16_t eta_q15[PV_MODEL_INV_LUT_SIZE];    // Efficiency vs P_dc/P_dco (Q15)
+};
+
+extern PVModelParams pvModelParams;
+
+/**
+ * Load default parameters from pv_model_coeffs.h into pvModelParams
+ * (changed at runtime with pvModelSetParam, e.g. the "pv set" serial command)
+ */
+void pvModelLoadDefaults(PVModelParams* params);
+
+/**
+ * Read input record from PROGMEM and compute register-encoded sample
+ */
+void pvModelCompute(const PVModelParams* params, uint16_t index, PVSample* out);
+
+/**
+ * Check that a parameter set is usable (ratings and steps > 0, coefficients
+ * within physical ranges, LUTs non-zero where they are divided or scaled by)
+ */
+bool pvModelValidate(const PVModelParams* params);
+
+/**
+ * Set one scalar parameter by name (e.g. "gamma_ppm") on a copy of params,
+ * validate the copy and only then replace params with it
+ * Returns false (params unchanged) for an unknown name or an invalid result.
+ */
+bool pvModelSetParam(PVModelParams* params, const char* name, int32_t value);
+
+/**
+ * Print the scalar parameters to Serial
+ */
+void pvModelPrintParams(const PVModelParams* params);
+
+#endif // PV_MODEL_H
@@ -0,0 +1,22 @@
+#ifndef PV_SAMPLE_H
+#define PV_SAMPLE_H
+
+#include <Arduino.h>
+
+/**
+ * Register-encoded PV sample (one Modbus telemetry frame)
+ *
+ * Shared by the precomputed table (pv_data.h) and the on-device model
+ * (pv_model.h), so either source fills the same struct.
+ */
+struct PVSample {
+    uint16_t P_ac;      // AC Power (W)
+    uint16_t P_dc;      // DC Power (W)
+    uint16_t V_dc;      // DC Voltage (V × 10)
+    uint16_t I_dc;      // DC Current (A × 100)
+    uint16_t G;         // Irradiance (W/m²)
+    uint16_t T_cell;    // Cell Temperature (°C × 10)
+    uint32_t timestamp; // Unix seconds
+};
+
+#endif // PV_SAMPLE_H
@@ -0,0 +1,49 @@
+#ifndef RTOS_STATS_H
+#define RTOS_STATS_H
+
+#include <Arduino.h>
+
+/**
+ * FreeRTOS runtime profiling (CPU, stack, heap)
+ *
+ * Collected every RTOS_STATS_INTERVAL_MS and written to RPI#1 as a status
+ * block of RTOS_STATS_REGISTER_COUNT holding registers starting at
+ * RTOS_STATS_REGISTER, over the same transport as the telemetry frame.
+ *
+ * Status block layout (offsets from RTOS_STATS_REGISTER):
+ *   0:     collection sequence
+ *   1-2:   free heap (bytes, u32 high/low)
+ *   3-4:   minimum free heap since boot (bytes, u32 high/low)
+ *   5:     core 0 load (% × 100)
+ *   6:     core 1 load (% × 100)
+ *   7:     number of tasks
+ *   8-17:  tracked tasks (RTOS_STATS_TASK_NAMES), 2 registers each:
+ *            CPU (% of one core × 100), stack high-water mark (bytes free)
+ *
+ * CPU fields are 0xFFFF when the core is built without
+ * configGENERATE_RUN_TIME_STATS; stack and heap are always available.
+ * Tasks that do not exist report 0xFFFF in both fields.
+ */
+
+#define RTOS_STATS_REGISTER 16
+#define RTOS_STATS_TRACKED_TASKS 5
+#define RTOS_STATS_REGISTER_COUNT (8 + 2 * RTOS_STATS_TRACKED_TASKS)
+#define RTOS_STATS_NOT_AVAILABLE 0xFFFF
+
+// loopTask: Arduino loop (Modbus, TLS/DTLS, PV model)
+// tiT: lwIP TCP/IP stack, wifi: WiFi driver, sys_evt: event loop, esp_timer: timer service
+#define RTOS_STATS_TASK_NAMES { "loopTask", "tiT", "wifi", "sys_evt", "esp_timer" }
+
+/**
+ * Sample all tasks and fill the status block (RTOS_STATS_REGISTER_COUNT registers)
+ *
+ * CPU percentages cover the time since the previous call.
+ */
+void rtosStatsCollect(uint16_t* regs);
+
+/**
+ * Print the last collected status block to Serial
+ */
+void rtosStatsPrint(const uint16_t* regs);
+
+#endif // RTOS_STATS_H
@@ -0,0 +1,64 @@
+#ifndef TIME_SYNC_H
+#define TIME_SYNC_H
+
+#include <Arduino.h>
+
+/**
+ * Clock offset to the RPI#1 time service (NTP-style, no NTP server needed)
+ *
+ * RPI#1 answers an FC03 of TIME_SERVICE_REGISTER (8 registers) with its
+ * CLOCK_MONOTONIC and UTC time in ns, sampled together. For one exchange
+ * with local send/receive times t1/t4 (esp_timer, µs):
+ *
+ *   offset = T_server - (t1 + t4) / 2      rtt = t4 - t1      error <= rtt / 2
+ *
+ * A sync is a burst of TIME_SYNC_SAMPLES exchanges; the sample with the
+ * lowest RTT is kept (WiFi queueing only ever adds delay, so the fastest
+ * exchange is the most symmetric one).
+ *
+ * Clock report block (written to RPI#1 at CLOCK_REPORT_REGISTER, logged there):
+ *   0-3: offset µs, RPI#1 monotonic - esp_timer (i64, most significant word first)
+ *   4-5: RTT µs of the kept sample (u32)
+ */
+
+#define TIME_SERVICE_REGISTER 0x2000
+#define TIME_SERVICE_COUNT 8
+#define CLOCK_REPORT_COUNT 6
+
+class TimeSyncEstimator {
+public:
+    /** Start a new burst */
+    void begin();
+
+    /**
+     * Add one exchange
+     * t1Us/t4Us: esp_timer_get_time() around the request
+     * regs: the TIME_SERVICE_COUNT registers returned by RPI#1
+     */
+    void addSample(int64_t t1Us, int64_t t4Us, const uint16_t* regs);
+
+    /** True once at least one burst produced a sample */
+    bool valid() const { return _valid; }
+
+    int64_t monoOffsetUs() const { return _monoOffsetUs; }   // RPI#1 monotonic - esp_timer
+    int64_t utcOffsetUs() const { return _utcOffsetUs; }     // RPI#1 UTC µs - esp_timer
+    uint32_t rttUs() const { return _rttUs; }
+    uint32_t samples() const { return _samples; }
+
+    /** Local esp_timer time → RPI#1 monotonic / UTC (µs) */
+    int64_t toServerMonoUs(int64_t localUs) const { return localUs + _monoOffsetUs; }
+    int64_t toUtcUs(int64_t localUs) const { return localUs + _utcOffsetUs; }
+
+    /** Fill the clock report block (CLOCK_REPORT_COUNT registers) */
+    void report(uint16_t* regs) const;
+
+private:
+    bool _valid = false;
+    bool _burstValid = false;
+    int64_t _monoOffsetUs = 0;
+    int64_t _utcOffsetUs = 0;
+    uint32_t _rttUs = 0;
+    uint32_t _samples = 0;
+};
+
+#endif // TIME_SYNC_H
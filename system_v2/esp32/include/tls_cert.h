@@ -11,8 +11,8 @@
  * Common Name: modbus-server
  * Valid Until: 2026-12-14
  *
- * NOTE: In production, certificates should be validated.
- * For testing, we use skip verification mode on ESP32 client.
+ * Server authentication is selected with TLS_VERIFY_MODE in config.h
+ * (public-key pin below by default).
  */
 
 // Server certificate (PEM format)
@@ -37,4 +37,15 @@ const char* TLS_SERVER_CERT =
 "fmJFS9XBywShm1kKXoYKjESpAheN\n"
 "-----END CERTIFICATE-----\n";
 
+// SHA-256 of the server certificate's SubjectPublicKeyInfo (public-key pin,
+// used with TLS_VERIFY_MODE == TLS_VERIFY_PIN, see tls_pin.h)
+// Regenerate whenever the key in TLS_SERVER_CERT changes:
+//   openssl x509 -in server.crt -pubkey -noout | openssl pkey -pubin -outform DER | openssl dgst -sha256
+const uint8_t TLS_SERVER_SPKI_SHA256[32] = {
+    0x06, 0xa7, 0x41, 0xe8, 0x57, 0xad, 0x2d, 0x01,
+    0x77, 0x6b, 0xd1, 0x29, 0x6a, 0x3d, 0x2e, 0x07,
+    0x4e, 0xfd, 0x42, 0x81, 0xa5, 0x48, 0x02, 0xa3,
+    0x76, 0x12, 0xd7, 0x17, 0x2f, 0x11, 0x29, 0x12
+};
+
 #endif // TLS_CERT_H
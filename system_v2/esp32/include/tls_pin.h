@@ -0,0 +1,37 @@
+#ifndef TLS_PIN_H
+#define TLS_PIN_H
+
+#include <Arduino.h>
+#include "mbedtls/x509_crt.h"
+
+/**
+ * Server public-key pinning (SPKI SHA-256)
+ *
+ * The handshake runs without X.509 path validation (no chain building, no
+ * certificate signature check, no validity/name checks). Afterwards the
+ * SHA-256 of the server's SubjectPublicKeyInfo is compared with a
+ * compile-time pin (TLS_SERVER_SPKI_SHA256 in tls_cert.h).
+ *
+ * This authenticates RPI#1: the handshake already proved that the server
+ * holds the private key of the certificate it presented (ServerKeyExchange
+ * signature / key transport), so a matching public key means it is the
+ * pinned server. The pin survives certificate renewal as long as the key
+ * pair is kept.
+ *
+ * Must be checked before any application data is sent.
+ */
+
+#define TLS_PIN_SIZE 32
+
+/**
+ * SHA-256 over the DER SubjectPublicKeyInfo of crt
+ * Returns false if the key cannot be encoded
+ */
+bool tlsPinCompute(const mbedtls_x509_crt* crt, uint8_t* sha256);
+
+/**
+ * True if crt carries the pinned public key (constant-time compare)
+ */
+bool tlsPinMatches(const mbedtls_x509_crt* crt, const uint8_t* pin);
+
+#endif // TLS_PIN_H
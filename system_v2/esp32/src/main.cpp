@@ -6,10 +6,14 @@
  *
  * Architecture:
  *   ESP32 (this device) --[WiFi, Modbus TLS Write:802]--> RPI#1 (Smart Meter/RTU)
+ *   (or Modbus/UDP over DTLS 1.2, udp/802, with MODBUS_TRANSPORT_DTLS)
+ *   (or sequenced Modbus over TLS 1.3, tcp/803, with MODBUS_TRANSPORT_TLS13)
  *
- * Data Source:
- *   Pre-computed PV simulation data stored in Flash (PROGMEM)
- *   Generated from weather_washingtonDC_2016.xlsx using pvlib ModelChain
+ * Data Source (PV_SOURCE_MODEL in config.h):
+ *   Table mode: pre-computed PV simulation data stored in Flash (PROGMEM)
+ *     Generated from weather_washingtonDC_2016.xlsx using pvlib ModelChain
+ *   Model mode: fixed-point PV model evaluated on-device from a compact
+ *     irradiance/temperature input stream (see pv_model.h)
  *
  * Register Map (8 registers, starting at address 0):
  *   0: P_ac (W, uint16)
@@ -20,27 +24,92 @@
  *   5: T_cell (°C×10, uint16)
  *   6: Timestamp_high [31:16]
  *   7: Timestamp_low [15:0]
+ *
+ * Time service (TIME_SYNC_ENABLED, ModbusTLS transport): every
+ * TIME_SYNC_INTERVAL_MS a burst of FC03 reads of RPI#1's time registers
+ * gives the clock offset to RPI#1 (time_sync.h), reported to RPI#1 at
+ * CLOCK_REPORT_REGISTER.
  */
 
 #include <Arduino.h>
 #include <WiFi.h>
 #include <ModbusTLS.h>
 #include "config.h"
-#include "pv_data.h"
 #include "tls_cert.h"
+#include "tls_pin.h"
+
+#if MODBUS_TRANSPORT_DTLS
+#include "modbus_dtls.h"
+#endif
+#if MODBUS_TRANSPORT_TLS13
+#include "modbus_tls13.h"
+#endif
+#if MODBUS_TRANSPORT_DTLS && MODBUS_TRANSPORT_TLS13
+#error "Select at most one of MODBUS_TRANSPORT_DTLS and MODBUS_TRANSPORT_TLS13"
+#endif
+
+// Transports with frame sequence numbers (idempotent writes on RPI#1)
+#define MODBUS_SEQUENCED (MODBUS_TRANSPORT_DTLS || MODBUS_TRANSPORT_TLS13)
+
+// Sequenced transports only implement writes, so the time service needs ModbusTLS
+#define TIME_SYNC (TIME_SYNC_ENABLED && !MODBUS_SEQUENCED)
+#if TIME_SYNC
+#include "time_sync.h"
+#include "esp_timer.h"
+#endif
+#if RTOS_STATS_ENABLED
+#include "rtos_stats.h"
+#endif
+
+#if PV_SOURCE_MODEL
+#include "pv_model.h"
+#include "pv_input.h"   // PV_INPUT_COUNT (array itself is only defined in pv_model.cpp)
+#define PV_SAMPLE_COUNT PV_INPUT_COUNT
+#define PV_SOURCE_BYTES (PV_INPUT_COUNT * sizeof(PVInputSample))
+#else
+#include "pv_data.h"
+#define PV_SAMPLE_COUNT PV_DATA_COUNT
+#define PV_SOURCE_BYTES (PV_DATA_COUNT * sizeof(PVSample))
+#endif
 
 
+/**
+ * ModbusTLS with access to the TLS connection to a server (public-key pinning)
+ */
+class PinnedModbusTLS : public ModbusTLS {
+public:
+    const mbedtls_x509_crt* peerCertificate(IPAddress ip) {
+        int8_t p = getSlave(ip);
+        return p < 0 ? nullptr : tcpclient[p]->getPeerCertificate();
+    }
+};
+
 // Modbus TLS client
-ModbusTLS modbus;
+PinnedModbusTLS modbus;
+#if MODBUS_TRANSPORT_DTLS
+ModbusDTLSClient dtls;
+#elif MODBUS_TRANSPORT_TLS13
+ModbusTLS13Client tls13;
+#endif
+#if MODBUS_SEQUENCED
+uint16_t frameSeq = 0;      // Application-level frame sequence (MBAP transaction id)
+#endif
 IPAddress rpi1Ip;
 bool rpi1IpValid = false;
 
 // State variables
 uint16_t currentSampleIndex = 0;
 unsigned long lastSendTime = 0;
+unsigned long lastStatsTime = 0;
 bool wifiConnected = false;
 bool modbusConnected = false;
 
+#if TIME_SYNC
+TimeSyncEstimator timeSync;
+unsigned long lastTimeSyncTime = 0;
+bool timeSyncDue = true;          // First burst as soon as the session is up
+#endif
+
 // Statistics
 unsigned long totalSamplesSent = 0;
 unsigned long totalErrors = 0;
@@ -87,6 +156,167 @@ void connectWiFi() {
     }
 }
 
+#if MODBUS_TRANSPORT_DTLS
+/**
+ * Connect to Modbus DTLS server (RPI#1)
+ */
+void connectModbus() {
+    Serial.println("Connecting to RPI#1 Modbus DTLS server...");
+    Serial.print("  Target: ");
+    Serial.print(RPI1_IP);
+    Serial.print(":");
+    Serial.print(RPI1_DTLS_PORT);
+    Serial.println("/udp");
+    Serial.println("  Protocol: Modbus/UDP over DTLS 1.2 (encrypted)");
+
+    dtls.begin(RPI1_IP, RPI1_DTLS_PORT,
+               TLS_VERIFY_MODE == TLS_VERIFY_CHAIN ? TLS_SERVER_CERT : nullptr,
+               TLS_VERIFY_MODE == TLS_VERIFY_PIN ? TLS_SERVER_SPKI_SHA256 : nullptr);
+    modbusConnected = dtls.connect();
+
+    if (modbusConnected) {
+        Serial.print("✓ DTLS session established (handshake ");
+        Serial.print(dtls.lastHandshakeMs());
+        Serial.println(" ms)");
+    } else {
+        Serial.println("✗ DTLS handshake failed");
+        Serial.println("  Check:");
+        Serial.println("    - RPI#1 DTLS server is running (udp/802)");
+        Serial.println("    - Firewall allows udp/802");
+        Serial.println("    - RPI#1 key matches tls_cert.h");
+    }
+}
+
+/**
+ * Make sure the DTLS session is up (re-handshake only after a fatal error)
+ */
+bool ensureModbusConnected() {
+    if (!dtls.isConnected()) {
+        modbusConnected = dtls.connect();
+        if (modbusConnected && DEBUG_ENABLED) {
+            Serial.print("  DTLS re-handshake: ");
+            Serial.print(dtls.lastHandshakeMs());
+            Serial.println(" ms");
+        }
+    }
+    return modbusConnected;
+}
+
+/**
+ * Write a register block as one sequence-numbered datagram (frameSeq)
+ */
+bool writeRegisters(uint16_t address, uint16_t* registers, uint16_t count) {
+    bool ok = dtls.writeRegisters(MODBUS_UNIT_ID, address, registers, count, frameSeq);
+    if (ok && DEBUG_ENABLED) {
+        Serial.print("  Write RTT: ");
+        Serial.print(dtls.lastWriteMs());
+        Serial.print(" ms (retransmissions total: ");
+        Serial.print(dtls.retransmissions());
+        Serial.println(")");
+    }
+    modbusConnected = dtls.isConnected();
+    return ok;
+}
+#elif MODBUS_TRANSPORT_TLS13
+/**
+ * Connect to the sequenced Modbus TLS 1.3 server (RPI#1)
+ */
+void connectModbus() {
+    Serial.println("Connecting to RPI#1 Modbus TLS 1.3 server...");
+    Serial.print("  Target: ");
+    Serial.print(RPI1_IP);
+    Serial.print(":");
+    Serial.println(RPI1_TLS13_PORT);
+    Serial.println("  Protocol: Modbus over TLS 1.3 (PSK resumption, 0-RTT frames)");
+
+    tls13.begin(RPI1_IP, RPI1_TLS13_PORT,
+                TLS_VERIFY_MODE == TLS_VERIFY_CHAIN ? TLS_SERVER_CERT : nullptr,
+                TLS_VERIFY_MODE == TLS_VERIFY_PIN ? TLS_SERVER_SPKI_SHA256 : nullptr);
+    modbusConnected = tls13.connect();
+
+    if (modbusConnected) {
+        Serial.print("✓ TLS 1.3 session established (handshake ");
+        Serial.print(tls13.lastHandshakeMs());
+        Serial.println(" ms)");
+    } else {
+        Serial.println("✗ TLS 1.3 handshake failed");
+        Serial.println("  Check:");
+        Serial.println("    - RPI#1 TLS 1.3 server is running (TLS13_ENABLED, port 803)");
+        Serial.println("    - Firewall allows port 803");
+        Serial.println("    - RPI#1 key matches tls_cert.h");
+    }
+}
+
+/**
+ * With a saved ticket the reconnect is left to writeRegisters(), so the
+ * frame can travel as early data in the first flight
+ */
+bool ensureModbusConnected() {
+    if (!tls13.isConnected() && !tls13.canResume()) {
+        tls13.connect();
+    }
+    modbusConnected = tls13.isConnected() || tls13.canResume();
+    return modbusConnected;
+}
+
+/**
+ * Write a register block as one sequence-numbered request (frameSeq)
+ */
+bool writeRegisters(uint16_t address, uint16_t* registers, uint16_t count) {
+    bool reconnect = !tls13.isConnected();
+    unsigned long handshakes = tls13.handshakes();
+    unsigned long early = tls13.earlyDataFrames();
+
+    bool ok = tls13.writeRegisters(MODBUS_UNIT_ID, address, registers, count, frameSeq);
+    if (ok && DEBUG_ENABLED) {
+        Serial.print("  Write RTT: ");
+        Serial.print(tls13.lastWriteMs());
+        Serial.print(" ms");
+        if (reconnect && tls13.handshakes() != handshakes) {
+            Serial.print(" incl. ");
+            Serial.print(tls13.lastOfferedTicket() ? "resumed" : "full");
+            Serial.print(" handshake ");
+            Serial.print(tls13.lastHandshakeMs());
+            Serial.print(" ms");
+            if (tls13.earlyDataFrames() != early) {
+                Serial.print(", frame sent as 0-RTT early data");
+            }
+        }
+        Serial.println();
+    }
+    modbusConnected = tls13.isConnected();
+    return ok;
+}
+#else
+uint32_t lastHandshakeMs = 0;
+
+/**
+ * TCP connect + TLS handshake with the configured server authentication
+ *
+ * ModbusTLS::connect(ip, port, client_cert, client_key, ca_cert)
+ * No client cert/key (server-only TLS). A nullptr CA skips X.509 path
+ * validation; in TLS_VERIFY_PIN mode the server's public key is then
+ * checked against the pin before any register is written.
+ */
+bool connectTLS() {
+    const char* ca = TLS_VERIFY_MODE == TLS_VERIFY_CHAIN ? TLS_SERVER_CERT : nullptr;
+
+    unsigned long start = millis();
+    if (!modbus.connect(rpi1Ip, RPI1_PORT, nullptr, nullptr, ca)) {
+        return false;
+    }
+
+    if (TLS_VERIFY_MODE == TLS_VERIFY_PIN
+        && !tlsPinMatches(modbus.peerCertificate(rpi1Ip), TLS_SERVER_SPKI_SHA256)) {
+        Serial.println("✗ TLS server public key does not match pin (tls_cert.h), disconnecting");
+        modbus.disconnect(rpi1Ip);
+        return false;
+    }
+
+    lastHandshakeMs = millis() - start;
+    return true;
+}
+
 /**
  * Connect to Modbus TLS server (RPI#1)
  */
@@ -99,8 +329,9 @@ void connectModbus() {
     Serial.println("  Protocol: Modbus over TLS (encrypted)");
 
     // Initialize ModbusTLS client
+    // Auto-reconnect would bypass the pin check: reconnects go through ensureModbusConnected()
     modbus.client();
-    modbus.autoConnect(true);
+    modbus.autoConnect(TLS_VERIFY_MODE != TLS_VERIFY_PIN);
 
     rpi1IpValid = rpi1Ip.fromString(RPI1_IP);
     if (!rpi1IpValid) {
@@ -109,25 +340,48 @@ void connectModbus() {
         return;
     }
 
-    // Connect with TLS
-    // ModbusTLS::connect(ip, port, client_cert, client_key, ca_cert)
-    // For ESP32: If ca_cert is nullptr, certificate validation is skipped
-    // Parameters: No client cert/key needed (server-only TLS)
-    //             No CA cert = skip verification (testing mode)
-    modbusConnected = modbus.connect(rpi1Ip, RPI1_PORT, nullptr, nullptr, nullptr);
+    modbusConnected = connectTLS();
 
     if (modbusConnected) {
-        Serial.println("✓ Modbus TLS connected (encrypted channel established)");
-        Serial.println("  Note: Certificate verification skipped (testing mode)");
+        Serial.print("✓ Modbus TLS connected (handshake ");
+        Serial.print(lastHandshakeMs);
+        Serial.println(" ms)");
+        if (TLS_VERIFY_MODE == TLS_VERIFY_NONE) {
+            Serial.println("  Note: Server not authenticated (TLS_VERIFY_NONE, testing mode)");
+        }
     } else {
         Serial.println("✗ Modbus TLS connect failed");
         Serial.println("  Check:");
         Serial.println("    - RPI#1 TLS server is running on port 802");
         Serial.println("    - Firewall allows port 802");
-        Serial.println("    - Certificates are valid on RPI#1");
+        Serial.println("    - RPI#1 key matches tls_cert.h");
     }
 }
 
+/**
+ * Reconnect the TLS session if it dropped
+ */
+bool ensureModbusConnected() {
+    if (!modbusConnected || !modbus.isConnected(rpi1Ip)) {
+        modbusConnected = connectTLS();
+        if (modbusConnected && DEBUG_ENABLED) {
+            Serial.print("  TLS re-handshake: ");
+            Serial.print(lastHandshakeMs);
+            Serial.println(" ms");
+        }
+    }
+    return modbusConnected;
+}
+
+/**
+ * Write a register block to RPI#1
+ */
+bool writeRegisters(uint16_t address, uint16_t* registers, uint16_t count) {
+    // ModbusIP_ESP8266 API: writeHreg(serverIP, address, values, count, cb, unit)
+    return modbus.writeHreg(rpi1Ip, address, registers, count, nullptr, MODBUS_UNIT_ID);
+}
+#endif
+
 /**
  * Quick TLS connectivity check to RPI#1
  * Note: This tests plain TCP socket, not TLS handshake
@@ -162,9 +416,14 @@ bool testTlsConnection() {
  * Send current PV sample to RPI#1 via Modbus TLS
  */
 bool sendPVSample() {
-    // Read sample from PROGMEM
     PVSample sample;
+#if PV_SOURCE_MODEL
+    // Compute sample from input stream
+    pvModelCompute(&pvModelParams, currentSampleIndex, &sample);
+#else
+    // Read sample from PROGMEM
     memcpy_P(&sample, &PV_DATA[currentSampleIndex], sizeof(PVSample));
+#endif
 
     // Prepare 8 Modbus registers
     uint16_t registers[8];
@@ -183,7 +442,7 @@ bool sendPVSample() {
         Serial.print("Sample #");
         Serial.print(currentSampleIndex);
         Serial.print(" of ");
-        Serial.println(PV_DATA_COUNT);
+        Serial.println(PV_SAMPLE_COUNT);
 
         // Decode for human-readable display
         float V_dc_decoded = sample.V_dc / 10.0;
@@ -218,6 +477,11 @@ bool sendPVSample() {
         Serial.println(sample.timestamp);
     }
 
+#if MODBUS_SEQUENCED
+    // New frame: retries below reuse the same sequence number
+    frameSeq++;
+#endif
+
     // Write to Modbus server with retries
     bool success = false;
     for (int attempt = 0; attempt < MODBUS_RETRY_COUNT && !success; attempt++) {
@@ -229,18 +493,16 @@ bool sendPVSample() {
             delay(1000);
         }
 
-        if (!modbusConnected || !modbus.isConnected(rpi1Ip)) {
-            modbusConnected = modbus.connect(rpi1Ip, RPI1_PORT, nullptr, nullptr, nullptr);
-            if (!modbusConnected) {
-                Serial.println("✗ Modbus TLS connect failed");
-                testTlsConnection();
-                continue;
-            }
+        if (!ensureModbusConnected()) {
+            Serial.println("✗ Modbus connect failed");
+#if !MODBUS_SEQUENCED
+            testTlsConnection();
+#endif
+            continue;
         }
 
         // Write 8 registers starting at address 0
-        // ModbusIP_ESP8266 API: writeMultipleRegisters(serverIP, address, values, count)
-        if (modbus.writeHreg(rpi1Ip, 0, registers, 8, nullptr, MODBUS_UNIT_ID)) {
+        if (writeRegisters(0, registers, 8)) {
             success = true;
             totalSamplesSent++;
 
@@ -251,7 +513,9 @@ bool sendPVSample() {
             }
         } else {
             Serial.println("✗ Modbus write failed");
+#if !MODBUS_SEQUENCED
             testTlsConnection();
+#endif
         }
     }
 
@@ -267,6 +531,163 @@ bool sendPVSample() {
     return success;
 }
 
+#if TIME_SYNC
+// Pending time service read: the library writes the response into
+// timeServiceRegs (static, so a late response never lands in a dead stack
+// frame) and the callback only accepts the transaction it was issued for
+uint16_t timeServiceRegs[TIME_SERVICE_COUNT];
+volatile uint16_t timeReadTrans = 0;
+volatile int64_t timeReadDoneUs = 0;
+volatile bool timeReadOk = false;
+
+bool onTimeRead(Modbus::ResultCode event, uint16_t transactionId, void* data) {
+    if (transactionId != timeReadTrans) {
+        return true;    // Stale exchange
+    }
+    timeReadDoneUs = esp_timer_get_time();
+    timeReadOk = event == Modbus::EX_SUCCESS;
+    return true;
+}
+
+/**
+ * One FC03 exchange with the RPI#1 time service
+ * t4 is taken in the response callback, not after the polling loop. Waits
+ * until the library has finished the transaction (answered or timed out);
+ * a response later than TIME_SYNC_TIMEOUT_MS is not used as a sample.
+ */
+bool readTimeService(uint16_t* regs, int64_t* t1, int64_t* t4) {
+    timeReadDoneUs = 0;
+    timeReadOk = false;
+
+    *t1 = esp_timer_get_time();
+    uint16_t trans = modbus.readHreg(rpi1Ip, TIME_SERVICE_REGISTER, timeServiceRegs,
+                                     TIME_SERVICE_COUNT, onTimeRead, MODBUS_UNIT_ID);
+    if (trans == 0) {
+        return false;
+    }
+    timeReadTrans = trans;
+    while (modbus.isTransaction(trans)) {
+        modbus.task();
+    }
+    timeReadTrans = 0;
+
+    *t4 = timeReadDoneUs;
+    if (!timeReadOk || *t4 == 0 || *t4 - *t1 > (int64_t)TIME_SYNC_TIMEOUT_MS * 1000) {
+        return false;
+    }
+    memcpy(regs, timeServiceRegs, sizeof(timeServiceRegs));
+    return true;
+}
+
+/**
+ * Burst of TIME_SYNC_SAMPLES exchanges, then write the clock report to RPI#1
+ */
+void syncClock() {
+    if (!ensureModbusConnected()) {
+        return;
+    }
+
+    uint16_t regs[TIME_SERVICE_COUNT];
+    int64_t t1, t4;
+    timeSync.begin();
+    for (int i = 0; i < TIME_SYNC_SAMPLES; i++) {
+        if (!readTimeService(regs, &t1, &t4)) {
+            Serial.println("✗ Time service read failed");
+            return;
+        }
+        timeSync.addSample(t1, t4, regs);
+    }
+
+    uint16_t report[CLOCK_REPORT_COUNT];
+    timeSync.report(report);
+    if (!writeRegisters(CLOCK_REPORT_REGISTER, report, CLOCK_REPORT_COUNT)) {
+        Serial.println("✗ Clock report write failed");
+    }
+
+    if (DEBUG_ENABLED) {
+        Serial.print("  Clock offset to RPI#1: ");
+        Serial.print((double)timeSync.monoOffsetUs() / 1000.0, 3);
+        Serial.print(" ms (RTT ");
+        Serial.print(timeSync.rttUs());
+        Serial.print(" µs over ");
+        Serial.print(timeSync.samples());
+        Serial.println(" samples)");
+    }
+}
+#endif
+
+#if PV_SOURCE_MODEL
+/**
+ * Serial commands for the on-device model parameters (one per line):
+ *   pv show              scalar parameters and accepted ranges
+ *   pv set NAME VALUE    validate and apply (e.g. "pv set gamma_ppm -3900")
+ *   pv defaults          reload pv_model_coeffs.h
+ */
+void handleSerialCommand() {
+    static char line[64];
+    static size_t len = 0;
+
+    while (Serial.available()) {
+        char c = Serial.read();
+        if (c != '\n' && c != '\r') {
+            if (len < sizeof(line) - 1) {
+                line[len++] = c;
+            }
+            continue;
+        }
+        if (len == 0) {
+            continue;
+        }
+        line[len] = '\0';
+        len = 0;
+
+        char name[24];
+        long value;
+        if (strcmp(line, "pv show") == 0) {
+            pvModelPrintParams(&pvModelParams);
+        } else if (strcmp(line, "pv defaults") == 0) {
+            pvModelLoadDefaults(&pvModelParams);
+            Serial.println("✓ PV model parameters reset to defaults");
+        } else if (sscanf(line, "pv set %23s %ld", name, &value) == 2) {
+            if (pvModelSetParam(&pvModelParams, name, (int32_t)value)) {
+                Serial.print("✓ ");
+                Serial.print(name);
+                Serial.print(" = ");
+                Serial.println(value);
+            } else {
+                Serial.print("✗ Rejected: ");
+                Serial.print(name);
+                Serial.println(" unknown or out of range (pv show lists the ranges)");
+            }
+        } else {
+            Serial.println("✗ Commands: pv show | pv set NAME VALUE | pv defaults");
+        }
+    }
+}
+#endif
+
+#if RTOS_STATS_ENABLED
+/**
+ * Collect FreeRTOS runtime stats and write the status block to RPI#1
+ */
+void sendRtosStats() {
+    uint16_t regs[RTOS_STATS_REGISTER_COUNT];
+    rtosStatsCollect(regs);
+
+    if (DEBUG_ENABLED) {
+        rtosStatsPrint(regs);
+    }
+
+#if MODBUS_SEQUENCED
+    frameSeq++;
+#endif
+    // Single attempt: next status block follows in RTOS_STATS_INTERVAL_MS
+    if (!ensureModbusConnected() || !writeRegisters(RTOS_STATS_REGISTER, regs, RTOS_STATS_REGISTER_COUNT)) {
+        Serial.println("✗ RTOS stats write failed");
+    }
+}
+#endif
+
 /**
  * Arduino setup function
  */
@@ -278,10 +699,15 @@ void setup() {
     Serial.println("================================================================================");
     Serial.println("ESP32 Solar Inverter Simulator (Modbus TLS)");
     Serial.println("================================================================================");
+#if PV_SOURCE_MODEL
+    pvModelLoadDefaults(&pvModelParams);
+    Serial.print("PV Model: ");
+#else
     Serial.print("PV Data: ");
-    Serial.print(PV_DATA_COUNT);
+#endif
+    Serial.print(PV_SAMPLE_COUNT);
     Serial.print(" samples (");
-    Serial.print((PV_DATA_COUNT * sizeof(PVSample)) / 1024);
+    Serial.print(PV_SOURCE_BYTES / 1024);
     Serial.println(" KB in Flash)");
     Serial.print("Send interval: ");
     Serial.print(SEND_INTERVAL_MS / 1000);
@@ -329,7 +755,7 @@ void loop() {
             currentSampleIndex++;
 
             // Loop back to beginning if enabled
-            if (currentSampleIndex >= PV_DATA_COUNT) {
+            if (currentSampleIndex >= PV_SAMPLE_COUNT) {
                 if (PV_DATA_LOOP) {
                     Serial.println("========================================");
                     Serial.println("Reached end of data, looping back to start");
@@ -347,8 +773,31 @@ void loop() {
         }
     }
 
+#if TIME_SYNC
+    // Clock offset to RPI#1 (first burst right after connect, then every interval)
+    if (timeSyncDue || currentTime - lastTimeSyncTime >= TIME_SYNC_INTERVAL_MS) {
+        lastTimeSyncTime = currentTime;
+        timeSyncDue = false;
+        syncClock();
+    }
+#endif
+
+#if RTOS_STATS_ENABLED
+    // Publish runtime stats (first block one interval after boot)
+    if (currentTime - lastStatsTime >= RTOS_STATS_INTERVAL_MS) {
+        lastStatsTime = currentTime;
+        sendRtosStats();
+    }
+#endif
+
+#if PV_SOURCE_MODEL
+    handleSerialCommand();
+#endif
+
     // Keep Modbus client alive
+#if !MODBUS_SEQUENCED
     modbus.task();
+#endif
 
     // Small delay to prevent watchdog issues
     delay(10);
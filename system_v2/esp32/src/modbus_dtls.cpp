@@ -0,0 +1,250 @@
+/**
+ * Modbus/UDP over DTLS 1.2 client (see include/modbus_dtls.h)
+ *
+ * Only compiled into the firmware when MODBUS_TRANSPORT_DTLS is enabled in
+ * config.h. Uses the mbedTLS build shipped with the ESP32 Arduino core.
+ */
+
+#include "config.h"
+
+#if MODBUS_TRANSPORT_DTLS
+
+#include "modbus_dtls.h"
+#include "tls_pin.h"
+#include "mbedtls/error.h"
+
+#define MODBUS_FC_WRITE_MULTIPLE_REGISTERS 0x10
+#define MODBUS_MBAP_SIZE 7
+#define MODBUS_MAX_WRITE_REGISTERS 123    // FC16 limit (Modbus spec)
+
+ModbusDTLSClient::ModbusDTLSClient()
+    : _host(nullptr), _verify(false), _pin(nullptr), _initialized(false), _connected(false),
+      _haveSession(false), _failedFrames(0), _lastHandshakeMs(0), _lastWriteMs(0),
+      _handshakes(0), _retransmissions(0) {
+    _port[0] = '\0';
+    _timer = {0, 0, 0};
+}
+
+ModbusDTLSClient::~ModbusDTLSClient() {
+    close();
+    if (_initialized) {
+        mbedtls_ssl_free(&_ssl);
+        mbedtls_ssl_config_free(&_conf);
+        mbedtls_ssl_session_free(&_session);
+        mbedtls_ctr_drbg_free(&_drbg);
+        mbedtls_entropy_free(&_entropy);
+        mbedtls_x509_crt_free(&_ca);
+    }
+}
+
+/**
+ * DTLS retransmission timer (mbedtls_ssl_set_timer_cb contract)
+ */
+void ModbusDTLSClient::timerSet(void* ctx, uint32_t intMs, uint32_t finMs) {
+    DTLSTimer* t = (DTLSTimer*)ctx;
+    t->start = millis();
+    t->intMs = intMs;
+    t->finMs = finMs;
+}
+
+int ModbusDTLSClient::timerGet(void* ctx) {
+    DTLSTimer* t = (DTLSTimer*)ctx;
+    if (t->finMs == 0) {
+        return -1;  // Cancelled
+    }
+    unsigned long elapsed = millis() - t->start;
+    if (elapsed >= t->finMs) {
+        return 2;   // Final delay passed
+    }
+    if (elapsed >= t->intMs) {
+        return 1;   // Intermediate delay passed
+    }
+    return 0;
+}
+
+void ModbusDTLSClient::begin(const char* host, uint16_t port, const char* caPem,
+                             const uint8_t* pinSha256) {
+    _host = host;
+    _pin = pinSha256;
+    snprintf(_port, sizeof(_port), "%u", port);
+
+    mbedtls_net_init(&_net);
+    mbedtls_ssl_init(&_ssl);
+    mbedtls_ssl_config_init(&_conf);
+    mbedtls_ssl_session_init(&_session);
+    mbedtls_entropy_init(&_entropy);
+    mbedtls_ctr_drbg_init(&_drbg);
+    mbedtls_x509_crt_init(&_ca);
+    _initialized = true;
+
+    const char* pers = "esp32-modbus-dtls";
+    mbedtls_ctr_drbg_seed(&_drbg, mbedtls_entropy_func, &_entropy,
+                          (const unsigned char*)pers, strlen(pers));
+
+    mbedtls_ssl_config_defaults(&_conf, MBEDTLS_SSL_IS_CLIENT,
+                                MBEDTLS_SSL_TRANSPORT_DATAGRAM, MBEDTLS_SSL_PRESET_DEFAULT);
+    mbedtls_ssl_conf_rng(&_conf, mbedtls_ctr_drbg_random, &_drbg);
+    mbedtls_ssl_conf_min_version(&_conf, MBEDTLS_SSL_MAJOR_VERSION_3, MBEDTLS_SSL_MINOR_VERSION_3);
+    mbedtls_ssl_conf_handshake_timeout(&_conf, DTLS_HANDSHAKE_MIN_MS, DTLS_HANDSHAKE_MAX_MS);
+    mbedtls_ssl_conf_read_timeout(&_conf, DTLS_ACK_TIMEOUT_MS);
+
+    // The self-signed server certificate is its own trust anchor
+    _verify = caPem != nullptr
+        && mbedtls_x509_crt_parse(&_ca, (const unsigned char*)caPem, strlen(caPem) + 1) == 0;
+    if (_verify) {
+        mbedtls_ssl_conf_ca_chain(&_conf, &_ca, nullptr);
+        mbedtls_ssl_conf_authmode(&_conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+    } else {
+        mbedtls_ssl_conf_authmode(&_conf, MBEDTLS_SSL_VERIFY_NONE);
+    }
+
+    mbedtls_ssl_setup(&_ssl, &_conf);
+    mbedtls_ssl_set_timer_cb(&_ssl, &_timer, timerSet, timerGet);
+}
+
+bool ModbusDTLSClient::connect() {
+    close();
+
+    int ret = mbedtls_net_connect(&_net, _host, _port, MBEDTLS_NET_PROTO_UDP);
+    if (ret != 0) {
+        return false;
+    }
+
+    mbedtls_ssl_session_reset(&_ssl);
+    mbedtls_ssl_set_bio(&_ssl, &_net, mbedtls_net_send, mbedtls_net_recv, mbedtls_net_recv_timeout);
+    if (_verify) {
+        mbedtls_ssl_set_hostname(&_ssl, TLS_SERVER_NAME);
+    }
+    if (_haveSession) {
+        // Abbreviated handshake if the server kept the session
+        mbedtls_ssl_set_session(&_ssl, &_session);
+    }
+
+    unsigned long start = millis();
+    do {
+        ret = mbedtls_ssl_handshake(&_ssl);
+    } while (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE);
+
+    if (ret != 0) {
+        if (DEBUG_ENABLED) {
+            char err[96];
+            mbedtls_strerror(ret, err, sizeof(err));
+            Serial.print("✗ DTLS handshake failed: ");
+            Serial.println(err);
+        }
+        mbedtls_net_free(&_net);
+        _haveSession = false;
+        return false;
+    }
+
+    // Resumed sessions keep the peer certificate of the pinned full handshake
+    if (_pin != nullptr && !tlsPinMatches(mbedtls_ssl_get_peer_cert(&_ssl), _pin)) {
+        if (DEBUG_ENABLED) {
+            Serial.println("✗ DTLS server public key does not match pin");
+        }
+        mbedtls_ssl_close_notify(&_ssl);
+        mbedtls_net_free(&_net);
+        _haveSession = false;
+        return false;
+    }
+
+    _lastHandshakeMs = millis() - start;
+    _handshakes++;
+    _connected = true;
+    _failedFrames = 0;
+
+    mbedtls_ssl_session_free(&_session);
+    mbedtls_ssl_session_init(&_session);
+    _haveSession = mbedtls_ssl_get_session(&_ssl, &_session) == 0;
+    return true;
+}
+
+bool ModbusDTLSClient::writeRegisters(uint8_t unitId, uint16_t address, const uint16_t* values,
+                                      uint16_t count, uint16_t seq) {
+    if (!_connected || count == 0 || count > MODBUS_MAX_WRITE_REGISTERS) {
+        return false;
+    }
+
+    // MBAP + FC16 request
+    uint8_t req[MODBUS_MBAP_SIZE + 6 + 2 * MODBUS_MAX_WRITE_REGISTERS];
+    uint16_t pduLen = 6 + 2 * count;
+    uint16_t len = MODBUS_MBAP_SIZE + pduLen;
+    req[0] = seq >> 8;
+    req[1] = seq & 0xFF;
+    req[2] = 0;
+    req[3] = 0;
+    req[4] = (pduLen + 1) >> 8;
+    req[5] = (pduLen + 1) & 0xFF;
+    req[6] = unitId;
+    req[7] = MODBUS_FC_WRITE_MULTIPLE_REGISTERS;
+    req[8] = address >> 8;
+    req[9] = address & 0xFF;
+    req[10] = count >> 8;
+    req[11] = count & 0xFF;
+    req[12] = 2 * count;
+    for (uint16_t i = 0; i < count; i++) {
+        req[13 + 2 * i] = values[i] >> 8;
+        req[14 + 2 * i] = values[i] & 0xFF;
+    }
+
+    unsigned long start = millis();
+    uint8_t resp[32];
+
+    for (int attempt = 0; attempt < DTLS_RETRY_COUNT; attempt++) {
+        if (attempt > 0) {
+            _retransmissions++;
+        }
+
+        int ret = mbedtls_ssl_write(&_ssl, req, len);
+        if (ret < 0) {
+            // Fatal record-layer error: session must be re-established
+            _connected = false;
+            return false;
+        }
+
+        // Wait for the matching response, discarding late answers to older frames
+        while (true) {
+            ret = mbedtls_ssl_read(&_ssl, resp, sizeof(resp));
+            if (ret == MBEDTLS_ERR_SSL_TIMEOUT) {
+                break;  // Retransmit same frame
+            }
+            if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+                continue;
+            }
+            if (ret <= 0) {
+                // Close notify or fatal alert (e.g. server restarted)
+                _connected = false;
+                _haveSession = false;
+                return false;
+            }
+            if (ret < MODBUS_MBAP_SIZE + 1 || ((resp[0] << 8) | resp[1]) != seq) {
+                continue;
+            }
+            _lastWriteMs = millis() - start;
+            _failedFrames = 0;
+            return resp[7] == MODBUS_FC_WRITE_MULTIPLE_REGISTERS;
+        }
+    }
+
+    // No answer at all: the server ignores records of sessions it no longer
+    // knows, so a silently dropped session looks exactly like this
+    if (++_failedFrames >= DTLS_MAX_FAILED_FRAMES) {
+        if (DEBUG_ENABLED) {
+            Serial.println("✗ DTLS session unresponsive, re-handshaking next cycle");
+        }
+        close();
+    }
+    return false;
+}
+
+void ModbusDTLSClient::close() {
+    if (_connected) {
+        mbedtls_ssl_close_notify(&_ssl);
+    }
+    if (_initialized) {
+        mbedtls_net_free(&_net);
+    }
+    _connected = false;
+}
+
+#endif // MODBUS_TRANSPORT_DTLS
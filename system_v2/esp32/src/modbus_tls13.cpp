@@ -0,0 +1,299 @@
+/**
+ * Sequenced Modbus/TCP over TLS 1.3 client (see include/modbus_tls13.h)
+ *
+ * Only compiled into the firmware when MODBUS_TRANSPORT_TLS13 is enabled in
+ * config.h. Needs mbedTLS 3.6 with TLS 1.3 (ESP32 Arduino core 3.x, see
+ * env:esp32tls13 in platformio.ini); 0-RTT additionally needs
+ * MBEDTLS_SSL_EARLY_DATA, otherwise reconnects use 1-RTT resumption.
+ */
+
+#include "config.h"
+
+#if MODBUS_TRANSPORT_TLS13
+
+#include "modbus_tls13.h"
+#include "tls_pin.h"
+#include "mbedtls/error.h"
+#include "psa/crypto.h"
+
+#if !defined(MBEDTLS_SSL_PROTO_TLS1_3)
+#error "MODBUS_TRANSPORT_TLS13 needs an ESP32 core with CONFIG_MBEDTLS_SSL_PROTO_TLS1_3 (env:esp32tls13)"
+#endif
+
+#define MODBUS_FC_WRITE_MULTIPLE_REGISTERS 0x10
+#define MODBUS_MBAP_SIZE 7
+#define MODBUS_MAX_WRITE_REGISTERS 123    // FC16 limit (Modbus spec)
+
+ModbusTLS13Client::ModbusTLS13Client()
+    : _host(nullptr), _verify(false), _pin(nullptr), _initialized(false), _connected(false),
+      _haveSession(false), _lastOfferedTicket(false), _lastHandshakeMs(0), _lastWriteMs(0),
+      _handshakes(0), _ticketOffers(0), _earlyDataFrames(0) {
+    _port[0] = '\0';
+}
+
+ModbusTLS13Client::~ModbusTLS13Client() {
+    close();
+    if (_initialized) {
+        mbedtls_ssl_free(&_ssl);
+        mbedtls_ssl_config_free(&_conf);
+        mbedtls_ssl_session_free(&_session);
+        mbedtls_ctr_drbg_free(&_drbg);
+        mbedtls_entropy_free(&_entropy);
+        mbedtls_x509_crt_free(&_ca);
+    }
+}
+
+void ModbusTLS13Client::begin(const char* host, uint16_t port, const char* caPem,
+                              const uint8_t* pinSha256) {
+    _host = host;
+    _pin = pinSha256;
+    snprintf(_port, sizeof(_port), "%u", port);
+
+    // TLS 1.3 in mbedTLS 3.x runs its key schedule through PSA
+    psa_crypto_init();
+
+    mbedtls_net_init(&_net);
+    mbedtls_ssl_init(&_ssl);
+    mbedtls_ssl_config_init(&_conf);
+    mbedtls_ssl_session_init(&_session);
+    mbedtls_entropy_init(&_entropy);
+    mbedtls_ctr_drbg_init(&_drbg);
+    mbedtls_x509_crt_init(&_ca);
+    _initialized = true;
+
+    const char* pers = "esp32-modbus-tls13";
+    mbedtls_ctr_drbg_seed(&_drbg, mbedtls_entropy_func, &_entropy,
+                          (const unsigned char*)pers, strlen(pers));
+
+    mbedtls_ssl_config_defaults(&_conf, MBEDTLS_SSL_IS_CLIENT,
+                                MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT);
+    mbedtls_ssl_conf_rng(&_conf, mbedtls_ctr_drbg_random, &_drbg);
+    mbedtls_ssl_conf_min_tls_version(&_conf, MBEDTLS_SSL_VERSION_TLS1_3);
+    mbedtls_ssl_conf_max_tls_version(&_conf, MBEDTLS_SSL_VERSION_TLS1_3);
+    mbedtls_ssl_conf_read_timeout(&_conf, TLS13_RESPONSE_TIMEOUT_MS);
+
+    // psk_dhe_ke for resumption (forward secrecy kept), ephemeral for full handshakes
+    mbedtls_ssl_conf_tls13_key_exchange_modes(&_conf, MBEDTLS_SSL_TLS1_3_KEY_EXCHANGE_MODE_ALL);
+#if defined(MBEDTLS_SSL_SESSION_TICKETS) && MBEDTLS_VERSION_NUMBER >= 0x03060100
+    // Since 3.6.1 NewSessionTicket is only reported to the application when enabled
+    mbedtls_ssl_conf_tls13_enable_signal_new_session_tickets(
+        &_conf, MBEDTLS_SSL_TLS1_3_SIGNAL_NEW_SESSION_TICKETS_ENABLED);
+#endif
+#if defined(MBEDTLS_SSL_EARLY_DATA)
+    mbedtls_ssl_conf_early_data(&_conf, TLS13_EARLY_DATA ? MBEDTLS_SSL_EARLY_DATA_ENABLED
+                                                         : MBEDTLS_SSL_EARLY_DATA_DISABLED);
+#endif
+
+    _verify = caPem != nullptr
+        && mbedtls_x509_crt_parse(&_ca, (const unsigned char*)caPem, strlen(caPem) + 1) == 0;
+    if (_verify) {
+        mbedtls_ssl_conf_ca_chain(&_conf, &_ca, nullptr);
+        mbedtls_ssl_conf_authmode(&_conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+    } else {
+        mbedtls_ssl_conf_authmode(&_conf, MBEDTLS_SSL_VERIFY_NONE);
+    }
+
+    mbedtls_ssl_setup(&_ssl, &_conf);
+}
+
+/**
+ * TCP connect + TLS 1.3 handshake, offering the saved ticket
+ *
+ * If earlyData is given and the ticket allows 0-RTT, it is sent in the
+ * first flight; *earlySent returns how many bytes the server accepted.
+ */
+bool ModbusTLS13Client::handshake(const uint8_t* earlyData, size_t earlyLen, size_t* earlySent) {
+    close();
+    *earlySent = 0;
+
+    unsigned long start = millis();
+    int ret = mbedtls_net_connect(&_net, _host, _port, MBEDTLS_NET_PROTO_TCP);
+    if (ret != 0) {
+        return false;
+    }
+
+    mbedtls_ssl_session_reset(&_ssl);
+    mbedtls_ssl_set_bio(&_ssl, &_net, mbedtls_net_send, mbedtls_net_recv, mbedtls_net_recv_timeout);
+    // Also bound to the ticket: resumption requires the same server name
+    mbedtls_ssl_set_hostname(&_ssl, TLS_SERVER_NAME);
+
+    _lastOfferedTicket = _haveSession && mbedtls_ssl_set_session(&_ssl, &_session) == 0;
+    if (_lastOfferedTicket) {
+        _ticketOffers++;
+    }
+
+    size_t early = 0;
+#if defined(MBEDTLS_SSL_EARLY_DATA)
+    if (TLS13_EARLY_DATA && _lastOfferedTicket && earlyData != nullptr) {
+        // Fails with MBEDTLS_ERR_SSL_CANNOT_WRITE_EARLY_DATA if the ticket does not allow 0-RTT
+        do {
+            ret = mbedtls_ssl_write_early_data(&_ssl, earlyData, earlyLen);
+        } while (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE);
+        early = ret > 0 ? ret : 0;
+    }
+#endif
+
+    do {
+        ret = mbedtls_ssl_handshake(&_ssl);
+    } while (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE);
+
+    if (ret != 0) {
+        if (DEBUG_ENABLED) {
+            char err[96];
+            mbedtls_strerror(ret, err, sizeof(err));
+            Serial.print("✗ TLS 1.3 handshake failed: ");
+            Serial.println(err);
+        }
+        mbedtls_net_free(&_net);
+        _haveSession = false;  // Ticket may be the reason (server restarted, key rotated)
+        return false;
+    }
+
+    // Full handshakes present a certificate; resumption is authenticated by
+    // the PSK of an earlier (pinned) full handshake
+    const mbedtls_x509_crt* peer = mbedtls_ssl_get_peer_cert(&_ssl);
+    bool authenticated = peer != nullptr ? (_pin == nullptr || tlsPinMatches(peer, _pin))
+                                         : _lastOfferedTicket;
+    if (!authenticated) {
+        if (DEBUG_ENABLED) {
+            Serial.println("✗ TLS 1.3 server public key does not match pin");
+        }
+        mbedtls_ssl_close_notify(&_ssl);
+        mbedtls_net_free(&_net);
+        _haveSession = false;
+        return false;
+    }
+
+#if defined(MBEDTLS_SSL_EARLY_DATA)
+    if (early > 0 && mbedtls_ssl_get_early_data_status(&_ssl) == MBEDTLS_SSL_EARLY_DATA_STATUS_ACCEPTED) {
+        *earlySent = early;
+        _earlyDataFrames++;
+    }
+#endif
+
+    _lastHandshakeMs = millis() - start;
+    _handshakes++;
+    _connected = true;
+    return true;
+}
+
+bool ModbusTLS13Client::connect() {
+    size_t earlySent;
+    return handshake(nullptr, 0, &earlySent);
+}
+
+/**
+ * Keep the latest ticket for the next reconnect
+ */
+void ModbusTLS13Client::saveSession() {
+    mbedtls_ssl_session_free(&_session);
+    mbedtls_ssl_session_init(&_session);
+    _haveSession = mbedtls_ssl_get_session(&_ssl, &_session) == 0;
+}
+
+bool ModbusTLS13Client::writeAll(const uint8_t* data, size_t len) {
+    while (len > 0) {
+        int ret = mbedtls_ssl_write(&_ssl, data, len);
+        if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+            continue;
+        }
+        if (ret <= 0) {
+            return false;
+        }
+        data += ret;
+        len -= ret;
+    }
+    return true;
+}
+
+bool ModbusTLS13Client::writeRegisters(uint8_t unitId, uint16_t address, const uint16_t* values,
+                                       uint16_t count, uint16_t seq) {
+    if (count == 0 || count > MODBUS_MAX_WRITE_REGISTERS) {
+        return false;
+    }
+
+    // MBAP + FC16 request (transaction id = frame sequence)
+    uint8_t req[MODBUS_MBAP_SIZE + 6 + 2 * MODBUS_MAX_WRITE_REGISTERS];
+    uint16_t pduLen = 6 + 2 * count;
+    uint16_t len = MODBUS_MBAP_SIZE + pduLen;
+    req[0] = seq >> 8;
+    req[1] = seq & 0xFF;
+    req[2] = 0;
+    req[3] = 0;
+    req[4] = (pduLen + 1) >> 8;
+    req[5] = (pduLen + 1) & 0xFF;
+    req[6] = unitId;
+    req[7] = MODBUS_FC_WRITE_MULTIPLE_REGISTERS;
+    req[8] = address >> 8;
+    req[9] = address & 0xFF;
+    req[10] = count >> 8;
+    req[11] = count & 0xFF;
+    req[12] = 2 * count;
+    for (uint16_t i = 0; i < count; i++) {
+        req[13 + 2 * i] = values[i] >> 8;
+        req[14 + 2 * i] = values[i] & 0xFF;
+    }
+
+    unsigned long start = millis();
+    size_t sent = 0;
+    if (!_connected && !handshake(req, len, &sent)) {
+        return false;
+    }
+    if (!writeAll(req + sent, len - sent)) {
+        close();
+        return false;
+    }
+
+    // Read the response; tickets and late answers to older frames are skipped
+    uint8_t resp[64];
+    size_t have = 0;
+    while (true) {
+        int ret = mbedtls_ssl_read(&_ssl, resp + have, sizeof(resp) - have);
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+        if (ret == MBEDTLS_ERR_SSL_RECEIVED_NEW_SESSION_TICKET) {
+            saveSession();
+            continue;
+        }
+#endif
+        if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+            continue;
+        }
+        if (ret <= 0) {
+            // Timeout, close notify or fatal alert: reconnect, RPI#1 dedupes the resend
+            close();
+            return false;
+        }
+        have += ret;
+
+        while (have >= MODBUS_MBAP_SIZE + 2) {
+            size_t adu = MODBUS_MBAP_SIZE - 1 + ((resp[4] << 8) | resp[5]);
+            if (adu > sizeof(resp)) {
+                close();
+                return false;
+            }
+            if (have < adu) {
+                break;
+            }
+            bool match = ((resp[0] << 8) | resp[1]) == seq;
+            bool ok = resp[7] == MODBUS_FC_WRITE_MULTIPLE_REGISTERS;
+            memmove(resp, resp + adu, have - adu);
+            have -= adu;
+            if (match) {
+                _lastWriteMs = millis() - start;
+                return ok;
+            }
+        }
+    }
+}
+
+void ModbusTLS13Client::close() {
+    if (_connected) {
+        mbedtls_ssl_close_notify(&_ssl);
+    }
+    if (_initialized) {
+        mbedtls_net_free(&_net);
+    }
+    _connected = false;
+}
+
+#endif // MODBUS_TRANSPORT_TLS13
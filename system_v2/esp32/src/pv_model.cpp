@@ -0,0 +1,197 @@
+/**
+ * On-device fixed-point PV model (see include/pv_model.h)
+ *
+ * Only compiled into the firmware when PV_SOURCE_MODEL is enabled in
+ * config.h; the generated pv_input.h / pv_model_coeffs.h headers are then
+ * required (run data_preparation/generate_esp32_data.py).
+ *
+ * Any change to the arithmetic here must be mirrored in
+ * fixed_point_model() in generate_esp32_data.py, which validates the
+ * integer model against the pvlib ModelChain output.
+ */
+
+#include "config.h"
+
+#if PV_SOURCE_MODEL
+
+#include "pv_model.h"
+#define PV_INPUT_IMPLEMENTATION
+#include "pv_input.h"
+#include "pv_model_coeffs.h"
+
+PVModelParams pvModelParams;
+
+/**
+ * Helper function: Clamp value to uint16 range
+ */
+static uint16_t clampU16(int32_t value) {
+    if (value < 0) return 0;
+    if (value > 65535) return 65535;
+    return (uint16_t)value;
+}
+
+/**
+ * Linear interpolation on a uniform-grid LUT
+ * x_q16: position in LUT steps (Q16)
+ */
+static int32_t lutInterp(const uint16_t* lut, uint16_t size, uint32_t x_q16) {
+    uint32_t i = x_q16 >> 16;
+    if (i >= (uint32_t)(size - 1)) {
+        return lut[size - 1];
+    }
+    int32_t a = lut[i];
+    int32_t b = lut[i + 1];
+    int64_t frac = x_q16 & 0xFFFF;
+    return a + (int32_t)(((int64_t)(b - a) * frac) >> 16);
+}
+
+void pvModelLoadDefaults(PVModelParams* params) {
+    memcpy_P(params, &PV_MODEL_DEFAULTS, sizeof(PVModelParams));
+}
+
+void pvModelCompute(const PVModelParams* p, uint16_t index, PVSample* out) {
+    PVInputSample in;
+    memcpy_P(&in, &PV_INPUT[index], sizeof(PVInputSample));
+
+    // Unpack input record
+    uint32_t packed = (uint32_t)in.b[0] | ((uint32_t)in.b[1] << 8) | ((uint32_t)in.b[2] << 16);
+    int32_t poa = packed & 0xFFF;                 // POA global (W/m²)
+    int32_t ghi = packed >> 12;                   // GHI (W/m²)
+    int32_t eff = poa * in.b[3] / 255;            // Effective irradiance (W/m²)
+    int32_t tair_x10 = (int8_t)in.b[4] * 5;       // °C × 2 → °C × 10
+
+    // SAPM cell temperature (°C × 10)
+    int32_t tm_x10 = tair_x10 + (int32_t)(((int64_t)poa * p->wind_q20[in.b[5]] * 10) >> 20);
+    int32_t tc_x10 = tm_x10 + poa * p->delta_t_x10 / 1000;
+    int32_t dt_x10 = tc_x10 - 250;
+
+    // DC side (maximum power point)
+    int32_t pdc_mw = 0;
+    int32_t vmp_mv = 0;
+    int32_t imp_ma = 0;
+    if (eff > 0) {
+        uint32_t x_q16 = ((uint32_t)eff << 16) / p->irr_step;
+
+        int64_t pdc = (int64_t)p->pdc0_mw * eff / 1000;
+        pdc = (pdc * lutInterp(p->k_irr_q15, PV_MODEL_IRR_LUT_SIZE, x_q16)) >> 15;
+        pdc = pdc * (1000000 + (int64_t)p->gamma_ppm * dt_x10 / 10) / 1000000;
+        pdc_mw = pdc > 0 ? (int32_t)pdc : 0;
+
+        int64_t vmp = ((int64_t)p->vmp_ref_mv * lutInterp(p->v_irr_q15, PV_MODEL_IRR_LUT_SIZE, x_q16)) >> 15;
+        vmp = vmp * (1000000 + (int64_t)p->beta_vmp_ppm * dt_x10 / 10) / 1000000;
+        vmp_mv = vmp > 0 ? (int32_t)vmp : 0;
+
+        if (vmp_mv > 0) {
+            imp_ma = (int32_t)((int64_t)pdc_mw * 1000 / vmp_mv);
+        }
+    }
+
+    // AC side (inverter efficiency curve, clipped at AC rating)
+    int32_t pac_mw = 0;
+    if (pdc_mw > p->pso_mw) {
+        // LUT step is 0.05 × P_dco
+        uint32_t load_q16 = (uint32_t)((((int64_t)pdc_mw << 16) * 20) / p->pdco_mw);
+        int32_t eta = lutInterp(p->eta_q15, PV_MODEL_INV_LUT_SIZE, load_q16);
+        pac_mw = (int32_t)(((int64_t)pdc_mw * eta) >> 15);
+        if (pac_mw > p->paco_mw) {
+            pac_mw = p->paco_mw;
+        }
+    }
+
+    // Register encoding (same scaling as pv_data.h)
+    out->P_ac = clampU16((pac_mw + 500) / 1000);
+    out->P_dc = clampU16((pdc_mw + 500) / 1000);
+    out->V_dc = clampU16((vmp_mv + 50) / 100);     // V × 10
+    out->I_dc = clampU16((imp_ma + 5) / 10);       // A × 100
+    out->G = clampU16(ghi);
+    out->T_cell = clampU16(tc_x10);                // °C × 10
+    out->timestamp = PV_INPUT_START + (uint32_t)index * PV_INPUT_STEP_S;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Runtime parameter updates                                                 */
+/* ------------------------------------------------------------------------- */
+
+struct PVModelField {
+    const char* name;
+    size_t offset;
+    bool isU16;
+    int32_t min;
+    int32_t max;
+};
+
+// Scalar parameters and their accepted ranges (LUTs come from the generator only)
+static const PVModelField PV_MODEL_FIELDS[] = {
+    {"pdc0_mw",      offsetof(PVModelParams, pdc0_mw),      false, 1,       20000000},
+    {"gamma_ppm",    offsetof(PVModelParams, gamma_ppm),    false, -20000,  0},
+    {"vmp_ref_mv",   offsetof(PVModelParams, vmp_ref_mv),   false, 1000,    1500000},
+    {"beta_vmp_ppm", offsetof(PVModelParams, beta_vmp_ppm), false, -20000,  0},
+    {"irr_step",     offsetof(PVModelParams, irr_step),     true,  1,       500},
+    {"delta_t_x10",  offsetof(PVModelParams, delta_t_x10),  false, 0,       200},
+    {"paco_mw",      offsetof(PVModelParams, paco_mw),      false, 1,       20000000},
+    {"pdco_mw",      offsetof(PVModelParams, pdco_mw),      false, 1,       20000000},
+    {"pso_mw",       offsetof(PVModelParams, pso_mw),       false, 0,       1000000},
+};
+
+#define PV_MODEL_FIELD_COUNT (sizeof(PV_MODEL_FIELDS) / sizeof(PV_MODEL_FIELDS[0]))
+
+static int32_t fieldGet(const PVModelParams* params, const PVModelField& f) {
+    const uint8_t* p = (const uint8_t*)params + f.offset;
+    return f.isU16 ? *(const uint16_t*)p : *(const int32_t*)p;
+}
+
+bool pvModelValidate(const PVModelParams* params) {
+    for (size_t i = 0; i < PV_MODEL_FIELD_COUNT; i++) {
+        int32_t v = fieldGet(params, PV_MODEL_FIELDS[i]);
+        if (v < PV_MODEL_FIELDS[i].min || v > PV_MODEL_FIELDS[i].max) {
+            return false;
+        }
+    }
+    // Self-consumption below the DC rating, AC rating at most the DC input at it
+    if (params->pso_mw >= params->pdco_mw || params->paco_mw > params->pdco_mw) {
+        return false;
+    }
+    return true;
+}
+
+bool pvModelSetParam(PVModelParams* params, const char* name, int32_t value) {
+    for (size_t i = 0; i < PV_MODEL_FIELD_COUNT; i++) {
+        const PVModelField& f = PV_MODEL_FIELDS[i];
+        if (strcmp(name, f.name) != 0) {
+            continue;
+        }
+        PVModelParams next = *params;
+        uint8_t* p = (uint8_t*)&next + f.offset;
+        if (f.isU16) {
+            if (value < 0 || value > 65535) {
+                return false;
+            }
+            *(uint16_t*)p = (uint16_t)value;
+        } else {
+            *(int32_t*)p = value;
+        }
+        if (!pvModelValidate(&next)) {
+            return false;
+        }
+        // Samples are computed on the loop task, which also runs this: no torn reads
+        *params = next;
+        return true;
+    }
+    return false;
+}
+
+void pvModelPrintParams(const PVModelParams* params) {
+    for (size_t i = 0; i < PV_MODEL_FIELD_COUNT; i++) {
+        Serial.print("  ");
+        Serial.print(PV_MODEL_FIELDS[i].name);
+        Serial.print(" = ");
+        Serial.print(fieldGet(params, PV_MODEL_FIELDS[i]));
+        Serial.print("  [");
+        Serial.print(PV_MODEL_FIELDS[i].min);
+        Serial.print(", ");
+        Serial.print(PV_MODEL_FIELDS[i].max);
+        Serial.println("]");
+    }
+}
+
+#endif // PV_SOURCE_MODEL
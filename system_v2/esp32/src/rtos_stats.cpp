@@ -0,0 +1,151 @@
+/**
+ * FreeRTOS runtime profiling (see include/rtos_stats.h)
+ *
+ * Only compiled into the firmware when RTOS_STATS_ENABLED is set in config.h.
+ * Per-task CPU needs configGENERATE_RUN_TIME_STATS in the core's sdkconfig.
+ */
+
+#include "config.h"
+
+#if RTOS_STATS_ENABLED
+
+#include "rtos_stats.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+
+#define RTOS_STATS_MAX_TASKS 32
+
+static const char* trackedNames[RTOS_STATS_TRACKED_TASKS] = RTOS_STATS_TASK_NAMES;
+static uint16_t sequence = 0;
+
+#if configGENERATE_RUN_TIME_STATS
+// Run-time counters from the previous collection (per task handle)
+static TaskHandle_t prevHandles[RTOS_STATS_MAX_TASKS];
+static uint32_t prevCounters[RTOS_STATS_MAX_TASKS];
+static UBaseType_t prevCount = 0;
+static uint32_t prevTotal = 0;
+
+/**
+ * Run-time delta of a task since the previous collection
+ */
+static uint32_t taskDelta(const TaskStatus_t* task) {
+    for (UBaseType_t i = 0; i < prevCount; i++) {
+        if (prevHandles[i] == task->xHandle) {
+            return task->ulRunTimeCounter - prevCounters[i];
+        }
+    }
+    return task->ulRunTimeCounter;  // New task: counted since creation
+}
+
+/**
+ * Share of one core (% × 100)
+ */
+static uint16_t cpuPercent(uint32_t delta, uint32_t total) {
+    if (total == 0) {
+        return 0;
+    }
+    uint32_t pct = (uint32_t)((uint64_t)delta * 10000 / total);
+    return pct > 10000 ? 10000 : pct;
+}
+#endif
+
+void rtosStatsCollect(uint16_t* regs) {
+    static TaskStatus_t tasks[RTOS_STATS_MAX_TASKS];
+    uint32_t total = 0;
+    UBaseType_t count = uxTaskGetSystemState(tasks, RTOS_STATS_MAX_TASKS, &total);
+
+    uint32_t heapFree = esp_get_free_heap_size();
+    uint32_t heapMin = esp_get_minimum_free_heap_size();
+
+    regs[0] = ++sequence;
+    regs[1] = heapFree >> 16;
+    regs[2] = heapFree & 0xFFFF;
+    regs[3] = heapMin >> 16;
+    regs[4] = heapMin & 0xFFFF;
+    regs[5] = RTOS_STATS_NOT_AVAILABLE;
+    regs[6] = RTOS_STATS_NOT_AVAILABLE;
+    regs[7] = count;
+    for (int t = 0; t < RTOS_STATS_TRACKED_TASKS; t++) {
+        regs[8 + 2 * t] = RTOS_STATS_NOT_AVAILABLE;
+        regs[9 + 2 * t] = RTOS_STATS_NOT_AVAILABLE;
+    }
+
+#if configGENERATE_RUN_TIME_STATS
+    uint32_t totalDelta = total - prevTotal;
+#endif
+
+    for (UBaseType_t i = 0; i < count; i++) {
+#if configGENERATE_RUN_TIME_STATS
+        uint16_t cpu = cpuPercent(taskDelta(&tasks[i]), totalDelta);
+
+        // Core load = 100% − idle task share
+        if (tasks[i].xHandle == xTaskGetIdleTaskHandleForCPU(0)) {
+            regs[5] = 10000 - cpu;
+        } else if (portNUM_PROCESSORS > 1 && tasks[i].xHandle == xTaskGetIdleTaskHandleForCPU(1)) {
+            regs[6] = 10000 - cpu;
+        }
+#else
+        uint16_t cpu = RTOS_STATS_NOT_AVAILABLE;
+#endif
+
+        for (int t = 0; t < RTOS_STATS_TRACKED_TASKS; t++) {
+            if (strcmp(tasks[i].pcTaskName, trackedNames[t]) == 0) {
+                regs[8 + 2 * t] = cpu;
+                regs[9 + 2 * t] = tasks[i].usStackHighWaterMark;  // Bytes on ESP-IDF
+            }
+        }
+    }
+
+#if configGENERATE_RUN_TIME_STATS
+    for (UBaseType_t i = 0; i < count; i++) {
+        prevHandles[i] = tasks[i].xHandle;
+        prevCounters[i] = tasks[i].ulRunTimeCounter;
+    }
+    prevCount = count;
+    prevTotal = total;
+#endif
+}
+
+/**
+ * Helper function: print % × 100 value or "n/a"
+ */
+static void printPercent(uint16_t value) {
+    if (value == RTOS_STATS_NOT_AVAILABLE) {
+        Serial.print("n/a");
+    } else {
+        Serial.print(value / 100.0, 2);
+        Serial.print("%");
+    }
+}
+
+void rtosStatsPrint(const uint16_t* regs) {
+    Serial.println("[RTOS STATS]");
+    Serial.print("  Heap free: ");
+    Serial.print(((uint32_t)regs[1] << 16) | regs[2]);
+    Serial.print(" B (min ");
+    Serial.print(((uint32_t)regs[3] << 16) | regs[4]);
+    Serial.println(" B)");
+    Serial.print("  Core load: ");
+    printPercent(regs[5]);
+    Serial.print(" / ");
+    printPercent(regs[6]);
+    Serial.print(" | Tasks: ");
+    Serial.println(regs[7]);
+
+    for (int t = 0; t < RTOS_STATS_TRACKED_TASKS; t++) {
+        Serial.print("  ");
+        Serial.print(trackedNames[t]);
+        Serial.print(": CPU ");
+        printPercent(regs[8 + 2 * t]);
+        Serial.print(", stack free ");
+        if (regs[9 + 2 * t] == RTOS_STATS_NOT_AVAILABLE) {
+            Serial.println("n/a");
+        } else {
+            Serial.print(regs[9 + 2 * t]);
+            Serial.println(" B");
+        }
+    }
+}
+
+#endif // RTOS_STATS_ENABLED
@@ -0,0 +1,45 @@
+/**
+ * Clock offset to the RPI#1 time service (see include/time_sync.h)
+ */
+
+#include "time_sync.h"
+
+static uint64_t u64(const uint16_t* regs) {
+    return ((uint64_t)regs[0] << 48) | ((uint64_t)regs[1] << 32)
+         | ((uint64_t)regs[2] << 16) | regs[3];
+}
+
+void TimeSyncEstimator::begin() {
+    _burstValid = false;
+    _samples = 0;
+}
+
+void TimeSyncEstimator::addSample(int64_t t1Us, int64_t t4Us, const uint16_t* regs) {
+    if (t4Us < t1Us) {
+        return;
+    }
+    uint32_t rtt = (uint32_t)(t4Us - t1Us);
+    _samples++;
+
+    // Keep the lowest-RTT exchange of the burst
+    if (_burstValid && rtt >= _rttUs) {
+        return;
+    }
+
+    int64_t mid = t1Us + (t4Us - t1Us) / 2;
+    _monoOffsetUs = (int64_t)(u64(&regs[0]) / 1000) - mid;
+    _utcOffsetUs = (int64_t)(u64(&regs[4]) / 1000) - mid;
+    _rttUs = rtt;
+    _burstValid = true;
+    _valid = true;
+}
+
+void TimeSyncEstimator::report(uint16_t* regs) const {
+    uint64_t offset = (uint64_t)_monoOffsetUs;
+    regs[0] = (offset >> 48) & 0xFFFF;
+    regs[1] = (offset >> 32) & 0xFFFF;
+    regs[2] = (offset >> 16) & 0xFFFF;
+    regs[3] = offset & 0xFFFF;
+    regs[4] = _rttUs >> 16;
+    regs[5] = _rttUs & 0xFFFF;
+}
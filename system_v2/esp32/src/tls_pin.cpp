@@ -0,0 +1,43 @@
+/**
+ * Server public-key pinning (see include/tls_pin.h)
+ */
+
+#include "tls_pin.h"
+#include "mbedtls/version.h"
+#include "mbedtls/pk.h"
+#include "mbedtls/sha256.h"
+
+// DER SubjectPublicKeyInfo of an RSA-4096 key is 550 bytes
+#define TLS_PIN_MAX_SPKI 600
+
+bool tlsPinCompute(const mbedtls_x509_crt* crt, uint8_t* sha256) {
+    if (crt == nullptr) {
+        return false;
+    }
+
+    // mbedtls_pk_write_pubkey_der() writes at the end of the buffer
+    uint8_t der[TLS_PIN_MAX_SPKI];
+    int len = mbedtls_pk_write_pubkey_der((mbedtls_pk_context*)&crt->pk, der, sizeof(der));
+    if (len <= 0) {
+        return false;
+    }
+
+#if MBEDTLS_VERSION_NUMBER >= 0x03000000
+    return mbedtls_sha256(der + sizeof(der) - len, len, sha256, 0) == 0;
+#else
+    return mbedtls_sha256_ret(der + sizeof(der) - len, len, sha256, 0) == 0;
+#endif
+}
+
+bool tlsPinMatches(const mbedtls_x509_crt* crt, const uint8_t* pin) {
+    uint8_t hash[TLS_PIN_SIZE];
+    if (!tlsPinCompute(crt, hash)) {
+        return false;
+    }
+
+    uint8_t diff = 0;
+    for (int i = 0; i < TLS_PIN_SIZE; i++) {
+        diff |= hash[i] ^ pin[i];
+    }
+    return diff == 0;
+}
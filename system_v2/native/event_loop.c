@@ -0,0 +1,692 @@
+// Completion-based event loop with io_uring and epoll backends (see event_loop.h)
+//
+// Compiled into the tools that use it, e.g.:
+//   gcc -O2 -Wall -o modbus_mms_gateway modbus_mms_gateway.c event_loop.c timer_wheel.c
+
+#define _GNU_SOURCE
+#include "event_loop.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+
+#define OP_SEND     1
+#define OP_RECV     2
+#define OP_PWRITE   3
+
+#define MAX_EVENTS  64
+
+// Older headers
+#ifndef IORING_FEAT_CQE_SKIP
+#define IORING_FEAT_CQE_SKIP    (1U << 11)
+#endif
+#ifndef IOSQE_CQE_SKIP_SUCCESS
+#define IOSQE_CQE_SKIP_SUCCESS  (1U << 6)
+#endif
+
+struct uring {
+    int fd;
+    unsigned entries;
+    unsigned features;
+    // SQ ring
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned sq_local_tail;
+    struct io_uring_sqe* sqes;
+    // CQ ring
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_cqe* cqes;
+    // mmaps
+    void* sq_ring;
+    size_t sq_ring_size;
+    void* cq_ring;
+    size_t cq_ring_size;
+    size_t sqes_size;
+};
+
+struct fd_state {
+    struct ev_op* recv;     // Pending recv (waiting for EPOLLIN)
+    struct ev_op* send;     // Pending send (waiting for EPOLLOUT)
+    int readable;
+    int writable;
+};
+
+struct ev_loop {
+    enum ev_backend backend;
+    unsigned long syscalls;
+    int stopped;
+    unsigned inflight;          // Ops that will produce a callback
+    unsigned lazy_inflight;     // ... of which EV_LAZY
+    struct timer_wheel timers;
+
+    // io_uring
+    struct uring ring;
+
+    // epoll
+    int epfd;
+    struct fd_state* fds;
+    int fds_len;
+    struct ev_op* done_head;    // Completed, callback not run yet
+    struct ev_op* done_tail;
+    int link_failed;            // Previous op had EV_LINK and failed at submit
+    int in_submit;
+};
+
+uint64_t ev_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+unsigned long ev_syscalls(const struct ev_loop* loop)
+{
+    return loop->syscalls;
+}
+
+const char* ev_backend_name(const struct ev_loop* loop)
+{
+    return loop->backend == EV_BACKEND_IO_URING ? "io_uring" : "epoll";
+}
+
+void ev_stop(struct ev_loop* loop)
+{
+    loop->stopped = 1;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Timers                                                                    */
+/* ------------------------------------------------------------------------- */
+
+static void on_wheel_timer(struct timer_wheel* w, struct tw_timer* tw)
+{
+    struct ev_timer* timer = tw->arg;
+    timer->cb(timer->loop, timer);
+}
+
+void ev_timer_stop(struct ev_loop* loop, struct ev_timer* timer)
+{
+    tw_cancel(&loop->timers, &timer->tw);
+}
+
+void ev_timer_start(struct ev_loop* loop, struct ev_timer* timer, uint64_t delay_ms)
+{
+    timer->tw.cb = on_wheel_timer;
+    timer->tw.arg = timer;
+    timer->loop = loop;
+    tw_start(&loop->timers, &timer->tw, ev_now_ns() + delay_ms * 1000000ULL);
+}
+
+/**
+ * ns until the first timer (0 if due, -1 if no timer)
+ */
+static int64_t next_timeout_ns(struct ev_loop* loop)
+{
+    if (loop->timers.count == 0) return -1;
+    return tw_next_ns(&loop->timers, ev_now_ns());
+}
+
+static int run_timers(struct ev_loop* loop)
+{
+    if (loop->timers.count == 0) return 0;
+    return tw_advance(&loop->timers, ev_now_ns());
+}
+
+/* ------------------------------------------------------------------------- */
+/* io_uring backend                                                          */
+/* ------------------------------------------------------------------------- */
+
+static int uring_init(struct ev_loop* loop, unsigned entries)
+{
+    struct uring* r = &loop->ring;
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+
+    r->fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (r->fd < 0) return -errno;
+
+    // Wait timeouts need IORING_ENTER_EXT_ARG (5.11)
+    if (!(p.features & IORING_FEAT_EXT_ARG)) {
+        close(r->fd);
+        return -ENOSYS;
+    }
+    r->entries = p.sq_entries;
+    r->features = p.features;
+
+    r->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (r->cq_ring_size > r->sq_ring_size) r->sq_ring_size = r->cq_ring_size;
+        r->cq_ring_size = r->sq_ring_size;
+    }
+
+    r->sq_ring = mmap(NULL, r->sq_ring_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+    if (r->sq_ring == MAP_FAILED) goto fail;
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        r->cq_ring = r->sq_ring;
+    } else {
+        r->cq_ring = mmap(NULL, r->cq_ring_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+        if (r->cq_ring == MAP_FAILED) goto fail;
+    }
+
+    r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) goto fail;
+
+    char* sq = r->sq_ring;
+    r->sq_head = (unsigned*)(sq + p.sq_off.head);
+    r->sq_tail = (unsigned*)(sq + p.sq_off.tail);
+    r->sq_mask = (unsigned*)(sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned*)(sq + p.sq_off.array);
+    r->sq_local_tail = *r->sq_tail;
+
+    char* cq = r->cq_ring;
+    r->cq_head = (unsigned*)(cq + p.cq_off.head);
+    r->cq_tail = (unsigned*)(cq + p.cq_off.tail);
+    r->cq_mask = (unsigned*)(cq + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+    return 0;
+
+fail:
+    {
+        int err = errno;
+        if (r->sq_ring && r->sq_ring != MAP_FAILED) munmap(r->sq_ring, r->sq_ring_size);
+        if (r->cq_ring && r->cq_ring != MAP_FAILED && r->cq_ring != r->sq_ring)
+            munmap(r->cq_ring, r->cq_ring_size);
+        close(r->fd);
+        return -err;
+    }
+}
+
+static void uring_free(struct uring* r)
+{
+    munmap(r->sqes, r->sqes_size);
+    if (r->cq_ring != r->sq_ring) munmap(r->cq_ring, r->cq_ring_size);
+    munmap(r->sq_ring, r->sq_ring_size);
+    close(r->fd);
+}
+
+/**
+ * Submit queued SQEs and optionally wait for min_complete CQEs or timeout_ns
+ * (-1 = no timeout). One syscall.
+ */
+static int uring_enter(struct ev_loop* loop, unsigned min_complete, int64_t timeout_ns)
+{
+    struct uring* r = &loop->ring;
+    unsigned to_submit = r->sq_local_tail - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+    unsigned flags = 0;
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    void* argp = NULL;
+    size_t argsz = 0;
+
+    if (to_submit == 0 && min_complete == 0) return 0;
+
+    __atomic_store_n(r->sq_tail, r->sq_local_tail, __ATOMIC_RELEASE);
+
+    if (min_complete > 0) {
+        flags |= IORING_ENTER_GETEVENTS;
+        if (timeout_ns >= 0) {
+            ts.tv_sec = timeout_ns / 1000000000LL;
+            ts.tv_nsec = timeout_ns % 1000000000LL;
+            memset(&arg, 0, sizeof(arg));
+            arg.sigmask_sz = _NSIG / 8;
+            arg.ts = (uint64_t)(uintptr_t)&ts;
+            flags |= IORING_ENTER_EXT_ARG;
+            argp = &arg;
+            argsz = sizeof(arg);
+        }
+    }
+
+    loop->syscalls++;
+    int ret = (int)syscall(__NR_io_uring_enter, r->fd, to_submit, min_complete, flags, argp, argsz);
+    if (ret < 0 && errno != ETIME && errno != EINTR && errno != EBUSY) {
+        return -errno;
+    }
+    return 0;
+}
+
+static struct io_uring_sqe* uring_sqe(struct ev_loop* loop)
+{
+    struct uring* r = &loop->ring;
+
+    if (r->sq_local_tail - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE) >= r->entries) {
+        // SQ full: hand what is queued to the kernel first
+        if (uring_enter(loop, 0, -1) < 0) return NULL;
+        if (r->sq_local_tail - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE) >= r->entries)
+            return NULL;
+    }
+
+    unsigned idx = r->sq_local_tail & *r->sq_mask;
+    struct io_uring_sqe* sqe = &r->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    r->sq_array[idx] = idx;
+    r->sq_local_tail++;
+    return sqe;
+}
+
+static int uring_submit(struct ev_loop* loop, struct ev_op* op)
+{
+    struct io_uring_sqe* sqe = uring_sqe(loop);
+    if (!sqe) return -EBUSY;
+
+    switch (op->opcode) {
+    case OP_SEND:
+        sqe->opcode = IORING_OP_SEND;
+        sqe->msg_flags = MSG_NOSIGNAL;
+        break;
+    case OP_RECV:
+        sqe->opcode = IORING_OP_RECV;
+        sqe->msg_flags = (op->flags & EV_ALL) ? MSG_WAITALL : 0;
+        break;
+    case OP_PWRITE:
+        sqe->opcode = IORING_OP_WRITE;
+        sqe->off = (uint64_t)op->off;
+        break;
+    }
+    sqe->fd = op->fd;
+    sqe->addr = (uint64_t)(uintptr_t)op->buf;
+    sqe->len = (unsigned)op->len;
+    sqe->user_data = (uint64_t)(uintptr_t)op;
+
+    if (op->flags & EV_LINK) sqe->flags |= IOSQE_IO_LINK;
+    if ((op->flags & EV_QUIET) && (loop->ring.features & IORING_FEAT_CQE_SKIP))
+        sqe->flags |= IOSQE_CQE_SKIP_SUCCESS;
+    return 0;
+}
+
+static int uring_reap(struct ev_loop* loop)
+{
+    struct uring* r = &loop->ring;
+    unsigned head = *r->cq_head;
+    int ran = 0;
+
+    for (;;) {
+        unsigned tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+        if (head == tail) break;
+
+        struct io_uring_cqe* cqe = &r->cqes[head & *r->cq_mask];
+        struct ev_op* op = (struct ev_op*)(uintptr_t)cqe->user_data;
+        int res = cqe->res;
+        head++;
+        // Release the slot before the callback (it may submit and wait)
+        __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+
+        if (op->flags & EV_QUIET) {
+            // Kernels without IORING_FEAT_CQE_SKIP still post successes
+            if (res >= 0) continue;
+        } else {
+            loop->inflight--;
+            if (op->flags & EV_LAZY) loop->lazy_inflight--;
+        }
+        if (op->cb) op->cb(loop, op, res);
+        ran++;
+    }
+    return ran;
+}
+
+static int uring_wait(struct ev_loop* loop)
+{
+    int64_t timeout = next_timeout_ns(loop);
+    unsigned min_complete = loop->lazy_inflight;
+
+    // Lazy completions alone do not end the wait: also wait for one more
+    // completion or the next timer (whichever the loop is really waiting on)
+    if (loop->inflight > loop->lazy_inflight || timeout >= 0) min_complete++;
+
+    int err = uring_enter(loop, min_complete, timeout);
+    if (err < 0) return err;
+    return uring_reap(loop);
+}
+
+/* ------------------------------------------------------------------------- */
+/* epoll backend                                                             */
+/* ------------------------------------------------------------------------- */
+
+static struct fd_state* fd_state(struct ev_loop* loop, int fd)
+{
+    if (fd >= loop->fds_len) {
+        int len = loop->fds_len ? loop->fds_len : 64;
+        while (len <= fd) len *= 2;
+        struct fd_state* fds = realloc(loop->fds, len * sizeof(*fds));
+        if (!fds) return NULL;
+        memset(fds + loop->fds_len, 0, (len - loop->fds_len) * sizeof(*fds));
+        loop->fds = fds;
+        loop->fds_len = len;
+    }
+    return &loop->fds[fd];
+}
+
+static void complete(struct ev_loop* loop, struct ev_op* op, int res)
+{
+    if ((op->flags & EV_LINK) && res < 0 && loop->in_submit) loop->link_failed = 1;
+    if ((op->flags & EV_QUIET) && res >= 0) return;
+
+    // Run from ev_run_once, never from inside a submit call
+    op->done = res;
+    op->next = NULL;
+    if (loop->done_tail) loop->done_tail->next = op;
+    else loop->done_head = op;
+    loop->done_tail = op;
+}
+
+static int epoll_dispatch(struct ev_loop* loop)
+{
+    struct ev_op* op = loop->done_head;
+    int ran = 0;
+
+    loop->done_head = loop->done_tail = NULL;
+    while (op) {
+        struct ev_op* next = op->next;
+        if (!(op->flags & EV_QUIET)) {
+            loop->inflight--;
+            if (op->flags & EV_LAZY) loop->lazy_inflight--;
+        }
+        if (op->cb) op->cb(loop, op, (int)op->done);
+        ran++;
+        op = next;
+    }
+    return ran;
+}
+
+/**
+ * Send as much as the socket takes; 1 if the op finished, 0 if it waits for EPOLLOUT
+ */
+static int epoll_do_send(struct ev_loop* loop, struct fd_state* st, struct ev_op* op)
+{
+    while (op->done < op->len) {
+        loop->syscalls++;
+        ssize_t n = send(op->fd, (char*)op->buf + op->done, op->len - op->done, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN) {
+                st->writable = 0;
+                return 0;
+            }
+            complete(loop, op, -errno);
+            return 1;
+        }
+        op->done += n;
+    }
+    complete(loop, op, (int)op->len);
+    return 1;
+}
+
+/**
+ * Read what is available; 1 if the op finished, 0 if it waits for EPOLLIN
+ */
+static int epoll_do_recv(struct ev_loop* loop, struct fd_state* st, struct ev_op* op)
+{
+    for (;;) {
+        size_t want = op->len - op->done;
+        loop->syscalls++;
+        ssize_t n = recv(op->fd, (char*)op->buf + op->done, want, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN) {
+                st->readable = 0;
+                return 0;
+            }
+            complete(loop, op, op->done ? (int)op->done : -errno);
+            return 1;
+        }
+        if (n == 0) {
+            // EOF: like MSG_WAITALL, return what arrived
+            complete(loop, op, (int)op->done);
+            return 1;
+        }
+        op->done += n;
+        // A short read drained the socket (edge-triggered: wait for the next edge)
+        if ((size_t)n < want) st->readable = 0;
+        if (op->done == op->len || !(op->flags & EV_ALL)) {
+            complete(loop, op, (int)op->done);
+            return 1;
+        }
+        if (!st->readable) return 0;
+    }
+}
+
+static int epoll_submit(struct ev_loop* loop, struct ev_op* op)
+{
+    if (loop->link_failed) {
+        loop->link_failed = 0;
+        complete(loop, op, -ECANCELED);
+        return 0;
+    }
+
+    if (op->opcode == OP_PWRITE) {
+        // Regular files are always "ready": write now, complete on the next dispatch
+        while (op->done < op->len) {
+            loop->syscalls++;
+            ssize_t n = op->off == (off_t)-1
+                ? write(op->fd, (char*)op->buf + op->done, op->len - op->done)
+                : pwrite(op->fd, (char*)op->buf + op->done, op->len - op->done, op->off + op->done);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                complete(loop, op, -errno);
+                return 0;
+            }
+            op->done += n;
+        }
+        complete(loop, op, (int)op->len);
+        return 0;
+    }
+
+    struct fd_state* st = fd_state(loop, op->fd);
+    if (!st) return -ENOMEM;
+
+    if (op->opcode == OP_SEND) {
+        if (st->send) return -EBUSY;
+        if (!epoll_do_send(loop, st, op)) st->send = op;
+    } else {
+        if (st->recv) return -EBUSY;
+        if (!st->readable || !epoll_do_recv(loop, st, op)) st->recv = op;
+    }
+    return 0;
+}
+
+static int epoll_wait_events(struct ev_loop* loop)
+{
+    struct epoll_event events[MAX_EVENTS];
+    int timeout_ms = -1;
+
+    if (loop->done_head) {
+        timeout_ms = 0;
+    } else {
+        int64_t ns = next_timeout_ns(loop);
+        if (ns >= 0) timeout_ms = (int)((ns + 999999) / 1000000);
+    }
+
+    loop->syscalls++;
+    int n = epoll_wait(loop->epfd, events, MAX_EVENTS, timeout_ms);
+    if (n < 0) return errno == EINTR ? 0 : -errno;
+
+    for (int i = 0; i < n; i++) {
+        int fd = events[i].data.fd;
+        uint32_t ev = events[i].events;
+        struct fd_state* st = fd_state(loop, fd);
+        if (!st) continue;
+
+        if (ev & (EPOLLOUT | EPOLLERR | EPOLLHUP)) {
+            st->writable = 1;
+            if (st->send && epoll_do_send(loop, st, st->send)) st->send = NULL;
+        }
+        if (ev & (EPOLLIN | EPOLLERR | EPOLLHUP | EPOLLRDHUP)) {
+            st->readable = 1;
+            if (st->recv && epoll_do_recv(loop, st, st->recv)) st->recv = NULL;
+        }
+    }
+    return epoll_dispatch(loop);
+}
+
+/* ------------------------------------------------------------------------- */
+/* API                                                                       */
+/* ------------------------------------------------------------------------- */
+
+struct ev_loop* ev_loop_create(enum ev_backend backend, unsigned entries)
+{
+    struct ev_loop* loop = calloc(1, sizeof(*loop));
+    if (!loop) return NULL;
+    loop->epfd = -1;
+    tw_init(&loop->timers, 1000000, ev_now_ns());
+
+    if (backend != EV_BACKEND_EPOLL) {
+        int err = uring_init(loop, entries ? entries : 256);
+        if (err == 0) {
+            loop->backend = EV_BACKEND_IO_URING;
+            return loop;
+        }
+        if (backend == EV_BACKEND_IO_URING) {
+            fprintf(stderr, "io_uring not available: %s\n", strerror(-err));
+            free(loop);
+            return NULL;
+        }
+        // AUTO: seccomp / old kernel / io_uring disabled -> epoll
+        memset(&loop->ring, 0, sizeof(loop->ring));
+    }
+
+    loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epfd < 0) {
+        free(loop);
+        return NULL;
+    }
+    loop->backend = EV_BACKEND_EPOLL;
+    return loop;
+}
+
+void ev_loop_destroy(struct ev_loop* loop)
+{
+    if (!loop) return;
+    if (loop->backend == EV_BACKEND_IO_URING) uring_free(&loop->ring);
+    if (loop->epfd >= 0) close(loop->epfd);
+    free(loop->fds);
+    free(loop);
+}
+
+int ev_add_fd(struct ev_loop* loop, int fd)
+{
+    if (loop->backend != EV_BACKEND_EPOLL) return 0;
+
+    struct fd_state* st = fd_state(loop, fd);
+    if (!st) return -ENOMEM;
+    memset(st, 0, sizeof(*st));
+    st->writable = 1;
+
+    // Registered once, edge-triggered for both directions: no epoll_ctl per op
+    struct epoll_event ev = { .events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, .data.fd = fd };
+    loop->syscalls++;
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) return -errno;
+    return 0;
+}
+
+void ev_remove_fd(struct ev_loop* loop, int fd)
+{
+    if (loop->backend != EV_BACKEND_EPOLL) return;
+
+    // Pending ops on fd are dropped (io_uring: shutdown() the socket to end them)
+    if (fd < loop->fds_len) {
+        struct fd_state* st = &loop->fds[fd];
+        if (st->recv && !(st->recv->flags & EV_QUIET)) loop->inflight--;
+        if (st->send && !(st->send->flags & EV_QUIET)) loop->inflight--;
+        memset(st, 0, sizeof(*st));
+    }
+    loop->syscalls++;
+    epoll_ctl(loop->epfd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+static int submit(struct ev_loop* loop, struct ev_op* op, int opcode, int fd, void* buf,
+                  size_t len, off_t off, unsigned flags)
+{
+    op->opcode = opcode;
+    op->fd = fd;
+    op->buf = buf;
+    op->len = len;
+    op->off = off;
+    op->done = 0;
+    op->flags = flags;
+    op->next = NULL;
+
+    if (!(flags & EV_QUIET)) {
+        loop->inflight++;
+        if (flags & EV_LAZY) loop->lazy_inflight++;
+    }
+
+    int err;
+    if (loop->backend == EV_BACKEND_IO_URING) {
+        err = uring_submit(loop, op);
+    } else {
+        loop->in_submit = 1;
+        err = epoll_submit(loop, op);
+        loop->in_submit = 0;
+    }
+    if (err < 0 && !(flags & EV_QUIET)) {
+        loop->inflight--;
+        if (flags & EV_LAZY) loop->lazy_inflight--;
+    }
+    return err;
+}
+
+int ev_send(struct ev_loop* loop, struct ev_op* op, int fd, const void* buf, size_t len, unsigned flags)
+{
+    return submit(loop, op, OP_SEND, fd, (void*)buf, len, 0, flags);
+}
+
+int ev_recv(struct ev_loop* loop, struct ev_op* op, int fd, void* buf, size_t len, unsigned flags)
+{
+    return submit(loop, op, OP_RECV, fd, buf, len, 0, flags);
+}
+
+int ev_pwrite(struct ev_loop* loop, struct ev_op* op, int fd, const void* buf, size_t len,
+              off_t off, unsigned flags)
+{
+    return submit(loop, op, OP_PWRITE, fd, (void*)buf, len, off, flags);
+}
+
+int ev_run_once(struct ev_loop* loop)
+{
+    int ran;
+
+    if (loop->backend == EV_BACKEND_IO_URING) {
+        // Completions already in the CQ ring need no syscall
+        ran = uring_reap(loop);
+        ran += run_timers(loop);
+        if (ran > 0) return ran;
+        ran = uring_wait(loop);
+    } else {
+        ran = epoll_dispatch(loop);
+        ran += run_timers(loop);
+        if (ran > 0) return ran;
+        ran = epoll_wait_events(loop);
+    }
+    if (ran < 0) return ran;
+    return ran + run_timers(loop);
+}
+
+void ev_run(struct ev_loop* loop)
+{
+    loop->stopped = 0;
+    while (!loop->stopped) {
+        if (loop->inflight == 0 && loop->timers.count == 0 && !loop->done_head) {
+            break;  // Nothing left that could complete
+        }
+        if (ev_run_once(loop) < 0) break;
+    }
+}
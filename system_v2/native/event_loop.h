@@ -0,0 +1,114 @@
+// Completion-based event loop with io_uring and epoll backends
+//
+// Used by the native gateway (modbus_mms_gateway.c). Callers submit
+// operations (socket send/recv, file write) with caller-owned struct ev_op
+// storage and get a callback with the result (bytes or -errno) when the
+// operation has completed, on either backend.
+//
+//   io_uring  raw io_uring_setup/io_uring_enter (no liburing). Submissions
+//             queue up in the SQ ring and go to the kernel together with the
+//             next wait, so one io_uring_enter per wake-up both submits and
+//             waits. Timers are the wait's timeout (IORING_ENTER_EXT_ARG),
+//             not separate operations. Needs Linux 5.11 or later.
+//   epoll     readiness emulation: sends and file writes are done right away,
+//             recvs when epoll reports the socket readable.
+//
+// Flags:
+//   EV_LINK   next submitted op only starts after this one succeeded
+//             (io_uring IOSQE_IO_LINK; epoll cancels it if this one failed)
+//   EV_QUIET  no callback on success (io_uring IOSQE_CQE_SKIP_SUCCESS)
+//   EV_LAZY   completion is not worth a wake-up: the loop keeps waiting for
+//             another completion or a timer and picks it up then (file writes)
+//   EV_ALL    recv: complete only when len bytes arrived (MSG_WAITALL)
+//
+// Timers live in a timing wheel with 1 ms ticks (timer_wheel.c), so a loop
+// can carry one timeout per connection without start/stop getting slower.
+//
+// Not thread-safe: one loop per thread.
+
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "timer_wheel.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum ev_backend {
+    EV_BACKEND_AUTO,
+    EV_BACKEND_IO_URING,
+    EV_BACKEND_EPOLL,
+};
+
+#define EV_LINK  0x01
+#define EV_QUIET 0x02
+#define EV_LAZY  0x04
+#define EV_ALL   0x08
+
+struct ev_loop;
+struct ev_op;
+struct ev_timer;
+
+typedef void (*ev_op_cb)(struct ev_loop* loop, struct ev_op* op, int res);
+typedef void (*ev_timer_cb)(struct ev_loop* loop, struct ev_timer* timer);
+
+struct ev_op {
+    ev_op_cb cb;
+    void* arg;
+    // Internal
+    int opcode;
+    int fd;
+    void* buf;
+    size_t len;
+    size_t done;
+    off_t off;
+    unsigned flags;
+    struct ev_op* next;
+};
+
+struct ev_timer {
+    ev_timer_cb cb;
+    void* arg;
+    // Internal
+    struct tw_timer tw;
+    struct ev_loop* loop;
+};
+
+struct ev_loop* ev_loop_create(enum ev_backend backend, unsigned entries);
+void ev_loop_destroy(struct ev_loop* loop);
+const char* ev_backend_name(const struct ev_loop* loop);
+
+// Submit an operation (completion through op->cb). Returns 0 or -errno.
+int ev_send(struct ev_loop* loop, struct ev_op* op, int fd, const void* buf, size_t len, unsigned flags);
+int ev_recv(struct ev_loop* loop, struct ev_op* op, int fd, void* buf, size_t len, unsigned flags);
+int ev_pwrite(struct ev_loop* loop, struct ev_op* op, int fd, const void* buf, size_t len,
+              off_t off, unsigned flags);
+
+// Socket lifetime: call after connect/accept and before close (epoll registration)
+int ev_add_fd(struct ev_loop* loop, int fd);
+void ev_remove_fd(struct ev_loop* loop, int fd);
+
+// One-shot timer (re-arm from the callback for periodic timers)
+void ev_timer_start(struct ev_loop* loop, struct ev_timer* timer, uint64_t delay_ms);
+void ev_timer_stop(struct ev_loop* loop, struct ev_timer* timer);
+
+// Submit, wait for completions or the next timer, run callbacks
+int ev_run_once(struct ev_loop* loop);
+void ev_run(struct ev_loop* loop);
+void ev_stop(struct ev_loop* loop);
+
+uint64_t ev_now_ns(void);
+
+// Syscalls issued by the loop (io_uring_enter, epoll_wait/ctl, send, recv, pwrite)
+unsigned long ev_syscalls(const struct ev_loop* loop);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EVENT_LOOP_H
@@ -0,0 +1,280 @@
+// MMS over TLS (IEC 62351-3) vs plain MMS benchmark (libiec61850)
+//
+// Not yet built against libiec61850 or run: no results exist (README.md)
+//
+// Starts two local libiec61850 servers as a relay stand-in (plain MMS and MMS
+// over TLS) and measures, with the same client code as rpi2/shabnam_mms.c:
+//   - association setup (TCP + [TLS handshake] + COTP/MMS initiate)
+//       plain        no TLS
+//       tls-full     full handshake on every connect (resumption disabled)
+//       tls-resumed  TLS configuration kept across connects (session resumed)
+//   - per-write round trip on the established association (6 writes per frame,
+//     like one bridge cycle)
+//
+// The stand-in models the bridge's data objects as ASG settings (FC=SP):
+// libiec61850 servers refuse client writes to FC=MX, and the MMS exchange per
+// write is the same.
+//
+// Build (libiec61850 built with mbedTLS, see README.md):
+//   gcc -O2 -Wall -o mms_tls_bench mms_tls_bench.c -liec61850 -lpthread -lm
+//
+// Run (certificates from README.md):
+//   ./mms_tls_bench -d certs -n 50 -w 20
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <libiec61850/iec61850_server.h>
+#include <libiec61850/iec61850_client.h>
+#include <libiec61850/iec61850_dynamic_model.h>
+#include <libiec61850/iec61850_cdc.h>
+
+#define IED_NAME    "RELAY"
+#define LD_NAME     "LD0"
+#define PLAIN_PORT  10102
+#define TLS_PORT    13782
+#define MAX_SAMPLES 100000
+
+// Bridge data objects (shabnam_mms.c REF_*) as ASG settings
+static const struct { const char* ln; const char* dobj; } bench_objects[] = {
+    { "MMXU1", "TotW" }, { "MMXU1", "TotWDC" }, { "MMXU1", "VolDC" },
+    { "MMXU1", "AmpDC" }, { "MET1", "Irradiance" }, { "MET1", "CellTemp" },
+};
+#define WRITES_PER_FRAME (int)(sizeof(bench_objects) / sizeof(bench_objects[0]))
+
+static const char* cert_dir = "certs";
+
+/* ------------------------------------------------------------------------- */
+/* Helpers                                                                   */
+/* ------------------------------------------------------------------------- */
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static const char* cert_path(const char* name)
+{
+    static char paths[4][512];
+    static int next = 0;
+    char* p = paths[next++ % 4];
+    snprintf(p, sizeof(paths[0]), "%s/%s", cert_dir, name);
+    return p;
+}
+
+static int cmp_double(const void* a, const void* b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+struct samples {
+    double v[MAX_SAMPLES];
+    int n;
+};
+
+static void add_sample(struct samples* s, double v)
+{
+    if (s->n < MAX_SAMPLES) s->v[s->n++] = v;
+}
+
+static void print_row(const char* mode, const char* what, struct samples* s)
+{
+    if (s->n == 0) {
+        printf("%-12s %-8s %8s\n", mode, what, "-");
+        return;
+    }
+    double sum = 0;
+    for (int i = 0; i < s->n; i++) sum += s->v[i];
+    qsort(s->v, s->n, sizeof(double), cmp_double);
+    printf("%-12s %-8s %8d %10.3f %10.3f %10.3f %10.3f\n", mode, what, s->n,
+           s->v[0], s->v[s->n / 2], sum / s->n, s->v[(int)(s->n * 0.99)]);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Relay stand-in                                                            */
+/* ------------------------------------------------------------------------- */
+
+static IedModel* build_model(void)
+{
+    IedModel* model = IedModel_create(IED_NAME);
+    LogicalDevice* ld = LogicalDevice_create(LD_NAME, model);
+    LogicalNode* lln0 = LogicalNode_create("LLN0", ld);
+    CDC_ENS_create("Mod", (ModelNode*)lln0, 0);
+
+    LogicalNode* mmxu = LogicalNode_create("MMXU1", ld);
+    LogicalNode* met = LogicalNode_create("MET1", ld);
+    for (int i = 0; i < WRITES_PER_FRAME; i++) {
+        LogicalNode* ln = strcmp(bench_objects[i].ln, "MMXU1") == 0 ? mmxu : met;
+        CDC_ASG_create(bench_objects[i].dobj, (ModelNode*)ln, 0, false);
+    }
+    return model;
+}
+
+static TLSConfiguration server_tls_config(void)
+{
+    TLSConfiguration tls = TLSConfiguration_create();
+    TLSConfiguration_setChainValidation(tls, true);
+    TLSConfiguration_setAllowOnlyKnownCertificates(tls, false);
+    if (!TLSConfiguration_addCACertificateFromFile(tls, cert_path("relay_ca.pem")) ||
+        !TLSConfiguration_setOwnCertificateFromFile(tls, cert_path("relay.pem")) ||
+        !TLSConfiguration_setOwnKeyFromFile(tls, cert_path("relay.key"), NULL)) {
+        fprintf(stderr, "server TLS: cannot load certificates from %s/\n", cert_dir);
+        TLSConfiguration_destroy(tls);
+        return NULL;
+    }
+    TLSConfiguration_enableSessionResumption(tls, true);
+    TLSConfiguration_setSessionResumptionInterval(tls, 3600);
+    return tls;
+}
+
+static IedServer start_server(IedModel* model, TLSConfiguration tls, int port)
+{
+    IedServer server = tls ? IedServer_createWithTlsSupport(model, tls) : IedServer_create(model);
+    IedServer_setWriteAccessPolicy(server, IEC61850_FC_SP, ACCESS_POLICY_ALLOW);
+    IedServer_start(server, port);
+    if (!IedServer_isRunning(server)) {
+        fprintf(stderr, "cannot start stand-in server on port %d\n", port);
+        IedServer_destroy(server);
+        return NULL;
+    }
+    return server;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Client runs                                                               */
+/* ------------------------------------------------------------------------- */
+
+static TLSConfiguration client_tls_config(bool resumption)
+{
+    TLSConfiguration tls = TLSConfiguration_create();
+    TLSConfiguration_setChainValidation(tls, true);
+    TLSConfiguration_setAllowOnlyKnownCertificates(tls, false);
+    if (!TLSConfiguration_addCACertificateFromFile(tls, cert_path("relay_ca.pem")) ||
+        !TLSConfiguration_setOwnCertificateFromFile(tls, cert_path("rpi2.pem")) ||
+        !TLSConfiguration_setOwnKeyFromFile(tls, cert_path("rpi2.key"), NULL)) {
+        fprintf(stderr, "client TLS: cannot load certificates from %s/\n", cert_dir);
+        TLSConfiguration_destroy(tls);
+        return NULL;
+    }
+    TLSConfiguration_enableSessionResumption(tls, resumption);
+    if (resumption) TLSConfiguration_setSessionResumptionInterval(tls, 3600);
+    return tls;
+}
+
+/**
+ * Associate, write `frames` bridge cycles and release, `connects` times
+ *
+ * The first connect of a TLS run is always a full handshake and is reported
+ * on its own ("first"), so "connect" shows the steady-state reconnect cost.
+ */
+static int run_mode(const char* mode, TLSConfiguration tls, int port, int connects, int frames)
+{
+    static struct samples first, assoc, writes;
+    char ref[128];
+    int failures = 0;
+
+    first.n = assoc.n = writes.n = 0;
+
+    for (int c = 0; c < connects; c++) {
+        IedClientError err;
+        IedConnection con = tls ? IedConnection_createWithTlsSupport(tls) : IedConnection_create();
+
+        double t0 = now_ms();
+        IedConnection_connect(con, &err, "127.0.0.1", port);
+        double t1 = now_ms();
+        if (err != IED_ERROR_OK) {
+            fprintf(stderr, "%s: connect failed err=%d\n", mode, err);
+            IedConnection_destroy(con);
+            return -1;
+        }
+        add_sample(c == 0 && tls ? &first : &assoc, t1 - t0);
+
+        for (int f = 0; f < frames; f++) {
+            for (int i = 0; i < WRITES_PER_FRAME; i++) {
+                snprintf(ref, sizeof(ref), "%s%s/%s.%s.setMag.f", IED_NAME, LD_NAME,
+                         bench_objects[i].ln, bench_objects[i].dobj);
+                double w0 = now_ms();
+                IedConnection_writeFloatValue(con, &err, ref, IEC61850_FC_SP, (float)(f + i));
+                double w1 = now_ms();
+                if (err != IED_ERROR_OK) failures++;
+                else add_sample(&writes, w1 - w0);
+            }
+        }
+
+        IedConnection_close(con);
+        IedConnection_destroy(con);
+    }
+
+    if (tls) print_row(mode, "first", &first);
+    print_row(mode, "connect", &assoc);
+    print_row(mode, "write", &writes);
+    if (failures) printf("%-12s %d writes failed\n", mode, failures);
+    return 0;
+}
+
+static void usage(const char* prog)
+{
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  -d DIR     certificate directory (default certs)\n"
+        "  -n COUNT   connects per mode (default 50)\n"
+        "  -w FRAMES  frames (6 writes each) per connect (default 20)\n",
+        prog);
+}
+
+int main(int argc, char** argv)
+{
+    int connects = 50, frames = 20, opt;
+    while ((opt = getopt(argc, argv, "d:n:w:h")) != -1) {
+        switch (opt) {
+        case 'd': cert_dir = optarg; break;
+        case 'n': connects = atoi(optarg); break;
+        case 'w': frames = atoi(optarg); break;
+        default: usage(argv[0]); return 1;
+        }
+    }
+    if (connects < 1 || frames < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    IedModel* plain_model = build_model();
+    IedModel* tls_model = build_model();
+    TLSConfiguration server_tls = server_tls_config();
+    if (!server_tls) return 1;
+
+    IedServer plain_server = start_server(plain_model, NULL, PLAIN_PORT);
+    IedServer tls_server = start_server(tls_model, server_tls, TLS_PORT);
+    if (!plain_server || !tls_server) return 1;
+
+    TLSConfiguration full = client_tls_config(false);
+    TLSConfiguration resumed = client_tls_config(true);
+    if (!full || !resumed) return 1;
+
+    printf("MMS benchmark: %d connects per mode, %d writes per connect (times in ms)\n\n",
+           connects, frames * WRITES_PER_FRAME);
+    printf("%-12s %-8s %8s %10s %10s %10s %10s\n", "mode", "op", "count", "min", "median", "mean", "p99");
+
+    int rc = 0;
+    rc |= run_mode("plain", NULL, PLAIN_PORT, connects, frames);
+    rc |= run_mode("tls-full", full, TLS_PORT, connects, frames);
+    rc |= run_mode("tls-resumed", resumed, TLS_PORT, connects, frames);
+
+    TLSConfiguration_destroy(full);
+    TLSConfiguration_destroy(resumed);
+    IedServer_stop(plain_server);
+    IedServer_stop(tls_server);
+    IedServer_destroy(plain_server);
+    IedServer_destroy(tls_server);
+    IedModel_destroy(plain_model);
+    IedModel_destroy(tls_model);
+    TLSConfiguration_destroy(server_tls);
+    return rc ? 1 : 0;
+}
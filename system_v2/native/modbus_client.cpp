@@ -0,0 +1,438 @@
+// Coroutine Modbus TCP / Modbus/TLS client (see modbus_client.h)
+//
+// Compiled into the tools that use it, e.g.:
+//   gcc -O2 -Wall -c event_loop.c timer_wheel.c
+//   g++ -std=c++20 -O2 -Wall -o modbus_client_bench modbus_client_bench.cpp modbus_client.cpp reactor.cpp event_loop.o timer_wheel.o -lssl -lcrypto
+
+#include "modbus_client.h"
+
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <openssl/err.h>
+
+namespace modbus {
+
+namespace {
+
+constexpr size_t kMbapSize = 7;
+constexpr size_t kMaxAdu = 260;
+
+}  // namespace
+
+const char* status_name(Status status) {
+    switch (status) {
+    case Status::Ok: return "ok";
+    case Status::Exception: return "exception";
+    case Status::Timeout: return "timeout";
+    case Status::Closed: return "closed";
+    case Status::Busy: return "busy";
+    case Status::Protocol: return "protocol error";
+    }
+    return "?";
+}
+
+Client::Client(Reactor& reactor) : _reactor(reactor) {}
+
+Client::~Client() {
+    close();
+    // Operations still in flight point into this object: let them complete
+    while (!idle() && _reactor.run_once() >= 0) {
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/* Connection                                                                */
+/* ------------------------------------------------------------------------- */
+
+Task<bool> Client::connect(const char* host, uint16_t port, SSL_CTX* tls, const char* server_name) {
+    if (_fd >= 0) co_return false;
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) co_return false;
+
+    // Blocking connect like the other native tools; all I/O after it goes through the reactor
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) co_return false;
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        ::close(fd);
+        co_return false;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    ev_add_fd(_reactor.loop(), fd);
+
+    _fd = fd;
+    _closing = false;
+    _wlen = _rlen = 0;
+
+    if (tls) {
+        _ssl = SSL_new(tls);
+        _rbio = BIO_new(BIO_s_mem());
+        _wbio = BIO_new(BIO_s_mem());
+        SSL_set_bio(_ssl, _rbio, _wbio);
+        SSL_set_connect_state(_ssl);
+        if (server_name) {
+            SSL_set_tlsext_host_name(_ssl, server_name);
+            SSL_set1_host(_ssl, server_name);
+        }
+        if (!co_await handshake()) {
+            close();        // The OpenSSL error queue tells why
+            co_return false;
+        }
+    }
+
+    submit_recv();
+    co_return true;
+}
+
+Task<bool> Client::send_all(const uint8_t* data, size_t len) {
+    size_t off = 0;
+    while (off < len) {
+        int n = co_await _reactor.send(_fd, data + off, len - off);
+        if (n <= 0) co_return false;
+        off += n;
+    }
+    co_return true;
+}
+
+/**
+ * TLS handshake over the memory BIOs: every flight goes out through the
+ * reactor, and the coroutine waits for the server's answer
+ */
+Task<bool> Client::handshake() {
+    for (;;) {
+        int r = SSL_do_handshake(_ssl);
+
+        int n;
+        while ((n = BIO_read(_wbio, _cbuf, sizeof(_cbuf))) > 0) {
+            if (!co_await send_all(_cbuf, n)) co_return false;
+        }
+        if (r == 1) co_return true;
+        if (SSL_get_error(_ssl, r) != SSL_ERROR_WANT_READ) co_return false;
+
+        int got = co_await _reactor.recv(_fd, _ibuf, sizeof(_ibuf));
+        if (got <= 0) co_return false;
+        BIO_write(_rbio, _ibuf, got);
+    }
+}
+
+void Client::close() {
+    if (_fd < 0 || _closing) return;
+    _closing = true;
+
+    // Completes the pending recv (and send): the socket is released after them
+    shutdown(_fd, SHUT_RDWR);
+
+    std::coroutine_handle<> ready[kMaxInFlight];
+    size_t n = 0;
+    for (Call* call : _calls) {
+        if (!call) continue;
+        std::coroutine_handle<> h = finish(*call, Status::Closed);
+        if (h) ready[n++] = h;
+    }
+    release_socket();
+
+    for (size_t i = 0; i < n; i++) ready[i].resume();
+}
+
+void Client::release_socket() {
+    if (!_closing || _sending || _receiving || _fd < 0) return;
+
+    ev_remove_fd(_reactor.loop(), _fd);
+    ::close(_fd);
+    _fd = -1;
+    _closing = false;
+    if (_ssl) {
+        SSL_free(_ssl);     // Frees both BIOs
+        _ssl = nullptr;
+        _rbio = _wbio = nullptr;
+    }
+    _wlen = _rlen = 0;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Calls                                                                     */
+/* ------------------------------------------------------------------------- */
+
+Task<Result> Client::read_holding(uint8_t unit, uint16_t address, std::span<uint16_t> out,
+                                  uint32_t timeout_ms) {
+    if (out.empty() || out.size() > 125) co_return Result{Status::Protocol};
+
+    Call call{};
+    call.fc = 0x03;
+    call.address = address;
+    call.out = out;
+    call.count = static_cast<uint16_t>(out.size());
+
+    const uint8_t pdu[5] = {
+        0x03,
+        static_cast<uint8_t>(address >> 8), static_cast<uint8_t>(address),
+        static_cast<uint8_t>(call.count >> 8), static_cast<uint8_t>(call.count),
+    };
+    if (start(call, unit, pdu, sizeof(pdu), timeout_ms)) co_await call;
+    co_return call.result;
+}
+
+Task<Result> Client::write_multiple(uint8_t unit, uint16_t address, std::span<const uint16_t> values,
+                                    uint32_t timeout_ms) {
+    if (values.empty() || values.size() > 123) co_return Result{Status::Protocol};
+
+    Call call{};
+    call.fc = 0x10;
+    call.address = address;
+    call.count = static_cast<uint16_t>(values.size());
+
+    uint8_t pdu[6 + 2 * 123];
+    pdu[0] = 0x10;
+    pdu[1] = address >> 8;
+    pdu[2] = address & 0xFF;
+    pdu[3] = call.count >> 8;
+    pdu[4] = call.count & 0xFF;
+    pdu[5] = 2 * call.count;
+    for (size_t i = 0; i < values.size(); i++) {
+        pdu[6 + 2 * i] = values[i] >> 8;
+        pdu[7 + 2 * i] = values[i] & 0xFF;
+    }
+    if (start(call, unit, pdu, 6 + 2 * values.size(), timeout_ms)) co_await call;
+    co_return call.result;
+}
+
+/**
+ * Queue the request and register the call under a free transaction id
+ * Returns false (with call.result set) if it was not sent
+ */
+bool Client::start(Call& call, uint8_t unit, const uint8_t* pdu, size_t pdu_len, uint32_t timeout_ms) {
+    call.client = this;
+    if (!connected()) {
+        call.result.status = Status::Closed;
+        return false;
+    }
+    size_t len = kMbapSize + pdu_len;
+    if (_in_flight == kMaxInFlight || _wlen + len > kBufSize) {
+        call.result.status = Status::Busy;
+        return false;
+    }
+
+    // A slot can still be held by a slow call from an earlier lap of the ids
+    uint16_t tid = _next_tid;
+    while (_calls[tid % kMaxInFlight]) tid++;
+    _next_tid = tid + 1;
+
+    uint8_t* adu = _wbuf[_wfill] + _wlen;
+    adu[0] = tid >> 8;
+    adu[1] = tid & 0xFF;
+    adu[2] = 0;
+    adu[3] = 0;
+    adu[4] = (len - 6) >> 8;
+    adu[5] = (len - 6) & 0xFF;
+    adu[6] = unit;
+    std::memcpy(adu + kMbapSize, pdu, pdu_len);
+    _wlen += len;
+
+    call.tid = tid;
+    _calls[tid % kMaxInFlight] = &call;
+    _in_flight++;
+    _stats.requests++;
+
+    if (timeout_ms) {
+        call.timer.cb = on_deadline;
+        call.timer.arg = &call;
+        ev_timer_start(_reactor.loop(), &call.timer, timeout_ms);
+    }
+    flush();
+    return true;
+}
+
+/**
+ * Complete a call; returns its coroutine for the caller to resume (may be
+ * null if the call had not suspended yet)
+ */
+std::coroutine_handle<> Client::finish(Call& call, Status status, uint8_t code) {
+    ev_timer_stop(_reactor.loop(), &call.timer);
+    _calls[call.tid % kMaxInFlight] = nullptr;
+    _in_flight--;
+    call.result.status = status;
+    call.result.exception_code = code;
+    call.done = true;
+    return std::exchange(call.waiter, nullptr);
+}
+
+void Client::on_deadline(ev_loop*, ev_timer* timer) {
+    Call* call = static_cast<Call*>(timer->arg);
+    Client* self = call->client;
+    self->_stats.timeouts++;
+    std::coroutine_handle<> h = self->finish(*call, Status::Timeout);
+    if (h) h.resume();
+}
+
+/* ------------------------------------------------------------------------- */
+/* Socket I/O                                                                */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * Put the requests queued so far on the wire (one send, one TLS record
+ * batch); requests queued while it is in flight go out with the next one
+ */
+void Client::flush() {
+    if (_sending || _wlen == 0 || _fd < 0 || _closing) return;
+
+    if (_ssl) {
+        SSL_write(_ssl, _wbuf[_wfill], static_cast<int>(_wlen));
+        int n = BIO_read(_wbio, _cbuf, sizeof(_cbuf));
+        _send_buf = _cbuf;
+        _send_len = n > 0 ? n : 0;
+    } else {
+        _send_buf = _wbuf[_wfill];
+        _send_len = _wlen;
+        _wfill ^= 1;
+    }
+    _wlen = 0;
+    _send_off = 0;
+    _sending = true;
+    _stats.sends++;
+    submit_send();
+}
+
+void Client::submit_send() {
+    _send_op.cb = on_sent;
+    _send_op.arg = this;
+    if (ev_send(_reactor.loop(), &_send_op, _fd, _send_buf + _send_off, _send_len - _send_off, 0) < 0) {
+        _sending = false;
+        close();
+    }
+}
+
+void Client::on_sent(ev_loop*, ev_op* op, int res) {
+    Client* self = static_cast<Client*>(op->arg);
+    if (res <= 0 || self->_closing) {
+        self->_sending = false;
+        self->close();
+        self->release_socket();
+        return;
+    }
+    self->_send_off += res;
+    if (self->_send_off < self->_send_len) {
+        self->submit_send();    // Short send
+        return;
+    }
+    self->_sending = false;
+    self->flush();
+}
+
+void Client::submit_recv() {
+    _recv_op.cb = on_received;
+    _recv_op.arg = this;
+    _receiving = true;
+    int err = _ssl ? ev_recv(_reactor.loop(), &_recv_op, _fd, _ibuf, sizeof(_ibuf), 0)
+                   : ev_recv(_reactor.loop(), &_recv_op, _fd, _rbuf + _rlen, kBufSize - _rlen, 0);
+    if (err < 0) {
+        _receiving = false;
+        close();
+    }
+}
+
+void Client::on_received(ev_loop*, ev_op* op, int res) {
+    Client* self = static_cast<Client*>(op->arg);
+    self->_receiving = false;
+    if (res <= 0 || self->_closing) {
+        self->close();
+        self->release_socket();
+        return;
+    }
+
+    if (self->_ssl) {
+        BIO_write(self->_rbio, self->_ibuf, res);
+        for (;;) {
+            int n = SSL_read(self->_ssl, self->_rbuf + self->_rlen, kBufSize - self->_rlen);
+            if (n > 0) {
+                self->_rlen += n;
+                continue;
+            }
+            if (SSL_get_error(self->_ssl, n) != SSL_ERROR_WANT_READ) {
+                ERR_clear_error();
+                self->close();
+                return;
+            }
+            break;
+        }
+    } else {
+        self->_rlen += res;
+    }
+
+    std::coroutine_handle<> ready[kMaxInFlight];
+    size_t n = self->parse(ready);
+    if (n == SIZE_MAX) {
+        self->close();
+        return;
+    }
+    self->submit_recv();
+
+    // Last: a resumed call may issue more calls, close or destroy the client
+    for (size_t i = 0; i < n; i++) ready[i].resume();
+}
+
+/**
+ * Match complete responses to their calls
+ * Returns the number of calls to resume (SIZE_MAX = not Modbus/TCP)
+ */
+size_t Client::parse(std::coroutine_handle<>* ready) {
+    size_t off = 0;
+    size_t n = 0;
+
+    while (_rlen - off >= kMbapSize + 1) {
+        const uint8_t* adu = _rbuf + off;
+        size_t len = 6 + ((adu[4] << 8) | adu[5]);
+        if (len < kMbapSize + 2 || len > kMaxAdu || adu[2] || adu[3]) return SIZE_MAX;
+        if (_rlen - off < len) break;
+        off += len;
+
+        uint16_t tid = (adu[0] << 8) | adu[1];
+        Call* call = _calls[tid % kMaxInFlight];
+        if (!call || call->tid != tid) {
+            _stats.late++;
+            continue;
+        }
+        _stats.responses++;
+
+        Status status = Status::Ok;
+        uint8_t code = 0;
+        uint8_t fc = adu[7];
+        if (fc == (call->fc | 0x80)) {
+            status = Status::Exception;
+            code = adu[8];
+            _stats.exceptions++;
+        } else if (fc != call->fc) {
+            status = Status::Protocol;
+        } else if (fc == 0x03) {
+            if (adu[8] != 2 * call->count || len != 9u + 2 * call->count) {
+                status = Status::Protocol;
+            } else {
+                for (uint16_t i = 0; i < call->count; i++) {
+                    call->out[i] = (adu[9 + 2 * i] << 8) | adu[10 + 2 * i];
+                }
+            }
+        } else if (len != 12 || ((adu[8] << 8) | adu[9]) != call->address
+                   || ((adu[10] << 8) | adu[11]) != call->count) {
+            status = Status::Protocol;  // FC16 echo
+        }
+
+        std::coroutine_handle<> h = finish(*call, status, code);
+        if (h) ready[n++] = h;
+    }
+
+    std::memmove(_rbuf, _rbuf + off, _rlen - off);
+    _rlen -= off;
+    return n;
+}
+
+}  // namespace modbus
@@ -0,0 +1,168 @@
+// Coroutine Modbus TCP / Modbus/TLS client (C++20, see reactor.h)
+//
+// Calls are coroutines that complete when the response arrives:
+//
+//   Task<void> poll(Client& c) {
+//       uint16_t regs[6];
+//       Result r = co_await c.read_holding(1, 0, regs, 500);    // 500 ms deadline
+//       if (!r.ok()) printf("%s\n", status_name(r.status));
+//   }
+//
+// Any number of coroutines may call into one client at the same time: their
+// requests are pipelined on the connection (up to kMaxInFlight, matched by
+// transaction id) and coalesced into one send (one TLS record) per flush.
+// Each call can have its own deadline, a timer in the reactor's timing
+// wheel; a response arriving after it is dropped. TLS runs through memory
+// BIOs, so the socket I/O stays on the reactor (io_uring or epoll) and the
+// handshake is a coroutine too.
+//
+// Frames of the call coroutines come from the FramePool: after warm-up a
+// call allocates nothing.
+
+#ifndef MODBUS_CLIENT_H
+#define MODBUS_CLIENT_H
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include <openssl/ssl.h>
+
+#include "reactor.h"
+
+namespace modbus {
+
+enum class Status : uint8_t {
+    Ok,
+    Exception,      // Server answered with an exception (Result::exception_code)
+    Timeout,        // Deadline passed
+    Closed,         // Not connected, or the connection closed with the call in flight
+    Busy,           // kMaxInFlight calls in flight, or the send buffer is full
+    Protocol,       // Malformed or mismatched response
+};
+
+const char* status_name(Status status);
+
+struct Result {
+    Status status = Status::Ok;
+    uint8_t exception_code = 0;
+
+    bool ok() const { return status == Status::Ok; }
+};
+
+struct ClientStats {
+    uint64_t requests;
+    uint64_t responses;
+    uint64_t exceptions;
+    uint64_t timeouts;
+    uint64_t late;          // Responses to calls that had already timed out
+    uint64_t sends;         // send operations (one per flush)
+};
+
+class Client {
+public:
+    static constexpr unsigned kMaxInFlight = 256;
+    static constexpr size_t kBufSize = kMaxInFlight * 260;
+
+    explicit Client(Reactor& reactor);
+    ~Client();
+    Client(const Client&) = delete;
+    Client& operator=(const Client&) = delete;
+
+    /**
+     * TCP connect, then a TLS handshake if tls is set (server_name for SNI)
+     */
+    Task<bool> connect(const char* host, uint16_t port, SSL_CTX* tls = nullptr,
+                       const char* server_name = nullptr);
+
+    /**
+     * FC03 into out (out.size() registers, 1..125); timeout_ms 0 = no deadline
+     */
+    Task<Result> read_holding(uint8_t unit, uint16_t address, std::span<uint16_t> out,
+                              uint32_t timeout_ms = 0);
+
+    /**
+     * FC16 of values (1..123 registers)
+     */
+    Task<Result> write_multiple(uint8_t unit, uint16_t address, std::span<const uint16_t> values,
+                                uint32_t timeout_ms = 0);
+
+    /**
+     * Fail the calls in flight with Closed and shut the connection down.
+     * The socket is released once its pending operations completed (idle()).
+     */
+    void close();
+
+    bool connected() const { return _fd >= 0 && !_closing; }
+    bool idle() const { return _fd < 0; }
+    unsigned in_flight() const { return _in_flight; }
+    const ClientStats& stats() const { return _stats; }
+
+private:
+    struct Call {
+        Client* client;
+        uint16_t tid;
+        uint8_t fc;
+        uint16_t address;
+        std::span<uint16_t> out;
+        uint16_t count;
+        Result result;
+        ev_timer timer;
+        std::coroutine_handle<> waiter;
+        bool done;          // Finished before the caller suspended (e.g. send failed)
+
+        bool await_ready() const noexcept { return done; }
+        void await_suspend(std::coroutine_handle<> h) noexcept { waiter = h; }
+        void await_resume() const noexcept {}
+    };
+
+    bool start(Call& call, uint8_t unit, const uint8_t* pdu, size_t pdu_len, uint32_t timeout_ms);
+    std::coroutine_handle<> finish(Call& call, Status status, uint8_t code = 0);
+    size_t parse(std::coroutine_handle<>* ready);
+    void flush();
+    void submit_send();
+    void submit_recv();
+    void release_socket();
+    Task<bool> handshake();
+    Task<bool> send_all(const uint8_t* data, size_t len);
+
+    static void on_sent(ev_loop* loop, ev_op* op, int res);
+    static void on_received(ev_loop* loop, ev_op* op, int res);
+    static void on_deadline(ev_loop* loop, ev_timer* timer);
+
+    Reactor& _reactor;
+    int _fd = -1;
+    bool _closing = false;
+    SSL* _ssl = nullptr;
+    BIO* _rbio = nullptr;           // Ciphertext from the socket
+    BIO* _wbio = nullptr;           // Ciphertext to the socket
+
+    uint16_t _next_tid = 0;
+    unsigned _in_flight = 0;
+    Call* _calls[kMaxInFlight] = {};
+
+    // Requests are appended to _wbuf[_wfill] while the other buffer (or
+    // _cbuf with TLS) is on the wire
+    uint8_t _wbuf[2][kBufSize];
+    size_t _wlen = 0;
+    int _wfill = 0;
+    uint8_t _cbuf[kBufSize + 1024];
+    const uint8_t* _send_buf = nullptr;
+    size_t _send_len = 0;
+    size_t _send_off = 0;
+    bool _sending = false;
+    ev_op _send_op{};
+
+    bool _receiving = false;
+    ev_op _recv_op{};
+    uint8_t _rbuf[kBufSize];        // Plaintext responses
+    size_t _rlen = 0;
+    uint8_t _ibuf[16384 + 512];     // Ciphertext in (TLS)
+
+    ClientStats _stats = {};
+};
+
+}  // namespace modbus
+
+#endif  // MODBUS_CLIENT_H
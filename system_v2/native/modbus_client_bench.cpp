@@ -0,0 +1,290 @@
+// Coroutine Modbus client benchmark (requests/s per core)
+//
+// One thread, one reactor: CONNS clients (modbus_client.h), each with DEPTH
+// coroutines issuing FC03 reads (and optional FC16 writes) back to back, so
+// up to DEPTH calls are pipelined per connection. Reports req/s, req/s per
+// CPU second of this process (user + system, from getrusage), latency
+// percentiles, and the coroutine frame pool: after the first second (warm-up)
+// no frame may come from a new slab or the heap.
+//
+// Build:
+//   gcc -O2 -Wall -c event_loop.c timer_wheel.c
+//   g++ -std=c++20 -O2 -Wall -o modbus_client_bench modbus_client_bench.cpp modbus_client.cpp reactor.cpp event_loop.o timer_wheel.o -lssl -lcrypto
+//
+// Run:
+//   ./modbus_client_bench -p 1502 -c 8 -d 16 -s 10
+//   ./modbus_client_bench -p 1502 -c 8 -d 16 -w 0.1 -b epoll
+//   ./modbus_client_bench -p 8020 -S -A certs/ca.crt -N localhost    (Modbus/TLS)
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include <getopt.h>
+#include <signal.h>
+#include <strings.h>
+#include <sys/resource.h>
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+#include "modbus_client.h"
+
+using namespace modbus;
+
+namespace {
+
+constexpr int kHistUs = 100000;
+constexpr int kStatuses = 6;
+
+struct Config {
+    const char* host = "127.0.0.1";
+    int port = 1502;
+    int conns = 8;
+    int depth = 16;
+    int seconds = 10;
+    int address = 0;
+    int count = 10;
+    int unit = 1;
+    double write_ratio = 0;
+    int timeout_ms = 1000;
+    ev_backend backend = EV_BACKEND_AUTO;
+    bool tls = false;
+    const char* ca = nullptr;
+    const char* server_name = nullptr;
+};
+
+Config cfg;
+volatile sig_atomic_t interrupted = 0;
+
+struct Bench {
+    Reactor& reactor;
+    std::vector<std::unique_ptr<Client>> clients;
+    bool running = true;
+    int active = 0;
+    uint64_t responses = 0;
+    uint64_t status[kStatuses] = {};
+    std::vector<uint64_t> hist = std::vector<uint64_t>(kHistUs + 1);
+    uint64_t max_ns = 0;
+    FramePool::Stats warm = {};     // Pool counters at the end of warm-up
+};
+
+double cpu_seconds() {
+    rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+double percentile_us(const std::vector<uint64_t>& hist, uint64_t total, double q) {
+    uint64_t target = static_cast<uint64_t>(q * total);
+    uint64_t sum = 0;
+    for (int i = 0; i <= kHistUs; i++) {
+        sum += hist[i];
+        if (sum > target) return i;
+    }
+    return kHistUs;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Coroutines                                                                */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * One request stream: the next call starts as soon as the previous completes
+ */
+Task<void> worker(Bench& b, Client& client, uint64_t rng) {
+    uint16_t regs[125];
+    for (int i = 0; i < cfg.count; i++) regs[i] = i;
+
+    while (b.running && client.connected()) {
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        bool write = cfg.write_ratio > 0 && (rng >> 11) * 0x1.0p-53 < cfg.write_ratio;
+
+        uint64_t t0 = ev_now_ns();
+        std::span<uint16_t> range(regs, cfg.count);
+        Result r = write ? co_await client.write_multiple(cfg.unit, cfg.address, range, cfg.timeout_ms)
+                         : co_await client.read_holding(cfg.unit, cfg.address, range, cfg.timeout_ms);
+        uint64_t ns = ev_now_ns() - t0;
+
+        b.status[static_cast<int>(r.status)]++;
+        if (r.status == Status::Ok || r.status == Status::Exception) {
+            b.responses++;
+            uint64_t us = ns / 1000;
+            b.hist[us > kHistUs ? kHistUs : us]++;
+            if (ns > b.max_ns) b.max_ns = ns;
+        }
+    }
+
+    if (--b.active == 0) b.reactor.stop();
+}
+
+Task<void> run(Bench& b, SSL_CTX* tls) {
+    for (int i = 0; i < cfg.conns; i++) {
+        auto client = std::make_unique<Client>(b.reactor);
+        if (!co_await client->connect(cfg.host, cfg.port, tls, cfg.server_name)) {
+            fprintf(stderr, "✗ Connection %d to %s:%d failed\n", i, cfg.host, cfg.port);
+            if (tls) ERR_print_errors_fp(stderr);
+            b.reactor.stop();
+            co_return;
+        }
+        b.clients.push_back(std::move(client));
+    }
+
+    uint64_t seed = 0x9E3779B97F4A7C15ULL ^ ev_now_ns();
+    b.active = cfg.conns * cfg.depth;
+    for (auto& client : b.clients) {
+        for (int d = 0; d < cfg.depth; d++) {
+            seed += 0x9E3779B97F4A7C15ULL;
+            spawn(worker(b, *client, seed | 1));
+        }
+    }
+
+    // Per-second report; the first second is the warm-up
+    uint64_t prev = 0;
+    uint64_t last = ev_now_ns();
+    for (int s = 0; s < cfg.seconds && !interrupted; s++) {
+        co_await b.reactor.sleep(1000);
+        uint64_t now = ev_now_ns();
+        fprintf(stderr, "[BENCH] %.0f req/s\n", (b.responses - prev) / ((now - last) / 1e9));
+        prev = b.responses;
+        last = now;
+        if (s == 0) b.warm = FramePool::stats();
+    }
+    b.running = false;     // Workers return after their call in flight
+}
+
+/* ------------------------------------------------------------------------- */
+/* Main                                                                      */
+/* ------------------------------------------------------------------------- */
+
+void on_signal(int) {
+    interrupted = 1;
+}
+
+void usage(const char* prog) {
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  -h HOST        server (default 127.0.0.1)\n"
+        "  -p PORT        port (default 1502)\n"
+        "  -c CONNS       connections (default 8)\n"
+        "  -d DEPTH       coroutines (calls in flight) per connection (default 16, max %u)\n"
+        "  -s SECONDS     duration, including 1 s warm-up (default 10)\n"
+        "  -a ADDR        first register (default 0)\n"
+        "  -n COUNT       registers per request (default 10)\n"
+        "  -u UNIT        unit id (default 1)\n"
+        "  -w RATIO       fraction of FC16 writes (default 0)\n"
+        "  -T MS          per-call deadline (default 1000, 0 = none)\n"
+        "  -b BACKEND     auto | io_uring | epoll (default auto)\n"
+        "  -S             Modbus/TLS\n"
+        "  -A FILE        CA certificate to verify the server with (default: no verification)\n"
+        "  -N NAME        server name for SNI and verification\n",
+        prog, Client::kMaxInFlight);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "h:p:c:d:s:a:n:u:w:T:b:SA:N:")) != -1) {
+        switch (opt) {
+        case 'h': cfg.host = optarg; break;
+        case 'p': cfg.port = atoi(optarg); break;
+        case 'c': cfg.conns = atoi(optarg); break;
+        case 'd': cfg.depth = atoi(optarg); break;
+        case 's': cfg.seconds = atoi(optarg); break;
+        case 'a': cfg.address = atoi(optarg); break;
+        case 'n': cfg.count = atoi(optarg); break;
+        case 'u': cfg.unit = atoi(optarg); break;
+        case 'w': cfg.write_ratio = atof(optarg); break;
+        case 'T': cfg.timeout_ms = atoi(optarg); break;
+        case 'b':
+            if (!strcasecmp(optarg, "io_uring")) cfg.backend = EV_BACKEND_IO_URING;
+            else if (!strcasecmp(optarg, "epoll")) cfg.backend = EV_BACKEND_EPOLL;
+            else cfg.backend = EV_BACKEND_AUTO;
+            break;
+        case 'S': cfg.tls = true; break;
+        case 'A': cfg.ca = optarg; break;
+        case 'N': cfg.server_name = optarg; break;
+        default: usage(argv[0]); return 1;
+        }
+    }
+    if (cfg.conns < 1 || cfg.depth < 1 || cfg.depth > static_cast<int>(Client::kMaxInFlight) ||
+        cfg.count < 1 || cfg.count > 123 || cfg.seconds < 1 || cfg.timeout_ms < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    SSL_CTX* tls = nullptr;
+    if (cfg.tls) {
+        tls = SSL_CTX_new(TLS_client_method());
+        SSL_CTX_set_min_proto_version(tls, TLS1_2_VERSION);
+        if (cfg.ca) {
+            if (!SSL_CTX_load_verify_locations(tls, cfg.ca, nullptr)) {
+                fprintf(stderr, "✗ Cannot load CA %s\n", cfg.ca);
+                return 1;
+            }
+            SSL_CTX_set_verify(tls, SSL_VERIFY_PEER, nullptr);
+        }
+    }
+
+    Reactor reactor(cfg.backend);
+    if (!reactor.ok()) {
+        fprintf(stderr, "✗ Event loop setup failed\n");
+        return 1;
+    }
+    Bench b{reactor};
+
+    fprintf(stderr, "Bench: %s:%d%s | %d conns x depth %d | %s | FC03 %d regs at %d%s | %d s\n",
+            cfg.host, cfg.port, cfg.tls ? " (TLS)" : "", cfg.conns, cfg.depth, reactor.backend_name(),
+            cfg.count, cfg.address, cfg.write_ratio > 0 ? ", FC16 writes" : "", cfg.seconds);
+
+    double cpu0 = cpu_seconds();
+    uint64_t start = ev_now_ns();
+    spawn(run(b, tls));
+    reactor.run();
+    if (b.clients.size() < static_cast<size_t>(cfg.conns)) return 1;
+    double elapsed = (ev_now_ns() - start) / 1e9;
+    double cpu = cpu_seconds() - cpu0;
+
+    ClientStats cs = {};
+    for (auto& client : b.clients) {
+        const ClientStats& s = client->stats();
+        cs.requests += s.requests;
+        cs.sends += s.sends;
+        cs.late += s.late;
+    }
+    b.clients.clear();
+    if (tls) SSL_CTX_free(tls);
+
+    const FramePool::Stats& pool = FramePool::stats();
+    uint64_t steady_slabs = pool.slabs - b.warm.slabs;
+    uint64_t steady_heap = pool.heap_frames - b.warm.heap_frames;
+    uint64_t failed = b.status[static_cast<int>(Status::Timeout)] + b.status[static_cast<int>(Status::Closed)]
+                      + b.status[static_cast<int>(Status::Busy)] + b.status[static_cast<int>(Status::Protocol)];
+
+    printf("%llu requests in %.1f s | %.0f req/s | %.0f req/s per CPU second (%.2f s CPU) | "
+           "%.1f requests per send | latency p50 %.0f µs p99 %.0f µs max %.0f µs\n",
+           (unsigned long long)b.responses, elapsed, b.responses / elapsed,
+           cpu > 0 ? b.responses / cpu : 0.0, cpu, cs.sends ? (double)cs.requests / cs.sends : 0.0,
+           percentile_us(b.hist, b.responses, 0.50), percentile_us(b.hist, b.responses, 0.99),
+           b.max_ns / 1e3);
+    printf("exceptions %llu | timeouts %llu | late %llu | closed %llu | busy %llu | protocol %llu\n",
+           (unsigned long long)b.status[static_cast<int>(Status::Exception)],
+           (unsigned long long)b.status[static_cast<int>(Status::Timeout)], (unsigned long long)cs.late,
+           (unsigned long long)b.status[static_cast<int>(Status::Closed)],
+           (unsigned long long)b.status[static_cast<int>(Status::Busy)],
+           (unsigned long long)b.status[static_cast<int>(Status::Protocol)]);
+    printf("frame pool: %llu frames, peak %llu in use, %llu slabs | after warm-up: %llu slabs, %llu heap frames %s\n",
+           (unsigned long long)pool.pool_frames, (unsigned long long)pool.peak,
+           (unsigned long long)pool.slabs, (unsigned long long)steady_slabs,
+           (unsigned long long)steady_heap, steady_slabs || steady_heap ? "✗" : "✓");
+
+    return failed || steady_slabs || steady_heap ? 1 : 0;
+}
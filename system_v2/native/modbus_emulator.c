@@ -0,0 +1,941 @@
+// Native Modbus TCP/TLS device emulator (epoll, single thread)
+//
+// Stand-in for RPI#1 / RPI#2 / any Modbus device in Opta, bridge and gateway
+// tests: registers follow scripted dynamics (const, ramp, sine, counter,
+// replay of PV_DATA from pv_data.h, Gaussian noise), responses can be delayed
+// (latency + jitter) and faults injected (exception responses, dropped
+// responses, connection resets). Serves plain Modbus TCP and Modbus/TLS on
+// separate ports from one event loop. Delayed responses wait in a per-connection
+// FIFO with one timing-wheel timer (timer_wheel.c) for its head; their ADU
+// buffers come from a slab pool (slab.c) that grows with the backlog and is
+// reused after it.
+//
+// Build:
+//   gcc -O2 -Wall -pthread -o modbus_emulator modbus_emulator.c timer_wheel.c slab.c -lssl -lcrypto -lm
+//
+// Run (see README.md for the script format):
+//   ./modbus_emulator -p 1502 -s scenarios/pv_replay.emu -P ../esp32/include/pv_data.h
+//   ./modbus_emulator -p 1502 -t 8802 -c ../rpi1/server.crt -k ../rpi1/server.key -l 20:5 -x 0.01
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <signal.h>
+#include <getopt.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+
+#include "slab.h"
+#include "timer_wheel.h"
+
+#define MAX_CONNS       4096
+#define MAX_EVENTS      256
+#define MAX_REGISTERS   65536
+#define MAX_DELAYED     65536   // Delayed responses in flight (all connections)
+#define MBAP_SIZE       7
+#define MAX_ADU         260
+#define RBUF_SIZE       4096
+#define WBUF_SIZE       16384
+
+#define FC_READ_HOLDING     0x03
+#define FC_READ_INPUT       0x04
+#define FC_WRITE_SINGLE     0x06
+#define FC_WRITE_MULTIPLE   0x10
+
+#define EX_ILLEGAL_FUNCTION     0x01
+#define EX_ILLEGAL_ADDRESS      0x02
+#define EX_ILLEGAL_VALUE        0x03
+
+// epoll tags for the listeners (connections use their slot index)
+#define TAG_LISTEN_PLAIN    (MAX_CONNS + 1)
+#define TAG_LISTEN_TLS      (MAX_CONNS + 2)
+
+/* ------------------------------------------------------------------------- */
+/* Configuration                                                             */
+/* ------------------------------------------------------------------------- */
+
+struct config {
+    int port;               // Plain Modbus TCP (0 = off)
+    int tls_port;           // Modbus/TLS (0 = off)
+    const char* cert;
+    const char* key;
+    const char* script;
+    const char* pv_data;    // pv_data.h for replay generators
+    int unit;               // Answer only this unit id (0 = any)
+    int registers;          // Size of the register bank
+    double latency_ms;      // Response delay
+    double jitter_ms;       // Uniform ± jitter on top of latency_ms
+    double p_exception;     // Probability of an exception response
+    int exception_code;     // Code used for injected exceptions (0x04 device failure)
+    double p_drop;          // Probability of dropping the response
+    double p_reset;         // Probability of resetting the connection
+    int stats_s;            // Statistics interval (0 = off)
+};
+
+static struct config cfg = {
+    .port = 1502,
+    .unit = 0,
+    .registers = 100,
+    .exception_code = 0x04,
+    .stats_s = 5,
+};
+
+/* ------------------------------------------------------------------------- */
+/* Register dynamics                                                         */
+/* ------------------------------------------------------------------------- */
+
+enum gen_kind { GEN_CONST, GEN_RAMP, GEN_SINE, GEN_COUNTER, GEN_REPLAY };
+
+struct generator {
+    uint8_t kind;
+    uint8_t column;         // Replay column (0-7)
+    double a, b, c, d;      // Kind-specific parameters
+    double noise;           // Gaussian sigma added to the value (0 = none)
+};
+
+static struct generator* gens;
+
+// PV_DATA rows as 8 registers (same layout as the ESP32 frame)
+static uint16_t (*replay_rows)[8];
+static size_t replay_count;
+
+static struct timespec start_time;
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t rng_next(void)
+{
+    // xorshift64*
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+static double rng_uniform(void)
+{
+    return (rng_next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double rng_gauss(void)
+{
+    double u1 = rng_uniform() + 1e-12;
+    double u2 = rng_uniform();
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static double elapsed_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec - start_time.tv_sec) + (ts.tv_nsec - start_time.tv_nsec) * 1e-9;
+}
+
+static uint16_t clamp_u16(double v)
+{
+    if (v < 0) return 0;
+    if (v > 65535) return 65535;
+    return (uint16_t)lround(v);
+}
+
+/**
+ * Value of a register at time t (seconds since start)
+ */
+static uint16_t gen_value(const struct generator* g, double t)
+{
+    double v = 0;
+
+    switch (g->kind) {
+    case GEN_CONST:     // a = value
+        v = g->a;
+        break;
+    case GEN_RAMP: {    // a = start, b = step, c = period (s), d = max (wraps to start)
+        double steps = floor(t / g->c);
+        v = g->a + g->b * steps;
+        if (g->d > g->a && g->b > 0) {
+            double span = g->d - g->a + g->b;
+            v = g->a + fmod(v - g->a, span);
+        }
+        break;
+    }
+    case GEN_SINE:      // a = offset, b = amplitude, c = period (s)
+        v = g->a + g->b * sin(2.0 * M_PI * t / g->c);
+        break;
+    case GEN_COUNTER:   // a = period (s), wraps at 65536
+        return (uint16_t)((uint64_t)(t / g->a) & 0xFFFF);
+    case GEN_REPLAY:    // a = period (s) per PV_DATA row
+        if (replay_count == 0) return 0;
+        v = replay_rows[(size_t)(t / g->a) % replay_count][g->column];
+        break;
+    }
+
+    if (g->noise > 0) {
+        v += g->noise * rng_gauss();
+    }
+    return clamp_u16(v);
+}
+
+/**
+ * Load PV_DATA rows ({P_ac, P_dc, V_dc, I_dc, G, T_cell, timestamp}) from pv_data.h
+ */
+static int load_pv_data(const char* path)
+{
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "cannot open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    size_t cap = 9000;
+    replay_rows = malloc(cap * sizeof(*replay_rows));
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        unsigned v[6];
+        unsigned long ts;
+        if (sscanf(line, " {%u, %u, %u, %u, %u, %u, %luUL}",
+                   &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &ts) != 7)
+            continue;
+        if (replay_count == cap) {
+            cap *= 2;
+            replay_rows = realloc(replay_rows, cap * sizeof(*replay_rows));
+        }
+        uint16_t* row = replay_rows[replay_count++];
+        for (int i = 0; i < 6; i++) row[i] = (uint16_t)v[i];
+        row[6] = (uint16_t)(ts >> 16);
+        row[7] = (uint16_t)(ts & 0xFFFF);
+    }
+    fclose(f);
+
+    fprintf(stderr, "Loaded %zu PV_DATA rows from %s\n", replay_count, path);
+    return replay_count > 0 ? 0 : -1;
+}
+
+/**
+ * Parse one script line: <reg>[-<reg>] <kind> <params...> [noise=<sigma>]
+ */
+static int parse_script_line(char* line, int lineno)
+{
+    char* hash = strchr(line, '#');
+    if (hash) *hash = '\0';
+
+    char* tok[8];
+    int n = 0;
+    for (char* p = strtok(line, " \t\r\n"); p && n < 8; p = strtok(NULL, " \t\r\n"))
+        tok[n++] = p;
+    if (n == 0) return 0;
+
+    struct generator g = {0};
+    if (n >= 2 && strncmp(tok[n - 1], "noise=", 6) == 0) {
+        g.noise = atof(tok[n - 1] + 6);
+        n--;
+    }
+
+    int first, last;
+    if (sscanf(tok[0], "%d-%d", &first, &last) != 2) {
+        first = last = atoi(tok[0]);
+    }
+    if (n < 2 || first < 0 || last < first || last >= cfg.registers) {
+        fprintf(stderr, "%s:%d: bad register range\n", cfg.script, lineno);
+        return -1;
+    }
+
+    const char* kind = tok[1];
+    int argc = n - 2;
+    double arg[4] = {0};
+    for (int i = 0; i < argc && i < 4; i++) arg[i] = atof(tok[2 + i]);
+
+    if (strcmp(kind, "const") == 0 && argc == 1) {
+        g.kind = GEN_CONST;
+        g.a = arg[0];
+    } else if (strcmp(kind, "ramp") == 0 && argc >= 3) {
+        g.kind = GEN_RAMP;
+        g.a = arg[0];
+        g.b = arg[1];
+        g.c = arg[2] / 1000.0;
+        g.d = argc >= 4 ? arg[3] : 0;
+    } else if (strcmp(kind, "sine") == 0 && argc == 3) {
+        g.kind = GEN_SINE;
+        g.a = arg[0];
+        g.b = arg[1];
+        g.c = arg[2] / 1000.0;
+    } else if (strcmp(kind, "counter") == 0 && argc == 1) {
+        g.kind = GEN_COUNTER;
+        g.a = arg[0] / 1000.0;
+    } else if (strcmp(kind, "replay") == 0 && argc >= 1) {
+        g.kind = GEN_REPLAY;
+        g.a = arg[0] / 1000.0;
+        g.column = argc >= 2 ? (uint8_t)arg[1] : 0;
+        if (replay_count == 0) {
+            fprintf(stderr, "%s:%d: replay needs PV_DATA (-P pv_data.h)\n", cfg.script, lineno);
+            return -1;
+        }
+    } else {
+        fprintf(stderr, "%s:%d: unknown generator '%s' or wrong argument count\n",
+                cfg.script, lineno, kind);
+        return -1;
+    }
+
+    double period = g.kind == GEN_RAMP || g.kind == GEN_SINE ? g.c : g.a;
+    if (g.kind != GEN_CONST && period <= 0) {
+        fprintf(stderr, "%s:%d: period must be > 0\n", cfg.script, lineno);
+        return -1;
+    }
+
+    for (int r = first; r <= last; r++) {
+        gens[r] = g;
+        // A replay range maps consecutive registers to consecutive columns
+        if (g.kind == GEN_REPLAY) gens[r].column = (g.column + (r - first)) % 8;
+    }
+    return 0;
+}
+
+static int load_script(const char* path)
+{
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "cannot open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    char line[512];
+    int lineno = 0, rc = 0;
+    while (rc == 0 && fgets(line, sizeof(line), f)) {
+        rc = parse_script_line(line, ++lineno);
+    }
+    fclose(f);
+    return rc;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Connections                                                               */
+/* ------------------------------------------------------------------------- */
+
+struct delayed;
+
+struct conn {
+    int fd;                 // -1 = free slot
+    SSL* ssl;               // NULL for plain Modbus TCP
+    int handshaking;
+    uint64_t last_due;      // Keeps delayed responses in request order
+    struct delayed* delayed_head;
+    struct delayed* delayed_tail;
+    struct tw_timer delay_timer;    // Due time of delayed_head
+    size_t rlen;
+    size_t wlen;
+    uint8_t rbuf[RBUF_SIZE];
+    uint8_t wbuf[WBUF_SIZE];
+};
+
+struct delayed {
+    uint64_t due;
+    struct delayed* next;
+    uint16_t len;
+    uint8_t adu[MAX_ADU];
+};
+
+static struct conn* conns;
+static int epfd;
+static SSL_CTX* ssl_ctx;
+static volatile sig_atomic_t running = 1;
+
+// Delayed responses: slab pool, queued per connection in request order
+static struct slab_pool delayed_pool;
+static size_t delayed_len;
+static struct timer_wheel wheel;
+
+static struct {
+    uint64_t requests;
+    uint64_t exceptions;
+    uint64_t injected_exceptions;
+    uint64_t dropped;
+    uint64_t resets;
+    uint64_t accepted;
+    int active;
+} stats;
+
+static struct delayed* delayed_alloc(void)
+{
+    if (delayed_len == MAX_DELAYED) return NULL;
+    struct delayed* d = slab_alloc(&delayed_pool);
+    if (d) delayed_len++;
+    return d;
+}
+
+static void delayed_release(struct delayed* d)
+{
+    slab_free(&delayed_pool, d);
+    delayed_len--;
+}
+
+static void set_events(int slot, uint32_t events)
+{
+    struct epoll_event ev = { .events = events, .data.u32 = slot };
+    epoll_ctl(epfd, EPOLL_CTL_MOD, conns[slot].fd, &ev);
+}
+
+static void close_conn(int slot, int reset)
+{
+    struct conn* c = &conns[slot];
+    if (c->fd < 0) return;
+
+    if (reset) {
+        // RST instead of FIN, as a device or NAT dropping the session would
+        struct linger lg = { .l_onoff = 1, .l_linger = 0 };
+        setsockopt(c->fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+    } else if (c->ssl && !c->handshaking) {
+        SSL_shutdown(c->ssl);
+    }
+    if (c->ssl) SSL_free(c->ssl);
+
+    epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    c->fd = -1;
+    c->ssl = NULL;
+    stats.active--;
+
+    // Responses still delayed for this session are discarded
+    while (c->delayed_head) {
+        struct delayed* d = c->delayed_head;
+        c->delayed_head = d->next;
+        delayed_release(d);
+    }
+    c->delayed_tail = NULL;
+    tw_cancel(&wheel, &c->delay_timer);
+}
+
+/**
+ * Send as much of wbuf as the socket takes; EPOLLOUT while data remains
+ */
+static int flush_conn(int slot)
+{
+    struct conn* c = &conns[slot];
+    size_t off = 0;
+
+    while (off < c->wlen) {
+        ssize_t n;
+        if (c->ssl) {
+            n = SSL_write(c->ssl, c->wbuf + off, (int)(c->wlen - off));
+            if (n <= 0) {
+                int e = SSL_get_error(c->ssl, (int)n);
+                if (e == SSL_ERROR_WANT_WRITE || e == SSL_ERROR_WANT_READ) break;
+                return -1;
+            }
+        } else {
+            n = write(c->fd, c->wbuf + off, c->wlen - off);
+            if (n < 0) {
+                if (errno == EAGAIN || errno == EINTR) break;
+                return -1;
+            }
+        }
+        off += n;
+    }
+
+    if (off > 0) {
+        memmove(c->wbuf, c->wbuf + off, c->wlen - off);
+        c->wlen -= off;
+    }
+    set_events(slot, EPOLLIN | (c->wlen ? EPOLLOUT : 0));
+    return 0;
+}
+
+static int queue_response(int slot, const uint8_t* adu, size_t len)
+{
+    struct conn* c = &conns[slot];
+    if (c->wlen + len > WBUF_SIZE) return -1;  // Client not reading: drop it
+    memcpy(c->wbuf + c->wlen, adu, len);
+    c->wlen += len;
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Modbus request handling                                                   */
+/* ------------------------------------------------------------------------- */
+
+static size_t exception_adu(const uint8_t* req, uint8_t* resp, uint8_t code)
+{
+    memcpy(resp, req, MBAP_SIZE);
+    resp[4] = 0;
+    resp[5] = 3;
+    resp[7] = req[7] | 0x80;
+    resp[8] = code;
+    stats.exceptions++;
+    return MBAP_SIZE + 2;
+}
+
+/**
+ * Build the response ADU for one request (0 = no response)
+ */
+static size_t handle_request(const uint8_t* req, size_t len, uint8_t* resp)
+{
+    uint8_t fc = req[7];
+    const uint8_t* pdu = req + MBAP_SIZE;
+    size_t pdu_len = len - MBAP_SIZE;
+
+    if (cfg.unit && req[6] != cfg.unit) {
+        return 0;   // Not addressed to this device (a gateway would answer 0x0B)
+    }
+
+    memcpy(resp, req, MBAP_SIZE);
+    resp[7] = fc;
+
+    switch (fc) {
+    case FC_READ_HOLDING:
+    case FC_READ_INPUT: {
+        if (pdu_len < 5) return exception_adu(req, resp, EX_ILLEGAL_VALUE);
+        uint16_t addr = (pdu[1] << 8) | pdu[2];
+        uint16_t count = (pdu[3] << 8) | pdu[4];
+        if (count < 1 || count > 125) return exception_adu(req, resp, EX_ILLEGAL_VALUE);
+        if (addr + count > cfg.registers) return exception_adu(req, resp, EX_ILLEGAL_ADDRESS);
+
+        double t = elapsed_s();
+        resp[8] = 2 * count;
+        for (int i = 0; i < count; i++) {
+            uint16_t v = gen_value(&gens[addr + i], t);
+            resp[9 + 2 * i] = v >> 8;
+            resp[10 + 2 * i] = v & 0xFF;
+        }
+        resp[4] = 0;
+        resp[5] = 3 + 2 * count;
+        return MBAP_SIZE + 2 + 2 * count;
+    }
+    case FC_WRITE_SINGLE: {
+        if (pdu_len < 5) return exception_adu(req, resp, EX_ILLEGAL_VALUE);
+        uint16_t addr = (pdu[1] << 8) | pdu[2];
+        if (addr >= cfg.registers) return exception_adu(req, resp, EX_ILLEGAL_ADDRESS);
+
+        // A written register holds the written value (overrides its generator)
+        gens[addr] = (struct generator){ .kind = GEN_CONST, .a = (pdu[3] << 8) | pdu[4] };
+        memcpy(resp + 8, pdu + 1, 4);
+        resp[4] = 0;
+        resp[5] = 6;
+        return MBAP_SIZE + 5;
+    }
+    case FC_WRITE_MULTIPLE: {
+        if (pdu_len < 6) return exception_adu(req, resp, EX_ILLEGAL_VALUE);
+        uint16_t addr = (pdu[1] << 8) | pdu[2];
+        uint16_t count = (pdu[3] << 8) | pdu[4];
+        if (count < 1 || count > 123 || pdu[5] != 2 * count || pdu_len < 6u + 2 * count)
+            return exception_adu(req, resp, EX_ILLEGAL_VALUE);
+        if (addr + count > cfg.registers) return exception_adu(req, resp, EX_ILLEGAL_ADDRESS);
+
+        for (int i = 0; i < count; i++) {
+            gens[addr + i] = (struct generator){
+                .kind = GEN_CONST, .a = (pdu[6 + 2 * i] << 8) | pdu[7 + 2 * i] };
+        }
+        memcpy(resp + 8, pdu + 1, 4);
+        resp[4] = 0;
+        resp[5] = 6;
+        return MBAP_SIZE + 5;
+    }
+    default:
+        return exception_adu(req, resp, EX_ILLEGAL_FUNCTION);
+    }
+}
+
+/**
+ * Apply fault injection and latency to one request
+ * Returns -1 if the connection must be closed
+ */
+static int process_request(int slot, const uint8_t* req, size_t len)
+{
+    stats.requests++;
+
+    double roll = rng_uniform();
+    if (roll < cfg.p_reset) {
+        stats.resets++;
+        return -1;
+    }
+    roll -= cfg.p_reset;
+    if (roll < cfg.p_drop) {
+        stats.dropped++;
+        return 0;
+    }
+    roll -= cfg.p_drop;
+
+    uint8_t adu[MAX_ADU];
+    size_t rlen;
+    if (roll < cfg.p_exception) {
+        stats.injected_exceptions++;
+        rlen = exception_adu(req, adu, (uint8_t)cfg.exception_code);
+    } else {
+        rlen = handle_request(req, len, adu);
+    }
+    if (rlen == 0) return 0;
+
+    if (cfg.latency_ms <= 0 && cfg.jitter_ms <= 0) {
+        return queue_response(slot, adu, rlen);
+    }
+
+    struct conn* c = &conns[slot];
+    double delay_ms = cfg.latency_ms + cfg.jitter_ms * (2.0 * rng_uniform() - 1.0);
+    uint64_t due = now_ns() + (uint64_t)(delay_ms > 0 ? delay_ms * 1e6 : 0);
+    if (due < c->last_due) due = c->last_due;   // Device answers in order
+    c->last_due = due;
+
+    struct delayed* d = delayed_alloc();
+    if (!d) return -1;
+    d->due = due;
+    d->next = NULL;
+    d->len = (uint16_t)rlen;
+    memcpy(d->adu, adu, rlen);
+
+    // Due times never decrease along the queue: only its head needs a timer
+    if (c->delayed_tail) {
+        c->delayed_tail->next = d;
+    } else {
+        c->delayed_head = d;
+        tw_start(&wheel, &c->delay_timer, due);
+    }
+    c->delayed_tail = d;
+    return 0;
+}
+
+/**
+ * Split the receive buffer into ADUs (MBAP length framing)
+ */
+static int process_rbuf(int slot)
+{
+    struct conn* c = &conns[slot];
+    size_t off = 0;
+
+    // Stop when the transmit buffer is full: the rest waits for the client to read
+    while (c->rlen - off >= MBAP_SIZE + 1 && c->wlen <= WBUF_SIZE - MAX_ADU) {
+        const uint8_t* adu = c->rbuf + off;
+        size_t len = 6 + ((adu[4] << 8) | adu[5]);
+        if (len < MBAP_SIZE + 1 || len > MAX_ADU || adu[2] || adu[3]) {
+            return -1;  // Not Modbus/TCP
+        }
+        if (c->rlen - off < len) break;
+        if (process_request(slot, adu, len) < 0) return -1;
+        off += len;
+    }
+
+    memmove(c->rbuf, c->rbuf + off, c->rlen - off);
+    c->rlen -= off;
+    return 0;
+}
+
+static void on_readable(int slot)
+{
+    struct conn* c = &conns[slot];
+
+    if (c->handshaking) {
+        int rc = SSL_do_handshake(c->ssl);
+        if (rc != 1) {
+            int e = SSL_get_error(c->ssl, rc);
+            if (e == SSL_ERROR_WANT_READ) { set_events(slot, EPOLLIN); return; }
+            if (e == SSL_ERROR_WANT_WRITE) { set_events(slot, EPOLLIN | EPOLLOUT); return; }
+            close_conn(slot, 0);
+            return;
+        }
+        c->handshaking = 0;
+    }
+
+    for (;;) {
+        if (process_rbuf(slot) < 0) {
+            close_conn(slot, 1);
+            return;
+        }
+
+        // Backpressure: stop reading until EPOLLOUT drains the transmit buffer
+        if (c->wlen > WBUF_SIZE - MAX_ADU) {
+            if (flush_conn(slot) < 0) {
+                close_conn(slot, 0);
+                return;
+            }
+            if (c->wlen > WBUF_SIZE - MAX_ADU) {
+                set_events(slot, EPOLLOUT);
+                return;
+            }
+            continue;
+        }
+
+        ssize_t n;
+        if (c->ssl) {
+            n = SSL_read(c->ssl, c->rbuf + c->rlen, RBUF_SIZE - c->rlen);
+            if (n <= 0) {
+                int e = SSL_get_error(c->ssl, (int)n);
+                if (e == SSL_ERROR_WANT_READ || e == SSL_ERROR_WANT_WRITE) break;
+                close_conn(slot, 0);
+                return;
+            }
+        } else {
+            n = read(c->fd, c->rbuf + c->rlen, RBUF_SIZE - c->rlen);
+            if (n == 0) { close_conn(slot, 0); return; }
+            if (n < 0) {
+                if (errno == EAGAIN || errno == EINTR) break;
+                close_conn(slot, 0);
+                return;
+            }
+        }
+        c->rlen += n;
+    }
+
+    if (c->wlen && flush_conn(slot) < 0) close_conn(slot, 0);
+}
+
+static void on_accept(int lfd, int tls)
+{
+    for (;;) {
+        int fd = accept4(lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;
+
+        int slot = -1;
+        for (int i = 0; i < MAX_CONNS; i++) {
+            if (conns[i].fd < 0) { slot = i; break; }
+        }
+        if (slot < 0) { close(fd); continue; }
+
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        struct conn* c = &conns[slot];
+        c->fd = fd;
+        c->rlen = c->wlen = 0;
+        c->last_due = 0;
+        c->ssl = NULL;
+        c->handshaking = 0;
+        if (tls) {
+            c->ssl = SSL_new(ssl_ctx);
+            SSL_set_fd(c->ssl, fd);
+            SSL_set_accept_state(c->ssl);
+            c->handshaking = 1;
+        }
+
+        struct epoll_event ev = { .events = EPOLLIN, .data.u32 = slot };
+        epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+        stats.accepted++;
+        stats.active++;
+    }
+}
+
+/**
+ * Delay timer: move the due responses at the head of the queue to the
+ * connection, then re-arm for the next one
+ */
+static void on_delay_due(struct timer_wheel* w, struct tw_timer* t)
+{
+    struct conn* c = t->arg;
+    int slot = c - conns;
+    uint64_t now = now_ns();
+
+    while (c->delayed_head && c->delayed_head->due <= now) {
+        struct delayed* d = c->delayed_head;
+        c->delayed_head = d->next;
+        if (!c->delayed_head) c->delayed_tail = NULL;
+        int rc = queue_response(slot, d->adu, d->len);
+        delayed_release(d);
+        if (rc < 0) {
+            close_conn(slot, 0);
+            return;
+        }
+    }
+    if (flush_conn(slot) < 0) {
+        close_conn(slot, 0);
+        return;
+    }
+    if (c->delayed_head) tw_start(w, t, c->delayed_head->due);
+}
+
+/**
+ * Run due timers
+ * Returns ms until the next one (-1 = none)
+ */
+static int run_timers(void)
+{
+    uint64_t now = now_ns();
+    tw_advance(&wheel, now);
+    int64_t wait = tw_next_ns(&wheel, now);
+    if (wait < 0) return -1;
+    return (int)((wait + 999999) / 1000000);
+}
+
+static int listen_on(int port, uint32_t tag)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(port),
+                                .sin_addr.s_addr = htonl(INADDR_ANY) };
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 1024) < 0) {
+        fprintf(stderr, "listen on port %d failed: %s\n", port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    struct epoll_event ev = { .events = EPOLLIN, .data.u32 = tag };
+    epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+    return fd;
+}
+
+static SSL_CTX* build_ssl_ctx(const char* cert, const char* key)
+{
+    SSL_CTX* ctx = SSL_CTX_new(TLS_server_method());
+    SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+    SSL_CTX_set_mode(ctx, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+    if (SSL_CTX_use_certificate_chain_file(ctx, cert) != 1
+        || SSL_CTX_use_PrivateKey_file(ctx, key, SSL_FILETYPE_PEM) != 1) {
+        ERR_print_errors_fp(stderr);
+        SSL_CTX_free(ctx);
+        return NULL;
+    }
+    return ctx;
+}
+
+static void print_stats(double interval_s, uint64_t prev_requests)
+{
+    fprintf(stderr,
+            "[STATS] %.0f req/s | conns %d (accepted %llu) | requests %llu | "
+            "exceptions %llu (injected %llu) | dropped %llu | resets %llu | delayed %zu (slabs %llu)\n",
+            (stats.requests - prev_requests) / interval_s, stats.active,
+            (unsigned long long)stats.accepted, (unsigned long long)stats.requests,
+            (unsigned long long)stats.exceptions, (unsigned long long)stats.injected_exceptions,
+            (unsigned long long)stats.dropped, (unsigned long long)stats.resets, delayed_len,
+            (unsigned long long)slab_total_slabs());
+}
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    running = 0;
+}
+
+static void usage(const char* prog)
+{
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  -p PORT        plain Modbus TCP port (default 1502, 0 = off)\n"
+        "  -t PORT        Modbus/TLS port (needs -c and -k)\n"
+        "  -c FILE        TLS certificate (PEM)\n"
+        "  -k FILE        TLS private key (PEM)\n"
+        "  -s FILE        register script (see README.md)\n"
+        "  -P FILE        pv_data.h for replay generators\n"
+        "  -u UNIT        answer only this unit id (default: any)\n"
+        "  -n COUNT       number of registers (default 100)\n"
+        "  -l MS[:JITTER] response latency (+/- uniform jitter)\n"
+        "  -x PROB[:CODE] exception response probability (default code 4)\n"
+        "  -d PROB        dropped response probability\n"
+        "  -r PROB        connection reset probability\n"
+        "  -i SECONDS     statistics interval (default 5, 0 = off)\n",
+        prog);
+}
+
+int main(int argc, char** argv)
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "p:t:c:k:s:P:u:n:l:x:d:r:i:h")) != -1) {
+        switch (opt) {
+        case 'p': cfg.port = atoi(optarg); break;
+        case 't': cfg.tls_port = atoi(optarg); break;
+        case 'c': cfg.cert = optarg; break;
+        case 'k': cfg.key = optarg; break;
+        case 's': cfg.script = optarg; break;
+        case 'P': cfg.pv_data = optarg; break;
+        case 'u': cfg.unit = atoi(optarg); break;
+        case 'n': cfg.registers = atoi(optarg); break;
+        case 'l': sscanf(optarg, "%lf:%lf", &cfg.latency_ms, &cfg.jitter_ms); break;
+        case 'x': sscanf(optarg, "%lf:%i", &cfg.p_exception, &cfg.exception_code); break;
+        case 'd': cfg.p_drop = atof(optarg); break;
+        case 'r': cfg.p_reset = atof(optarg); break;
+        case 'i': cfg.stats_s = atoi(optarg); break;
+        default: usage(argv[0]); return 1;
+        }
+    }
+
+    if (cfg.registers < 1 || cfg.registers > MAX_REGISTERS) {
+        fprintf(stderr, "register count must be 1..%d\n", MAX_REGISTERS);
+        return 1;
+    }
+    if (cfg.tls_port && (!cfg.cert || !cfg.key)) {
+        fprintf(stderr, "-t needs -c CERT and -k KEY\n");
+        return 1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    rng_state ^= (uint64_t)start_time.tv_nsec;
+
+    gens = calloc(cfg.registers, sizeof(*gens));
+    if (cfg.pv_data && load_pv_data(cfg.pv_data) < 0) return 1;
+    if (cfg.script && load_script(cfg.script) < 0) return 1;
+
+    conns = calloc(MAX_CONNS, sizeof(*conns));
+    for (int i = 0; i < MAX_CONNS; i++) {
+        conns[i].fd = -1;
+        conns[i].delay_timer.cb = on_delay_due;
+        conns[i].delay_timer.arg = &conns[i];
+    }
+    slab_pool_init(&delayed_pool, "delayed", sizeof(struct delayed), 256);
+    tw_init(&wheel, 1000000, now_ns());
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    int plain_fd = -1, tls_fd = -1;
+    if (cfg.port && (plain_fd = listen_on(cfg.port, TAG_LISTEN_PLAIN)) < 0) return 1;
+    if (cfg.tls_port) {
+        if (!(ssl_ctx = build_ssl_ctx(cfg.cert, cfg.key))) return 1;
+        if ((tls_fd = listen_on(cfg.tls_port, TAG_LISTEN_TLS)) < 0) return 1;
+    }
+
+    fprintf(stderr, "Modbus emulator: tcp %d, tls %d, %d registers, unit %s, "
+            "latency %.1f±%.1f ms, p(exception/drop/reset) %.4f/%.4f/%.4f\n",
+            cfg.port, cfg.tls_port, cfg.registers, cfg.unit ? "fixed" : "any",
+            cfg.latency_ms, cfg.jitter_ms, cfg.p_exception, cfg.p_drop, cfg.p_reset);
+
+    struct epoll_event events[MAX_EVENTS];
+    uint64_t next_stats = now_ns() + (uint64_t)cfg.stats_s * 1000000000ULL;
+    uint64_t prev_requests = 0;
+
+    while (running) {
+        int timeout = run_timers();
+        if (cfg.stats_s && (timeout < 0 || timeout > 1000)) timeout = 1000;
+
+        int n = epoll_wait(epfd, events, MAX_EVENTS, timeout);
+        for (int i = 0; i < n; i++) {
+            uint32_t tag = events[i].data.u32;
+            if (tag == TAG_LISTEN_PLAIN) { on_accept(plain_fd, 0); continue; }
+            if (tag == TAG_LISTEN_TLS) { on_accept(tls_fd, 1); continue; }
+
+            if (conns[tag].fd < 0) continue;
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                on_readable(tag);
+            } else if (events[i].events & EPOLLOUT) {
+                // Drained: continue with buffered requests (or the TLS handshake)
+                if (!conns[tag].handshaking && flush_conn(tag) < 0) close_conn(tag, 0);
+                else on_readable(tag);
+            }
+        }
+
+        if (cfg.stats_s && now_ns() >= next_stats) {
+            print_stats(cfg.stats_s, prev_requests);
+            prev_requests = stats.requests;
+            next_stats += (uint64_t)cfg.stats_s * 1000000000ULL;
+        }
+    }
+
+    for (int i = 0; i < MAX_CONNS; i++) close_conn(i, 0);
+    fprintf(stderr, "Shutdown: %llu requests, %llu accepted connections\n",
+            (unsigned long long)stats.requests, (unsigned long long)stats.accepted);
+    return 0;
+}
@@ -0,0 +1,595 @@
+// Modbus TCP load generator (multi-threaded, pipelined)
+//
+// Drives modbus_server / modbus_emulator / RPI#1 with FC03 reads and optional
+// FC16 writes: each thread runs its own epoll loop over its connections and
+// keeps DEPTH requests in flight per connection. Reports req/s every second
+// and latency percentiles at the end. With -V, every write sets the whole
+// range to one value, and reads of that range must never see two different
+// values (a torn write).
+//
+// Every connection has a response timeout on its oldest request (restarted
+// as responses arrive) in a per-thread timing wheel (timer_wheel.c); a
+// connection that times out or fails is closed and reconnected with
+// exponential backoff. Servers answer a connection's requests in order, so
+// a response whose transaction id is not the oldest request's means that
+// response was dropped: it counts as a timeout right away.
+//
+// Build:
+//   gcc -O2 -Wall -pthread -o modbus_loadgen modbus_loadgen.c timer_wheel.c
+//
+// Run:
+//   ./modbus_loadgen -p 1502 -t 4 -c 64 -d 8 -s 10
+//   ./modbus_loadgen -p 1502 -t 2 -c 8 -a 60 -n 10 -w 0.05 -V    (RCU check across a page boundary)
+//   ./modbus_loadgen -p 1502 -c 1000 -T 200                       (timeouts against a slow emulator)
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "timer_wheel.h"
+
+#define MAX_THREADS     256
+#define MAX_DEPTH       64
+#define MAX_EVENTS      256
+#define MBAP_SIZE       7
+#define MAX_ADU         260
+#define RBUF_SIZE       16384
+#define WBUF_SIZE       (MAX_DEPTH * MAX_ADU)
+#define HIST_US         10000   // 1 µs bins up to 10 ms, then overflow
+#define BACKOFF_MIN_MS  10
+#define BACKOFF_MAX_MS  1000
+#define MS              1000000ULL
+
+/* ------------------------------------------------------------------------- */
+/* Configuration                                                             */
+/* ------------------------------------------------------------------------- */
+
+struct config {
+    const char* host;
+    int port;
+    int threads;
+    int conns;              // Per thread
+    int depth;              // Requests in flight per connection
+    int seconds;
+    int address;
+    int count;              // Registers per request
+    int unit;
+    double write_ratio;     // Fraction of requests sent as FC16
+    int verify;             // Check reads for torn writes
+    int first_cpu;          // Pin thread i to CPU first_cpu + i (-1 = no pinning)
+    int timeout_ms;         // Response timeout (0 = none)
+};
+
+static struct config cfg = {
+    .host = "127.0.0.1",
+    .port = 1502,
+    .threads = 1,
+    .conns = 8,
+    .depth = 1,
+    .seconds = 10,
+    .count = 10,
+    .unit = 1,
+    .first_cpu = -1,
+    .timeout_ms = 1000,
+};
+
+/* ------------------------------------------------------------------------- */
+/* State                                                                     */
+/* ------------------------------------------------------------------------- */
+
+struct pending {
+    uint64_t sent_ns;
+    uint16_t tid;
+    uint8_t fc;
+};
+
+struct lconn {
+    int fd;
+    struct worker* owner;
+    struct tw_timer timer;      // Response timeout, or reconnect backoff while fd < 0
+    unsigned backoff_ms;
+    uint16_t next_tid;
+    struct pending ring[MAX_DEPTH];
+    unsigned head;
+    unsigned tail;
+    size_t rlen;
+    size_t wlen;
+    uint8_t rbuf[RBUF_SIZE];
+    uint8_t wbuf[WBUF_SIZE];
+};
+
+struct worker {
+    int id;
+    pthread_t thread;
+    int epfd;
+    struct timer_wheel wheel;
+    struct lconn* conns;
+    struct sockaddr_in addr;
+    uint64_t rng;
+    uint16_t write_seq;
+    // Owner thread only
+    uint64_t hist[HIST_US + 1];
+    uint64_t max_ns;
+    uint64_t errors;
+    uint64_t exceptions;
+    uint64_t torn;
+    uint64_t timeouts;
+    uint64_t reconnects;
+    // Read by the main thread
+    uint64_t responses __attribute__((aligned(64)));
+} __attribute__((aligned(64)));
+
+static struct worker* workers;
+static volatile sig_atomic_t running = 1;
+static pthread_barrier_t start_barrier;
+static uint64_t stop_ns;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static double rng_uniform(struct worker* w)
+{
+    // xorshift64*
+    w->rng ^= w->rng >> 12;
+    w->rng ^= w->rng << 25;
+    w->rng ^= w->rng >> 27;
+    return ((w->rng * 0x2545F4914F6CDD1DULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Requests                                                                  */
+/* ------------------------------------------------------------------------- */
+
+static void queue_request(struct worker* w, struct lconn* c)
+{
+    uint8_t* adu = c->wbuf + c->wlen;
+    uint16_t tid = c->next_tid++;
+    int write = cfg.write_ratio > 0 && rng_uniform(w) < cfg.write_ratio;
+    size_t len;
+
+    adu[0] = tid >> 8;
+    adu[1] = tid & 0xFF;
+    adu[2] = 0;
+    adu[3] = 0;
+    adu[6] = cfg.unit;
+    adu[8] = cfg.address >> 8;
+    adu[9] = cfg.address & 0xFF;
+    adu[10] = cfg.count >> 8;
+    adu[11] = cfg.count & 0xFF;
+
+    if (write) {
+        // The whole range gets one value (distinct per thread and write)
+        uint16_t v = (uint16_t)((w->id << 12) | (w->write_seq++ & 0x0FFF));
+        adu[7] = 0x10;
+        adu[12] = 2 * cfg.count;
+        for (int i = 0; i < cfg.count; i++) {
+            adu[13 + 2 * i] = v >> 8;
+            adu[14 + 2 * i] = v & 0xFF;
+        }
+        len = 13 + 2 * cfg.count;
+    } else {
+        adu[7] = 0x03;
+        len = 12;
+    }
+    adu[4] = (len - 6) >> 8;
+    adu[5] = (len - 6) & 0xFF;
+    c->wlen += len;
+
+    struct pending* p = &c->ring[c->tail++ % MAX_DEPTH];
+    p->tid = tid;
+    p->fc = adu[7];
+    p->sent_ns = now_ns();
+}
+
+static int flush(struct lconn* c)
+{
+    size_t off = 0;
+    while (off < c->wlen) {
+        ssize_t n = write(c->fd, c->wbuf + off, c->wlen - off);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN) break;
+            return -1;
+        }
+        off += n;
+    }
+    memmove(c->wbuf, c->wbuf + off, c->wlen - off);
+    c->wlen -= off;
+    return 0;
+}
+
+static void check_response(struct worker* w, const struct pending* p, const uint8_t* adu, size_t len)
+{
+    uint64_t lat = now_ns() - p->sent_ns;
+    uint64_t us = lat / 1000;
+    w->hist[us < HIST_US ? us : HIST_US]++;
+    if (lat > w->max_ns) w->max_ns = lat;
+
+    if (adu[7] & 0x80) {
+        w->exceptions++;
+        return;
+    }
+    if (adu[7] != p->fc) {
+        w->errors++;
+        return;
+    }
+    if (p->fc == 0x03) {
+        if (len < 9u + 2 * cfg.count || adu[8] != 2 * cfg.count) {
+            w->errors++;
+            return;
+        }
+        if (cfg.verify) {
+            for (int i = 1; i < cfg.count; i++) {
+                if (adu[9 + 2 * i] != adu[9] || adu[10 + 2 * i] != adu[10]) {
+                    w->torn++;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Response timeout for the oldest request in flight (restarted as it changes)
+ */
+static void arm_timeout(struct worker* w, struct lconn* c)
+{
+    if (cfg.timeout_ms == 0) return;
+    if (c->head == c->tail) {
+        tw_cancel(&w->wheel, &c->timer);
+        return;
+    }
+    tw_start(&w->wheel, &c->timer, c->ring[c->head % MAX_DEPTH].sent_ns + cfg.timeout_ms * MS);
+}
+
+static void drop_conn(struct worker* w, struct lconn* c);
+
+/**
+ * Consume complete responses; one new request per response until the run ends
+ */
+static int on_readable(struct worker* w, struct lconn* c)
+{
+    for (;;) {
+        size_t room = RBUF_SIZE - c->rlen;
+        ssize_t n = read(c->fd, c->rbuf + c->rlen, room);
+        if (n == 0) return -1;
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EINTR) break;
+            return -1;
+        }
+        c->rlen += n;
+
+        size_t off = 0;
+        unsigned done = 0;
+        int skipped = 0;
+        while (c->rlen - off >= MBAP_SIZE + 1) {
+            const uint8_t* adu = c->rbuf + off;
+            size_t len = 6 + ((adu[4] << 8) | adu[5]);
+            if (len < MBAP_SIZE + 1 || len > MAX_ADU) return -1;
+            if (c->rlen - off < len) break;
+            if (c->head == c->tail) return -1;  // Unsolicited response
+
+            // The oldest request's response was dropped: the pipeline is out of step
+            if (((adu[0] << 8) | adu[1]) != c->ring[c->head % MAX_DEPTH].tid) {
+                skipped = 1;
+                break;
+            }
+            check_response(w, &c->ring[c->head++ % MAX_DEPTH], adu, len);
+            off += len;
+            done++;
+        }
+        memmove(c->rbuf, c->rbuf + off, c->rlen - off);
+        c->rlen -= off;
+
+        __atomic_store_n(&w->responses, w->responses + done, __ATOMIC_RELAXED);
+        if (skipped) {
+            w->timeouts++;
+            drop_conn(w, c);
+            return 0;
+        }
+        for (unsigned i = 0; i < done; i++) queue_request(w, c);
+        if (done) {
+            c->backoff_ms = 0;
+            arm_timeout(w, c);
+        }
+        if ((size_t)n < room) break;   // Drained
+    }
+    return flush(c);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Connections                                                               */
+/* ------------------------------------------------------------------------- */
+
+static void on_timeout(struct timer_wheel* wheel, struct tw_timer* t);
+static void on_retry(struct timer_wheel* wheel, struct tw_timer* t);
+
+static int connect_to(const struct sockaddr_in* addr)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(fd, (const struct sockaddr*)addr, sizeof(*addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    return fd;
+}
+
+/**
+ * Close a failed or timed-out connection and schedule its reconnect
+ * (backoff doubles from BACKOFF_MIN_MS up to BACKOFF_MAX_MS until a response)
+ */
+static void drop_conn(struct worker* w, struct lconn* c)
+{
+    if (c->fd >= 0) {
+        epoll_ctl(w->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+        close(c->fd);
+        c->fd = -1;
+    }
+    c->backoff_ms = c->backoff_ms ? c->backoff_ms * 2 : BACKOFF_MIN_MS;
+    if (c->backoff_ms > BACKOFF_MAX_MS) c->backoff_ms = BACKOFF_MAX_MS;
+    c->timer.cb = on_retry;
+    tw_start(&w->wheel, &c->timer, now_ns() + c->backoff_ms * MS);
+}
+
+static int open_conn(struct worker* w, struct lconn* c)
+{
+    c->fd = connect_to(&w->addr);
+    if (c->fd < 0) return -1;
+
+    struct epoll_event ev = { .events = EPOLLIN, .data.u32 = c - w->conns };
+    epoll_ctl(w->epfd, EPOLL_CTL_ADD, c->fd, &ev);
+    return 0;
+}
+
+/**
+ * Fill the pipeline of a fresh connection and start its response timeout
+ */
+static void start_requests(struct worker* w, struct lconn* c)
+{
+    c->head = c->tail = 0;
+    c->rlen = c->wlen = 0;
+    for (int d = 0; d < cfg.depth; d++) queue_request(w, c);
+    c->timer.cb = on_timeout;
+    arm_timeout(w, c);
+    if (flush(c) < 0) {
+        w->errors++;
+        drop_conn(w, c);
+    }
+}
+
+static void on_timeout(struct timer_wheel* wheel, struct tw_timer* t)
+{
+    struct lconn* c = t->arg;
+    c->owner->timeouts++;
+    drop_conn(c->owner, c);
+}
+
+static void on_retry(struct timer_wheel* wheel, struct tw_timer* t)
+{
+    struct lconn* c = t->arg;
+    struct worker* w = c->owner;
+
+    if (open_conn(w, c) < 0) {
+        drop_conn(w, c);
+        return;
+    }
+    w->reconnects++;
+    start_requests(w, c);
+}
+
+static void* worker_main(void* arg)
+{
+    struct worker* w = arg;
+    struct epoll_event events[MAX_EVENTS];
+    w->addr.sin_family = AF_INET;
+    w->addr.sin_port = htons(cfg.port);
+    inet_pton(AF_INET, cfg.host, &w->addr.sin_addr);
+
+    if (cfg.first_cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET((cfg.first_cpu + w->id) % sysconf(_SC_NPROCESSORS_ONLN), &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+
+    w->epfd = epoll_create1(EPOLL_CLOEXEC);
+    w->conns = calloc(cfg.conns, sizeof(struct lconn));
+    tw_init(&w->wheel, MS, now_ns());
+    for (int i = 0; i < cfg.conns; i++) {
+        struct lconn* c = &w->conns[i];
+        c->owner = w;
+        c->timer.arg = c;
+        if (open_conn(w, c) < 0) {
+            fprintf(stderr, "✗ connect %s:%d failed: %s\n", cfg.host, cfg.port, strerror(errno));
+            w->errors++;
+        }
+    }
+
+    pthread_barrier_wait(&start_barrier);
+
+    for (int i = 0; i < cfg.conns; i++) {
+        struct lconn* c = &w->conns[i];
+        if (c->fd >= 0) start_requests(w, c);
+        else drop_conn(w, c);
+    }
+
+    while (__atomic_load_n(&running, __ATOMIC_RELAXED) &&
+           now_ns() < __atomic_load_n(&stop_ns, __ATOMIC_RELAXED)) {
+        // Wake up for the next timer, and at least every 100 ms to see the end of the run
+        int64_t ns = tw_next_ns(&w->wheel, now_ns());
+        int timeout_ms = ns < 0 || ns > (int64_t)(100 * MS) ? 100 : (int)((ns + MS - 1) / MS);
+
+        int n = epoll_wait(w->epfd, events, MAX_EVENTS, timeout_ms);
+        for (int i = 0; i < n; i++) {
+            struct lconn* c = &w->conns[events[i].data.u32];
+            if (c->fd < 0) continue;
+            if (on_readable(w, c) < 0) {
+                w->errors++;
+                drop_conn(w, c);
+            }
+        }
+        tw_advance(&w->wheel, now_ns());
+    }
+
+    for (int i = 0; i < cfg.conns; i++) {
+        if (w->conns[i].fd >= 0) close(w->conns[i].fd);
+    }
+    close(w->epfd);
+    free(w->conns);
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Main                                                                      */
+/* ------------------------------------------------------------------------- */
+
+static double percentile_us(const uint64_t* hist, uint64_t total, double q)
+{
+    uint64_t target = (uint64_t)(q * total);
+    uint64_t sum = 0;
+    for (int i = 0; i <= HIST_US; i++) {
+        sum += hist[i];
+        if (sum > target) return i;
+    }
+    return HIST_US;
+}
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    __atomic_store_n(&running, 0, __ATOMIC_RELAXED);
+}
+
+static void usage(const char* prog)
+{
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  -h HOST        server (default 127.0.0.1)\n"
+        "  -p PORT        port (default 1502)\n"
+        "  -t THREADS     worker threads (default 1)\n"
+        "  -c CONNS       connections per thread (default 8)\n"
+        "  -d DEPTH       requests in flight per connection (default 1, max %d)\n"
+        "  -s SECONDS     duration (default 10)\n"
+        "  -a ADDR        first register (default 0)\n"
+        "  -n COUNT       registers per request (default 10)\n"
+        "  -u UNIT        unit id (default 1)\n"
+        "  -w RATIO       fraction of FC16 writes (default 0)\n"
+        "  -V             count torn reads (needs uniform writes: run with -w)\n"
+        "  -C CPU         pin thread i to CPU (CPU + i) (default: no pinning)\n"
+        "  -T MS          response timeout, then reconnect (default 1000, 0 = none)\n",
+        prog, MAX_DEPTH);
+}
+
+int main(int argc, char** argv)
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "h:p:t:c:d:s:a:n:u:w:VC:T:")) != -1) {
+        switch (opt) {
+        case 'h': cfg.host = optarg; break;
+        case 'p': cfg.port = atoi(optarg); break;
+        case 't': cfg.threads = atoi(optarg); break;
+        case 'c': cfg.conns = atoi(optarg); break;
+        case 'd': cfg.depth = atoi(optarg); break;
+        case 's': cfg.seconds = atoi(optarg); break;
+        case 'a': cfg.address = atoi(optarg); break;
+        case 'n': cfg.count = atoi(optarg); break;
+        case 'u': cfg.unit = atoi(optarg); break;
+        case 'w': cfg.write_ratio = atof(optarg); break;
+        case 'V': cfg.verify = 1; break;
+        case 'C': cfg.first_cpu = atoi(optarg); break;
+        case 'T': cfg.timeout_ms = atoi(optarg); break;
+        default: usage(argv[0]); return 1;
+        }
+    }
+    if (cfg.threads < 1 || cfg.threads > MAX_THREADS || cfg.depth < 1 || cfg.depth > MAX_DEPTH ||
+        cfg.count < 1 || cfg.count > 123 || cfg.timeout_ms < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    workers = aligned_alloc(64, cfg.threads * sizeof(*workers));
+    memset(workers, 0, cfg.threads * sizeof(*workers));
+    pthread_barrier_init(&start_barrier, NULL, cfg.threads + 1);
+
+    stop_ns = UINT64_MAX;
+    for (int i = 0; i < cfg.threads; i++) {
+        workers[i].id = i;
+        workers[i].rng = 0x9E3779B97F4A7C15ULL ^ ((uint64_t)(i + 1) << 32) ^ now_ns();
+        pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]);
+    }
+
+    fprintf(stderr, "Load: %s:%d | %d threads x %d conns, depth %d | FC03 %d regs at %d%s | %d s\n",
+            cfg.host, cfg.port, cfg.threads, cfg.conns, cfg.depth, cfg.count, cfg.address,
+            cfg.write_ratio > 0 ? ", FC16 writes" : "", cfg.seconds);
+
+    pthread_barrier_wait(&start_barrier);
+    uint64_t start = now_ns();
+    __atomic_store_n(&stop_ns, start + (uint64_t)cfg.seconds * 1000000000ULL, __ATOMIC_RELAXED);
+
+    uint64_t prev = 0;
+    uint64_t last = start;
+    while (__atomic_load_n(&running, __ATOMIC_RELAXED) && now_ns() < stop_ns) {
+        usleep(1000 * 1000);
+        uint64_t total = 0;
+        for (int i = 0; i < cfg.threads; i++) {
+            total += __atomic_load_n(&workers[i].responses, __ATOMIC_RELAXED);
+        }
+        uint64_t now = now_ns();
+        fprintf(stderr, "[LOAD] %.0f req/s\n", (total - prev) / ((now - last) / 1e9));
+        prev = total;
+        last = now;
+    }
+    double elapsed = (now_ns() - start) / 1e9;
+    __atomic_store_n(&running, 0, __ATOMIC_RELAXED);
+
+    uint64_t* hist = calloc(HIST_US + 1, sizeof(uint64_t));
+    uint64_t total = 0, errors = 0, exceptions = 0, torn = 0, timeouts = 0, reconnects = 0;
+    uint64_t max_ns = 0;
+    for (int i = 0; i < cfg.threads; i++) {
+        struct worker* w = &workers[i];
+        pthread_join(w->thread, NULL);
+        for (int b = 0; b <= HIST_US; b++) hist[b] += w->hist[b];
+        total += w->responses;
+        errors += w->errors;
+        exceptions += w->exceptions;
+        torn += w->torn;
+        timeouts += w->timeouts;
+        reconnects += w->reconnects;
+        if (w->max_ns > max_ns) max_ns = w->max_ns;
+    }
+
+    printf("%llu requests in %.1f s | %.0f req/s (%.0f per thread) | latency p50 %.0f µs "
+           "p99 %.0f µs max %.0f µs | errors %llu | exceptions %llu | torn %llu | "
+           "timeouts %llu | reconnects %llu\n",
+           (unsigned long long)total, elapsed, total / elapsed, total / elapsed / cfg.threads,
+           percentile_us(hist, total, 0.50), percentile_us(hist, total, 0.99), max_ns / 1e3,
+           (unsigned long long)errors, (unsigned long long)exceptions, (unsigned long long)torn,
+           (unsigned long long)timeouts, (unsigned long long)reconnects);
+    return errors || torn || timeouts ? 1 : 0;
+}
@@ -0,0 +1,781 @@
+// Native Modbus -> MMS gateway loop (io_uring / epoll)
+//
+// Same job as rpi2/shabnam_mms.c: poll the 6 PV registers over Modbus TCP,
+// write them to the relay over MMS, mirror them to relay_mirror.json for the
+// dashboard and (optionally) append them to a historian CSV. The Modbus
+// request/response, the cycle timer and both file writes go through
+// event_loop.c, where the io_uring backend needs two io_uring_enter calls per
+// frame. `-b legacy` runs the current bridge loop (blocking socket read in
+// libmodbus' steps, fopen/fprintf/fclose, usleep) for comparison, and every
+// mode reports syscalls per frame.
+//
+// Build:
+//   gcc -O2 -Wall -o modbus_mms_gateway modbus_mms_gateway.c event_loop.c timer_wheel.c
+//   gcc -O2 -Wall -DWITH_MMS -o modbus_mms_gateway modbus_mms_gateway.c event_loop.c timer_wheel.c -liec61850 -lpthread
+//
+// Run:
+//   ./modbus_emulator -p 1502 -s scenarios/synthetic.emu -i 0 &
+//   ./modbus_mms_gateway -p 1502 -H historian.csv
+//   ./modbus_mms_gateway -p 1502 -b legacy -i 0 -n 20000      (syscall comparison)
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <getopt.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "event_loop.h"
+
+#ifdef WITH_MMS
+#include <libiec61850/iec61850_client.h>
+#endif
+
+#define REG_COUNT       6
+#define SCALE           10.0f
+#define MBAP_SIZE       7
+#define REQ_SIZE        12
+#define RESP_SIZE       (MBAP_SIZE + 2 + 2 * REG_COUNT)
+#define MIRROR_SIZE     320     // Mirror is rewritten in place, padded to this size
+#define HIST_BUF        8192
+#define RECONNECT_MS    1000
+
+// MMS attribute paths (same as rpi2/shabnam_mms.c)
+#define REF_PAC   "LD0/MMXU1.TotW.mag.f"
+#define REF_PDC   "LD0/MMXU1.TotWDC.mag.f"
+#define REF_VDC   "LD0/MMXU1.VolDC.mag.f"
+#define REF_IDC   "LD0/MMXU1.AmpDC.mag.f"
+#define REF_G     "LD0/MET1.Irradiance.mag.f"
+#define REF_TCELL "LD0/MET1.CellTemp.mag.f"
+
+/* ------------------------------------------------------------------------- */
+/* Configuration                                                             */
+/* ------------------------------------------------------------------------- */
+
+struct config {
+    const char* host;       // Modbus server (RPI#1 / emulator)
+    int port;
+    int unit;
+    int address;            // First of the 6 PV registers
+    int interval_ms;        // Pause between frames (0 = back to back)
+    int timeout_ms;         // Modbus response timeout
+    const char* backend;    // auto, io_uring, epoll, legacy
+    const char* mirror;
+    const char* historian;  // CSV appended per frame (NULL = off)
+    long frames;            // Stop after this many frames (0 = run forever)
+    int stats_s;            // Statistics interval (0 = off)
+    const char* relay;      // MMS relay (WITH_MMS only, NULL = no MMS writes)
+    int relay_port;
+};
+
+static struct config cfg = {
+    .host = "127.0.0.1",
+    .port = 1502,
+    .unit = 1,
+    .interval_ms = 200,
+    .timeout_ms = 1000,
+    .backend = "auto",
+    .mirror = "relay_mirror.json",
+    .stats_s = 5,
+    .relay_port = 102,
+};
+
+/* ------------------------------------------------------------------------- */
+/* State                                                                     */
+/* ------------------------------------------------------------------------- */
+
+static volatile sig_atomic_t running = 1;
+
+static struct {
+    unsigned long frames;
+    unsigned long errors;
+    unsigned long exceptions;
+    unsigned long mirror_skipped;   // Previous mirror write still in flight
+    unsigned long syscalls;         // Gateway's own (socket setup); the loop counts the rest
+    double latency_ms_sum;          // Request sent -> values decoded
+    double latency_ms_max;
+} stats;
+
+struct gateway {
+    struct ev_loop* loop;
+    int fd;
+    uint16_t tid;
+    uint8_t req[REQ_SIZE];
+    uint8_t resp[RESP_SIZE];
+    size_t resp_len;
+    uint64_t sent_ns;
+
+    struct ev_op send_op;
+    struct ev_op recv_op;
+    struct ev_timer cycle_timer;
+    struct ev_timer timeout_timer;
+    struct ev_timer stats_timer;
+
+    int mirror_fd;
+    int mirror_busy;
+    char mirror_buf[MIRROR_SIZE];
+    struct ev_op mirror_op;
+
+    // Historian: one buffer in flight, the other collects lines meanwhile
+    int hist_fd;
+    int hist_busy;
+    int hist_cur;
+    size_t hist_len[2];
+    char hist_buf[2][HIST_BUF];
+    struct ev_op hist_op;
+
+    unsigned long last_frames;
+    unsigned long last_syscalls;
+};
+
+#ifdef WITH_MMS
+static IedConnection mms_con;
+#endif
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static void iso_ts(char* buf, size_t n)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    struct tm tm;
+    localtime_r(&ts.tv_sec, &tm);
+    snprintf(buf, n, "%04d-%02d-%02dT%02d:%02d:%02d",
+             tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+             tm.tm_hour, tm.tm_min, tm.tm_sec);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Frame processing (shared by all modes)                                    */
+/* ------------------------------------------------------------------------- */
+
+static size_t build_request(uint8_t* req, uint16_t tid)
+{
+    req[0] = tid >> 8;
+    req[1] = tid & 0xFF;
+    req[2] = 0;
+    req[3] = 0;
+    req[4] = 0;
+    req[5] = 6;
+    req[6] = cfg.unit;
+    req[7] = 0x03;
+    req[8] = cfg.address >> 8;
+    req[9] = cfg.address & 0xFF;
+    req[10] = 0;
+    req[11] = REG_COUNT;
+    return REQ_SIZE;
+}
+
+/**
+ * Check an FC03 response and extract the values
+ * Returns 0, 1 for an exception response, -1 for a protocol error
+ */
+static int parse_response(const uint8_t* resp, size_t len, uint16_t tid, float* values)
+{
+    if (len < MBAP_SIZE + 2) return -1;
+    if (((resp[0] << 8) | resp[1]) != tid) return -1;
+    if (resp[7] & 0x80) return 1;
+    if (resp[7] != 0x03 || resp[8] != 2 * REG_COUNT || len < RESP_SIZE) return -1;
+
+    for (int i = 0; i < REG_COUNT; i++) {
+        uint16_t reg = (resp[9 + 2 * i] << 8) | resp[10 + 2 * i];
+        values[i] = reg / SCALE;
+    }
+    return 0;
+}
+
+#ifdef WITH_MMS
+/**
+ * The 6 MMS writes of one frame (blocking, on libiec61850's own socket)
+ */
+static int mms_write_frame(const float* v, char* emsg, size_t emsg_n)
+{
+    static const char* refs[REG_COUNT] = { REF_PAC, REF_PDC, REF_VDC, REF_IDC, REF_G, REF_TCELL };
+    IedClientError err = IED_ERROR_OK;
+
+    if (IedConnection_getState(mms_con) != IED_STATE_CONNECTED) {
+        IedConnection_connect(mms_con, &err, cfg.relay, cfg.relay_port);
+        if (err != IED_ERROR_OK) {
+            snprintf(emsg, emsg_n, "connect err=%d", err);
+            return 0;
+        }
+    }
+    for (int i = 0; i < REG_COUNT; i++) {
+        IedConnection_writeFloatValue(mms_con, &err, refs[i], IEC61850_FC_MX, v[i]);
+        if (err != IED_ERROR_OK) {
+            snprintf(emsg, emsg_n, "write %s FC=MX err=%d", refs[i], err);
+            return 0;
+        }
+    }
+    return 1;
+}
+#endif
+
+static int relay_write(const float* v, char* emsg, size_t emsg_n)
+{
+    emsg[0] = '\0';
+#ifdef WITH_MMS
+    if (cfg.relay) return mms_write_frame(v, emsg, emsg_n);
+#endif
+    (void)v;
+    snprintf(emsg, emsg_n, "no relay configured");
+    return 0;
+}
+
+static int format_mirror(char* buf, size_t n, const char* ts, int mms_ok, const char* mms_err,
+                         const float* v)
+{
+    return snprintf(buf, n,
+        "{\n"
+        "  \"ts\": \"%s\",\n"
+        "  \"mms_ok\": %s,\n"
+        "  \"mms_error\": \"%s\",\n"
+        "  \"P_ac_W\": %.3f,\n"
+        "  \"P_dc_W\": %.3f,\n"
+        "  \"V_dc_V\": %.3f,\n"
+        "  \"I_dc_A\": %.3f,\n"
+        "  \"G_poa_Wm2\": %.3f,\n"
+        "  \"T_cell_C\": %.3f\n"
+        "}\n",
+        ts, mms_ok ? "true" : "false", mms_err, v[0], v[1], v[2], v[3], v[4], v[5]);
+}
+
+static int format_historian(char* buf, size_t n, const char* ts, int mms_ok, const float* v)
+{
+    return snprintf(buf, n, "%s,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%d\n",
+                    ts, v[0], v[1], v[2], v[3], v[4], v[5], mms_ok);
+}
+
+static void record_latency(double ms)
+{
+    stats.frames++;
+    stats.latency_ms_sum += ms;
+    if (ms > stats.latency_ms_max) stats.latency_ms_max = ms;
+}
+
+static int connect_modbus(int nonblocking)
+{
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(cfg.port) };
+    if (inet_pton(AF_INET, cfg.host, &addr.sin_addr) != 1) {
+        fprintf(stderr, "invalid host %s\n", cfg.host);
+        return -1;
+    }
+
+    stats.syscalls += 3;
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        fprintf(stderr, "✗ Modbus connect %s:%d failed: %s\n", cfg.host, cfg.port, strerror(errno));
+        close(fd);
+        stats.syscalls++;
+        return -1;
+    }
+    if (nonblocking) {
+        stats.syscalls++;
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+    }
+    printf("✓ Modbus connected to %s:%d (unit %d)\n", cfg.host, cfg.port, cfg.unit);
+    return fd;
+}
+
+static void print_stats(const char* mode, unsigned long syscalls, unsigned long frames_delta,
+                        unsigned long syscalls_delta)
+{
+    printf("[STATS] %s | frames %lu | syscalls %lu (%.2f/frame, last interval %.2f/frame) | "
+           "latency avg %.3f ms max %.3f ms | errors %lu | exceptions %lu | mirror skipped %lu\n",
+           mode, stats.frames, syscalls,
+           stats.frames ? (double)syscalls / stats.frames : 0.0,
+           frames_delta ? (double)syscalls_delta / frames_delta : 0.0,
+           stats.frames ? stats.latency_ms_sum / stats.frames : 0.0, stats.latency_ms_max,
+           stats.errors, stats.exceptions, stats.mirror_skipped);
+    fflush(stdout);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Event loop gateway (io_uring / epoll)                                     */
+/* ------------------------------------------------------------------------- */
+
+static void on_cycle(struct ev_loop* loop, struct ev_timer* t);
+
+static unsigned long total_syscalls(struct gateway* gw)
+{
+    return ev_syscalls(gw->loop) + stats.syscalls;
+}
+
+static void drop_connection(struct gateway* gw)
+{
+    ev_timer_stop(gw->loop, &gw->timeout_timer);
+    ev_remove_fd(gw->loop, gw->fd);
+    close(gw->fd);
+    stats.syscalls++;
+    gw->fd = -1;
+    ev_timer_start(gw->loop, &gw->cycle_timer, RECONNECT_MS);
+}
+
+static void next_frame(struct gateway* gw)
+{
+    if (!running || (cfg.frames > 0 && stats.frames >= (unsigned long)cfg.frames)) {
+        ev_timer_stop(gw->loop, &gw->stats_timer);
+        ev_stop(gw->loop);
+        return;
+    }
+    ev_timer_start(gw->loop, &gw->cycle_timer, cfg.interval_ms);
+}
+
+static void on_mirror_written(struct ev_loop* loop, struct ev_op* op, int res)
+{
+    struct gateway* gw = op->arg;
+    gw->mirror_busy = 0;
+    if (res < 0) fprintf(stderr, "✗ mirror write failed: %s\n", strerror(-res));
+}
+
+static void flush_historian(struct gateway* gw)
+{
+    int cur = gw->hist_cur;
+    if (gw->hist_busy || gw->hist_len[cur] == 0) return;
+
+    // Append (offset -1 = file position, O_APPEND)
+    if (ev_pwrite(gw->loop, &gw->hist_op, gw->hist_fd, gw->hist_buf[cur], gw->hist_len[cur],
+                  -1, EV_LAZY) == 0) {
+        gw->hist_busy = 1;
+        gw->hist_cur = !cur;
+        gw->hist_len[gw->hist_cur] = 0;
+    }
+}
+
+static void on_historian_written(struct ev_loop* loop, struct ev_op* op, int res)
+{
+    struct gateway* gw = op->arg;
+    gw->hist_busy = 0;
+    if (res < 0) fprintf(stderr, "✗ historian write failed: %s\n", strerror(-res));
+    flush_historian(gw);
+}
+
+static void on_send_failed(struct ev_loop* loop, struct ev_op* op, int res)
+{
+    // The linked recv completes with -ECANCELED and drops the connection
+    fprintf(stderr, "✗ Modbus send failed: %s\n", strerror(-res));
+}
+
+static void on_response(struct ev_loop* loop, struct ev_op* op, int res)
+{
+    struct gateway* gw = op->arg;
+    float v[REG_COUNT];
+
+    if (res <= 0) {
+        stats.errors++;
+        fprintf(stderr, "✗ Modbus read failed: %s\n",
+                res < 0 ? strerror(-res) : "connection closed / timeout");
+        drop_connection(gw);
+        return;
+    }
+
+    // Usually one segment; an exception response is shorter than RESP_SIZE
+    gw->resp_len += res;
+    int exception = gw->resp_len >= MBAP_SIZE + 2 && (gw->resp[7] & 0x80);
+    if (!exception && gw->resp_len < RESP_SIZE) {
+        if (ev_recv(loop, &gw->recv_op, gw->fd, gw->resp + gw->resp_len,
+                    RESP_SIZE - gw->resp_len, 0) < 0) {
+            drop_connection(gw);
+        }
+        return;
+    }
+    ev_timer_stop(loop, &gw->timeout_timer);
+
+    int rc = parse_response(gw->resp, gw->resp_len, gw->tid, v);
+    if (rc != 0) {
+        if (rc > 0) {
+            stats.exceptions++;
+            next_frame(gw);
+        } else {
+            stats.errors++;
+            fprintf(stderr, "✗ invalid Modbus response\n");
+            drop_connection(gw);
+        }
+        return;
+    }
+    record_latency((ev_now_ns() - gw->sent_ns) / 1e6);
+
+    char ts[64];
+    char mms_err[256];
+    iso_ts(ts, sizeof(ts));
+    int mms_ok = relay_write(v, mms_err, sizeof(mms_err));
+
+    // Mirror: rewrite in place at offset 0, padded to a fixed size (valid JSON,
+    // no truncate/reopen per frame)
+    if (gw->mirror_busy) {
+        stats.mirror_skipped++;
+    } else {
+        int n = format_mirror(gw->mirror_buf, MIRROR_SIZE, ts, mms_ok, mms_err, v);
+        if (n > 0 && n < MIRROR_SIZE) {
+            memset(gw->mirror_buf + n - 1, ' ', MIRROR_SIZE - n);
+            gw->mirror_buf[MIRROR_SIZE - 1] = '\n';
+            if (ev_pwrite(loop, &gw->mirror_op, gw->mirror_fd, gw->mirror_buf, MIRROR_SIZE, 0,
+                          EV_LAZY) == 0) {
+                gw->mirror_busy = 1;
+            }
+        }
+    }
+
+    if (gw->hist_fd >= 0) {
+        int cur = gw->hist_cur;
+        size_t room = HIST_BUF - gw->hist_len[cur];
+        int n = format_historian(gw->hist_buf[cur] + gw->hist_len[cur], room, ts, mms_ok, v);
+        if (n > 0 && (size_t)n < room) gw->hist_len[cur] += n;
+        flush_historian(gw);
+    }
+
+    next_frame(gw);
+}
+
+static void on_timeout(struct ev_loop* loop, struct ev_timer* t)
+{
+    struct gateway* gw = t->arg;
+    // Ends the pending recv on both backends (completes with 0)
+    stats.syscalls++;
+    shutdown(gw->fd, SHUT_RDWR);
+}
+
+static void on_cycle(struct ev_loop* loop, struct ev_timer* t)
+{
+    struct gateway* gw = t->arg;
+
+    if (!running) {
+        next_frame(gw);
+        return;
+    }
+    if (gw->fd < 0) {
+        gw->fd = connect_modbus(1);
+        if (gw->fd < 0 || ev_add_fd(loop, gw->fd) < 0) {
+            if (gw->fd >= 0) close(gw->fd);
+            gw->fd = -1;
+            ev_timer_start(loop, &gw->cycle_timer, RECONNECT_MS);
+            return;
+        }
+    }
+
+    // Request and response go to the kernel together, with the next wait
+    gw->tid++;
+    build_request(gw->req, gw->tid);
+    gw->sent_ns = ev_now_ns();
+    gw->resp_len = 0;
+    if (ev_send(loop, &gw->send_op, gw->fd, gw->req, REQ_SIZE, EV_LINK | EV_QUIET) < 0 ||
+        ev_recv(loop, &gw->recv_op, gw->fd, gw->resp, RESP_SIZE, 0) < 0) {
+        fprintf(stderr, "✗ submit failed\n");
+        drop_connection(gw);
+        return;
+    }
+    ev_timer_start(loop, &gw->timeout_timer, cfg.timeout_ms);
+}
+
+static void on_stats(struct ev_loop* loop, struct ev_timer* t)
+{
+    struct gateway* gw = t->arg;
+    unsigned long sc = total_syscalls(gw);
+
+    print_stats(ev_backend_name(loop), sc, stats.frames - gw->last_frames, sc - gw->last_syscalls);
+    gw->last_frames = stats.frames;
+    gw->last_syscalls = sc;
+    ev_timer_start(loop, t, cfg.stats_s * 1000ULL);
+}
+
+static int run_event_loop(enum ev_backend backend)
+{
+    static struct gateway gw;
+
+    gw.loop = ev_loop_create(backend, 64);
+    if (!gw.loop) return 1;
+    gw.fd = -1;
+    gw.hist_fd = -1;
+
+    gw.mirror_fd = open(cfg.mirror, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (gw.mirror_fd < 0) {
+        fprintf(stderr, "cannot open %s: %s\n", cfg.mirror, strerror(errno));
+        return 1;
+    }
+    gw.send_op.cb = on_send_failed;
+    gw.send_op.arg = &gw;
+    gw.recv_op.cb = on_response;
+    gw.recv_op.arg = &gw;
+    gw.mirror_op.cb = on_mirror_written;
+    gw.mirror_op.arg = &gw;
+
+    if (cfg.historian) {
+        gw.hist_fd = open(cfg.historian, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (gw.hist_fd < 0) {
+            fprintf(stderr, "cannot open %s: %s\n", cfg.historian, strerror(errno));
+            return 1;
+        }
+        gw.hist_op.cb = on_historian_written;
+        gw.hist_op.arg = &gw;
+    }
+
+    gw.cycle_timer.cb = on_cycle;
+    gw.cycle_timer.arg = &gw;
+    gw.timeout_timer.cb = on_timeout;
+    gw.timeout_timer.arg = &gw;
+    gw.stats_timer.cb = on_stats;
+    gw.stats_timer.arg = &gw;
+
+    printf("Gateway running (%s):\n", ev_backend_name(gw.loop));
+    printf("  Modbus:    %s:%d (unit %d, registers %d-%d)\n",
+           cfg.host, cfg.port, cfg.unit, cfg.address, cfg.address + REG_COUNT - 1);
+    printf("  Mirror:    %s\n", cfg.mirror);
+    printf("  Historian: %s\n", cfg.historian ? cfg.historian : "off");
+    printf("  Interval:  %d ms\n", cfg.interval_ms);
+
+    ev_timer_start(gw.loop, &gw.cycle_timer, 0);
+    if (cfg.stats_s > 0) ev_timer_start(gw.loop, &gw.stats_timer, cfg.stats_s * 1000ULL);
+    ev_run(gw.loop);
+
+    // Let the last file writes complete
+    while (gw.mirror_busy || gw.hist_busy) {
+        if (ev_run_once(gw.loop) < 0) break;
+    }
+    print_stats(ev_backend_name(gw.loop), total_syscalls(&gw), 0, 0);
+
+    if (gw.fd >= 0) close(gw.fd);
+    close(gw.mirror_fd);
+    if (gw.hist_fd >= 0) close(gw.hist_fd);
+    ev_loop_destroy(gw.loop);
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Legacy loop (rpi2/shabnam_mms.c pattern, for comparison)                  */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * libmodbus-style receive step: select() for readability, then one recv()
+ */
+static int legacy_recv_step(int fd, uint8_t* buf, size_t len)
+{
+    size_t got = 0;
+    while (got < len) {
+        fd_set rset;
+        FD_ZERO(&rset);
+        FD_SET(fd, &rset);
+        struct timeval tv = { .tv_sec = cfg.timeout_ms / 1000, .tv_usec = (cfg.timeout_ms % 1000) * 1000 };
+        stats.syscalls++;
+        int rc = select(fd + 1, &rset, NULL, NULL, &tv);
+        if (rc <= 0) return -1;
+
+        stats.syscalls++;
+        ssize_t n = recv(fd, buf + got, len - got, 0);
+        if (n <= 0) return -1;
+        got += n;
+    }
+    return 0;
+}
+
+/**
+ * modbus_read_registers(): send, then header+function, byte count and data
+ * as separate select/recv steps
+ */
+static int legacy_read(int fd, uint16_t tid, uint8_t* resp)
+{
+    uint8_t req[REQ_SIZE];
+    build_request(req, tid);
+
+    stats.syscalls++;
+    if (send(fd, req, REQ_SIZE, MSG_NOSIGNAL) != REQ_SIZE) return -1;
+
+    if (legacy_recv_step(fd, resp, MBAP_SIZE + 1) < 0) return -1;
+    if (resp[7] & 0x80) {
+        return legacy_recv_step(fd, resp + 8, 1) < 0 ? -1 : MBAP_SIZE + 2;
+    }
+    if (legacy_recv_step(fd, resp + 8, 1) < 0) return -1;
+    if (resp[8] != 2 * REG_COUNT) return -1;
+    if (legacy_recv_step(fd, resp + 9, 2 * REG_COUNT) < 0) return -1;
+    return RESP_SIZE;
+}
+
+static int run_legacy(void)
+{
+    uint8_t resp[RESP_SIZE];
+    uint16_t tid = 0;
+    int fd = -1;
+    FILE* hist = NULL;
+    double last_stats = now_ms();
+    unsigned long last_frames = 0;
+    unsigned long last_syscalls = 0;
+
+    if (cfg.historian) {
+        hist = fopen(cfg.historian, "a");
+        if (!hist) {
+            fprintf(stderr, "cannot open %s: %s\n", cfg.historian, strerror(errno));
+            return 1;
+        }
+    }
+
+    printf("Gateway running (legacy loop):\n");
+    printf("  Modbus:    %s:%d (unit %d)\n", cfg.host, cfg.port, cfg.unit);
+    printf("  Mirror:    %s\n", cfg.mirror);
+    printf("  Historian: %s\n", cfg.historian ? cfg.historian : "off");
+
+    while (running && (cfg.frames == 0 || stats.frames < (unsigned long)cfg.frames)) {
+        if (fd < 0) {
+            fd = connect_modbus(0);
+            if (fd < 0) {
+                sleep(1);
+                continue;
+            }
+        }
+
+        double t0 = now_ms();
+        int len = legacy_read(fd, ++tid, resp);
+        float v[REG_COUNT];
+        int rc = len > 0 ? parse_response(resp, len, tid, v) : -1;
+        if (rc < 0) {
+            stats.errors++;
+            fprintf(stderr, "✗ Modbus read failed\n");
+            close(fd);
+            fd = -1;
+            stats.syscalls++;
+            sleep(1);
+            continue;
+        }
+        if (rc > 0) {
+            stats.exceptions++;
+        } else {
+            record_latency(now_ms() - t0);
+
+            char ts[64];
+            char mms_err[256];
+            iso_ts(ts, sizeof(ts));
+            int mms_ok = relay_write(v, mms_err, sizeof(mms_err));
+
+            // write_mirror(): openat, fstat (stdio buffer), write, close
+            char buf[MIRROR_SIZE];
+            FILE* f = fopen(cfg.mirror, "w");
+            if (f) {
+                format_mirror(buf, sizeof(buf), ts, mms_ok, mms_err, v);
+                fputs(buf, f);
+                fclose(f);
+                stats.syscalls += 4;
+            }
+            if (hist) {
+                format_historian(buf, sizeof(buf), ts, mms_ok, v);
+                fputs(buf, hist);
+                fflush(hist);
+                stats.syscalls++;
+            }
+        }
+
+        if (cfg.stats_s > 0 && now_ms() - last_stats >= cfg.stats_s * 1000.0) {
+            print_stats("legacy", stats.syscalls, stats.frames - last_frames,
+                        stats.syscalls - last_syscalls);
+            last_stats = now_ms();
+            last_frames = stats.frames;
+            last_syscalls = stats.syscalls;
+        }
+
+        stats.syscalls++;
+        usleep(cfg.interval_ms * 1000);
+    }
+
+    print_stats("legacy", stats.syscalls, 0, 0);
+    if (fd >= 0) close(fd);
+    if (hist) fclose(hist);
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Main                                                                      */
+/* ------------------------------------------------------------------------- */
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    running = 0;
+}
+
+static void usage(const char* prog)
+{
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  -h HOST     Modbus server (default 127.0.0.1)\n"
+        "  -p PORT     Modbus port (default 1502)\n"
+        "  -u UNIT     Unit id (default 1)\n"
+        "  -a ADDR     First PV register (default 0)\n"
+        "  -i MS       Pause between frames (default 200, 0 = back to back)\n"
+        "  -t MS       Modbus response timeout (default 1000)\n"
+        "  -b BACKEND  auto, io_uring, epoll or legacy (default auto)\n"
+        "  -m FILE     Mirror file (default relay_mirror.json)\n"
+        "  -H FILE     Historian CSV, one line per frame (default off)\n"
+        "  -n FRAMES   Stop after FRAMES frames (default 0 = forever)\n"
+        "  -s SECONDS  Statistics interval (default 5, 0 = only at exit)\n"
+#ifdef WITH_MMS
+        "  -r IP       MMS relay (default off)\n"
+        "  -R PORT     MMS port (default 102)\n"
+#endif
+        , prog);
+}
+
+int main(int argc, char** argv)
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "h:p:u:a:i:t:b:m:H:n:s:r:R:")) != -1) {
+        switch (opt) {
+        case 'h': cfg.host = optarg; break;
+        case 'p': cfg.port = atoi(optarg); break;
+        case 'u': cfg.unit = atoi(optarg); break;
+        case 'a': cfg.address = atoi(optarg); break;
+        case 'i': cfg.interval_ms = atoi(optarg); break;
+        case 't': cfg.timeout_ms = atoi(optarg); break;
+        case 'b': cfg.backend = optarg; break;
+        case 'm': cfg.mirror = optarg; break;
+        case 'H': cfg.historian = optarg; break;
+        case 'n': cfg.frames = atol(optarg); break;
+        case 's': cfg.stats_s = atoi(optarg); break;
+        case 'r': cfg.relay = optarg; break;
+        case 'R': cfg.relay_port = atoi(optarg); break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+
+#ifdef WITH_MMS
+    if (cfg.relay) mms_con = IedConnection_create();
+#endif
+
+    int rc;
+    if (strcmp(cfg.backend, "legacy") == 0) {
+        rc = run_legacy();
+    } else if (strcmp(cfg.backend, "io_uring") == 0) {
+        rc = run_event_loop(EV_BACKEND_IO_URING);
+    } else if (strcmp(cfg.backend, "epoll") == 0) {
+        rc = run_event_loop(EV_BACKEND_EPOLL);
+    } else if (strcmp(cfg.backend, "auto") == 0) {
+        rc = run_event_loop(EV_BACKEND_AUTO);
+    } else {
+        usage(argv[0]);
+        return 1;
+    }
+
+#ifdef WITH_MMS
+    if (mms_con) IedConnection_destroy(mms_con);
+#endif
+    return rc;
+}
@@ -0,0 +1,763 @@
+// Sharded native Modbus TCP server (one epoll loop per core, SO_REUSEPORT)
+//
+// Native replacement for the register-store role of the Python servers (RPI#1
+// smart meter server, RPI#2 local server): a holding register bank that
+// clients write (FC06/FC16) and read (FC03/FC04). Each shard is a thread
+// pinned to one CPU with its own epoll loop and its own listening socket; all
+// listeners share the port through SO_REUSEPORT, so the kernel spreads
+// connections over the shards and a connection stays on its shard. With -C a
+// classic BPF program picks the shard of the CPU that received the SYN.
+//
+// The register bank is an RCU snapshot: readers on any shard load one pointer
+// and never lock or write shared memory; writers copy the pages they change,
+// publish a new snapshot and free the old one after every shard has passed a
+// quiescent state (QSBR).
+//
+// Connections, snapshots and register pages come from slab pools (slab.c)
+// with per-shard caches: once the server has seen its peak number of
+// connections, neither accepts nor writes allocate. [STATS] shows the slab
+// count, which stays flat in steady state.
+//
+// Build:
+//   gcc -O2 -Wall -pthread -o modbus_server modbus_server.c slab.c
+//
+// Run:
+//   ./modbus_server -p 1502 -n 1000              (one shard per online CPU)
+//   ./modbus_server -p 1502 -w 4 -C              (4 shards, CPU steering)
+//   ./modbus_loadgen -p 1502 -t 4 -c 64 -d 8 -s 10
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <signal.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <linux/filter.h>
+
+#include "slab.h"
+
+#ifndef SO_ATTACH_REUSEPORT_CBPF
+#define SO_ATTACH_REUSEPORT_CBPF 51
+#endif
+
+#define MAX_SHARDS      256
+#define MAX_CONNS       4096    // Per shard
+#define MAX_EVENTS      256
+#define MAX_REGISTERS   65536
+#define PAGE_REGS       64      // Registers per RCU page
+#define MBAP_SIZE       7
+#define MAX_ADU         260
+#define RBUF_SIZE       4096
+#define WBUF_SIZE       16384
+
+#define FC_READ_HOLDING     0x03
+#define FC_READ_INPUT       0x04
+#define FC_WRITE_SINGLE     0x06
+#define FC_WRITE_MULTIPLE   0x10
+
+#define EX_ILLEGAL_FUNCTION     0x01
+#define EX_ILLEGAL_ADDRESS      0x02
+#define EX_ILLEGAL_VALUE        0x03
+
+#define TAG_LISTEN      MAX_CONNS
+#define QS_OFFLINE      UINT64_MAX
+
+// FC16 writes at most 123 registers: 3 pages
+#define MAX_WRITE_PAGES ((123 + PAGE_REGS - 2) / PAGE_REGS + 1)
+
+/* ------------------------------------------------------------------------- */
+/* Configuration                                                             */
+/* ------------------------------------------------------------------------- */
+
+struct config {
+    int port;
+    int shards;             // 0 = one per online CPU
+    int first_cpu;          // Shard i runs on CPU (first_cpu + i) % CPUs (-1 = no pinning)
+    int cpu_steering;       // SO_ATTACH_REUSEPORT_CBPF: shard = receiving CPU % shards
+    int unit;               // Answer only this unit id (0 = any)
+    int registers;
+    int stats_s;
+};
+
+static struct config cfg = {
+    .port = 1502,
+    .first_cpu = 0,
+    .registers = 100,
+    .stats_s = 5,
+};
+
+/* ------------------------------------------------------------------------- */
+/* RCU register bank                                                         */
+/* ------------------------------------------------------------------------- */
+
+struct reg_page {
+    uint16_t r[PAGE_REGS];
+};
+
+struct snapshot {
+    uint64_t version;
+    // Set when the snapshot is replaced
+    uint64_t retire_seq;
+    struct snapshot* retired_next;
+    int nreplaced;
+    struct reg_page* replaced[MAX_WRITE_PAGES];     // Pages the successor copied
+    struct reg_page* pages[];
+};
+
+static struct snapshot* bank;           // Current snapshot (RCU pointer)
+static uint64_t gp_seq;                 // Grace period counter, bumped per retire
+static pthread_mutex_t write_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct snapshot* retired;        // Waiting for a grace period (write_lock)
+static int retired_count;
+static int npages;
+static struct slab_pool snap_pool;      // Allocated by writers, freed by whichever shard reclaims
+static struct slab_pool page_pool;
+
+/* ------------------------------------------------------------------------- */
+/* Shards                                                                    */
+/* ------------------------------------------------------------------------- */
+
+struct conn {
+    int fd;
+    size_t rlen;
+    size_t wlen;
+    uint8_t rbuf[RBUF_SIZE];
+    uint8_t wbuf[WBUF_SIZE];
+};
+
+struct shard_stats {
+    uint64_t requests;
+    uint64_t writes;
+    uint64_t exceptions;
+    uint64_t accepted;
+    int active;
+};
+
+struct shard {
+    int id;
+    int cpu;
+    int epfd;
+    int lfd;
+    pthread_t thread;
+    struct conn* conns[MAX_CONNS];
+    int free_slots[MAX_CONNS];
+    int nfree;
+    struct shard_stats st;          // Owner thread only
+    // Read by other threads
+    uint64_t qs __attribute__((aligned(64)));  // gp_seq at the last quiescent state
+    struct shard_stats pub;         // st, published once per loop iteration
+} __attribute__((aligned(64)));
+
+static struct shard* shards;
+static int nshards;
+static struct slab_pool conn_pool;
+static volatile sig_atomic_t running = 1;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static struct snapshot* snapshot_alloc(void)
+{
+    struct snapshot* s = slab_alloc(&snap_pool);
+    if (!s) {
+        perror("slab_alloc");
+        exit(1);
+    }
+    s->nreplaced = 0;
+    s->retired_next = NULL;
+    return s;
+}
+
+static struct reg_page* page_alloc(void)
+{
+    struct reg_page* page = slab_alloc(&page_pool);
+    if (!page) {
+        perror("slab_alloc");
+        exit(1);
+    }
+    return page;
+}
+
+static void bank_init(void)
+{
+    npages = (cfg.registers + PAGE_REGS - 1) / PAGE_REGS;
+    slab_pool_init(&snap_pool, "snapshot", sizeof(struct snapshot) + npages * sizeof(struct reg_page*), 64);
+    slab_pool_init(&page_pool, "page", sizeof(struct reg_page), 256);
+
+    struct snapshot* s = snapshot_alloc();
+    s->version = 0;
+    for (int i = 0; i < npages; i++) {
+        s->pages[i] = page_alloc();
+        memset(s->pages[i], 0, sizeof(struct reg_page));
+    }
+    __atomic_store_n(&bank, s, __ATOMIC_RELEASE);
+}
+
+/**
+ * Read side: valid until the shard's next quiescent state
+ */
+static inline const struct snapshot* bank_read(void)
+{
+    return __atomic_load_n(&bank, __ATOMIC_ACQUIRE);
+}
+
+static inline uint16_t snap_reg(const struct snapshot* s, unsigned addr)
+{
+    return s->pages[addr / PAGE_REGS]->r[addr % PAGE_REGS];
+}
+
+/**
+ * Free retired snapshots (and the pages their successors replaced) that no
+ * shard can still see. Caller holds write_lock.
+ */
+static void reclaim(void)
+{
+    uint64_t min_qs = QS_OFFLINE;
+    for (int i = 0; i < nshards; i++) {
+        uint64_t qs = __atomic_load_n(&shards[i].qs, __ATOMIC_SEQ_CST);
+        if (qs < min_qs) min_qs = qs;
+    }
+
+    struct snapshot** p = &retired;
+    while (*p) {
+        struct snapshot* s = *p;
+        if (s->retire_seq <= min_qs) {
+            *p = s->retired_next;
+            for (int i = 0; i < s->nreplaced; i++) slab_free(&page_pool, s->replaced[i]);
+            slab_free(&snap_pool, s);
+            __atomic_store_n(&retired_count, retired_count - 1, __ATOMIC_RELAXED);
+        } else {
+            p = &s->retired_next;
+        }
+    }
+}
+
+/**
+ * Write side: copy the table and the touched pages, publish, retire the old snapshot
+ * values: big-endian register values (as in the PDU)
+ */
+static void bank_write(unsigned addr, const uint8_t* values, int count)
+{
+    pthread_mutex_lock(&write_lock);
+
+    struct snapshot* old = bank;    // Only writers change it, under write_lock
+    struct snapshot* s = snapshot_alloc();
+    s->version = old->version + 1;
+    memcpy(s->pages, old->pages, npages * sizeof(struct reg_page*));
+
+    for (unsigned p = addr / PAGE_REGS; p <= (addr + count - 1) / PAGE_REGS; p++) {
+        struct reg_page* page = page_alloc();
+        memcpy(page, old->pages[p], sizeof(*page));
+        old->replaced[old->nreplaced++] = old->pages[p];
+        s->pages[p] = page;
+    }
+    for (int i = 0; i < count; i++) {
+        unsigned a = addr + i;
+        s->pages[a / PAGE_REGS]->r[a % PAGE_REGS] = (values[2 * i] << 8) | values[2 * i + 1];
+    }
+
+    // Publish, then start the grace period (seq_cst: a shard that sees the new
+    // gp_seq at its quiescent state also sees the new snapshot)
+    __atomic_store_n(&bank, s, __ATOMIC_SEQ_CST);
+    old->retire_seq = __atomic_add_fetch(&gp_seq, 1, __ATOMIC_SEQ_CST);
+    old->retired_next = retired;
+    retired = old;
+    __atomic_store_n(&retired_count, retired_count + 1, __ATOMIC_RELAXED);
+    reclaim();
+
+    pthread_mutex_unlock(&write_lock);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Modbus request handling                                                   */
+/* ------------------------------------------------------------------------- */
+
+static size_t exception_adu(struct shard* sh, const uint8_t* req, uint8_t* resp, uint8_t code)
+{
+    memcpy(resp, req, MBAP_SIZE);
+    resp[4] = 0;
+    resp[5] = 3;
+    resp[7] = req[7] | 0x80;
+    resp[8] = code;
+    sh->st.exceptions++;
+    return MBAP_SIZE + 2;
+}
+
+/**
+ * Build the response ADU for one request (0 = no response)
+ */
+static size_t handle_request(struct shard* sh, const uint8_t* req, size_t len, uint8_t* resp)
+{
+    uint8_t fc = req[7];
+    const uint8_t* pdu = req + MBAP_SIZE;
+    size_t pdu_len = len - MBAP_SIZE;
+
+    if (cfg.unit && req[6] != cfg.unit) {
+        return 0;
+    }
+
+    memcpy(resp, req, MBAP_SIZE);
+    resp[7] = fc;
+
+    switch (fc) {
+    case FC_READ_HOLDING:
+    case FC_READ_INPUT: {
+        if (pdu_len < 5) return exception_adu(sh, req, resp, EX_ILLEGAL_VALUE);
+        uint16_t addr = (pdu[1] << 8) | pdu[2];
+        uint16_t count = (pdu[3] << 8) | pdu[4];
+        if (count < 1 || count > 125) return exception_adu(sh, req, resp, EX_ILLEGAL_VALUE);
+        if (addr + count > cfg.registers) return exception_adu(sh, req, resp, EX_ILLEGAL_ADDRESS);
+
+        // One snapshot per request: a concurrent FC16 is seen entirely or not at all
+        const struct snapshot* s = bank_read();
+        resp[8] = 2 * count;
+        for (int i = 0; i < count; i++) {
+            uint16_t v = snap_reg(s, addr + i);
+            resp[9 + 2 * i] = v >> 8;
+            resp[10 + 2 * i] = v & 0xFF;
+        }
+        resp[4] = 0;
+        resp[5] = 3 + 2 * count;
+        return MBAP_SIZE + 2 + 2 * count;
+    }
+    case FC_WRITE_SINGLE: {
+        if (pdu_len < 5) return exception_adu(sh, req, resp, EX_ILLEGAL_VALUE);
+        uint16_t addr = (pdu[1] << 8) | pdu[2];
+        if (addr >= cfg.registers) return exception_adu(sh, req, resp, EX_ILLEGAL_ADDRESS);
+
+        bank_write(addr, pdu + 3, 1);
+        sh->st.writes++;
+        memcpy(resp + 8, pdu + 1, 4);
+        resp[4] = 0;
+        resp[5] = 6;
+        return MBAP_SIZE + 5;
+    }
+    case FC_WRITE_MULTIPLE: {
+        if (pdu_len < 6) return exception_adu(sh, req, resp, EX_ILLEGAL_VALUE);
+        uint16_t addr = (pdu[1] << 8) | pdu[2];
+        uint16_t count = (pdu[3] << 8) | pdu[4];
+        if (count < 1 || count > 123 || pdu[5] != 2 * count || pdu_len < 6u + 2 * count)
+            return exception_adu(sh, req, resp, EX_ILLEGAL_VALUE);
+        if (addr + count > cfg.registers) return exception_adu(sh, req, resp, EX_ILLEGAL_ADDRESS);
+
+        bank_write(addr, pdu + 6, count);
+        sh->st.writes++;
+        memcpy(resp + 8, pdu + 1, 4);
+        resp[4] = 0;
+        resp[5] = 6;
+        return MBAP_SIZE + 5;
+    }
+    default:
+        return exception_adu(sh, req, resp, EX_ILLEGAL_FUNCTION);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/* Connections (per shard, no shared state)                                  */
+/* ------------------------------------------------------------------------- */
+
+static void set_events(struct shard* sh, int slot, uint32_t events)
+{
+    struct epoll_event ev = { .events = events, .data.u32 = slot };
+    epoll_ctl(sh->epfd, EPOLL_CTL_MOD, sh->conns[slot]->fd, &ev);
+}
+
+static void close_conn(struct shard* sh, int slot)
+{
+    struct conn* c = sh->conns[slot];
+    if (!c) return;
+
+    epoll_ctl(sh->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    slab_free(&conn_pool, c);
+    sh->conns[slot] = NULL;
+    sh->free_slots[sh->nfree++] = slot;
+    sh->st.active--;
+}
+
+/**
+ * Send as much of wbuf as the socket takes; EPOLLOUT while data remains
+ */
+static int flush_conn(struct shard* sh, int slot)
+{
+    struct conn* c = sh->conns[slot];
+    size_t off = 0;
+
+    while (off < c->wlen) {
+        ssize_t n = write(c->fd, c->wbuf + off, c->wlen - off);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EINTR) break;
+            return -1;
+        }
+        off += n;
+    }
+
+    if (off > 0) {
+        memmove(c->wbuf, c->wbuf + off, c->wlen - off);
+        c->wlen -= off;
+    }
+    if (c->wlen) set_events(sh, slot, EPOLLIN | EPOLLOUT);
+    return 0;
+}
+
+/**
+ * Split the receive buffer into ADUs and answer them (MBAP length framing)
+ */
+static int process_rbuf(struct shard* sh, int slot)
+{
+    struct conn* c = sh->conns[slot];
+    size_t off = 0;
+
+    while (c->rlen - off >= MBAP_SIZE + 1 && c->wlen <= WBUF_SIZE - MAX_ADU) {
+        const uint8_t* adu = c->rbuf + off;
+        size_t len = 6 + ((adu[4] << 8) | adu[5]);
+        if (len < MBAP_SIZE + 1 || len > MAX_ADU || adu[2] || adu[3]) {
+            return -1;  // Not Modbus/TCP
+        }
+        if (c->rlen - off < len) break;
+
+        sh->st.requests++;
+        c->wlen += handle_request(sh, adu, len, c->wbuf + c->wlen);
+        off += len;
+    }
+
+    memmove(c->rbuf, c->rbuf + off, c->rlen - off);
+    c->rlen -= off;
+    return 0;
+}
+
+static void on_readable(struct shard* sh, int slot)
+{
+    struct conn* c = sh->conns[slot];
+
+    for (;;) {
+        if (process_rbuf(sh, slot) < 0) {
+            close_conn(sh, slot);
+            return;
+        }
+
+        // Backpressure: stop reading until EPOLLOUT drains the transmit buffer
+        if (c->wlen > WBUF_SIZE - MAX_ADU) {
+            if (flush_conn(sh, slot) < 0) {
+                close_conn(sh, slot);
+                return;
+            }
+            if (c->wlen > WBUF_SIZE - MAX_ADU) {
+                set_events(sh, slot, EPOLLOUT);
+                return;
+            }
+            continue;
+        }
+
+        size_t room = RBUF_SIZE - c->rlen;
+        ssize_t n = read(c->fd, c->rbuf + c->rlen, room);
+        if (n == 0) { close_conn(sh, slot); return; }
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EINTR) break;
+            close_conn(sh, slot);
+            return;
+        }
+        c->rlen += n;
+        // Short read: the socket is drained, answer without another read()
+        // (level-triggered: anything arriving meanwhile raises EPOLLIN again)
+        if ((size_t)n < room) {
+            if (process_rbuf(sh, slot) < 0) {
+                close_conn(sh, slot);
+                return;
+            }
+            if (c->wlen <= WBUF_SIZE - MAX_ADU) break;
+        }
+    }
+
+    if (c->wlen && flush_conn(sh, slot) < 0) close_conn(sh, slot);
+}
+
+static void on_accept(struct shard* sh)
+{
+    for (;;) {
+        int fd = accept4(sh->lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;
+
+        struct conn* c = sh->nfree ? slab_alloc(&conn_pool) : NULL;
+        if (!c) { close(fd); continue; }
+
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        int slot = sh->free_slots[--sh->nfree];
+        c->fd = fd;
+        c->rlen = c->wlen = 0;
+        sh->conns[slot] = c;
+
+        struct epoll_event ev = { .events = EPOLLIN, .data.u32 = slot };
+        epoll_ctl(sh->epfd, EPOLL_CTL_ADD, fd, &ev);
+        sh->st.accepted++;
+        sh->st.active++;
+    }
+}
+
+static void publish_stats(struct shard* sh)
+{
+    __atomic_store_n(&sh->pub.requests, sh->st.requests, __ATOMIC_RELAXED);
+    __atomic_store_n(&sh->pub.writes, sh->st.writes, __ATOMIC_RELAXED);
+    __atomic_store_n(&sh->pub.exceptions, sh->st.exceptions, __ATOMIC_RELAXED);
+    __atomic_store_n(&sh->pub.accepted, sh->st.accepted, __ATOMIC_RELAXED);
+    __atomic_store_n(&sh->pub.active, sh->st.active, __ATOMIC_RELAXED);
+}
+
+static void* shard_main(void* arg)
+{
+    struct shard* sh = arg;
+    struct epoll_event events[MAX_EVENTS];
+
+    if (sh->cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(sh->cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+            fprintf(stderr, "shard %d: cannot pin to CPU %d\n", sh->id, sh->cpu);
+        }
+    }
+
+    while (__atomic_load_n(&running, __ATOMIC_RELAXED)) {
+        // Extended quiescent state: no snapshot references while blocked
+        __atomic_store_n(&sh->qs, QS_OFFLINE, __ATOMIC_RELEASE);
+        int n = epoll_wait(sh->epfd, events, MAX_EVENTS, 500);
+        __atomic_store_n(&sh->qs, __atomic_load_n(&gp_seq, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+
+        for (int i = 0; i < n; i++) {
+            uint32_t tag = events[i].data.u32;
+            if (tag == TAG_LISTEN) { on_accept(sh); continue; }
+
+            if (!sh->conns[tag]) continue;
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                on_readable(sh, tag);
+            } else if (events[i].events & EPOLLOUT) {
+                // Drained: back to EPOLLIN only, continue with buffered requests
+                if (flush_conn(sh, tag) < 0) {
+                    close_conn(sh, tag);
+                } else if (sh->conns[tag]->wlen == 0) {
+                    set_events(sh, tag, EPOLLIN);
+                    on_readable(sh, tag);
+                }
+            }
+        }
+        publish_stats(sh);
+
+        // Nothing held here: help reclaim if writers left snapshots behind
+        if (__atomic_load_n(&retired_count, __ATOMIC_RELAXED) > 0 &&
+            pthread_mutex_trylock(&write_lock) == 0) {
+            reclaim();
+            pthread_mutex_unlock(&write_lock);
+        }
+    }
+
+    __atomic_store_n(&sh->qs, QS_OFFLINE, __ATOMIC_RELEASE);
+    for (int i = 0; i < MAX_CONNS; i++) close_conn(sh, i);
+    publish_stats(sh);
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Setup                                                                     */
+/* ------------------------------------------------------------------------- */
+
+static int listen_reuseport(int port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(port),
+                                .sin_addr.s_addr = htonl(INADDR_ANY) };
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 1024) < 0) {
+        fprintf(stderr, "listen on port %d failed: %s\n", port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Connection -> shard of the CPU that handled the SYN (listeners are indexed
+ * in bind order, i.e. by shard id)
+ */
+static int attach_cpu_steering(int fd)
+{
+    struct sock_filter code[] = {
+        { BPF_LD | BPF_W | BPF_ABS, 0, 0, (uint32_t)(SKF_AD_OFF + SKF_AD_CPU) },
+        { BPF_ALU | BPF_MOD | BPF_K, 0, 0, (uint32_t)nshards },
+        { BPF_RET | BPF_A, 0, 0, 0 },
+    };
+    struct sock_fprog prog = { .len = sizeof(code) / sizeof(code[0]), .filter = code };
+    return setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog));
+}
+
+static void print_stats(double interval_s, uint64_t* prev)
+{
+    uint64_t total = 0, writes = 0, exceptions = 0, accepted = 0;
+    int active = 0;
+    uint64_t version;
+    int pending;
+    char per_shard[1024];
+    size_t off = 0;
+    static uint64_t prev_slabs;
+
+    for (int i = 0; i < nshards; i++) {
+        struct shard* sh = &shards[i];
+        uint64_t req = __atomic_load_n(&sh->pub.requests, __ATOMIC_RELAXED);
+        if (off < sizeof(per_shard) - 32) {
+            off += snprintf(per_shard + off, sizeof(per_shard) - off, "%s%d:%.0f",
+                            i ? " " : "", i, (req - prev[i]) / interval_s);
+        }
+        total += req - prev[i];
+        prev[i] = req;
+        writes += __atomic_load_n(&sh->pub.writes, __ATOMIC_RELAXED);
+        exceptions += __atomic_load_n(&sh->pub.exceptions, __ATOMIC_RELAXED);
+        accepted += __atomic_load_n(&sh->pub.accepted, __ATOMIC_RELAXED);
+        active += __atomic_load_n(&sh->pub.active, __ATOMIC_RELAXED);
+    }
+
+    // Not an RCU reader: the snapshot may only be dereferenced under write_lock here
+    pthread_mutex_lock(&write_lock);
+    version = bank->version;
+    pending = retired_count;
+    pthread_mutex_unlock(&write_lock);
+
+    // Slabs are the only heap allocations after startup: +0 in steady state
+    uint64_t slabs = slab_total_slabs();
+    fprintf(stderr,
+            "[STATS] %.0f req/s | shards %s | conns %d (accepted %llu) | writes %llu "
+            "(snapshot v%llu, retired %d) | exceptions %llu | slabs %llu (+%llu)\n",
+            total / interval_s, per_shard, active, (unsigned long long)accepted,
+            (unsigned long long)writes, (unsigned long long)version, pending,
+            (unsigned long long)exceptions, (unsigned long long)slabs,
+            (unsigned long long)(slabs - prev_slabs));
+    prev_slabs = slabs;
+}
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    __atomic_store_n(&running, 0, __ATOMIC_RELAXED);
+}
+
+static void usage(const char* prog)
+{
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  -p PORT        Modbus TCP port (default 1502)\n"
+        "  -w SHARDS      event loop threads (default: one per online CPU)\n"
+        "  -c CPU         pin shard i to CPU (CPU + i) %% CPUs (default 0, -1 = no pinning)\n"
+        "  -C             steer connections to the shard of the receiving CPU (CBPF)\n"
+        "  -u UNIT        answer only this unit id (default: any)\n"
+        "  -n COUNT       number of registers (default 100)\n"
+        "  -i SECONDS     statistics interval (default 5, 0 = off)\n",
+        prog);
+}
+
+int main(int argc, char** argv)
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "p:w:c:Cu:n:i:h")) != -1) {
+        switch (opt) {
+        case 'p': cfg.port = atoi(optarg); break;
+        case 'w': cfg.shards = atoi(optarg); break;
+        case 'c': cfg.first_cpu = atoi(optarg); break;
+        case 'C': cfg.cpu_steering = 1; break;
+        case 'u': cfg.unit = atoi(optarg); break;
+        case 'n': cfg.registers = atoi(optarg); break;
+        case 'i': cfg.stats_s = atoi(optarg); break;
+        default: usage(argv[0]); return 1;
+        }
+    }
+
+    int cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    nshards = cfg.shards > 0 ? cfg.shards : cpus;
+    if (nshards > MAX_SHARDS) nshards = MAX_SHARDS;
+    if (cfg.registers < 1 || cfg.registers > MAX_REGISTERS) {
+        fprintf(stderr, "register count must be 1..%d\n", MAX_REGISTERS);
+        return 1;
+    }
+
+    bank_init();
+    slab_pool_init(&conn_pool, "conn", sizeof(struct conn), 16);
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    shards = aligned_alloc(64, nshards * sizeof(*shards));
+    memset(shards, 0, nshards * sizeof(*shards));
+
+    // All listeners join the SO_REUSEPORT group before any shard accepts
+    for (int i = 0; i < nshards; i++) {
+        struct shard* sh = &shards[i];
+        sh->id = i;
+        sh->cpu = cfg.first_cpu >= 0 ? (cfg.first_cpu + i) % cpus : -1;
+        sh->qs = QS_OFFLINE;
+        for (int s = 0; s < MAX_CONNS; s++) sh->free_slots[s] = MAX_CONNS - 1 - s;
+        sh->nfree = MAX_CONNS;
+        if ((sh->lfd = listen_reuseport(cfg.port)) < 0) return 1;
+
+        sh->epfd = epoll_create1(EPOLL_CLOEXEC);
+        struct epoll_event ev = { .events = EPOLLIN, .data.u32 = TAG_LISTEN };
+        epoll_ctl(sh->epfd, EPOLL_CTL_ADD, sh->lfd, &ev);
+    }
+    if (cfg.cpu_steering && attach_cpu_steering(shards[0].lfd) < 0) {
+        fprintf(stderr, "CPU steering not available (%s), using the kernel's hash\n", strerror(errno));
+    }
+
+    fprintf(stderr, "Modbus server: tcp %d, %d shards (%d CPUs%s), %d registers, unit %s\n",
+            cfg.port, nshards, cpus, cfg.cpu_steering ? ", CPU steering" : "",
+            cfg.registers, cfg.unit ? "fixed" : "any");
+
+    for (int i = 0; i < nshards; i++) {
+        pthread_create(&shards[i].thread, NULL, shard_main, &shards[i]);
+    }
+
+    uint64_t* prev = calloc(nshards, sizeof(uint64_t));
+    uint64_t last = now_ns();
+    while (__atomic_load_n(&running, __ATOMIC_RELAXED)) {
+        usleep(100 * 1000);
+        if (cfg.stats_s && now_ns() - last >= (uint64_t)cfg.stats_s * 1000000000ULL) {
+            uint64_t now = now_ns();
+            print_stats((now - last) / 1e9, prev);
+            last = now;
+        }
+    }
+
+    uint64_t requests = 0, accepted = 0;
+    for (int i = 0; i < nshards; i++) {
+        pthread_join(shards[i].thread, NULL);
+        close(shards[i].lfd);
+        close(shards[i].epfd);
+        requests += shards[i].pub.requests;
+        accepted += shards[i].pub.accepted;
+    }
+    struct slab_stats cs, ss, ps;
+    slab_pool_stats(&conn_pool, &cs);
+    slab_pool_stats(&snap_pool, &ss);
+    slab_pool_stats(&page_pool, &ps);
+    fprintf(stderr, "Shutdown: %llu requests, %llu accepted connections | slabs: conn %llu (%llu KB), "
+            "snapshot %llu, page %llu\n",
+            (unsigned long long)requests, (unsigned long long)accepted,
+            (unsigned long long)cs.slabs, (unsigned long long)(cs.bytes / 1024),
+            (unsigned long long)ss.slabs, (unsigned long long)ps.slabs);
+    return 0;
+}
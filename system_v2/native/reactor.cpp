@@ -0,0 +1,129 @@
+// C++20 coroutines on top of event_loop.c (see reactor.h)
+//
+// Compiled into the tools that use it, e.g.:
+//   gcc -O2 -Wall -c event_loop.c timer_wheel.c
+//   g++ -std=c++20 -O2 -Wall -o modbus_client_bench modbus_client_bench.cpp modbus_client.cpp reactor.cpp event_loop.o timer_wheel.o -lssl -lcrypto
+
+#include "reactor.h"
+
+#include <cstdlib>
+
+namespace modbus {
+
+/* ------------------------------------------------------------------------- */
+/* Coroutine frame pool                                                      */
+/* ------------------------------------------------------------------------- */
+
+namespace {
+
+struct FreeBlock {
+    FreeBlock* next;
+};
+
+struct ThreadPool {
+    FreeBlock* free[FramePool::kClasses] = {};
+    FramePool::Stats stats = {};
+};
+
+thread_local ThreadPool tls_pool;
+
+/**
+ * Size class of a frame (kClasses = too large for a block)
+ */
+size_t size_class(size_t size) {
+    size_t block = FramePool::kMinBlock;
+    for (size_t c = 0; c < FramePool::kClasses; c++, block *= 2) {
+        if (size <= block) return c;
+    }
+    return FramePool::kClasses;
+}
+
+}  // namespace
+
+void* FramePool::allocate(size_t size) {
+    ThreadPool& pool = tls_pool;
+    size_t c = size_class(size);
+    if (c == kClasses) {
+        pool.stats.heap_frames++;
+        return ::operator new(size);
+    }
+
+    if (!pool.free[c]) {
+        // Refill: one slab, carved into blocks (never returned to the system)
+        size_t block = kMinBlock << c;
+        char* slab = static_cast<char*>(std::aligned_alloc(64, block * kBlocksPerSlab));
+        if (!slab) throw std::bad_alloc();
+        for (size_t i = kBlocksPerSlab; i-- > 0;) {
+            FreeBlock* b = reinterpret_cast<FreeBlock*>(slab + i * block);
+            b->next = pool.free[c];
+            pool.free[c] = b;
+        }
+        pool.stats.slabs++;
+    }
+
+    FreeBlock* b = pool.free[c];
+    pool.free[c] = b->next;
+    pool.stats.pool_frames++;
+    if (++pool.stats.in_use > pool.stats.peak) pool.stats.peak = pool.stats.in_use;
+    return b;
+}
+
+void FramePool::release(void* p, size_t size) noexcept {
+    ThreadPool& pool = tls_pool;
+    size_t c = size_class(size);
+    if (c == kClasses) {
+        ::operator delete(p);
+        return;
+    }
+    FreeBlock* b = static_cast<FreeBlock*>(p);
+    b->next = pool.free[c];
+    pool.free[c] = b;
+    pool.stats.in_use--;
+}
+
+const FramePool::Stats& FramePool::stats() {
+    return tls_pool.stats;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Reactor                                                                   */
+/* ------------------------------------------------------------------------- */
+
+Reactor::Reactor(ev_backend backend, unsigned entries)
+    : _loop(ev_loop_create(backend, entries)) {}
+
+Reactor::~Reactor() {
+    ev_loop_destroy(_loop);
+}
+
+bool Reactor::IoAwaiter::await_suspend(std::coroutine_handle<> h) noexcept {
+    _h = h;
+    _op.cb = on_complete;
+    _op.arg = this;
+    int err = _opcode == kSend ? ev_send(_loop, &_op, _fd, _buf, _len, _flags)
+                               : ev_recv(_loop, &_op, _fd, _buf, _len, _flags);
+    if (err < 0) {
+        _res = err;
+        return false;   // Not submitted: resume right away with the error
+    }
+    return true;
+}
+
+void Reactor::IoAwaiter::on_complete(ev_loop*, ev_op* op, int res) {
+    IoAwaiter* self = static_cast<IoAwaiter*>(op->arg);
+    self->_res = res;
+    self->_h.resume();
+}
+
+void Reactor::SleepAwaiter::await_suspend(std::coroutine_handle<> h) noexcept {
+    _h = h;
+    _timer.cb = on_timer;
+    _timer.arg = this;
+    ev_timer_start(_loop, &_timer, _ms);
+}
+
+void Reactor::SleepAwaiter::on_timer(ev_loop*, ev_timer* timer) {
+    static_cast<SleepAwaiter*>(timer->arg)->_h.resume();
+}
+
+}  // namespace modbus
@@ -0,0 +1,269 @@
+// C++20 coroutines on top of event_loop.c (io_uring or epoll)
+//
+// Task<T> is a lazily started coroutine that can be co_awaited, or started
+// detached with spawn(). Its frame comes from a per-thread FramePool of
+// fixed-size blocks, so after warm-up no coroutine call allocates. Reactor
+// wraps an ev_loop and turns its completions into awaitables:
+//
+//   Task<void> echo(Reactor& r, int fd) {
+//       char buf[256];
+//       for (;;) {
+//           int n = co_await r.recv(fd, buf, sizeof(buf));
+//           if (n <= 0) co_return;
+//           co_await r.send(fd, buf, n);
+//       }
+//   }
+//
+// Coroutines are resumed from the loop's callbacks on the loop's thread.
+// One Reactor per thread; a Task must finish on the thread that started it.
+// Used by modbus_client.cpp.
+
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <new>
+#include <utility>
+
+#include "event_loop.h"
+
+namespace modbus {
+
+/* ------------------------------------------------------------------------- */
+/* Coroutine frame pool                                                      */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * Per-thread free lists of 256/512/1024/2048-byte blocks for coroutine
+ * frames, refilled a slab of blocks at a time. Frames are returned to the
+ * free list of the thread that frees them. Larger frames fall back to
+ * operator new (counted in heap_frames).
+ */
+class FramePool {
+public:
+    static constexpr size_t kClasses = 4;
+    static constexpr size_t kMinBlock = 256;
+    static constexpr size_t kBlocksPerSlab = 64;
+
+    struct Stats {
+        uint64_t pool_frames;   // Frames served from a free list
+        uint64_t heap_frames;   // Frames too large for a block
+        uint64_t slabs;         // Slab refills (warm-up only in steady state)
+        uint64_t in_use;
+        uint64_t peak;
+    };
+
+    static void* allocate(size_t size);
+    static void release(void* p, size_t size) noexcept;
+    static const Stats& stats();
+};
+
+/* ------------------------------------------------------------------------- */
+/* Task                                                                      */
+/* ------------------------------------------------------------------------- */
+
+template <typename T>
+class Task;
+
+namespace detail {
+
+struct PromiseBase {
+    std::coroutine_handle<> continuation;
+    bool detached = false;
+
+    static void* operator new(size_t size) { return FramePool::allocate(size); }
+    static void operator delete(void* p, size_t size) noexcept { FramePool::release(p, size); }
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+
+        // Symmetric transfer to the awaiting coroutine; detached tasks free themselves
+        template <typename P>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept {
+            PromiseBase& p = h.promise();
+            if (p.detached) {
+                h.destroy();
+                return std::noop_coroutine();
+            }
+            return p.continuation ? p.continuation : std::noop_coroutine();
+        }
+
+        void await_resume() noexcept {}
+    };
+
+    FinalAwaiter final_suspend() noexcept { return {}; }
+
+    // The native tools are built without exception handling in mind
+    void unhandled_exception() noexcept { std::terminate(); }
+};
+
+template <typename T>
+struct Promise : PromiseBase {
+    alignas(T) unsigned char storage[sizeof(T)];
+    bool has_value = false;
+
+    Task<T> get_return_object();
+
+    void return_value(T value) {
+        new (storage) T(std::move(value));
+        has_value = true;
+    }
+
+    T take() { return std::move(*reinterpret_cast<T*>(storage)); }
+
+    ~Promise() {
+        if (has_value) reinterpret_cast<T*>(storage)->~T();
+    }
+};
+
+template <>
+struct Promise<void> : PromiseBase {
+    Task<void> get_return_object();
+    void return_void() noexcept {}
+    void take() noexcept {}
+};
+
+}  // namespace detail
+
+template <typename T = void>
+class [[nodiscard]] Task {
+public:
+    using promise_type = detail::Promise<T>;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    explicit Task(Handle h) : _h(h) {}
+    Task(Task&& other) noexcept : _h(std::exchange(other._h, {})) {}
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() {
+        if (_h) _h.destroy();
+    }
+
+    bool await_ready() const noexcept { return false; }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        _h.promise().continuation = awaiting;
+        return _h;
+    }
+
+    T await_resume() { return _h.promise().take(); }
+
+    /**
+     * Start without an awaiting coroutine; the frame frees itself when done
+     */
+    void detach() {
+        Handle h = std::exchange(_h, {});
+        h.promise().detached = true;
+        h.resume();
+    }
+
+private:
+    Handle _h;
+};
+
+namespace detail {
+
+template <typename T>
+Task<T> Promise<T>::get_return_object() {
+    return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+}
+
+inline Task<void> Promise<void>::get_return_object() {
+    return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+}
+
+}  // namespace detail
+
+template <typename T>
+void spawn(Task<T>&& task) {
+    task.detach();
+}
+
+/* ------------------------------------------------------------------------- */
+/* Reactor                                                                   */
+/* ------------------------------------------------------------------------- */
+
+class Reactor {
+public:
+    explicit Reactor(ev_backend backend = EV_BACKEND_AUTO, unsigned entries = 1024);
+    ~Reactor();
+    Reactor(const Reactor&) = delete;
+    Reactor& operator=(const Reactor&) = delete;
+
+    bool ok() const { return _loop != nullptr; }
+    ev_loop* loop() const { return _loop; }
+    const char* backend_name() const { return ev_backend_name(_loop); }
+
+    void run() { ev_run(_loop); }
+    int run_once() { return ev_run_once(_loop); }
+    void stop() { ev_stop(_loop); }
+
+    /**
+     * Socket operation awaiter: co_await yields bytes transferred or -errno
+     */
+    class IoAwaiter {
+    public:
+        IoAwaiter(ev_loop* loop, int opcode, int fd, void* buf, size_t len, unsigned flags)
+            : _loop(loop), _opcode(opcode), _fd(fd), _buf(buf), _len(len), _flags(flags) {}
+
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> h) noexcept;
+        int await_resume() const noexcept { return _res; }
+
+        static constexpr int kSend = 0;
+        static constexpr int kRecv = 1;
+
+    private:
+        static void on_complete(ev_loop* loop, ev_op* op, int res);
+
+        ev_op _op{};
+        ev_loop* _loop;
+        int _opcode;
+        int _fd;
+        void* _buf;
+        size_t _len;
+        unsigned _flags;
+        int _res = 0;
+        std::coroutine_handle<> _h;
+    };
+
+    class SleepAwaiter {
+    public:
+        SleepAwaiter(ev_loop* loop, uint64_t ms) : _loop(loop), _ms(ms) {}
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h) noexcept;
+        void await_resume() const noexcept {}
+
+    private:
+        static void on_timer(ev_loop* loop, ev_timer* timer);
+
+        ev_timer _timer{};
+        ev_loop* _loop;
+        uint64_t _ms;
+        std::coroutine_handle<> _h;
+    };
+
+    IoAwaiter send(int fd, const void* buf, size_t len) {
+        return IoAwaiter(_loop, IoAwaiter::kSend, fd, const_cast<void*>(buf), len, 0);
+    }
+
+    IoAwaiter recv(int fd, void* buf, size_t len, unsigned flags = 0) {
+        return IoAwaiter(_loop, IoAwaiter::kRecv, fd, buf, len, flags);
+    }
+
+    SleepAwaiter sleep(uint64_t ms) { return SleepAwaiter(_loop, ms); }
+
+private:
+    ev_loop* _loop;
+};
+
+}  // namespace modbus
+
+#endif  // REACTOR_H
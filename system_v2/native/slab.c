@@ -0,0 +1,136 @@
+// Fixed-size slab pools with per-thread caches (see slab.h)
+//
+// Compiled into the tools that use it, e.g.:
+//   gcc -O2 -Wall -pthread -o modbus_server modbus_server.c slab.c
+
+#include "slab.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+struct slab_cache {
+    unsigned n;
+    void* objs[SLAB_CACHE_SIZE];    // Stack: objs[n - 1] is the most recently freed
+};
+
+static struct slab_pool* pools[SLAB_MAX_POOLS];
+static int npools;
+static __thread struct slab_cache caches[SLAB_MAX_POOLS];
+
+#define NEXT(obj)   (*(void**)(obj))
+
+int slab_pool_init(struct slab_pool* p, const char* name, size_t obj_size, unsigned per_slab)
+{
+    int id = __atomic_fetch_add(&npools, 1, __ATOMIC_RELAXED);
+    if (id >= SLAB_MAX_POOLS) return -1;
+
+    memset(p, 0, sizeof(*p));
+    p->name = name;
+    p->obj_size = (obj_size + 15) & ~(size_t)15;
+    p->per_slab = per_slab ? per_slab : 1;
+    p->id = id;
+    pthread_mutex_init(&p->lock, NULL);
+    pools[id] = p;
+    return 0;
+}
+
+/**
+ * Hand a chain of n objects (head..tail, linked) to the depot
+ */
+static void depot_push(struct slab_pool* p, void* head, void* tail, size_t n)
+{
+    pthread_mutex_lock(&p->lock);
+    NEXT(tail) = p->depot;
+    p->depot = head;
+    p->depot_len += n;
+    pthread_mutex_unlock(&p->lock);
+}
+
+/**
+ * Empty cache: a batch from the depot, or else a new slab (the batch for
+ * this thread, the rest to the depot)
+ */
+static int refill(struct slab_pool* p, struct slab_cache* c)
+{
+    pthread_mutex_lock(&p->lock);
+    while (c->n < SLAB_BATCH && p->depot) {
+        void* obj = p->depot;
+        p->depot = NEXT(obj);
+        p->depot_len--;
+        c->objs[c->n++] = obj;
+    }
+    pthread_mutex_unlock(&p->lock);
+    if (c->n) {
+        __atomic_add_fetch(&p->depot_ops, 1, __ATOMIC_RELAXED);
+        return 0;
+    }
+
+    size_t size = p->obj_size;
+    size_t bytes = (p->per_slab * size + 63) & ~(size_t)63;
+    char* slab = aligned_alloc(64, bytes);
+    if (!slab) return -1;
+    __atomic_add_fetch(&p->slabs, 1, __ATOMIC_RELAXED);
+
+    // Lowest addresses on top of the stack, handed out first
+    unsigned batch = p->per_slab < SLAB_BATCH ? p->per_slab : SLAB_BATCH;
+    for (unsigned i = batch; i-- > 0;) c->objs[c->n++] = slab + i * size;
+
+    for (unsigned i = batch; i + 1 < p->per_slab; i++) NEXT(slab + i * size) = slab + (i + 1) * size;
+    if (p->per_slab > batch) {
+        depot_push(p, slab + batch * size, slab + (p->per_slab - 1) * size, p->per_slab - batch);
+    }
+    return 0;
+}
+
+/**
+ * Full cache: the oldest batch (bottom of the stack) goes to the depot, the
+ * recently freed (cache-warm) objects stay
+ */
+static void drain(struct slab_pool* p, struct slab_cache* c, unsigned n)
+{
+    for (unsigned i = 0; i + 1 < n; i++) NEXT(c->objs[i]) = c->objs[i + 1];
+    depot_push(p, c->objs[0], c->objs[n - 1], n);
+    memmove(c->objs, c->objs + n, (c->n - n) * sizeof(void*));
+    c->n -= n;
+    __atomic_add_fetch(&p->depot_ops, 1, __ATOMIC_RELAXED);
+}
+
+void* slab_alloc(struct slab_pool* p)
+{
+    struct slab_cache* c = &caches[p->id];
+    if (c->n == 0 && refill(p, c) < 0) return NULL;
+    return c->objs[--c->n];
+}
+
+void slab_free(struct slab_pool* p, void* obj)
+{
+    struct slab_cache* c = &caches[p->id];
+    if (c->n == SLAB_CACHE_SIZE) drain(p, c, SLAB_BATCH);
+    c->objs[c->n++] = obj;
+}
+
+void slab_thread_flush(void)
+{
+    int n = __atomic_load_n(&npools, __ATOMIC_RELAXED);
+    for (int id = 0; id < n && id < SLAB_MAX_POOLS; id++) {
+        if (caches[id].n) drain(pools[id], &caches[id], caches[id].n);
+    }
+}
+
+void slab_pool_stats(struct slab_pool* p, struct slab_stats* st)
+{
+    st->slabs = __atomic_load_n(&p->slabs, __ATOMIC_RELAXED);
+    st->objects = st->slabs * p->per_slab;
+    st->bytes = st->objects * p->obj_size;
+    st->depot_ops = __atomic_load_n(&p->depot_ops, __ATOMIC_RELAXED);
+}
+
+uint64_t slab_total_slabs(void)
+{
+    uint64_t total = 0;
+    int n = __atomic_load_n(&npools, __ATOMIC_RELAXED);
+    for (int id = 0; id < n && id < SLAB_MAX_POOLS; id++) {
+        total += __atomic_load_n(&pools[id]->slabs, __ATOMIC_RELAXED);
+    }
+    return total;
+}
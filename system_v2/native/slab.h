@@ -0,0 +1,74 @@
+// Fixed-size slab pools with per-thread caches
+//
+// Session objects, ADU buffers and register pages of the native tools:
+// modbus_server.c (connections, RCU snapshots and pages), modbus_emulator.c
+// (delayed response ADUs). slab_bench.c compares it with malloc/free and
+// counts heap calls.
+//
+// A pool hands out objects of one size. Memory comes from the heap one slab
+// (many objects) at a time and is never returned to it, so once a tool has
+// reached its peak number of live objects it does not allocate any more.
+// Each thread keeps a small cache of free objects per pool and serves
+// slab_alloc / slab_free from it without locking; only when its cache runs
+// empty or full does it move a batch of objects from / to the pool's shared
+// depot under a mutex. An object may be freed by another thread than the one
+// that allocated it (RCU reclaim): it goes to the freeing thread's cache.
+//
+// A thread's cached objects are stranded when it exits without
+// slab_thread_flush(). Pools live until the process exits.
+
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SLAB_MAX_POOLS      16
+#define SLAB_CACHE_SIZE     64      // Free objects a thread keeps per pool
+#define SLAB_BATCH          32      // Objects moved between a thread cache and the depot
+
+struct slab_pool {
+    const char* name;
+    size_t obj_size;            // Rounded up to 16 bytes
+    unsigned per_slab;
+    int id;                     // Index of the thread caches
+    pthread_mutex_t lock;
+    void* depot;                // Free objects (linked through their first word), lock
+    size_t depot_len;
+    // Statistics (atomic)
+    uint64_t slabs;             // Heap allocations: the pool's only ones
+    uint64_t depot_ops;         // Batches to and from the depot
+};
+
+struct slab_stats {
+    uint64_t slabs;
+    uint64_t objects;           // slabs * per_slab
+    uint64_t bytes;
+    uint64_t depot_ops;
+};
+
+// Returns -1 when SLAB_MAX_POOLS pools exist. Before the threads that use it start.
+int slab_pool_init(struct slab_pool* p, const char* name, size_t obj_size, unsigned per_slab);
+
+// NULL when out of memory
+void* slab_alloc(struct slab_pool* p);
+void slab_free(struct slab_pool* p, void* obj);
+
+// Return the calling thread's cached objects of every pool to the depots
+void slab_thread_flush(void);
+
+void slab_pool_stats(struct slab_pool* p, struct slab_stats* st);
+
+// Slabs of all pools: the heap allocations made through this file
+uint64_t slab_total_slabs(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SLAB_H
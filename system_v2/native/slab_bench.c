@@ -0,0 +1,279 @@
+// Slab pool benchmark: slab.c vs malloc/free, with a heap call counter
+//
+// Models the allocation patterns of the native tools:
+//   sessions  L live connection objects (modbus_server's struct conn), a
+//             random one closed and a new one accepted per op
+//   adu       a FIFO of D ADU buffers (the emulator's delayed responses):
+//             one allocated at the tail and one freed at the head per op
+//   xthread   128-byte register pages allocated on one thread and freed on
+//             another (modbus_server's RCU writes and reclaim)
+// Each workload runs once to warm up, then N ops are timed. malloc, free and
+// aligned_alloc are wrapped by the linker (--wrap), so every heap call made
+// by this file or slab.c is counted: in the timed (steady-state) phase the
+// slab pools must make none.
+//
+// Build:
+//   gcc -O2 -Wall -pthread -o slab_bench slab_bench.c slab.c -Wl,--wrap=malloc,--wrap=free,--wrap=aligned_alloc
+//
+// Run:
+//   ./slab_bench
+//   ./slab_bench -n 5000000 -l 20000
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "slab.h"
+
+#define PAGE_SIZE_B     128
+#define ADU_SIZE_B      280
+#define RING_SIZE       1024
+
+struct config {
+    size_t ops;
+    size_t live;
+    size_t session_size;
+    size_t depth;
+};
+
+static struct config cfg = {
+    .ops = 2000000,
+    .live = 4096,
+    .session_size = 20504,      // sizeof(struct conn) in modbus_server.c
+    .depth = 1024,
+};
+
+struct result {
+    double ns;
+    uint64_t heap_calls;
+};
+
+/* ------------------------------------------------------------------------- */
+/* Heap call counter (-Wl,--wrap)                                            */
+/* ------------------------------------------------------------------------- */
+
+static uint64_t heap_calls;
+
+void* __real_malloc(size_t size);
+void __real_free(void* p);
+void* __real_aligned_alloc(size_t align, size_t size);
+
+void* __wrap_malloc(size_t size)
+{
+    __atomic_add_fetch(&heap_calls, 1, __ATOMIC_RELAXED);
+    return __real_malloc(size);
+}
+
+void __wrap_free(void* p)
+{
+    if (p) __atomic_add_fetch(&heap_calls, 1, __ATOMIC_RELAXED);
+    __real_free(p);
+}
+
+void* __wrap_aligned_alloc(size_t align, size_t size)
+{
+    __atomic_add_fetch(&heap_calls, 1, __ATOMIC_RELAXED);
+    return __real_aligned_alloc(align, size);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Allocators under test                                                     */
+/* ------------------------------------------------------------------------- */
+
+static struct slab_pool session_pool, adu_pool, page_pool;
+static int use_slab;
+
+static void* obj_alloc(struct slab_pool* p)
+{
+    return use_slab ? slab_alloc(p) : malloc(p->obj_size);
+}
+
+static void obj_free(struct slab_pool* p, void* obj)
+{
+    if (use_slab) slab_free(p, obj);
+    else free(obj);
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static inline uint64_t rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Workloads                                                                 */
+/* ------------------------------------------------------------------------- */
+
+static void **sessions, **fifo;
+
+static void run_sessions(size_t ops)
+{
+    for (size_t i = 0; i < ops; i++) {
+        size_t k = rng() % cfg.live;
+        obj_free(&session_pool, sessions[k]);
+        sessions[k] = obj_alloc(&session_pool);
+        *(int*)sessions[k] = (int)i;    // The fd
+    }
+}
+
+static void run_adu(size_t ops)
+{
+    size_t head = 0;
+    for (size_t i = 0; i < ops; i++) {
+        obj_free(&adu_pool, fifo[head]);
+        uint8_t* adu = obj_alloc(&adu_pool);
+        memset(adu, (int)i, 12);          // A read response header
+        fifo[head] = adu;
+        head = head + 1 == cfg.depth ? 0 : head + 1;
+    }
+}
+
+struct ring {
+    void* slots[RING_SIZE];
+    size_t head __attribute__((aligned(64)));   // Producer
+    size_t tail __attribute__((aligned(64)));   // Consumer
+    size_t ops;
+};
+
+static void* reclaimer(void* arg)
+{
+    struct ring* r = arg;
+    for (size_t done = 0; done < r->ops;) {
+        size_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        if (r->tail == head) {
+            sched_yield();
+            continue;
+        }
+        for (; r->tail != head; r->tail++, done++) obj_free(&page_pool, r->slots[r->tail % RING_SIZE]);
+        __atomic_store_n(&r->tail, r->tail, __ATOMIC_RELEASE);
+    }
+    if (use_slab) slab_thread_flush();
+    return NULL;
+}
+
+static void run_xthread(size_t ops)
+{
+    struct ring* r = aligned_alloc(64, sizeof(*r));
+    memset(r, 0, sizeof(*r));
+    r->ops = ops;
+    pthread_t t;
+    pthread_create(&t, NULL, reclaimer, r);
+
+    for (size_t i = 0; i < ops; i++) {
+        while (r->head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) == RING_SIZE) sched_yield();
+        uint8_t* page = obj_alloc(&page_pool);
+        memset(page, (int)i, PAGE_SIZE_B);  // Copy of the old page
+        r->slots[r->head % RING_SIZE] = page;
+        __atomic_store_n(&r->head, r->head + 1, __ATOMIC_RELEASE);
+    }
+
+    pthread_join(t, NULL);
+    free(r);
+}
+
+/**
+ * Warm up, then time ops; heap calls counted in the timed phase only (the
+ * ring of xthread is allocated outside it)
+ */
+static struct result measure(void (*run)(size_t), size_t ops)
+{
+    struct result res;
+    run(ops / 4 > 0 ? ops / 4 : 1);
+
+    uint64_t calls0 = __atomic_load_n(&heap_calls, __ATOMIC_RELAXED);
+    uint64_t t0 = now_ns();
+    run(ops);
+    res.ns = (double)(now_ns() - t0) / ops;
+    res.heap_calls = __atomic_load_n(&heap_calls, __ATOMIC_RELAXED) - calls0;
+    if (run == run_xthread) res.heap_calls -= 2;    // The ring
+    return res;
+}
+
+static void setup(void)
+{
+    for (size_t i = 0; i < cfg.live; i++) sessions[i] = obj_alloc(&session_pool);
+    for (size_t i = 0; i < cfg.depth; i++) fifo[i] = obj_alloc(&adu_pool);
+}
+
+static void teardown(void)
+{
+    for (size_t i = 0; i < cfg.live; i++) obj_free(&session_pool, sessions[i]);
+    for (size_t i = 0; i < cfg.depth; i++) obj_free(&adu_pool, fifo[i]);
+}
+
+static void usage(const char* prog)
+{
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  -n OPS         timed ops per workload (default 2000000)\n"
+        "  -l LIVE        live sessions (default 4096)\n"
+        "  -s BYTES       session object size (default 20504)\n"
+        "  -d DEPTH       ADU FIFO depth (default 1024)\n",
+        prog);
+}
+
+int main(int argc, char** argv)
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "n:l:s:d:")) != -1) {
+        switch (opt) {
+        case 'n': cfg.ops = strtoull(optarg, NULL, 10); break;
+        case 'l': cfg.live = strtoull(optarg, NULL, 10); break;
+        case 's': cfg.session_size = strtoull(optarg, NULL, 10); break;
+        case 'd': cfg.depth = strtoull(optarg, NULL, 10); break;
+        default: usage(argv[0]); return 1;
+        }
+    }
+    if (cfg.ops < 1 || cfg.live < 1 || cfg.depth < 1 || cfg.session_size < 16) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    slab_pool_init(&session_pool, "session", cfg.session_size, 16);
+    slab_pool_init(&adu_pool, "adu", ADU_SIZE_B, 256);
+    slab_pool_init(&page_pool, "page", PAGE_SIZE_B, 256);
+    sessions = calloc(cfg.live, sizeof(void*));
+    fifo = calloc(cfg.depth, sizeof(void*));
+
+    static const char* names[] = { "sessions", "adu", "xthread" };
+    void (*runs[])(size_t) = { run_sessions, run_adu, run_xthread };
+    struct result res[3][2];
+
+    for (use_slab = 0; use_slab < 2; use_slab++) {
+        setup();
+        for (int w = 0; w < 3; w++) res[w][use_slab] = measure(runs[w], cfg.ops);
+        teardown();
+    }
+
+    printf("%zu ops per workload | %zu live sessions of %zu bytes | ADU FIFO depth %zu\n",
+           cfg.ops, cfg.live, cfg.session_size, cfg.depth);
+    printf("  workload      malloc      slab   heap calls (timed)\n");
+    printf("                 ns/op     ns/op     malloc     slab\n");
+    uint64_t steady = 0;
+    for (int w = 0; w < 3; w++) {
+        printf("  %-10s %9.1f %9.1f %10llu %8llu  %s\n", names[w], res[w][0].ns, res[w][1].ns,
+               (unsigned long long)res[w][0].heap_calls, (unsigned long long)res[w][1].heap_calls,
+               res[w][1].heap_calls ? "✗" : "✓");
+        steady += res[w][1].heap_calls;
+    }
+    printf("[STATS] steady-state heap calls with slab pools: %llu | slabs %llu\n",
+           (unsigned long long)steady, (unsigned long long)slab_total_slabs());
+    return steady ? 1 : 0;
+}
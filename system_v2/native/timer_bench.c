@@ -0,0 +1,313 @@
+// Timer queue benchmark: hierarchical timing wheel vs binary heap
+//
+// Models the per-connection timers of the native tools (response timeouts
+// that are restarted on every response, keepalives that re-arm when they
+// fire) with N live timers on a virtual millisecond clock, so the numbers
+// are the data structure cost only (no clock reads or syscalls):
+//   start     N timers with random delays in [1, MAX] ms
+//   restart   R random timers cancelled and restarted (timeout reset)
+//   expire    S simulated seconds in 1 ms steps; every expired timer re-arms
+// Every expiry is checked against its deadline (never early, at most one
+// tick late).
+//
+// Build:
+//   gcc -O2 -Wall -o timer_bench timer_bench.c timer_wheel.c
+//
+// Run:
+//   ./timer_bench                      (100k timers, 1..5000 ms)
+//   ./timer_bench -n 1000000 -m 30000 -s 60
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+
+#include "timer_wheel.h"
+
+#define MS      1000000ULL
+
+struct config {
+    size_t timers;
+    uint64_t max_ms;
+    size_t restarts;
+    uint64_t sim_s;
+};
+
+static struct config cfg = {
+    .timers = 100000,
+    .max_ms = 5000,
+    .restarts = 1000000,
+    .sim_s = 10,
+};
+
+struct btimer {
+    struct tw_timer tw;         // Wheel
+    size_t hidx;                // Heap position (SIZE_MAX = not queued)
+    uint64_t due_ns;
+};
+
+struct result {
+    double start_ns, restart_ns, expire_ns, tick_ns;
+    uint64_t fired, early, late;
+};
+
+static struct btimer* timers;
+static uint64_t vnow;           // Virtual clock
+static uint64_t rng_state;
+static struct result* cur;
+
+/* ------------------------------------------------------------------------- */
+/* Helpers                                                                    */
+/* ------------------------------------------------------------------------- */
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static uint64_t random_due(void)
+{
+    return vnow + (1 + rng() % cfg.max_ms) * MS;
+}
+
+/**
+ * Re-arm delay of an expired timer: a hash of (timer, time) rather than the
+ * shared stream, so both queues see the same schedule whatever order they
+ * run a tick's expiries in
+ */
+static uint64_t rearm_due(const struct btimer* t)
+{
+    uint64_t x = (uint64_t)(t - timers) * 0x9e3779b97f4a7c15ULL ^ vnow;
+    x ^= x >> 31;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 29;
+    return vnow + (1 + x % cfg.max_ms) * MS;
+}
+
+static void check_fire(struct btimer* t)
+{
+    cur->fired++;
+    if (vnow < t->due_ns) cur->early++;
+    else if (vnow - t->due_ns >= MS) cur->late++;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Binary heap (with positions, for O(log n) cancel)                          */
+/* ------------------------------------------------------------------------- */
+
+static struct btimer** heap;
+static size_t heap_len;
+
+static void heap_set(size_t i, struct btimer* t)
+{
+    heap[i] = t;
+    t->hidx = i;
+}
+
+static void heap_up(size_t i)
+{
+    struct btimer* t = heap[i];
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (heap[parent]->due_ns <= t->due_ns) break;
+        heap_set(i, heap[parent]);
+        i = parent;
+    }
+    heap_set(i, t);
+}
+
+static void heap_down(size_t i)
+{
+    struct btimer* t = heap[i];
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= heap_len) break;
+        if (child + 1 < heap_len && heap[child + 1]->due_ns < heap[child]->due_ns) child++;
+        if (t->due_ns <= heap[child]->due_ns) break;
+        heap_set(i, heap[child]);
+        i = child;
+    }
+    heap_set(i, t);
+}
+
+static void heap_cancel(struct btimer* t)
+{
+    if (t->hidx == SIZE_MAX) return;
+    size_t i = t->hidx;
+    struct btimer* last = heap[--heap_len];
+    t->hidx = SIZE_MAX;
+    if (last == t) return;
+    heap_set(i, last);
+    heap_up(i);
+    heap_down(last->hidx);
+}
+
+static void heap_start(struct btimer* t, uint64_t due_ns)
+{
+    heap_cancel(t);
+    t->due_ns = due_ns;
+    heap_set(heap_len++, t);
+    heap_up(heap_len - 1);
+}
+
+static void heap_advance(void)
+{
+    while (heap_len > 0 && heap[0]->due_ns <= vnow) {
+        struct btimer* t = heap[0];
+        heap_cancel(t);
+        check_fire(t);
+        heap_start(t, rearm_due(t));
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/* Timing wheel                                                               */
+/* ------------------------------------------------------------------------- */
+
+static struct timer_wheel wheel;
+
+static void wheel_start(struct btimer* t, uint64_t due_ns)
+{
+    t->due_ns = due_ns;
+    tw_start(&wheel, &t->tw, due_ns);
+}
+
+static void on_wheel_fire(struct timer_wheel* w, struct tw_timer* tw)
+{
+    struct btimer* t = tw->arg;
+    check_fire(t);
+    wheel_start(t, rearm_due(t));
+}
+
+static void wheel_advance(void)
+{
+    tw_advance(&wheel, vnow);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Benchmark                                                                  */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * Run the three phases against one queue (same random sequence for both)
+ */
+static void run(struct result* r, void (*start)(struct btimer*, uint64_t),
+                void (*advance)(void))
+{
+    memset(r, 0, sizeof(*r));
+    cur = r;
+    vnow = 0;
+    rng_state = 0x9e3779b97f4a7c15ULL;
+
+    uint64_t t0 = now_ns();
+    for (size_t i = 0; i < cfg.timers; i++) start(&timers[i], random_due());
+    uint64_t t1 = now_ns();
+    r->start_ns = (double)(t1 - t0) / cfg.timers;
+
+    t0 = now_ns();
+    for (size_t i = 0; i < cfg.restarts; i++) {
+        struct btimer* t = &timers[rng() % cfg.timers];
+        start(t, random_due());
+    }
+    t1 = now_ns();
+    r->restart_ns = (double)(t1 - t0) / cfg.restarts;
+
+    uint64_t ticks = cfg.sim_s * 1000;
+    t0 = now_ns();
+    for (uint64_t i = 0; i < ticks; i++) {
+        vnow += MS;
+        advance();
+    }
+    t1 = now_ns();
+    r->expire_ns = r->fired ? (double)(t1 - t0) / r->fired : 0;
+    r->tick_ns = (double)(t1 - t0) / ticks;
+}
+
+static void print_result(const char* name, const struct result* r)
+{
+    printf("  %-6s  %8.1f  %8.1f  %8.1f  %9.1f  %9lu  %s\n",
+           name, r->start_ns, r->restart_ns, r->expire_ns, r->tick_ns / 1000.0,
+           (unsigned long)r->fired,
+           r->early || r->late ? "✗" : "✓");
+    if (r->early || r->late) {
+        printf("          %lu early, %lu late\n", (unsigned long)r->early, (unsigned long)r->late);
+    }
+}
+
+static void usage(const char* prog)
+{
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  -n N      live timers (default 100000)\n"
+        "  -m MS     max timer delay in ms (default 5000)\n"
+        "  -r N      random restarts (default 1000000)\n"
+        "  -s SEC    simulated seconds of expiry (default 10)\n",
+        prog);
+}
+
+int main(int argc, char** argv)
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "n:m:r:s:")) != -1) {
+        switch (opt) {
+        case 'n': cfg.timers = strtoul(optarg, NULL, 10); break;
+        case 'm': cfg.max_ms = strtoull(optarg, NULL, 10); break;
+        case 'r': cfg.restarts = strtoul(optarg, NULL, 10); break;
+        case 's': cfg.sim_s = strtoull(optarg, NULL, 10); break;
+        default: usage(argv[0]); return 1;
+        }
+    }
+    if (cfg.timers == 0 || cfg.max_ms == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    timers = calloc(cfg.timers, sizeof(*timers));
+    heap = calloc(cfg.timers, sizeof(*heap));
+    if (!timers || !heap) {
+        perror("calloc");
+        return 1;
+    }
+
+    printf("%zu timers, delays 1..%lu ms, %zu restarts, %lu s simulated\n",
+           cfg.timers, (unsigned long)cfg.max_ms, cfg.restarts, (unsigned long)cfg.sim_s);
+
+    struct result rh, rw;
+    for (size_t i = 0; i < cfg.timers; i++) timers[i].hidx = SIZE_MAX;
+    run(&rh, heap_start, heap_advance);
+
+    tw_init(&wheel, MS, 0);
+    for (size_t i = 0; i < cfg.timers; i++) {
+        timers[i].tw.cb = on_wheel_fire;
+        timers[i].tw.arg = &timers[i];
+    }
+    run(&rw, wheel_start, wheel_advance);
+
+    printf("  %-6s  %8s  %8s  %8s  %9s  %9s\n",
+           "queue", "start", "restart", "expire", "tick", "fired");
+    printf("  %-6s  %8s  %8s  %8s  %9s\n", "", "ns/op", "ns/op", "ns/op", "us");
+    print_result("heap", &rh);
+    print_result("wheel", &rw);
+
+    if (rh.fired != rw.fired) {
+        printf("✗ expiry count differs (heap %lu, wheel %lu)\n",
+               (unsigned long)rh.fired, (unsigned long)rw.fired);
+        return 1;
+    }
+    printf("[STATS] restart %.1fx, expire %.1fx faster with the wheel\n",
+           rh.restart_ns / rw.restart_ns, rh.expire_ns / rw.expire_ns);
+    return rh.early || rh.late || rw.early || rw.late;
+}
@@ -0,0 +1,201 @@
+// Hierarchical timing wheel (see timer_wheel.h)
+//
+// Compiled into the tools that use it, e.g.:
+//   gcc -O2 -Wall -o timer_bench timer_bench.c timer_wheel.c
+
+#include "timer_wheel.h"
+
+#include <string.h>
+
+#define TW_MASK         (TW_SLOTS - 1)
+#define TW_MAX_DELTA    ((1ULL << (TW_BITS * TW_LEVELS)) - 1)
+
+void tw_init(struct timer_wheel* w, uint64_t tick_ns, uint64_t now_ns)
+{
+    memset(w, 0, sizeof(*w));
+    w->tick_ns = tick_ns;
+    w->origin_ns = now_ns;
+}
+
+static void link_timer(struct timer_wheel* w, struct tw_timer* t, int level, unsigned idx)
+{
+    struct tw_timer** head = &w->slots[level][idx];
+    t->next = *head;
+    if (*head) (*head)->pprev = &t->next;
+    *head = t;
+    t->pprev = head;
+    w->occupied[level] |= 1ULL << idx;
+}
+
+/**
+ * Slot for t relative to the current tick: the level is the first whose
+ * range covers the delta, the index is the expiry's digit at that level
+ */
+static void place(struct timer_wheel* w, struct tw_timer* t)
+{
+    uint64_t delta = t->expires > w->now ? t->expires - w->now : 0;
+    if (delta > TW_MAX_DELTA) delta = TW_MAX_DELTA;     // Parked, re-placed on cascade
+    uint64_t e = w->now + delta;
+
+    int level = 0;
+    while (level < TW_LEVELS - 1 && delta >= (1ULL << (TW_BITS * (level + 1)))) {
+        level++;
+    }
+    link_timer(w, t, level, (e >> (TW_BITS * level)) & TW_MASK);
+}
+
+void tw_cancel(struct timer_wheel* w, struct tw_timer* t)
+{
+    if (!t->pprev) return;
+
+    *t->pprev = t->next;
+    if (t->next) t->next->pprev = t->pprev;
+
+    // Was alone in its slot (pprev is the slot head): clear the occupancy bit
+    struct tw_timer** first = &w->slots[0][0];
+    if (!t->next && t->pprev >= first && t->pprev < first + TW_LEVELS * TW_SLOTS) {
+        size_t off = t->pprev - first;
+        w->occupied[off / TW_SLOTS] &= ~(1ULL << (off % TW_SLOTS));
+    }
+    t->pprev = NULL;
+    w->count--;
+}
+
+void tw_start(struct timer_wheel* w, struct tw_timer* t, uint64_t expires_ns)
+{
+    tw_cancel(w, t);
+
+    // Round up: a timer never fires before expires_ns
+    uint64_t rel = expires_ns > w->origin_ns ? expires_ns - w->origin_ns : 0;
+    t->expires = (rel + w->tick_ns - 1) / w->tick_ns;
+    place(w, t);
+    w->count++;
+}
+
+/**
+ * Move a higher-level slot down; returns its index (0 = cascade the next level too)
+ */
+static unsigned cascade(struct timer_wheel* w, int level)
+{
+    unsigned idx = (w->now >> (TW_BITS * level)) & TW_MASK;
+    struct tw_timer* t = w->slots[level][idx];
+
+    w->slots[level][idx] = NULL;
+    w->occupied[level] &= ~(1ULL << idx);
+    while (t) {
+        struct tw_timer* next = t->next;
+        place(w, t);
+        t = next;
+    }
+    return idx;
+}
+
+/**
+ * First tick >= w->now with a level-0 slot to run (UINT64_MAX = none)
+ */
+static uint64_t next_level0(const struct timer_wheel* w)
+{
+    unsigned idx = w->now & TW_MASK;
+    uint64_t bits = w->occupied[0] >> idx;
+    if (bits) return w->now + __builtin_ctzll(bits);
+    if (w->occupied[0]) return (w->now | TW_MASK) + 1 + __builtin_ctzll(w->occupied[0]);
+    return UINT64_MAX;
+}
+
+/**
+ * First tick >= from whose cascade can move timers: cascades of levels below
+ * the lowest occupied one are no-ops, so only that level's boundaries count
+ */
+static uint64_t next_cascade(const struct timer_wheel* w, uint64_t from)
+{
+    for (int level = 1; level < TW_LEVELS; level++) {
+        if (w->occupied[level]) {
+            uint64_t mask = (1ULL << (TW_BITS * level)) - 1;
+            return (from + mask) & ~mask;
+        }
+    }
+    return UINT64_MAX;
+}
+
+int tw_advance(struct timer_wheel* w, uint64_t now_ns)
+{
+    if (now_ns < w->origin_ns) return 0;
+    uint64_t target = (now_ns - w->origin_ns) / w->tick_ns;
+    int ran = 0;
+
+    while (w->now <= target) {
+        if (w->count == 0) {
+            w->now = target + 1;
+            break;
+        }
+
+        unsigned idx = w->now & TW_MASK;
+        if (idx == 0) {
+            for (int level = 1; level < TW_LEVELS && cascade(w, level) == 0; level++) {
+            }
+        }
+
+        // Nothing in this slot: jump to the next tick with work
+        if (!(w->occupied[0] & (1ULL << idx))) {
+            uint64_t next = next_level0(w);
+            uint64_t cas = next_cascade(w, w->now + 1);
+            if (cas < next) next = cas;
+            w->now = next < target + 1 ? next : target + 1;
+            continue;
+        }
+
+        // Detach the slot onto a local head: callbacks may start timers (they
+        // land in later ticks) or cancel ones still in the list
+        struct tw_timer* list = w->slots[0][idx];
+        list->pprev = &list;
+        w->slots[0][idx] = NULL;
+        w->occupied[0] &= ~(1ULL << idx);
+        w->now++;
+
+        while (list) {
+            struct tw_timer* t = list;
+            list = t->next;
+            if (list) list->pprev = &list;
+            t->pprev = NULL;
+            w->count--;
+            t->cb(w, t);
+            ran++;
+        }
+    }
+    return ran;
+}
+
+int64_t tw_next_ns(const struct timer_wheel* w, uint64_t now_ns)
+{
+    if (w->count == 0) return -1;
+
+    // Exact, so a loop waiting on it does not wake up for cascades: walk
+    // each higher level's occupied slots in block order while a block could
+    // still start before the best tick so far (usually only the first slot;
+    // parked timers sit in blocks before their expiry)
+    uint64_t tick = next_level0(w);
+    for (int level = 1; level < TW_LEVELS; level++) {
+        // The current block's slot was cascaded when the block started,
+        // unless w->now is that first tick (not processed yet)
+        int shift = TW_BITS * level;
+        uint64_t block = w->now >> shift;
+        if (w->now & ((1ULL << shift) - 1)) block++;
+
+        for (uint64_t occ = w->occupied[level]; occ; ) {
+            unsigned idx = block & TW_MASK;
+            uint64_t bits = idx ? (occ >> idx) | (occ << (TW_SLOTS - idx)) : occ;
+            block += __builtin_ctzll(bits);
+            if ((block << shift) >= tick) break;
+
+            idx = block & TW_MASK;
+            for (const struct tw_timer* t = w->slots[level][idx]; t; t = t->next) {
+                if (t->expires < tick) tick = t->expires;
+            }
+            occ &= ~(1ULL << idx);
+            block++;
+        }
+    }
+
+    uint64_t due = w->origin_ns + tick * w->tick_ns;
+    return due > now_ns ? (int64_t)(due - now_ns) : 0;
+}
@@ -0,0 +1,78 @@
+// Hierarchical timing wheel (O(1) start/cancel)
+//
+// Shared by the native tools for response timeouts, keepalives, reconnect
+// backoff and delayed responses: event_loop.c (modbus_mms_gateway),
+// modbus_loadgen.c and modbus_emulator.c. timer_bench.c compares it with a
+// binary heap.
+//
+// 4 levels of 64 slots. Level L covers deltas up to 64^(L+1) ticks, so with
+// 1 ms ticks level 0 is the next 64 ms and the wheel spans 4.6 hours (longer
+// timers are parked in the last level and re-placed when it cascades). A
+// timer is an intrusive list node in its slot: start and cancel are O(1),
+// and a slot of a higher level is moved down ("cascaded") once per rotation
+// of the level below. Per-level occupancy bitmaps let tw_advance skip empty
+// slots and tw_next_ns find the next wake-up without walking the wheel.
+//
+// Timers never fire early: expiry is rounded up to the next tick. Callbacks
+// may start and cancel timers (including their own). Not thread-safe: one
+// wheel per thread / event loop.
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TW_BITS     6
+#define TW_SLOTS    (1 << TW_BITS)
+#define TW_LEVELS   4
+
+struct timer_wheel;
+struct tw_timer;
+
+typedef void (*tw_cb)(struct timer_wheel* w, struct tw_timer* t);
+
+struct tw_timer {
+    tw_cb cb;
+    void* arg;
+    // Internal
+    uint64_t expires;           // Tick
+    struct tw_timer* next;
+    struct tw_timer** pprev;    // NULL = not pending
+};
+
+struct timer_wheel {
+    uint64_t tick_ns;
+    uint64_t origin_ns;
+    uint64_t now;               // Next tick to process
+    size_t count;
+    uint64_t occupied[TW_LEVELS];
+    struct tw_timer* slots[TW_LEVELS][TW_SLOTS];
+};
+
+void tw_init(struct timer_wheel* w, uint64_t tick_ns, uint64_t now_ns);
+
+// Start (or restart) t to expire at expires_ns (absolute, same clock as tw_init)
+void tw_start(struct timer_wheel* w, struct tw_timer* t, uint64_t expires_ns);
+void tw_cancel(struct timer_wheel* w, struct tw_timer* t);
+
+static inline int tw_pending(const struct tw_timer* t)
+{
+    return t->pprev != NULL;
+}
+
+// Run the callbacks of all timers due at now_ns; returns how many ran
+int tw_advance(struct timer_wheel* w, uint64_t now_ns);
+
+// ns from now_ns until tw_advance may have work (0 = now, -1 = no timers)
+int64_t tw_next_ns(const struct timer_wheel* w, uint64_t now_ns);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TIMER_WHEEL_H
@@ -0,0 +1,151 @@
+"""
+RPI#1 Modbus/UDP over DTLS 1.2 Server (ESP32 write path)
+
+Optional alternative to the TLS/TCP server on port 802 for lossy WiFi.
+Each Modbus request is one datagram (MBAP + PDU); the DTLS session survives
+WiFi blips because UDP has no connection state to lose.
+
+Architecture:
+  ESP32 --[WiFi, Modbus/UDP + DTLS 1.2, udp/802]--> RPI#1 (SmartMeterDataBlock)
+
+Sequence numbers / idempotency:
+  The MBAP transaction id is the ESP32's frame sequence number; duplicates
+  and stale frames are acknowledged without being applied again
+  (sequenced_modbus.py), also across re-handshakes.
+
+Requires python-mbedtls (pip install python-mbedtls); the standard ssl
+module has no DTLS support.
+"""
+
+import asyncio
+import logging
+import socket
+import threading
+from contextlib import suppress
+
+try:
+    from mbedtls import pk, tls, x509
+    DTLS_AVAILABLE = True
+except ImportError:
+    DTLS_AVAILABLE = False
+
+from sequenced_modbus import SequencedModbusHandler
+
+logger = logging.getLogger(__name__)
+
+SESSION_IDLE_SEC = 300       # Drop sessions without traffic (ESP32 sends every 10 s)
+
+
+def _retry(call, *args):
+    """Drive a non-blocking python-mbedtls call to completion"""
+    while True:
+        try:
+            return call(*args)
+        except (tls.WantReadError, tls.WantWriteError):
+            pass
+
+
+class ModbusDTLSServer:
+    """
+    DTLS listener + one thread per peer session
+
+    Register access is marshalled onto the asyncio loop that owns the
+    datablock, so it is serialized with the TCP/TLS servers.
+    """
+
+    def __init__(self, datablock, loop, address, port, certfile, keyfile, unit_id=1):
+        if not DTLS_AVAILABLE:
+            raise ImportError("python-mbedtls not installed. Run: pip install python-mbedtls")
+
+        self.datablock = datablock
+        self.loop = loop
+        self.address = address
+        self.port = port
+        self.unit_id = unit_id
+
+        with open(certfile) as f:
+            cert = x509.CRT.from_PEM(f.read())
+        with open(keyfile) as f:
+            key = pk.RSA.from_PEM(f.read())
+
+        self.context = tls.ServerContext(tls.DTLSConfiguration(
+            certificate_chain=([cert], key),
+            validate_certificates=False,
+            lowest_supported_version=tls.DTLSVersion.DTLSv1_2,
+        ))
+
+        self.listener = None
+        self.running = False
+        self.handler = SequencedModbusHandler(datablock, self._call, "DTLS")
+        self.total_sessions = 0
+
+    def start(self):
+        """Bind the UDP socket and start accepting DTLS sessions"""
+        sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self.listener = self.context.wrap_socket(sock)
+        self.listener.bind((self.address, self.port))
+        self.running = True
+        threading.Thread(target=self._accept_loop, name="dtls-accept", daemon=True).start()
+        logger.info(f"Modbus DTLS server listening on {self.address}:{self.port}/udp")
+
+    def stop(self):
+        self.running = False
+        if self.listener:
+            with suppress(OSError):
+                self.listener.close()
+
+    def _accept_loop(self):
+        while self.running:
+            try:
+                # First ClientHello is answered with a HelloVerifyRequest (cookie)
+                conn, addr = self.listener.accept()
+                conn.setcookieparam(addr[0].encode("ascii"))
+                with suppress(tls.HelloVerifyRequest):
+                    _retry(conn.do_handshake)
+
+                conn, addr = conn.accept()
+                conn.setcookieparam(addr[0].encode("ascii"))
+                _retry(conn.do_handshake)
+            except OSError:
+                if self.running:
+                    logger.exception("DTLS accept failed")
+                continue
+            except Exception as e:
+                logger.warning(f"DTLS handshake failed: {e}")
+                continue
+
+            # The sequence window survives re-handshakes: a frame whose response was
+            # lost is re-sent after the (usually abbreviated) handshake and must not
+            # be applied twice. python-mbedtls does not tell whether the session was
+            # resumed, so the first frame decides whether the ESP32 rebooted.
+            self.handler.session_started(addr[0])
+            self.total_sessions += 1
+            logger.info(f"DTLS session established with {addr[0]}:{addr[1]} "
+                        f"(sessions: {self.total_sessions})")
+            threading.Thread(target=self._session, args=(conn, addr),
+                             name=f"dtls-{addr[0]}", daemon=True).start()
+
+    def _session(self, conn, addr):
+        conn.settimeout(SESSION_IDLE_SEC)
+        try:
+            while self.running:
+                request = _retry(conn.recv, 512)
+                if not request:
+                    break
+                response = self.handler.handle(addr[0], request)
+                if response:
+                    _retry(conn.send, response)
+        except socket.timeout:
+            logger.info(f"DTLS session {addr[0]}:{addr[1]} idle, closing")
+        except Exception as e:
+            logger.warning(f"DTLS session {addr[0]}:{addr[1]} ended: {e}")
+        finally:
+            with suppress(Exception):
+                conn.close()
+
+    def _call(self, fn, *args):
+        """Run fn on the datablock's event loop and wait for the result"""
+        async def run():
+            return fn(*args)
+        return asyncio.run_coroutine_threadsafe(run(), self.loop).result()
@@ -0,0 +1,447 @@
+"""
+RPI#1 Modbus/TLS Server with Kernel TLS (kTLS) Offload (ESP32 write path)
+
+Optional replacement for the pymodbus TLS server on tcp/802. The handshake
+is done by OpenSSL in a worker thread with SSL_OP_ENABLE_KTLS; OpenSSL then
+installs the session keys in the kernel (TLS_TX/TLS_RX). When both
+directions are offloaded, the connection is handed to the event loop as a
+plain TCP socket: the kernel decrypts and encrypts the records, and Python
+only handles plaintext Modbus ADUs.
+
+Architecture:
+  ESP32 --[WiFi, Modbus/TCP + TLS, tcp/802]--> kernel TLS (AES-GCM) --plaintext--> RPI#1 event loop
+                                                 ^
+                        handshake (OpenSSL, worker thread), keys → setsockopt(SOL_TLS)
+
+Requirements:
+  - Linux kernel tls module (modprobe tls; /proc/net/tls_stat exists)
+  - OpenSSL >= 3.0 built with enable-ktls (Debian/Raspberry Pi OS bookworm: yes)
+  - A cipher the kernel offloads: AES-GCM / ChaCha20-Poly1305. TLS 1.2 is
+    offloaded both ways by OpenSSL 3.0; TLS 1.3 receive needs OpenSSL 3.2.
+    The ESP32's ModbusTLS client (mbedTLS 2.28) negotiates TLS 1.2.
+
+ktls_self_test() checks all of this with a loopback handshake at startup; if
+it fails, smart_meter_server.py keeps the pymodbus TLS server. A connection
+that negotiates something the kernel cannot take over is served with
+user-space TLS in a thread of its own.
+
+Supported function codes: FC16, FC03 (sequenced_modbus.py, unsequenced),
+which is what the ESP32 sends (telemetry, status block, time service).
+
+Benchmark (per-connection server CPU and latency, kTLS vs user-space TLS):
+  python3 ktls_server.py --bench --connections 4 --requests 5000
+"""
+
+import argparse
+import asyncio
+import logging
+import os
+import resource
+import socket
+import ssl
+import statistics
+import threading
+import time
+from contextlib import suppress
+
+from sequenced_modbus import MBAP, SequencedModbusHandler
+
+logger = logging.getLogger(__name__)
+
+# SSL_OP_ENABLE_KTLS (OpenSSL 3.0); exported by the ssl module from Python 3.12
+OP_ENABLE_KTLS = getattr(ssl, "OP_ENABLE_KTLS", 1 << 3)
+SOL_TLS = 282
+TLS_TX = 1
+TLS_RX = 2
+TCP_ULP = 31
+TLS_STAT_PATH = "/proc/net/tls_stat"
+
+HANDSHAKE_TIMEOUT_SEC = 10
+MAX_ADU_LENGTH = 260         # Modbus/TCP ADU limit (MBAP length field <= 254)
+
+
+def ktls_state(sock):
+    """(tx, rx): whether the kernel holds the session keys for each direction"""
+    state = []
+    for direction in (TLS_TX, TLS_RX):
+        try:
+            sock.getsockopt(SOL_TLS, direction, 64)
+            state.append(True)
+        except OSError:
+            state.append(False)
+    return tuple(state)
+
+
+def tls_stat():
+    """Kernel TLS counters (/proc/net/tls_stat), empty if the module is not loaded"""
+    try:
+        with open(TLS_STAT_PATH) as f:
+            return {name: int(value) for name, value in (line.split() for line in f)}
+    except OSError:
+        return {}
+
+
+def enable_ktls(sslctx):
+    """
+    Ask OpenSSL to offload record encryption after the handshake
+
+    Capped at TLS 1.2, which OpenSSL 3.0 offloads in both directions (TLS 1.3
+    receive needs 3.2); the ESP32 ModbusTLS client (mbedTLS 2.28) negotiates it.
+    """
+    sslctx.options |= OP_ENABLE_KTLS
+    sslctx.maximum_version = ssl.TLSVersion.TLSv1_2
+    return sslctx
+
+
+def _ulp_available():
+    """Attach the kernel tls ULP to a throwaway loopback connection"""
+    listener = socket.create_server(("127.0.0.1", 0))
+    client = socket.create_connection(listener.getsockname())
+    server, _ = listener.accept()
+    try:
+        server.setsockopt(socket.IPPROTO_TCP, TCP_ULP, b"tls")
+        return None
+    except OSError as e:
+        return e.strerror
+    finally:
+        for sock in (listener, client, server):
+            sock.close()
+
+
+def ktls_self_test(certfile, keyfile):
+    """
+    Loopback handshake with the server certificate
+
+    Returns:
+        (ok, reason) - ok when both directions were offloaded
+    """
+    if ssl.OPENSSL_VERSION_INFO < (3, 0):
+        return False, f"{ssl.OPENSSL_VERSION} has no kTLS support (needs OpenSSL 3.0)"
+    error = _ulp_available()
+    if error:
+        return False, f"kernel tls module not available ({error}; modprobe tls)"
+
+    listener = socket.create_server(("127.0.0.1", 0))
+    client = socket.create_connection(listener.getsockname())
+    server, _ = listener.accept()
+    listener.close()
+    try:
+        server_ctx = enable_ktls(ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER))
+        server_ctx.load_cert_chain(certfile, keyfile)
+        client_ctx = ssl.SSLContext(ssl.PROTOCOL_TLS_CLIENT)
+        client_ctx.check_hostname = False
+        client_ctx.verify_mode = ssl.CERT_NONE
+
+        result = {}
+
+        def accept():
+            with suppress(Exception):
+                result["sock"] = server_ctx.wrap_socket(server, server_side=True)
+
+        thread = threading.Thread(target=accept)
+        thread.start()
+        tls_client = client_ctx.wrap_socket(client)
+        thread.join(HANDSHAKE_TIMEOUT_SEC)
+        tls_sock = result.get("sock")
+        if tls_sock is None:
+            return False, "loopback handshake failed"
+
+        tx, rx = ktls_state(tls_sock)
+        cipher = tls_sock.cipher()[0]
+        tls_client.close()
+        tls_sock.close()
+        if not (tx and rx):
+            return False, (f"OpenSSL did not offload {cipher} (tx={tx}, rx={rx}); "
+                           f"{ssl.OPENSSL_VERSION} built without enable-ktls?")
+        return True, f"{cipher} offloaded ({ssl.OPENSSL_VERSION})"
+    finally:
+        for sock in (client, server):
+            with suppress(OSError):
+                sock.close()
+
+
+class ModbusKTLSServer:
+    """
+    TLS listener whose established sessions run on kernel TLS
+
+    ktls=False serves every connection with asyncio's user-space TLS on the
+    event loop instead (the pymodbus TLS server's data path); used as the
+    benchmark baseline.
+    """
+
+    def __init__(self, datablock, address, port, sslctx, ktls=True):
+        self.address = address
+        self.port = port
+        self.ktls = ktls
+        self.sslctx = enable_ktls(sslctx) if ktls else sslctx
+        self.loop = None
+        self.handler = SequencedModbusHandler(datablock, lambda fn, *args: fn(*args), "kTLS",
+                                              sequenced=False)
+        self.thread_handler = SequencedModbusHandler(datablock, self._call, "kTLS",
+                                                     sequenced=False)
+        self.server = None
+        self.listener = None
+        self.accept_task = None
+        self.ktls_sessions = 0
+        self.userspace_sessions = 0
+        self.failed_handshakes = 0
+
+    async def start(self):
+        self.loop = asyncio.get_running_loop()
+        if not self.ktls:
+            self.server = await asyncio.start_server(
+                self._serve_stream, self.address, self.port, ssl=self.sslctx)
+            logger.info(f"Modbus TLS server (user-space TLS) listening on {self.address}:{self.port}")
+            return
+
+        self.listener = socket.create_server((self.address, self.port))
+        self.listener.setblocking(False)
+        self.accept_task = asyncio.create_task(self._accept_loop())
+        logger.info(f"Modbus TLS server (kTLS) listening on {self.address}:{self.port}")
+
+    async def stop(self):
+        if self.server:
+            self.server.close()
+            await self.server.wait_closed()
+        if self.accept_task:
+            self.accept_task.cancel()
+            with suppress(asyncio.CancelledError):
+                await self.accept_task
+        if self.listener:
+            self.listener.close()
+
+    async def _accept_loop(self):
+        while True:
+            sock, addr = await self.loop.sock_accept(self.listener)
+            asyncio.create_task(self._on_client(sock, addr[0]))
+
+    def _handshake(self, sock):
+        """Blocking OpenSSL handshake (worker thread); keys go to the kernel at its end"""
+        sock.setblocking(True)
+        sock.settimeout(HANDSHAKE_TIMEOUT_SEC)
+        tls_sock = self.sslctx.wrap_socket(sock, server_side=True)
+        tls_sock.settimeout(None)
+        return tls_sock
+
+    async def _on_client(self, sock, peer):
+        sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        try:
+            tls_sock = await self.loop.run_in_executor(None, self._handshake, sock)
+        except (OSError, ssl.SSLError) as e:
+            self.failed_handshakes += 1
+            logger.warning(f"[kTLS] Handshake with {peer} failed: {e}")
+            sock.close()
+            return
+
+        tx, rx = ktls_state(tls_sock)
+        version, cipher = tls_sock.version(), tls_sock.cipher()[0]
+        if tx and rx and tls_sock.pending() == 0:
+            # Kernel owns the record layer: continue on a plain TCP socket
+            plain = socket.socket(fileno=os.dup(tls_sock.fileno()))
+            tls_sock.close()    # Frees the SSL object; no close_notify is sent
+            plain.setblocking(False)
+            self.ktls_sessions += 1
+            logger.info(f"[kTLS] Session with {peer} offloaded ({version}, {cipher}) | "
+                        f"kTLS: {self.ktls_sessions}, "
+                        f"user-space: {self.userspace_sessions}")
+            reader, writer = await asyncio.open_connection(sock=plain)
+            await self._serve(reader, writer, peer)
+        else:
+            self.userspace_sessions += 1
+            logger.warning(f"[kTLS] {peer}: {cipher} not offloaded (tx={tx}, rx={rx}), "
+                           f"serving with user-space TLS")
+            # Own thread: a long-lived session must not hold a default executor
+            # worker, which the handshakes of new connections need
+            threading.Thread(target=self._serve_blocking, args=(tls_sock, peer),
+                             name=f"ktls-fallback-{peer}", daemon=True).start()
+
+    async def _serve_stream(self, reader, writer):
+        self.userspace_sessions += 1
+        await self._serve(reader, writer, writer.get_extra_info("peername")[0])
+
+    async def _serve(self, reader, writer, peer):
+        """Modbus/TCP request loop on the event loop (plaintext or asyncio TLS stream)"""
+        try:
+            while True:
+                header = await reader.readexactly(MBAP.size)
+                length = MBAP.unpack(header)[2]
+                if length < 2 or MBAP.size - 1 + length > MAX_ADU_LENGTH:
+                    logger.warning(f"[kTLS] Invalid MBAP length {length} from {peer}, closing")
+                    break
+                request = header + await reader.readexactly(length - 1)
+
+                response = self.handler.handle(peer, request)
+                if response:
+                    writer.write(response)
+                    await writer.drain()
+        except (asyncio.IncompleteReadError, ConnectionError, ssl.SSLError, asyncio.CancelledError):
+            pass
+        except OSError as e:
+            # EIO: non-data record (alert, close_notify) on a kTLS socket
+            logger.debug(f"[kTLS] {peer}: {e}")
+        finally:
+            writer.close()
+            with suppress(Exception, asyncio.CancelledError):
+                await writer.wait_closed()
+
+    def _serve_blocking(self, tls_sock, peer):
+        """User-space TLS fallback for one connection (its own thread)"""
+        try:
+            while True:
+                header = _recv_exactly(tls_sock, MBAP.size)
+                length = MBAP.unpack(header)[2]
+                if length < 2 or MBAP.size - 1 + length > MAX_ADU_LENGTH:
+                    break
+                response = self.thread_handler.handle(peer, header + _recv_exactly(tls_sock, length - 1))
+                if response:
+                    tls_sock.sendall(response)
+        except (ConnectionError, OSError):
+            pass
+        finally:
+            with suppress(OSError):
+                tls_sock.close()
+
+    def _call(self, fn, *args):
+        """Run fn on the datablock's event loop and wait for the result"""
+        async def run():
+            return fn(*args)
+        return asyncio.run_coroutine_threadsafe(run(), self.loop).result()
+
+
+def _recv_exactly(sock, size):
+    data = b""
+    while len(data) < size:
+        chunk = sock.recv(size - len(data))
+        if not chunk:
+            raise ConnectionError("connection closed")
+        data += chunk
+    return data
+
+
+# =============================================================================
+# BENCHMARK
+# =============================================================================
+
+class _BenchBlock:
+    """Register bank with the datablock interface used by the handler"""
+
+    def __init__(self):
+        self.values = [0] * 100
+
+    def setValues(self, address, values):
+        self.values[address:address + len(values)] = values
+
+    def getValues(self, address, count=1):
+        return self.values[address:address + count]
+
+    def validate(self, address, count=1):
+        return 0 <= address and address + count <= len(self.values)
+
+
+def _bench_server(ktls, port, certfile, keyfile, ready, done, conn):
+    """Server process: serve until `done`, then report its own CPU time"""
+    async def run():
+        sslctx = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+        sslctx.load_cert_chain(certfile, keyfile)
+        sslctx.maximum_version = ssl.TLSVersion.TLSv1_2
+        server = ModbusKTLSServer(_BenchBlock(), "127.0.0.1", port, sslctx, ktls=ktls)
+        await server.start()
+        start = resource.getrusage(resource.RUSAGE_SELF)
+        ready.set()
+        await asyncio.get_running_loop().run_in_executor(None, done.wait)
+        end = resource.getrusage(resource.RUSAGE_SELF)
+        conn.send({
+            "user": end.ru_utime - start.ru_utime,
+            "sys": end.ru_stime - start.ru_stime,
+            "ktls": server.ktls_sessions,
+            "userspace": server.userspace_sessions,
+        })
+        await server.stop()
+
+    logging.basicConfig(level=logging.WARNING)
+    asyncio.run(run())
+
+
+def _bench_client(port, requests, latencies):
+    """Lockstep FC16 writes of one 8-register frame, like the ESP32"""
+    ctx = ssl.SSLContext(ssl.PROTOCOL_TLS_CLIENT)
+    ctx.check_hostname = False
+    ctx.verify_mode = ssl.CERT_NONE
+    sock = ctx.wrap_socket(socket.create_connection(("127.0.0.1", port)))
+    sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+    pdu = bytes([0x10, 0, 0, 0, 8, 16]) + bytes(16)
+    for tid in range(requests):
+        request = MBAP.pack(tid & 0xFFFF, 0, len(pdu) + 1, 1) + pdu
+        t0 = time.perf_counter_ns()
+        sock.sendall(request)
+        _recv_exactly(sock, 12)
+        latencies.append(time.perf_counter_ns() - t0)
+    sock.close()
+
+
+def benchmark(connections, requests, certfile, keyfile, port=18802):
+    import multiprocessing
+
+    ok, reason = ktls_self_test(certfile, keyfile)
+    print(f"kTLS: {'available' if ok else 'NOT available'} - {reason}")
+    print(f"{connections} connection(s) x {requests} FC16 writes (8 registers), lockstep\n")
+    print(f"{'mode':<11} {'sessions':>14} {'p50 µs':>8} {'p99 µs':>8} "
+          f"{'req/s':>8} {'CPU µs/req':>11} {'sys %':>6}")
+
+    ctx = multiprocessing.get_context("fork")
+    for mode in ("user-space", "ktls"):
+        ready, done = ctx.Event(), ctx.Event()
+        parent, child = ctx.Pipe()
+        proc = ctx.Process(target=_bench_server,
+                           args=(mode == "ktls", port, certfile, keyfile, ready, done, child))
+        proc.start()
+        ready.wait(10)
+
+        latencies = []
+        threads = [threading.Thread(target=_bench_client, args=(port, requests, latencies))
+                   for _ in range(connections)]
+        start = time.perf_counter()
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+        elapsed = time.perf_counter() - start
+
+        done.set()
+        usage = parent.recv()
+        proc.join()
+
+        total = connections * requests
+        latencies.sort()
+        cpu = usage["user"] + usage["sys"]
+        sessions = f"{usage['ktls']} kTLS/{usage['userspace']} us"
+        print(f"{mode:<11} {sessions:>14} {statistics.median(latencies) / 1000:8.1f} "
+              f"{latencies[int(len(latencies) * 0.99)] / 1000:8.1f} {total / elapsed:8.0f} "
+              f"{cpu / total * 1e6:11.1f} {100 * usage['sys'] / cpu if cpu else 0:6.1f}")
+        port += 1
+
+
+def main():
+    parser = argparse.ArgumentParser(description="RPI#1 kTLS Modbus/TLS server")
+    parser.add_argument("--check", action="store_true", help="Run the kTLS self-test")
+    parser.add_argument("--bench", action="store_true", help="Benchmark kTLS vs user-space TLS")
+    parser.add_argument("--connections", type=int, default=4)
+    parser.add_argument("--requests", type=int, default=5000, help="Writes per connection")
+    parser.add_argument("--cert", default="server.crt")
+    parser.add_argument("--key", default="server.key")
+    args = parser.parse_args()
+
+    if args.check:
+        ok, reason = ktls_self_test(args.cert, args.key)
+        print(f"{'✓' if ok else '✗'} kTLS {'available' if ok else 'not available'}: {reason}")
+        stats = tls_stat()
+        if stats:
+            print("  " + " ".join(f"{k}={v}" for k, v in stats.items()))
+    if args.bench:
+        benchmark(args.connections, args.requests, args.cert, args.key)
+    if not (args.check or args.bench):
+        parser.print_help()
+
+
+if __name__ == "__main__":
+    main()
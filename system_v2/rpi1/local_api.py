@@ -0,0 +1,201 @@
+"""
+RPI#1 Local Read API (same host only)
+
+Lets co-located tools (dashboards, loggers, historian) read telemetry
+without opening Modbus TCP sessions:
+
+  1. Shared-memory snapshot (SHM_PATH, seqlock): latest frame, read at
+     memory speed by any number of processes, never blocks the server.
+  2. Unix-domain socket (SOCKET_PATH): change-notification stream, one
+     fixed-size record pushed to every subscriber per received frame.
+
+Frame record (little-endian, 28 bytes, FRAME):
+  u32  generation     Frame generation (holding register 8: 1-65535, wraps)
+  u64  rx_time_ns     Unix time the frame was received (ns)
+  u16  registers[8]   Holding registers 0-7 (same encoding as REGISTER_MAP.md)
+
+Shared memory layout (32 bytes):
+  u32  seq            Seqlock counter (odd while the writer is updating)
+  ...  FRAME          Latest frame
+
+Usage:
+  python3 local_api.py --read     # Print current snapshot
+  python3 local_api.py --watch    # Follow the notification stream
+"""
+
+import argparse
+import asyncio
+import logging
+import mmap
+import os
+import socket
+import struct
+import time
+
+logger = logging.getLogger(__name__)
+
+# =============================================================================
+# CONFIGURATION
+# =============================================================================
+
+SHM_PATH = "/dev/shm/rpi1_meter"
+SOCKET_PATH = "/tmp/rpi1_meter.sock"
+MAX_SUBSCRIBER_BUFFER = 64 * 1024  # Drop subscribers that stop reading
+
+FRAME = struct.Struct("<IQ8H")
+SEQ = struct.Struct("<I")
+SHM_SIZE = SEQ.size + FRAME.size
+
+# =============================================================================
+# SERVER SIDE
+# =============================================================================
+
+class LocalTelemetryAPI:
+    """
+    Publishes every complete frame to shared memory and Unix-socket subscribers
+
+    publish() is called from the datablock's setValues() on the asyncio
+    thread; it only does in-memory writes and non-blocking socket writes.
+    """
+
+    def __init__(self, shm_path=SHM_PATH, socket_path=SOCKET_PATH):
+        self.shm_path = shm_path
+        self.socket_path = socket_path
+        self.shm = None
+        self.seq = 0
+        self.generation = 0
+        self.subscribers = set()
+        self.server = None
+
+    async def start(self):
+        """Create the shared memory file and start the notification socket"""
+        fd = os.open(self.shm_path, os.O_RDWR | os.O_CREAT | os.O_TRUNC, 0o644)
+        try:
+            os.ftruncate(fd, SHM_SIZE)
+            self.shm = mmap.mmap(fd, SHM_SIZE)
+        finally:
+            os.close(fd)
+
+        if os.path.exists(self.socket_path):
+            os.unlink(self.socket_path)
+        self.server = await asyncio.start_unix_server(self._on_subscriber, path=self.socket_path)
+        os.chmod(self.socket_path, 0o666)
+
+        logger.info(f"Local API: snapshot {self.shm_path}, notifications {self.socket_path}")
+
+    async def stop(self):
+        """Close subscribers, socket and shared memory"""
+        if self.server:
+            self.server.close()
+            await self.server.wait_closed()
+            self.server = None
+        for writer in list(self.subscribers):
+            writer.close()
+        self.subscribers.clear()
+        for path in (self.socket_path, self.shm_path):
+            if os.path.exists(path):
+                os.unlink(path)
+        if self.shm:
+            self.shm.close()
+            self.shm = None
+
+    async def _on_subscriber(self, reader, writer):
+        """Register subscriber and send the current frame immediately"""
+        self.subscribers.add(writer)
+        logger.info(f"Local API subscriber connected (total: {len(self.subscribers)})")
+        if self.generation and self.shm:
+            writer.write(bytes(self.shm[SEQ.size:SHM_SIZE]))
+
+        try:
+            # Subscribers never send; wait for EOF
+            await reader.read()
+        except (ConnectionError, asyncio.CancelledError):
+            pass
+        finally:
+            self.subscribers.discard(writer)
+            writer.close()
+            logger.info(f"Local API subscriber disconnected (total: {len(self.subscribers)})")
+
+    def publish(self, generation, registers):
+        """Store a complete frame and its datablock generation in the snapshot, notify subscribers"""
+        if self.shm is None:
+            return
+
+        self.generation = generation
+        record = FRAME.pack(self.generation, time.time_ns(), *registers[:8])
+
+        # Seqlock write: odd sequence while the payload is inconsistent
+        self.seq += 1
+        SEQ.pack_into(self.shm, 0, self.seq)
+        self.shm[SEQ.size:SHM_SIZE] = record
+        self.seq += 1
+        SEQ.pack_into(self.shm, 0, self.seq)
+
+        for writer in list(self.subscribers):
+            if writer.transport.get_write_buffer_size() > MAX_SUBSCRIBER_BUFFER:
+                logger.warning("Local API subscriber too slow, disconnecting")
+                self.subscribers.discard(writer)
+                writer.close()
+                continue
+            writer.write(record)
+
+# =============================================================================
+# CLIENT SIDE
+# =============================================================================
+
+class LocalTelemetryReader:
+    """Lock-free snapshot reader for the shared-memory frame"""
+
+    def __init__(self, shm_path=SHM_PATH):
+        fd = os.open(shm_path, os.O_RDONLY)
+        try:
+            self.shm = mmap.mmap(fd, SHM_SIZE, prot=mmap.PROT_READ)
+        finally:
+            os.close(fd)
+
+    def read(self):
+        """Return (generation, rx_time_ns, registers) from a consistent snapshot"""
+        while True:
+            seq1 = SEQ.unpack_from(self.shm, 0)[0]
+            if seq1 & 1:
+                continue
+            data = self.shm[SEQ.size:SHM_SIZE]
+            if SEQ.unpack_from(self.shm, 0)[0] == seq1:
+                generation, rx_time_ns, *registers = FRAME.unpack(data)
+                return generation, rx_time_ns, registers
+
+    def close(self):
+        self.shm.close()
+
+
+def format_frame(generation, rx_time_ns, registers):
+    age_ms = (time.time_ns() - rx_time_ns) / 1e6
+    return (f"gen={generation} age={age_ms:.1f}ms | P_ac={registers[0]}W P_dc={registers[1]}W "
+            f"V_dc={registers[2] / 10:.1f}V I_dc={registers[3] / 100:.2f}A G={registers[4]}W/m² "
+            f"T_cell={registers[5] / 10:.1f}°C t={(registers[6] << 16) | registers[7]}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="RPI#1 local read API client")
+    parser.add_argument("--read", action="store_true", help="Print the shared-memory snapshot")
+    parser.add_argument("--watch", action="store_true", help="Follow the notification stream")
+    args = parser.parse_args()
+
+    if args.watch:
+        sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        sock.connect(SOCKET_PATH)
+        stream = sock.makefile("rb")
+        while True:
+            record = stream.read(FRAME.size)
+            if len(record) < FRAME.size:
+                break
+            generation, rx_time_ns, *registers = FRAME.unpack(record)
+            print(format_frame(generation, rx_time_ns, registers))
+    else:
+        reader = LocalTelemetryReader()
+        print(format_frame(*reader.read()))
+        reader.close()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,126 @@
+"""
+RPI#1 Sequenced Modbus Request Handling (idempotent ESP32 writes)
+
+Shared by the ESP32 transports that carry a frame sequence number:
+  - Modbus/UDP over DTLS 1.2 (dtls_server.py)
+  - Modbus/TCP over TLS 1.3 with 0-RTT (tls13_server.py)
+Also used unsequenced (every write applied) by the kTLS server (ktls_server.py).
+
+Sequence numbers:
+  The MBAP transaction id is the ESP32's frame sequence number. A request
+  whose sequence is not newer than the last applied one from that peer
+  (retransmission after a lost response, replayed early data, or a
+  reordered old frame) is acknowledged without touching the datablock, so
+  the generation counter and local API see every frame exactly once and
+  never move backwards.
+
+Supported function codes: FC16 (write multiple registers), FC03 (read).
+Requests are checked like pymodbus does: counts and lengths (exception
+0x03), then the range against datablock.validate() (exception 0x02).
+"""
+
+import logging
+import struct
+
+logger = logging.getLogger(__name__)
+
+MBAP = struct.Struct(">HHHB")
+SEQ_WINDOW = 0x8000          # Sequence numbers within half the space are "old"
+
+# Exception codes (as pymodbus answers them)
+ILLEGAL_FUNCTION = 0x01
+ILLEGAL_ADDRESS = 0x02
+ILLEGAL_VALUE = 0x03
+
+
+def seq_is_newer(seq, last):
+    """Serial-number arithmetic on 16-bit sequence numbers (RFC 1982)"""
+    return last is None or 0 < ((seq - last) & 0xFFFF) < SEQ_WINDOW
+
+
+class SequencedModbusHandler:
+    """
+    Decode one Modbus ADU (MBAP + PDU), apply it at most once per sequence
+
+    call(fn, *args) runs fn where the datablock lives (directly on the
+    asyncio loop, or marshalled from a worker thread). With sequenced=False
+    the transaction id is not a frame sequence and every write is applied.
+    """
+
+    def __init__(self, datablock, call, transport, sequenced=True):
+        self.datablock = datablock
+        self.call = call
+        self.transport = transport
+        self.sequenced = sequenced
+        self.last_seq = {}           # peer IP -> last applied sequence
+        self.new_session = set()     # Peers whose next frame is the first of a new session
+        self.total_frames = 0
+        self.total_duplicates = 0
+
+    def reset(self, peer):
+        """Forget the peer's sequence (new sender state, e.g. ESP32 reboot)"""
+        self.last_seq.pop(peer, None)
+
+    def session_started(self, peer):
+        """
+        New session from peer, full or resumed handshake unknown: keep the
+        sequence, and let the first frame tell whether the sender restarted
+
+        A frame re-sent after a re-handshake carries the last sequence (or a
+        newer one if it was never applied). A first frame behind the window
+        that is not the last sequence can only come from a sender that
+        restarted its sequence, and resets it.
+        """
+        self.new_session.add(peer)
+
+    def handle(self, peer, request):
+        """Return the response ADU, or None for a malformed request"""
+        if len(request) < MBAP.size + 1:
+            return None
+        tid, proto, _, unit = MBAP.unpack_from(request)
+        pdu = request[MBAP.size:]
+        fc = pdu[0]
+
+        def reply(body):
+            return MBAP.pack(tid, proto, len(body) + 1, unit) + body
+
+        def exception(code):
+            return reply(bytes([fc | 0x80, code]))
+
+        if fc == 0x10 and len(pdu) >= 6:
+            address, count, nbytes = struct.unpack_from(">HHB", pdu, 1)
+            if not 1 <= count <= 123 or nbytes != 2 * count or len(pdu) != 6 + nbytes:
+                return exception(ILLEGAL_VALUE)
+            if not self.datablock.validate(address, count):
+                return exception(ILLEGAL_ADDRESS)
+            values = list(struct.unpack_from(f">{count}H", pdu, 6))
+
+            if self.sequenced and peer in self.new_session:
+                self.new_session.discard(peer)
+                last = self.last_seq.get(peer)
+                if last is not None and tid != last and not seq_is_newer(tid, last):
+                    logger.info(f"[{self.transport}] {peer} restarted its sequence "
+                                f"(seq={tid}, last={last})")
+                    self.reset(peer)
+
+            if not self.sequenced or seq_is_newer(tid, self.last_seq.get(peer)):
+                self.call(self.datablock.setValues, address, values)
+                self.last_seq[peer] = tid
+                self.total_frames += 1
+            else:
+                # Retransmission, replay or stale frame: acknowledge, do not re-apply
+                self.total_duplicates += 1
+                logger.info(f"[{self.transport}] Duplicate/stale frame seq={tid} from {peer} "
+                            f"(last={self.last_seq.get(peer)}), acknowledged")
+            return reply(struct.pack(">BHH", fc, address, count))
+
+        if fc == 0x03 and len(pdu) >= 5:
+            address, count = struct.unpack_from(">HH", pdu, 1)
+            if not 1 <= count <= 125:
+                return exception(ILLEGAL_VALUE)
+            if not self.datablock.validate(address, count):
+                return exception(ILLEGAL_ADDRESS)
+            values = self.call(self.datablock.getValues, address, count)
+            return reply(struct.pack(f">BB{count}H", fc, 2 * count, *values))
+
+        return exception(ILLEGAL_FUNCTION)
@@ -32,6 +32,14 @@ from pymodbus.datastore import (
 )
 from pymodbus.server import StartAsyncTlsServer, StartAsyncTcpServer
 
+from local_api import LocalTelemetryAPI, SHM_PATH, SOCKET_PATH
+from dtls_server import ModbusDTLSServer
+from tls13_server import ModbusTLS13Server
+from ktls_server import ModbusKTLSServer, ktls_self_test
+from time_service import (
+    TIME_SERVICE_BASE, TIME_SERVICE_COUNT, CLOCK_REPORT_COUNT, time_registers, decode_clock_report,
+)
+
 # =============================================================================
 # CONFIGURATION
 # =============================================================================
@@ -45,10 +53,50 @@ UNIT_ID = 1                # Modbus device ID
 TLS_BIND_ADDRESS = "0.0.0.0"
 TLS_BIND_PORT = 802
 
+# DTLS Server Configuration (optional Modbus/UDP transport for ESP32, see dtls_server.py)
+DTLS_ENABLED = False
+DTLS_BIND_ADDRESS = "0.0.0.0"
+DTLS_BIND_PORT = 802         # udp/802 (TLS uses tcp/802)
+
+# TLS 1.3 Server Configuration (optional sequenced transport for ESP32, see tls13_server.py)
+TLS13_ENABLED = False
+TLS13_BIND_ADDRESS = "0.0.0.0"
+TLS13_BIND_PORT = 803
+
+# Kernel TLS offload for the TLS server on TLS_BIND_PORT (see ktls_server.py)
+# Falls back to the pymodbus TLS server if the startup self-test fails
+KTLS_ENABLED = False
+
+# Session tickets on the TLS server (resumed handshakes for reconnecting clients)
+TLS_SESSION_TICKETS = 2
+
 # Certificate files (copied from system_v1)
 SERVER_CERT = "server.crt"
 SERVER_KEY = "server.key"
 
+# Frame generation register (incremented with every complete ESP32 frame)
+GENERATION_REGISTER = 8
+
+# ESP32 runtime status block (FreeRTOS CPU/stack/heap, see esp32/include/rtos_stats.h)
+ESP32_STATUS_REGISTER = 16
+ESP32_STATUS_COUNT = 18
+ESP32_STATUS_TASKS = ["loopTask", "tiT", "wifi", "sys_evt", "esp_timer"]
+
+# Long-poll ("wait for change") read window
+# FC03 read of up to 9 registers at LONGPOLL_BASE + (last_generation & 0xFF) is held
+# until the generation's low byte differs from the requested one or the timeout
+# expires, then answered with registers 0-8.
+LONGPOLL_BASE = 0x1000
+LONGPOLL_TIMEOUT_SEC = 5.0      # Keep below the client's response timeout
+
+# Time service (common timebase for ESP32/Opta latency measurement, see time_service.py)
+# FC03 of TIME_SERVICE_BASE (0x2000), 8 registers: monotonic ns + UTC ns, sampled together
+TIME_SERVICE_ENABLED = True
+CLOCK_REPORT_REGISTER = 40      # ESP32 writes its estimated offset here (6 registers)
+
+# Local read API (shared-memory snapshot + Unix-socket notifications, see local_api.py)
+LOCAL_API_ENABLED = True
+
 # =============================================================================
 # LOGGING SETUP
 # =============================================================================
@@ -73,7 +121,10 @@ def build_ssl_context(certfile=SERVER_CERT, keyfile=SERVER_KEY):
     try:
         sslctx = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
         sslctx.load_cert_chain(certfile=certfile, keyfile=keyfile)
+        # TLS 1.3 where the client supports it (ESP32 core 2.x / mbedTLS 2.28 stops at 1.2)
         sslctx.minimum_version = ssl.TLSVersion.TLSv1_2
+        sslctx.maximum_version = ssl.TLSVersion.TLSv1_3
+        sslctx.num_tickets = TLS_SESSION_TICKETS
         logger.info(f"SSL context created with cert={certfile}, key={keyfile}")
         return sslctx
     except Exception as e:
@@ -91,6 +142,11 @@ class SmartMeterDataBlock(ModbusSequentialDataBlock):
     2. Serves reads to Arduino Opta (Ethernet interface)
 
     Tracks statistics for received (from ESP32) and served (to Opta) data.
+
+    Register 8 (GENERATION_REGISTER) holds a frame generation counter
+    (1..65535, wraps to 1; 0 = no frame yet). It is written in the same
+    setValues() call as the frame, so a read of registers 0-8 always returns
+    a frame together with its own generation. Writes to it are overridden.
     """
 
     def __init__(self, address, values):
@@ -98,6 +154,12 @@ class SmartMeterDataBlock(ModbusSequentialDataBlock):
         self.total_received = 0
         self.total_served = 0
         self.last_update = None
+        self.local_api = None
+        self.generation = 0
+        self.frame_event = asyncio.Event()   # Replaced after every frame
+        self.longpoll_waiting = 0
+        self.longpoll_timeouts = 0
+        self.time_requests = 0
 
     def setValues(self, address, values):
         """
@@ -112,10 +174,32 @@ class SmartMeterDataBlock(ModbusSequentialDataBlock):
         start = int(address)
         end = start + len(values) - 1
 
+        if start <= GENERATION_REGISTER <= end:
+            # Generation register is read-only for clients
+            super().setValues(GENERATION_REGISTER, [self.generation & 0xFFFF])
+
+        if start == ESP32_STATUS_REGISTER and len(values) >= ESP32_STATUS_COUNT:
+            self._log_esp32_status(values)
+
+        if start == CLOCK_REPORT_REGISTER and len(values) >= CLOCK_REPORT_COUNT:
+            offset_us, rtt_us = decode_clock_report(values)
+            logger.info(f"[ESP32 CLOCK] offset={offset_us / 1000:+.3f} ms "
+                        f"(RPI#1 monotonic - ESP32) rtt={rtt_us / 1000:.2f} ms")
+
         if end < 0 or start > 7:
             # Outside our telemetry range, ignore
             return
 
+        # Complete frame: advance generation before any reader can run
+        complete = start <= 0 and end >= 7
+        if complete:
+            self.generation = self.generation % 0xFFFF + 1
+            super().setValues(GENERATION_REGISTER, [self.generation])
+
+            # Release long-poll readers (they resume after this call returns)
+            self.frame_event.set()
+            self.frame_event = asyncio.Event()
+
         # Read back the complete 8-register block for logging
         regs = self.getValues(0, 8)
 
@@ -134,10 +218,32 @@ class SmartMeterDataBlock(ModbusSequentialDataBlock):
         self.total_received += 1
         self.last_update = datetime.now(timezone.utc)
 
+        # Publish complete frames to local consumers (memory write + non-blocking socket writes)
+        if self.local_api and complete:
+            self.local_api.publish(self.generation, regs)
+
         logger.info(
             f"[RX FROM ESP32 via TLS] {ts.isoformat()} | "
             f"P_ac={P_ac:.1f}W P_dc={P_dc:.1f}W V_dc={V_dc:.2f}V I_dc={I_dc:.2f}A "
-            f"G={G:.1f}W/m² T_cell={T_cell:.1f}°C | Total RX: {self.total_received}"
+            f"G={G:.1f}W/m² T_cell={T_cell:.1f}°C | Gen: {self.generation} | "
+            f"Total RX: {self.total_received}"
+        )
+
+    def _log_esp32_status(self, regs):
+        """Decode the ESP32 FreeRTOS status block for logging"""
+        def pct(value):
+            return "n/a" if value == 0xFFFF else f"{value / 100:.1f}%"
+
+        heap_free = (regs[1] << 16) | regs[2]
+        heap_min = (regs[3] << 16) | regs[4]
+        tasks = " ".join(
+            f"{name}={pct(regs[8 + 2 * i])}/{regs[9 + 2 * i]}B"
+            for i, name in enumerate(ESP32_STATUS_TASKS)
+            if regs[9 + 2 * i] != 0xFFFF
+        )
+        logger.info(
+            f"[ESP32 STATUS #{regs[0]}] heap={heap_free}B (min {heap_min}B) "
+            f"cpu0={pct(regs[5])} cpu1={pct(regs[6])} tasks={regs[7]} | {tasks}"
         )
 
     def getValues(self, address, count=1):
@@ -145,19 +251,57 @@ class SmartMeterDataBlock(ModbusSequentialDataBlock):
         Called when Opta reads data via Modbus TCP
 
         Logs read operations for telemetry registers and updates statistics.
+        Reads of the time service block sample the clocks at this point.
         """
+        if TIME_SERVICE_ENABLED and TIME_SERVICE_BASE <= address < TIME_SERVICE_BASE + TIME_SERVICE_COUNT:
+            self.time_requests += 1
+            offset = address - TIME_SERVICE_BASE
+            return time_registers()[offset:offset + count]
+
         values = super().getValues(address, count)
 
-        # Log only if reading complete telemetry block
-        if address == 0 and count == 8:
+        # Log only if reading complete telemetry block (with or without generation)
+        if address == 0 and count in (8, 9):
             self.total_served += 1
             logger.info(
-                f"[TX TO OPTA via TCP] Served registers 0-7 | "
+                f"[TX TO OPTA via TCP] Served registers 0-{count - 1} | "
                 f"Total served: {self.total_served}"
             )
 
         return values
 
+    def validate(self, address, count=1):
+        """Accept the long-poll window and the time service block in addition to the normal register range"""
+        if LONGPOLL_BASE <= address < LONGPOLL_BASE + 256:
+            return 0 < count <= GENERATION_REGISTER + 1
+        if TIME_SERVICE_ENABLED and TIME_SERVICE_BASE <= address < TIME_SERVICE_BASE + TIME_SERVICE_COUNT:
+            return 0 < count and address + count <= TIME_SERVICE_BASE + TIME_SERVICE_COUNT
+        return super().validate(address, count)
+
+    async def async_getValues(self, address, count=1):
+        """
+        Long-poll read: wait for a new frame, then serve registers 0..count-1
+
+        The low byte of the generation the client already has is encoded in
+        the address, so a frame that arrives between two long-polls is
+        returned immediately instead of being missed.
+        """
+        if not LONGPOLL_BASE <= address < LONGPOLL_BASE + 256:
+            return await super().async_getValues(address, count)
+
+        if (self.generation & 0xFF) == address - LONGPOLL_BASE:
+            event = self.frame_event
+            self.longpoll_waiting += 1
+            try:
+                await asyncio.wait_for(event.wait(), LONGPOLL_TIMEOUT_SEC)
+            except asyncio.TimeoutError:
+                # Answer with the unchanged frame; client simply polls again
+                self.longpoll_timeouts += 1
+            finally:
+                self.longpoll_waiting -= 1
+
+        return self.getValues(0, count)
+
 
 async def statistics_task(datablock):
     """
@@ -171,6 +315,9 @@ async def statistics_task(datablock):
                 f"[STATISTICS] "
                 f"Received (from ESP32): {datablock.total_received} | "
                 f"Served (to Opta): {datablock.total_served} | "
+                f"Long-poll waiting: {datablock.longpoll_waiting} "
+                f"(timeouts: {datablock.longpoll_timeouts}) | "
+                f"Time requests: {datablock.time_requests} | "
                 f"Last Update: {datablock.last_update.isoformat() if datablock.last_update else 'Never'}"
             )
 
@@ -200,8 +347,16 @@ async def main():
     logger.info(f"Configuration:")
     logger.info(f"  TLS Server (ESP32 writes): {TLS_BIND_ADDRESS}:{TLS_BIND_PORT}")
     logger.info(f"  TCP Server (Opta reads):   {BIND_ADDRESS}:{BIND_PORT}")
+    if DTLS_ENABLED:
+        logger.info(f"  DTLS Server (ESP32 writes): {DTLS_BIND_ADDRESS}:{DTLS_BIND_PORT}/udp")
+    if TLS13_ENABLED:
+        logger.info(f"  TLS 1.3 Server (ESP32 writes): {TLS13_BIND_ADDRESS}:{TLS13_BIND_PORT}")
     logger.info(f"  Unit ID: {UNIT_ID}")
+    if TIME_SERVICE_ENABLED:
+        logger.info(f"  Time Service: FC03 0x{TIME_SERVICE_BASE:04X}, {TIME_SERVICE_COUNT} registers")
     logger.info(f"  Certificates: {SERVER_CERT}, {SERVER_KEY}")
+    if LOCAL_API_ENABLED:
+        logger.info(f"  Local API: {SHM_PATH}, {SOCKET_PATH}")
     logger.info("=" * 80)
 
     # Create shared datablock for holding registers
@@ -213,6 +368,11 @@ async def main():
     # Create server context (single=True accepts any unit-id, standard for Modbus TCP)
     context = ModbusServerContext(devices=device, single=True)
 
+    # Start local read API for co-located consumers
+    if LOCAL_API_ENABLED:
+        datablock.local_api = LocalTelemetryAPI()
+        await datablock.local_api.start()
+
     # Start statistics task
     stats = asyncio.create_task(statistics_task(datablock))
     logger.info("Statistics task created")
@@ -220,24 +380,50 @@ async def main():
     # Build SSL context for TLS server
     sslctx = build_ssl_context()
 
+    # Optional DTLS server (runs in its own threads, applies writes on this loop)
+    dtls_server = None
+    if DTLS_ENABLED:
+        dtls_server = ModbusDTLSServer(
+            datablock, asyncio.get_running_loop(),
+            DTLS_BIND_ADDRESS, DTLS_BIND_PORT, SERVER_CERT, SERVER_KEY,
+        )
+        dtls_server.start()
+
+    # Optional kTLS server replaces the pymodbus TLS server on TLS_BIND_PORT
+    ktls_server = None
+    if KTLS_ENABLED:
+        ok, reason = ktls_self_test(SERVER_CERT, SERVER_KEY)
+        if ok:
+            logger.info(f"✓ kTLS self-test: {reason}")
+            ktls_server = ModbusKTLSServer(datablock, TLS_BIND_ADDRESS, TLS_BIND_PORT, sslctx)
+            await ktls_server.start()
+        else:
+            logger.warning(f"✗ kTLS self-test failed: {reason}; using user-space TLS")
+
+    # Optional TLS 1.3 server (sequenced frames, resumption, anti-replay)
+    tls13_server = None
+    if TLS13_ENABLED:
+        tls13_server = ModbusTLS13Server(
+            datablock, TLS13_BIND_ADDRESS, TLS13_BIND_PORT, SERVER_CERT, SERVER_KEY,
+        )
+        await tls13_server.start()
+
     logger.info(f"Starting Modbus TLS server on {TLS_BIND_ADDRESS}:{TLS_BIND_PORT}...")
     logger.info(f"Starting Modbus TCP server on {BIND_ADDRESS}:{BIND_PORT}...")
     logger.info("Waiting for:")
     logger.info("  - ESP32 to write data via TLS (WiFi interface)")
     logger.info("  - Opta to read data via TCP (Ethernet interface)")
 
+    servers = [StartAsyncTcpServer(context=context, address=(BIND_ADDRESS, BIND_PORT))]
+    if not ktls_server:
+        servers.append(StartAsyncTlsServer(
+            context=context,
+            address=(TLS_BIND_ADDRESS, TLS_BIND_PORT),
+            sslctx=sslctx,
+        ))
+
     try:
-        await asyncio.gather(
-            StartAsyncTlsServer(
-                context=context,
-                address=(TLS_BIND_ADDRESS, TLS_BIND_PORT),
-                sslctx=sslctx,
-            ),
-            StartAsyncTcpServer(
-                context=context,
-                address=(BIND_ADDRESS, BIND_PORT),
-            )
-        )
+        await asyncio.gather(*servers)
     except KeyboardInterrupt:
         logger.info("Keyboard interrupt received")
     except Exception as e:
@@ -250,6 +436,28 @@ async def main():
         except asyncio.CancelledError:
             pass
 
+        if datablock.local_api:
+            await datablock.local_api.stop()
+
+        if dtls_server:
+            dtls_server.stop()
+            logger.info(f"DTLS: {dtls_server.handler.total_frames} frames, "
+                        f"{dtls_server.handler.total_duplicates} duplicates, "
+                        f"{dtls_server.total_sessions} sessions")
+
+        if ktls_server:
+            await ktls_server.stop()
+            logger.info(f"kTLS: {ktls_server.ktls_sessions} offloaded / "
+                        f"{ktls_server.userspace_sessions} user-space sessions, "
+                        f"{ktls_server.failed_handshakes} failed handshakes")
+
+        if tls13_server:
+            await tls13_server.stop()
+            logger.info(f"TLS 1.3: {tls13_server.handler.total_frames} frames, "
+                        f"{tls13_server.handler.total_duplicates} duplicates/replays, "
+                        f"{tls13_server.full_handshakes} full / "
+                        f"{tls13_server.resumed_handshakes} resumed handshakes")
+
         # Report final statistics
         logger.info("=" * 80)
         logger.info("Smart Meter Server Shutdown (Dual Server Mode)")
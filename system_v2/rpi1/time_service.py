@@ -0,0 +1,174 @@
+"""
+RPI#1 Modbus Time Service
+
+Gives the ESP32, Opta and test tools a common timebase without an external
+NTP server. RPI#1 exposes its clocks in a holding register block that is
+read with one FC03; clients estimate their offset NTP-style.
+
+Time service block (FC03, TIME_SERVICE_BASE, 8 registers, read-only):
+  0-3: RPI#1 CLOCK_MONOTONIC in ns (u64, most significant word first)
+  4-7: RPI#1 UTC time in ns since 1970-01-01 (u64, most significant word first)
+Both clocks are sampled together when the request is processed.
+
+Offset estimation (client side):
+  t1 = local send time, t4 = local receive time, T = server time
+  offset = T - (t1 + t4) / 2      rtt = t4 - t1      error <= rtt / 2
+  A burst of samples is taken and the one with the lowest RTT is kept
+  (NTP clock filter): queueing delays only ever add to the RTT, so the
+  fastest exchange is the most symmetric one.
+
+Clock report block (FC16, written by clients, CLOCK_REPORT_COUNT registers):
+  0-3: estimated offset in µs, RPI#1 monotonic - client clock (i64, two's complement)
+  4-5: RTT of the sample it was taken from, in µs (u32)
+
+Usage (from any host on the Ethernet or WiFi segment):
+  python3 time_service.py --host 192.168.2.100
+  python3 time_service.py --host 192.168.2.100 --watch 10
+"""
+
+import argparse
+import socket
+import struct
+import time
+
+TIME_SERVICE_BASE = 0x2000
+TIME_SERVICE_COUNT = 8
+CLOCK_REPORT_COUNT = 6
+
+_U64 = struct.Struct(">Q")
+_MBAP = struct.Struct(">HHHB")
+
+
+def encode_u64(value):
+    """u64 → 4 registers (most significant word first)"""
+    return list(struct.unpack(">4H", _U64.pack(value & 0xFFFFFFFFFFFFFFFF)))
+
+
+def decode_u64(regs):
+    return _U64.unpack(struct.pack(">4H", *regs))[0]
+
+
+def time_registers():
+    """Sample both clocks back to back and encode the time service block"""
+    mono_ns = time.monotonic_ns()
+    utc_ns = time.time_ns()
+    return encode_u64(mono_ns) + encode_u64(utc_ns)
+
+
+def decode_clock_report(regs):
+    """Clock report block → (offset µs, rtt µs)"""
+    offset = decode_u64(regs[0:4])
+    if offset >= 1 << 63:
+        offset -= 1 << 64
+    return offset, (regs[4] << 16) | regs[5]
+
+
+class TimeServiceClient:
+    """
+    Minimal Modbus TCP client for the time service block
+
+    Uses a plain socket (no pymodbus) so that t1/t4 are taken right around
+    the send() and recv() calls.
+    """
+
+    def __init__(self, host, port=502, unit_id=1, timeout=2.0):
+        self.sock = socket.create_connection((host, port), timeout=timeout)
+        self.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self.unit_id = unit_id
+        self.tid = 0
+
+    def close(self):
+        self.sock.close()
+
+    def _recv(self, size):
+        data = b""
+        while len(data) < size:
+            chunk = self.sock.recv(size - len(data))
+            if not chunk:
+                raise ConnectionError("connection closed by server")
+            data += chunk
+        return data
+
+    def sample(self):
+        """
+        One exchange
+
+        Returns:
+            (t1, t4, server_mono_ns, server_utc_ns, local_utc_ns) with t1/t4
+            from the local monotonic clock
+        """
+        self.tid = (self.tid + 1) & 0xFFFF
+        request = _MBAP.pack(self.tid, 0, 6, self.unit_id) + struct.pack(
+            ">BHH", 0x03, TIME_SERVICE_BASE, TIME_SERVICE_COUNT)
+
+        local_utc = time.time_ns()
+        t1 = time.monotonic_ns()
+        self.sock.sendall(request)
+        header = self._recv(_MBAP.size)
+        t4 = time.monotonic_ns()
+        local_utc += (t4 - t1) // 2
+
+        tid, _, length, _ = _MBAP.unpack(header)
+        pdu = self._recv(length - 1)
+        if tid != self.tid:
+            raise ValueError(f"transaction id mismatch ({tid} != {self.tid})")
+        if pdu[0] & 0x80:
+            raise ValueError(f"exception response 0x{pdu[1]:02x} (time service not available?)")
+        regs = struct.unpack(f">{TIME_SERVICE_COUNT}H", pdu[2:2 + 2 * TIME_SERVICE_COUNT])
+        return t1, t4, decode_u64(regs[0:4]), decode_u64(regs[4:8]), local_utc
+
+    def estimate(self, count=8):
+        """
+        Burst of `count` exchanges, keep the lowest-RTT sample
+
+        Returns:
+            dict with offset_mono_ns (server monotonic - local monotonic),
+            offset_utc_ns (server UTC - local UTC), rtt_ns, rtt_max_ns, samples
+        """
+        best = None
+        rtt_max = 0
+        for _ in range(count):
+            t1, t4, mono, utc, local_utc = self.sample()
+            rtt = t4 - t1
+            rtt_max = max(rtt_max, rtt)
+            if best is None or rtt < best[0]:
+                best = (rtt, mono - (t1 + t4) // 2, utc - local_utc)
+
+        rtt, offset_mono, offset_utc = best
+        return {
+            "offset_mono_ns": offset_mono,
+            "offset_utc_ns": offset_utc,
+            "rtt_ns": rtt,
+            "rtt_max_ns": rtt_max,
+            "samples": count,
+        }
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Estimate the clock offset to the RPI#1 time service")
+    parser.add_argument("--host", default="192.168.2.100", help="RPI#1 address (default Ethernet IP)")
+    parser.add_argument("--port", type=int, default=502)
+    parser.add_argument("--unit", type=int, default=1)
+    parser.add_argument("--samples", type=int, default=8, help="Exchanges per estimate (default 8)")
+    parser.add_argument("--watch", type=float, metavar="SEC", help="Repeat every SEC seconds")
+    args = parser.parse_args()
+
+    client = TimeServiceClient(args.host, args.port, args.unit)
+    try:
+        while True:
+            est = client.estimate(args.samples)
+            print(f"offset mono={est['offset_mono_ns'] / 1e6:+.3f} ms "
+                  f"utc={est['offset_utc_ns'] / 1e6:+.3f} ms | "
+                  f"rtt={est['rtt_ns'] / 1e3:.0f} µs (max {est['rtt_max_ns'] / 1e3:.0f} µs, "
+                  f"error ≤ {est['rtt_ns'] / 2e3:.0f} µs)")
+            if args.watch is None:
+                break
+            time.sleep(args.watch)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        client.close()
+
+
+if __name__ == "__main__":
+    main()
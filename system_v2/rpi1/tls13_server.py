@@ -0,0 +1,106 @@
+"""
+RPI#1 Sequenced Modbus/TCP over TLS 1.3 Server (ESP32 write path)
+
+Optional alternative to the pymodbus TLS server for ESP32 firmware built
+with MODBUS_TRANSPORT_TLS13 (esp32/src/modbus_tls13.cpp). TLS 1.3 only,
+with session tickets so a reconnect after a WiFi blip is a PSK resumption
+(no certificate, no signature) instead of a full handshake.
+
+Architecture:
+  ESP32 --[WiFi, Modbus/TCP + TLS 1.3, tcp/803]--> RPI#1 (SmartMeterDataBlock)
+
+Anti-replay:
+  Every request carries the ESP32's frame sequence number in the MBAP
+  transaction id and is applied at most once per peer (sequenced_modbus.py),
+  so a replayed 0-RTT flight or a frame re-sent after a reconnect is only
+  acknowledged. The sequence window is kept across resumed sessions and
+  reset on full handshakes only: the ESP32 keeps its ticket in RAM, so a
+  reboot (which restarts the sequence) always starts with a full handshake,
+  and a full handshake cannot be replayed.
+
+0-RTT:
+  Python's ssl module has no early-data API (OpenSSL max_early_data stays
+  0), so tickets issued here do not offer 0-RTT and the ESP32 sends the
+  first frame right after the 1-RTT resumed handshake. The client side and
+  the sequence check above are ready for a server that accepts early data.
+"""
+
+import asyncio
+import logging
+import ssl
+from contextlib import suppress
+
+from sequenced_modbus import MBAP, SequencedModbusHandler
+
+logger = logging.getLogger(__name__)
+
+SESSION_TICKETS = 2          # NewSessionTicket messages per handshake (one spare)
+MAX_ADU_LENGTH = 260         # Modbus/TCP ADU limit (MBAP length field <= 254)
+
+
+def build_tls13_context(certfile, keyfile):
+    """TLS 1.3-only server context with session tickets"""
+    sslctx = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+    sslctx.load_cert_chain(certfile=certfile, keyfile=keyfile)
+    sslctx.minimum_version = ssl.TLSVersion.TLSv1_3
+    sslctx.maximum_version = ssl.TLSVersion.TLSv1_3
+    sslctx.num_tickets = SESSION_TICKETS
+    return sslctx
+
+
+class ModbusTLS13Server:
+    """
+    asyncio TLS 1.3 listener; requests are applied on the datablock's loop
+    """
+
+    def __init__(self, datablock, address, port, certfile, keyfile):
+        self.address = address
+        self.port = port
+        self.sslctx = build_tls13_context(certfile, keyfile)
+        self.handler = SequencedModbusHandler(datablock, lambda fn, *args: fn(*args), "TLS1.3")
+        self.server = None
+        self.full_handshakes = 0
+        self.resumed_handshakes = 0
+
+    async def start(self):
+        self.server = await asyncio.start_server(
+            self._on_client, self.address, self.port, ssl=self.sslctx)
+        logger.info(f"Modbus TLS 1.3 server listening on {self.address}:{self.port}")
+
+    async def stop(self):
+        if self.server:
+            self.server.close()
+            await self.server.wait_closed()
+
+    async def _on_client(self, reader, writer):
+        peer = writer.get_extra_info("peername")[0]
+        resumed = writer.get_extra_info("ssl_object").session_reused
+
+        if resumed:
+            self.resumed_handshakes += 1
+        else:
+            # New sender state possible (e.g. ESP32 reboot restarts its sequence)
+            self.handler.reset(peer)
+            self.full_handshakes += 1
+        logger.info(f"TLS 1.3 session with {peer} ({'resumed' if resumed else 'full handshake'}, "
+                    f"full: {self.full_handshakes}, resumed: {self.resumed_handshakes})")
+
+        try:
+            while True:
+                header = await reader.readexactly(MBAP.size)
+                length = MBAP.unpack(header)[2]
+                if length < 2 or MBAP.size - 1 + length > MAX_ADU_LENGTH:
+                    logger.warning(f"[TLS1.3] Invalid MBAP length {length} from {peer}, closing")
+                    break
+                request = header + await reader.readexactly(length - 1)
+
+                response = self.handler.handle(peer, request)
+                if response:
+                    writer.write(response)
+                    await writer.drain()
+        except (asyncio.IncompleteReadError, ConnectionError, ssl.SSLError, asyncio.CancelledError):
+            pass
+        finally:
+            writer.close()
+            with suppress(Exception, asyncio.CancelledError):
+                await writer.wait_closed()
@@ -0,0 +1,397 @@
+"""
+RPI#2 Alarm Rule Engine
+
+Evaluates declarative alarm rules (config.ALARM_RULES) on every Modbus frame
+from every controller. Rules are compiled once at load time into a single
+flat Python function (straight-line code, constants folded in, no per-rule
+dispatch); per-controller state is kept in flat lists and only state
+transitions produce events.
+
+Rule types (one dict per rule):
+  threshold   value  <op> limit
+  rate        d(value)/dt <op> limit   (units per second, "abs": True for |rate|)
+
+Modifiers (any rule):
+  hysteresis  clear only once the value is back by more than this amount
+  delay_s     time qualification: condition must hold continuously this long
+  when        guard condition {"measurement", "op", "limit"} (AND)
+
+Architecture:
+  Opta --[Modbus write]--> GatewayDataBlock --callback--> AlarmEngine.evaluate(unit, values)
+                                                            |  compiled program (per frame)
+                                                            +--> [ALARM] log + ALARM_EVENT_LOG (JSON lines)
+                                                            +--> embedded IEC 61850 server GGIOn.IndN (MMS reports)
+
+Benchmark (no gateway needed):
+  python3 alarm_engine.py --bench --rules 300
+"""
+
+import argparse
+import json
+import logging
+import random
+import time
+from datetime import datetime, timezone
+
+import config
+
+logger = logging.getLogger(__name__)
+
+MEASUREMENTS = ("P_ac", "V_dc", "I_dc", "G")
+OPERATORS = (">", ">=", "<", "<=")
+RULE_TYPES = ("threshold", "rate")
+
+
+class AlarmRule:
+    """Validated rule specification (see module docstring)"""
+
+    def __init__(self, name, measurement, op, limit, type="threshold", hysteresis=0.0,
+                 delay_s=0.0, when=None, abs=False, severity="warning"):
+        if type not in RULE_TYPES:
+            raise ValueError(f"{name}: unknown rule type '{type}'")
+        for m, o in [(measurement, op)] + ([(when["measurement"], when["op"])] if when else []):
+            if m not in MEASUREMENTS:
+                raise ValueError(f"{name}: unknown measurement '{m}'")
+            if o not in OPERATORS:
+                raise ValueError(f"{name}: unsupported operator '{o}'")
+        self.name = name
+        self.measurement = measurement
+        self.op = op
+        self.limit = float(limit)
+        self.type = type
+        self.hysteresis = float(hysteresis)
+        self.delay_s = float(delay_s)
+        self.when = dict(when, limit=float(when["limit"])) if when else None
+        self.abs = bool(abs)
+        self.severity = severity
+
+    def describe(self):
+        subject = self.measurement if self.type == "threshold" else f"d{self.measurement}/dt"
+        if self.abs:
+            subject = f"|{subject}|"
+        text = f"{subject} {self.op} {self.limit:g}"
+        if self.when:
+            text += f" and {self.when['measurement']} {self.when['op']} {self.when['limit']:g}"
+        if self.delay_s:
+            text += f" for {self.delay_s:g}s"
+        return text
+
+
+# =============================================================================
+# COMPILER
+# =============================================================================
+
+def _relaxed_limit(rule):
+    """Limit used while the alarm is active (hysteresis towards clearing)"""
+    if rule.op in (">", ">="):
+        return rule.limit - rule.hysteresis
+    return rule.limit + rule.hysteresis
+
+
+def compile_rules(rules):
+    """
+    Compile rules into one evaluation function
+
+    Returns:
+        (program, source, rate_count) where program(m, t, st) takes the
+        measurement dict, a monotonic time in seconds and a ControllerState,
+        updates the state in place and returns a list of (rule index, active)
+        transitions; source is its generated code and rate_count the number
+        of measurements it keeps a previous value of (ControllerState.prev)
+    """
+    rate_measurements = sorted({r.measurement for r in rules if r.type == "rate"})
+    used = sorted({r.measurement for r in rules}
+                  | {r.when["measurement"] for r in rules if r.when})
+
+    lines = [
+        "def program(m, t, st):",
+        "    a = st.active",
+        "    ch = []",
+    ]
+    if any(r.delay_s for r in rules):
+        lines.append("    since = st.since")
+    for name in used:
+        lines.append(f"    {name} = m[{name!r}]")
+    if rate_measurements:
+        lines += [
+            "    prev = st.prev",
+            "    dt = t - st.prev_t",
+            "    ok = st.prev_t >= 0.0 and dt > 0.0",
+        ]
+        for k, name in enumerate(rate_measurements):
+            lines.append(f"    d_{name} = ({name} - prev[{k}]) / dt if ok else 0.0")
+
+    for i, r in enumerate(rules):
+        subject = r.measurement if r.type == "threshold" else f"d_{r.measurement}"
+        if r.abs:
+            subject = f"abs({subject})"
+        lines.append(f"    # [{i}] {r.name}: {r.describe()}")
+        if r.hysteresis:
+            lines.append(f"    c = ({subject} {r.op} {_relaxed_limit(r)!r}) if a[{i}] "
+                         f"else ({subject} {r.op} {r.limit!r})")
+        else:
+            lines.append(f"    c = {subject} {r.op} {r.limit!r}")
+        if r.when:
+            w = r.when
+            lines.append(f"    c = c and {w['measurement']} {w['op']} {w['limit']!r}")
+
+        if r.delay_s:
+            lines += [
+                "    if c:",
+                f"        if since[{i}] < 0.0:",
+                f"            since[{i}] = t",
+                f"        if not a[{i}] and t - since[{i}] >= {r.delay_s!r}:",
+                f"            a[{i}] = True",
+                f"            ch.append(({i}, True))",
+                "    else:",
+                f"        since[{i}] = -1.0",
+                f"        if a[{i}]:",
+                f"            a[{i}] = False",
+                f"            ch.append(({i}, False))",
+            ]
+        else:
+            lines += [
+                f"    if c is not a[{i}]:",
+                f"        a[{i}] = c",
+                f"        ch.append(({i}, c))",
+            ]
+
+    for k, name in enumerate(rate_measurements):
+        lines.append(f"    prev[{k}] = {name}")
+    if rate_measurements:
+        lines.append("    st.prev_t = t")
+    lines.append("    return ch")
+
+    source = "\n".join(lines) + "\n"
+    namespace = {}
+    exec(compile(source, "<alarm rules>", "exec"), namespace)
+    return namespace["program"], source, len(rate_measurements)
+
+
+class ControllerState:
+    """Incremental state of all rules for one controller"""
+
+    __slots__ = ("active", "since", "prev", "prev_t")
+
+    def __init__(self, rule_count, rate_count):
+        self.active = [False] * rule_count
+        self.since = [-1.0] * rule_count
+        self.prev = [0.0] * rate_count
+        self.prev_t = -1.0
+
+
+# =============================================================================
+# ENGINE
+# =============================================================================
+
+class AlarmEngine:
+    """
+    Compiled rule set + per-controller state + event sinks
+
+    evaluate() is called from the Modbus write callback for every frame.
+    """
+
+    def __init__(self, rules=None, controllers=None, event_log=None, local_server=None):
+        specs = config.ALARM_RULES if rules is None else rules
+        self.rules = [r if isinstance(r, AlarmRule) else AlarmRule(**r) for r in specs]
+        self.program, self.source, self.rate_count = compile_rules(self.rules)
+
+        self.controllers = dict(config.MODBUS_CONTROLLERS if controllers is None else controllers)
+        self.states = {uid: ControllerState(len(self.rules), self.rate_count) for uid in self.controllers}
+        self.local_server = local_server
+
+        path = config.ALARM_EVENT_LOG if event_log is None else event_log
+        self.event_log = open(path, "a", buffering=1) if path else None
+
+        self.total_frames = 0
+        self.total_events = 0
+        self.eval_ns = 0
+
+        logger.info(f"Alarm engine: {len(self.rules)} rules compiled "
+                    f"({self.source.count(chr(10))} lines) for {len(self.controllers)} controller(s)")
+
+    def evaluate(self, unit_id, measurements, t=None):
+        """
+        Evaluate all rules for one controller frame
+
+        Returns:
+            List of (rule, active) transitions
+        """
+        state = self.states.get(unit_id)
+        if state is None:
+            return []
+        if t is None:
+            t = time.monotonic()
+
+        start = time.perf_counter_ns()
+        try:
+            changes = self.program(measurements, t, state)
+        except KeyError as e:
+            logger.error(f"Alarm evaluation skipped for unit {unit_id}: missing measurement {e}")
+            return []
+        self.eval_ns += time.perf_counter_ns() - start
+        self.total_frames += 1
+
+        if changes:
+            self._dispatch(unit_id, measurements, changes)
+        return [(self.rules[i], active) for i, active in changes]
+
+    def _dispatch(self, unit_id, measurements, changes):
+        """Push transitions to the log, the event log and the embedded server"""
+        ln = self.controllers[unit_id]
+        ts = datetime.now(timezone.utc).isoformat()
+        for i, active in changes:
+            rule = self.rules[i]
+            self.total_events += 1
+            state = "RAISED" if active else "CLEARED"
+            value = measurements.get(rule.measurement)
+            logger.warning(f"[ALARM] {rule.name} {state} | unit {unit_id} ({ln}) | "
+                           f"{rule.describe()} | {rule.measurement}={value}")
+            if self.event_log:
+                self.event_log.write(json.dumps({
+                    "ts": ts, "unit": unit_id, "ln": ln, "rule": rule.name,
+                    "severity": rule.severity, "state": state,
+                    "condition": rule.describe(), "measurement": rule.measurement, "value": value,
+                }) + "\n")
+
+        if self.local_server:
+            self.local_server.update_alarms(ln, changes)
+
+    def active_alarms(self):
+        """Currently active alarms as (unit id, rule name)"""
+        return [(uid, self.rules[i].name)
+                for uid, st in self.states.items()
+                for i, active in enumerate(st.active) if active]
+
+    def get_statistics(self):
+        return {
+            "rules": len(self.rules),
+            "frames": self.total_frames,
+            "events": self.total_events,
+            "mean_eval_us": self.eval_ns / self.total_frames / 1000 if self.total_frames else 0.0,
+            "active": [f"{name}@{uid}" for uid, name in self.active_alarms()],
+        }
+
+    def close(self):
+        if self.event_log:
+            self.event_log.close()
+            self.event_log = None
+
+
+# =============================================================================
+# BENCHMARK
+# =============================================================================
+
+def _interpret(rules, m, t, st):
+    """Reference interpreter (rule-by-rule, same semantics as compile_rules)"""
+    rate_names = sorted({r.measurement for r in rules if r.type == "rate"})
+    dt = t - st.prev_t
+    ok = st.prev_t >= 0.0 and dt > 0.0
+    rates = {n: (m[n] - st.prev[k]) / dt if ok else 0.0 for k, n in enumerate(rate_names)}
+    ops = {">": float.__gt__, ">=": float.__ge__, "<": float.__lt__, "<=": float.__le__}
+    ch = []
+    for i, r in enumerate(rules):
+        v = m[r.measurement] if r.type == "threshold" else rates[r.measurement]
+        v = abs(v) if r.abs else v
+        c = ops[r.op](float(v), _relaxed_limit(r) if st.active[i] else r.limit)
+        if c and r.when:
+            c = ops[r.when["op"]](float(m[r.when["measurement"]]), r.when["limit"])
+        if r.delay_s:
+            if c:
+                if st.since[i] < 0.0:
+                    st.since[i] = t
+                if not st.active[i] and t - st.since[i] >= r.delay_s:
+                    st.active[i] = True
+                    ch.append((i, True))
+            else:
+                st.since[i] = -1.0
+                if st.active[i]:
+                    st.active[i] = False
+                    ch.append((i, False))
+        elif c != st.active[i]:
+            st.active[i] = c
+            ch.append((i, c))
+    for k, n in enumerate(rate_names):
+        st.prev[k] = m[n]
+    if rate_names:
+        st.prev_t = t
+    return ch
+
+
+def _synthetic_rules(count):
+    """Rule mix for benchmarking: thresholds, rates, hysteresis, delays, guards"""
+    spans = {"P_ac": 3000.0, "V_dc": 60.0, "I_dc": 12.0, "G": 1200.0}
+    rng = random.Random(1)
+    rules = []
+    for i in range(count):
+        m = MEASUREMENTS[i % len(MEASUREMENTS)]
+        kind = ("threshold", "threshold", "rate", "threshold")[i % 4]
+        limit = rng.uniform(0.2, 0.9) * spans[m] if kind == "threshold" else rng.uniform(0.05, 0.3) * spans[m]
+        rule = {"name": f"R{i}", "measurement": m, "type": kind, "op": rng.choice(OPERATORS),
+                "limit": limit, "hysteresis": 0.02 * spans[m] if i % 3 == 0 else 0.0,
+                "delay_s": 5.0 if i % 5 == 0 else 0.0, "abs": kind == "rate" and i % 2 == 0}
+        if i % 7 == 0:
+            g = MEASUREMENTS[(i + 1) % len(MEASUREMENTS)]
+            rule["when"] = {"measurement": g, "op": ">", "limit": 0.3 * spans[g]}
+        rules.append(AlarmRule(**rule))
+    return rules
+
+
+def benchmark(rule_count, frames):
+    rules = _synthetic_rules(rule_count)
+    program, source, rate_count = compile_rules(rules)
+
+    rng = random.Random(2)
+    stream = []
+    t = 0.0
+    for _ in range(frames):
+        t += 1.0
+        stream.append((t, {"P_ac": rng.uniform(0, 3000), "V_dc": rng.uniform(0, 60),
+                           "I_dc": rng.uniform(0, 12), "G": rng.uniform(0, 1200)}))
+
+    # Equivalence with the reference interpreter
+    compiled_state = ControllerState(len(rules), rate_count)
+    interp_state = ControllerState(len(rules), rate_count)
+    events = 0
+    for t, m in stream:
+        a = program(m, t, compiled_state)
+        b = _interpret(rules, m, t, interp_state)
+        if a != b:
+            raise AssertionError(f"compiled/interpreted mismatch at t={t}: {a} != {b}")
+        events += len(a)
+
+    results = {}
+    for label, fn in (("compiled", program), ("interpreted", lambda m, t, st: _interpret(rules, m, t, st))):
+        state = ControllerState(len(rules), rate_count)
+        start = time.perf_counter_ns()
+        for t, m in stream:
+            fn(m, t, state)
+        results[label] = (time.perf_counter_ns() - start) / frames / 1000
+
+    print(f"Alarm engine benchmark: {rule_count} rules, {frames} frames, "
+          f"{events} transitions ({source.count(chr(10))} compiled lines)")
+    print(f"  compiled:    {results['compiled']:8.2f} µs/frame "
+          f"({results['compiled'] * 1000 / rule_count:.0f} ns/rule)")
+    print(f"  interpreted: {results['interpreted']:8.2f} µs/frame "
+          f"({results['interpreted'] / results['compiled']:.1f}x slower)")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="RPI#2 alarm rule engine")
+    parser.add_argument("--bench", action="store_true", help="Run the evaluation benchmark")
+    parser.add_argument("--rules", type=int, default=300, help="Synthetic rule count (default 300)")
+    parser.add_argument("--frames", type=int, default=20000, help="Frames to evaluate (default 20000)")
+    parser.add_argument("--show", action="store_true", help="Print the program compiled from config.ALARM_RULES")
+    args = parser.parse_args()
+
+    if args.show:
+        rules = [AlarmRule(**r) for r in config.ALARM_RULES]
+        print(compile_rules(rules)[1])
+    if args.bench:
+        benchmark(args.rules, args.frames)
+    if not (args.show or args.bench):
+        parser.print_help()
+
+
+if __name__ == "__main__":
+    main()
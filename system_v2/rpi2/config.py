@@ -5,15 +5,88 @@ RPI#2 Substation Gateway Configuration
 # Modbus TCP Server Configuration
 MODBUS_BIND_ADDRESS = "0.0.0.0"
 MODBUS_BIND_PORT = 502
-MODBUS_UNIT_ID = 1
+MODBUS_UNIT_ID = 1                    # Primary controller (GOOSE thresholds, MET1)
+
+# Multi-controller feeder: Opta unit id -> MMXU instance (relay and embedded server)
+# Every controller writes the same 5-register block to its own unit id (RPI2_UNIT_ID
+# in microgrid_controller.ino). Eight controllers: {uid: f"MMXU{uid}" for uid in range(1, 9)}
+MODBUS_CONTROLLERS = {
+    MODBUS_UNIT_ID: "MMXU1",
+}
 
 # IEC 61850 MMS Client Configuration
 SIPROTEC_IP = "192.168.1.21"
 SIPROTEC_PORT = 102  # Standard IEC 61850 MMS port
 LOGICAL_DEVICE = "LD0"  # Verify with DIGSI/IEDScout
 
+# IEC 62351-3 MMS over TLS on the relay link (mutual certificate authentication)
+SIPROTEC_TLS_ENABLED = False
+SIPROTEC_TLS_PORT = 3782                     # IANA port for ISO transport over TLS
+SIPROTEC_TLS_CA_FILE = "certs/relay_ca.pem"  # CA that signed the relay certificate
+SIPROTEC_TLS_CERT_FILE = "certs/rpi2.pem"    # RPI#2 client certificate (imported into DIGSI)
+SIPROTEC_TLS_KEY_FILE = "certs/rpi2.key"
+SIPROTEC_TLS_SESSION_RESUMPTION_SEC = 3600   # Resume the TLS session on reconnect within this window (0 = off)
+SIPROTEC_TLS_RENEGOTIATION_MS = 3600000      # Rekey the long-lived association instead of reconnecting
+
+# Embedded IEC 61850 Server (serves translated data to SCADA/HMI clients)
+IEC61850_SERVER_ENABLED = True
+IEC61850_SERVER_PORT = 102            # Station Zone interface; relay link is outbound only
+IEC61850_SERVER_IED_NAME = "RPI2GW"
+IEC61850_SERVER_LD = "LD0"            # MMS domain: RPI2GWLD0
+IEC61850_SERVER_MAX_CONNECTIONS = 32
+IEC61850_SERVER_REPORT_INSTANCES = 8  # urcbMeas01..08 (one per reporting client)
+IEC61850_SERVER_INTEGRITY_PERIOD_MS = 10000
+
+# Local model mapping: measurement -> data object (LN.DO[.phs])
+IEC61850_SERVER_MAPPING = {
+    "P_ac": "MMXU1.TotW",
+    "V_dc": "MMXU1.PhV.phsA",
+    "I_dc": "MMXU1.A.phsA",
+    "G": "MET1.Irradiance",
+}
+
+# GOOSE Threshold Events (Process Zone, layer 2)
+# Published from the Modbus write callback, independent of TRANSLATION_INTERVAL_SEC
+GOOSE_ENABLED = False                 # Requires CAP_NET_RAW (run as root or setcap)
+GOOSE_INTERFACE = "eth1"              # Process Zone NIC (same segment as SIPROTEC)
+GOOSE_DST_MAC = "01:0C:CD:01:00:01"   # IEC 61850-8-1 GOOSE multicast range
+GOOSE_APP_ID = 0x1000
+GOOSE_VLAN_ID = 0
+GOOSE_VLAN_PRIORITY = 4
+GOOSE_GOCB_REF = "RPI2GWLD0/LLN0$GO$gcbEvents"
+GOOSE_DATASET_REF = "RPI2GWLD0/LLN0$ThresholdEvents"
+GOOSE_GO_ID = "RPI2GW_Events"
+GOOSE_CONF_REV = 1
+GOOSE_T_MIN_MS = 2                    # First retransmission after an event (doubles each time)
+GOOSE_T_MAX_MS = 1000                 # Heartbeat interval (steady state)
+
+# Alarm rules published as GOOSE events (names from ALARM_RULES, primary controller;
+# dataset order = list order, one BOOLEAN each). GOOSE_ENABLED runs the alarm engine even
+# with ALARM_RULES_ENABLED = False (no event log or GGIO alarms then).
+GOOSE_ALARMS = ["DcOverCurrent", "DcOverVoltage", "AcOverPower"]
+
+# Alarm Rule Engine (alarm_engine.py)
+# Rules are compiled once at startup and evaluated on every Modbus write, for every controller.
+# type: "threshold" (value) or "rate" (units per second, "abs": True for |rate|)
+# op: ">", ">=", "<", "<="; optional "hysteresis", "delay_s" (must hold this long),
+# "when": {"measurement", "op", "limit"} guard, "severity"
+ALARM_RULES_ENABLED = True
+ALARM_EVENT_LOG = "alarm_events.jsonl"   # JSON lines, one per RAISED/CLEARED ("" = off)
+ALARM_RULES = [
+    {"name": "DcOverVoltage", "measurement": "V_dc", "op": ">", "limit": 58.0, "hysteresis": 1.0,
+     "severity": "critical"},
+    {"name": "DcOverCurrent", "measurement": "I_dc", "op": ">", "limit": 10.0, "hysteresis": 0.5,
+     "delay_s": 2.0},
+    {"name": "AcOverPower", "measurement": "P_ac", "op": ">", "limit": 300.0, "hysteresis": 5.0},
+    {"name": "PowerRamp", "measurement": "P_ac", "type": "rate", "op": ">", "limit": 100.0, "abs": True},
+    {"name": "LowYield", "measurement": "P_ac", "op": "<", "limit": 20.0, "delay_s": 60.0,
+     "when": {"measurement": "G", "op": ">", "limit": 400.0}},
+    {"name": "IrradianceSensor", "measurement": "G", "op": ">", "limit": 1400.0, "delay_s": 10.0},
+]
+
 # Protocol Translator Configuration
 TRANSLATION_INTERVAL_SEC = 1.0  # Update rate to SIPROTEC
+MMS_WRITE_BATCH_SIZE = 32       # Variables per MMS Write request (one cycle, all controllers)
 
 # Network Configuration
 STATION_ZONE_IP = "192.168.1.50"  # Receives from Opta
@@ -0,0 +1,122 @@
+"""
+RPI#2 GOOSE Monitor (test subscriber)
+
+Minimal GOOSE subscriber on a raw AF_PACKET socket (no libiec61850 needed).
+Prints stNum/sqNum/timeAllowedToLive/dataset for every frame matching the
+configured APPID and, for each new stNum, the event-to-receive latency
+(receive time − GOOSE 't' field; same clock when run on the gateway host,
+e.g. across a veth pair).
+
+Usage (root / CAP_NET_RAW):
+  python3 goose_monitor.py --interface veth1
+"""
+
+import argparse
+import socket
+import struct
+import time
+
+import config
+
+ETH_P_GOOSE = 0x88B8
+ETH_P_8021Q = 0x8100
+
+
+def ber_items(data):
+    """Yield (tag, value) for a sequence of BER TLVs"""
+    i = 0
+    while i < len(data):
+        tag = data[i]
+        length = data[i + 1]
+        i += 2
+        if length & 0x80:
+            n = length & 0x7F
+            length = int.from_bytes(data[i:i + n], "big")
+            i += n
+        yield tag, data[i:i + length]
+        i += length
+
+
+def decode_data(tag, value):
+    """Decode the MMS Data types used by the gateway dataset"""
+    if tag == 0x83:                      # boolean
+        return bool(value[0])
+    if tag == 0x85:                      # integer
+        return int.from_bytes(value, "big", signed=True)
+    if tag == 0x86:                      # unsigned
+        return int.from_bytes(value, "big")
+    if tag == 0x87 and len(value) == 5:  # floating-point (single)
+        return struct.unpack(">f", value[1:])[0]
+    return value.hex()
+
+
+def decode_goose(frame):
+    """Return (appid, pdu dict) or None if the frame is not GOOSE"""
+    ethertype, offset = struct.unpack_from(">H", frame, 12)[0], 14
+    if ethertype == ETH_P_8021Q:
+        ethertype, offset = struct.unpack_from(">H", frame, 16)[0], 18
+    if ethertype != ETH_P_GOOSE:
+        return None
+
+    appid, length = struct.unpack_from(">HH", frame, offset)
+    apdu = frame[offset + 8:offset + length]
+
+    pdu = {}
+    for tag, body in ber_items(apdu):
+        if tag != 0x61:                  # goosePdu
+            continue
+        for field, value in ber_items(body):
+            if field == 0x80:
+                pdu["gocbRef"] = value.decode()
+            elif field == 0x81:
+                pdu["tal"] = int.from_bytes(value, "big")
+            elif field == 0x84:          # UtcTime: 4 s + 3 fraction + quality
+                secs = int.from_bytes(value[:4], "big")
+                frac = int.from_bytes(value[4:7], "big") / (1 << 24)
+                pdu["t"] = secs + frac
+            elif field == 0x85:
+                pdu["stNum"] = int.from_bytes(value, "big")
+            elif field == 0x86:
+                pdu["sqNum"] = int.from_bytes(value, "big")
+            elif field == 0xAB:
+                pdu["data"] = [decode_data(t, v) for t, v in ber_items(value)]
+    return appid, pdu
+
+
+def main():
+    parser = argparse.ArgumentParser(description="GOOSE test subscriber")
+    parser.add_argument("--interface", default=config.GOOSE_INTERFACE)
+    parser.add_argument("--app-id", type=lambda x: int(x, 0), default=config.GOOSE_APP_ID)
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_PACKET, socket.SOCK_RAW, socket.htons(0x0003))
+    sock.bind((args.interface, 0))
+
+    names = list(config.GOOSE_ALARMS)
+    last_st = None
+    last_rx = None
+    print(f"Listening for GOOSE APPID 0x{args.app_id:04X} on {args.interface}...")
+
+    while True:
+        frame = sock.recv(1518)
+        rx = time.time()
+        decoded = decode_goose(frame)
+        if decoded is None or decoded[0] != args.app_id:
+            continue
+
+        _, pdu = decoded
+        gap_ms = (rx - last_rx) * 1000 if last_rx else 0.0
+        last_rx = rx
+        states = ", ".join(f"{n}={v}" for n, v in zip(names, pdu.get("data", [])))
+
+        if pdu.get("stNum") != last_st:
+            latency_ms = (rx - pdu["t"]) * 1000 if "t" in pdu else float("nan")
+            print(f"[EVENT] stNum={pdu.get('stNum')} latency={latency_ms:.3f}ms | {states}")
+            last_st = pdu.get("stNum")
+        else:
+            print(f"        sqNum={pdu.get('sqNum')} TAL={pdu.get('tal')}ms "
+                  f"(+{gap_ms:.1f}ms) | {states}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,205 @@
+"""
+RPI#2 GOOSE Event Publisher Component
+
+Publishes IEC 61850 GOOSE messages (libiec61850 GoosePublisher) on the
+Process Zone interface when one of the GOOSE_ALARMS changes state. The rules
+themselves are the alarm engine's (alarm_engine.py, config.ALARM_RULES): the
+gateway passes the engine's transitions for the primary controller to
+publish_changes(), so GOOSE and the alarm log always agree.
+
+Unlike the periodic MMS writes (one TCP round trip per value, at the
+translator interval), the event frame is sent from the Modbus write callback
+itself, followed by the standard GOOSE retransmission curve:
+
+  event ─┬─ T1 ─┬─ 2·T1 ─┬─ 4·T1 ─ ... ─┬─ T0 ─┬─ T0 ─ ...
+  stNum++, sqNum=0      sqNum++ on every retransmission (heartbeat at T0)
+
+timeAllowedToLive is set to 2× the next retransmission interval.
+
+Dataset (GOOSE_DATASET_REF): one BOOLEAN per alarm, in GOOSE_ALARMS order.
+"""
+
+import logging
+import threading
+
+try:
+    import iec61850
+    IEC61850_AVAILABLE = True
+except Exception as exc:
+    try:
+        import pyiec61850 as iec61850
+        IEC61850_AVAILABLE = True
+    except Exception as exc2:
+        IEC61850_AVAILABLE = False
+        logging.warning(
+            "pyiec61850 import failed (%s). GOOSE publishing disabled.",
+            exc2,
+        )
+
+import config
+
+logger = logging.getLogger(__name__)
+
+
+def parse_mac(mac: str):
+    return [int(b, 16) for b in mac.split(":")]
+
+
+class GooseEventPublisher:
+    """
+    GOOSE publisher for alarm engine transitions, with retransmission curve
+
+    publish_changes() is called from the Modbus write callback (asyncio thread);
+    retransmissions run on a dedicated thread. A lock serialises access to
+    the libiec61850 publisher and the dataset values.
+    """
+
+    def __init__(self, rules, interface=None, alarms=None):
+        """
+        Args:
+            rules: Compiled alarm rules (AlarmEngine.rules)
+            interface: Network interface (default config.GOOSE_INTERFACE)
+            alarms: Rule names in dataset order (default config.GOOSE_ALARMS)
+        """
+        if not IEC61850_AVAILABLE:
+            raise ImportError("pyiec61850 library not installed. Run: pip install pyiec61850")
+        if not hasattr(iec61850, "GoosePublisher_create"):
+            raise ImportError("pyiec61850 was built without GOOSE publisher support")
+
+        self.interface = interface or config.GOOSE_INTERFACE
+        self.alarms = list(config.GOOSE_ALARMS if alarms is None else alarms)
+        known = {rule.name for rule in rules}
+        missing = [name for name in self.alarms if name not in known]
+        if missing:
+            raise ValueError(f"GOOSE_ALARMS not in the alarm rules: {', '.join(missing)}")
+        self.index = {name: k for k, name in enumerate(self.alarms)}
+        self.active = [False] * len(self.alarms)
+        self.t_min_ms = config.GOOSE_T_MIN_MS
+        self.t_max_ms = config.GOOSE_T_MAX_MS
+
+        self.publisher = None
+        self.dataset = None
+        self.values = []
+        self.interval_ms = self.t_max_ms
+        self.total_events = 0
+        self.total_messages = 0
+
+        self._lock = threading.Lock()
+        self._wakeup = threading.Condition(self._lock)
+        self._thread = None
+        self._running = False
+
+    def start(self):
+        """Create the publisher, send the initial state and start retransmissions"""
+        params = iec61850.CommParameters()
+        params.appId = config.GOOSE_APP_ID
+        params.vlanId = config.GOOSE_VLAN_ID
+        params.vlanPriority = config.GOOSE_VLAN_PRIORITY
+        iec61850.CommParameters_setDstAddress(params, *parse_mac(config.GOOSE_DST_MAC))
+
+        self.publisher = iec61850.GoosePublisher_create(params, self.interface)
+        if self.publisher is None:
+            raise RuntimeError(f"GOOSE publisher creation failed on {self.interface} "
+                               f"(interface missing or no CAP_NET_RAW?)")
+
+        iec61850.GoosePublisher_setGoCbRef(self.publisher, config.GOOSE_GOCB_REF)
+        iec61850.GoosePublisher_setDataSetRef(self.publisher, config.GOOSE_DATASET_REF)
+        iec61850.GoosePublisher_setGoID(self.publisher, config.GOOSE_GO_ID)
+        iec61850.GoosePublisher_setConfRev(self.publisher, config.GOOSE_CONF_REV)
+
+        self.dataset = iec61850.LinkedList_create()
+        for _ in self.alarms:
+            value = iec61850.MmsValue_newBoolean(False)
+            self.values.append(value)
+            iec61850.LinkedList_add(self.dataset, value)
+
+        logger.info(f"GOOSE publisher on {self.interface}: {config.GOOSE_GOCB_REF} "
+                    f"(APPID 0x{config.GOOSE_APP_ID:04X}, {len(self.alarms)} alarms, "
+                    f"T1={self.t_min_ms}ms T0={self.t_max_ms}ms)")
+
+        self._running = True
+        with self._lock:
+            self._publish_event()
+        self._thread = threading.Thread(target=self._retransmit_loop, name="goose-retx", daemon=True)
+        self._thread.start()
+
+    def stop(self):
+        """Stop retransmissions and release the publisher"""
+        with self._lock:
+            self._running = False
+            self._wakeup.notify()
+        if self._thread:
+            self._thread.join(timeout=2.0)
+        if self.publisher is not None:
+            iec61850.GoosePublisher_destroy(self.publisher)
+            self.publisher = None
+        if self.dataset is not None:
+            # destroyDeep needs a C function pointer; free the values one by one
+            for value in self.values:
+                iec61850.MmsValue_delete(value)
+            iec61850.LinkedList_destroyStatic(self.dataset)
+            self.dataset = None
+            self.values = []
+        logger.info("GOOSE publisher stopped")
+
+    def publish_changes(self, changes):
+        """
+        Publish alarm engine transitions (AlarmEngine.evaluate output)
+
+        Publishes immediately (new stNum) if any GOOSE alarm changed state;
+        transitions of rules not in GOOSE_ALARMS are ignored.
+        """
+        changed = []
+        for rule, active in changes:
+            k = self.index.get(rule.name)
+            if k is not None and self.active[k] != active:
+                self.active[k] = active
+                changed.append((rule, active))
+
+        if not changed or not self._running:
+            return
+
+        with self._lock:
+            for active, value in zip(self.active, self.values):
+                iec61850.MmsValue_setBoolean(value, active)
+            self._publish_event()
+            self._wakeup.notify()
+
+        for rule, active in changed:
+            logger.warning(f"[GOOSE EVENT] {rule.name} {'RAISED' if active else 'CLEARED'} "
+                           f"({rule.describe()}) | stNum event #{self.total_events}")
+
+    def _publish_event(self):
+        """New state: increase stNum and restart the retransmission curve (lock held)"""
+        iec61850.GoosePublisher_increaseStNum(self.publisher)
+        self.interval_ms = self.t_min_ms
+        self._publish()
+        self.total_events += 1
+
+    def _publish(self):
+        """Send one message with TAL = 2 × next interval (lock held)"""
+        iec61850.GoosePublisher_setTimeAllowedToLive(self.publisher, 2 * self.interval_ms)
+        if iec61850.GoosePublisher_publish(self.publisher, self.dataset) != 0:
+            logger.error("GOOSE publish failed")
+        self.total_messages += 1
+
+    def _retransmit_loop(self):
+        with self._lock:
+            while self._running:
+                interval = self.interval_ms
+                events = self.total_events
+                self._wakeup.wait(timeout=interval / 1000.0)
+                if not self._running:
+                    break
+                if self.total_events != events:
+                    # New event published meanwhile; curve restarted
+                    continue
+                self.interval_ms = min(self.interval_ms * 2, self.t_max_ms)
+                self._publish()
+
+    def get_statistics(self):
+        return {
+            "events": self.total_events,
+            "messages": self.total_messages,
+            "active": [name for name, active in zip(self.alarms, self.active) if active],
+        }
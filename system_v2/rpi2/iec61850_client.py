@@ -9,10 +9,21 @@ Before running:
 3. Verify MMXU Logical Node exists
 4. Export ICD file for reference
 5. Test manual MMS write with IEDScout
+
+With SIPROTEC_TLS_ENABLED the association runs over TLS (IEC 62351-3). The
+TLS configuration is created once per client and outlives the connection,
+so a reconnect resumes the previous TLS session (abbreviated handshake)
+instead of repeating the full certificate exchange.
+
+write_floats() aggregates many variables into one MMS Write request
+(listOfVariable) per MMS_WRITE_BATCH_SIZE items.
 """
 
 import logging
 import asyncio
+import ctypes
+import ctypes.util
+import time
 from typing import Optional
 
 try:
@@ -36,6 +47,88 @@ import config
 logger = logging.getLogger(__name__)
 
 
+class MmsBatchWriter:
+    """
+    Multi-variable MMS Write (MmsConnection_writeMultipleVariables) via ctypes
+
+    The SWIG binding cannot build a LinkedList of C strings (variable names),
+    so this calls the libiec61850 shared library that pyiec61850 already uses,
+    with the connection handle taken from the SWIG object (C-style API) or
+    from IedConnection.getConnection() (class API).
+    """
+
+    DATA_ACCESS_ERROR_SUCCESS = -1
+
+    def __init__(self):
+        path = ctypes.util.find_library("iec61850")
+        if path is None:
+            raise OSError("libiec61850 shared library not found")
+        lib = ctypes.CDLL(path)
+        vp = ctypes.c_void_p
+
+        lib.IedConnection_getMmsConnection.argtypes = [vp]
+        lib.IedConnection_getMmsConnection.restype = vp
+        lib.LinkedList_create.restype = vp
+        lib.LinkedList_add.argtypes = [vp, vp]
+        lib.LinkedList_getNext.argtypes = [vp]
+        lib.LinkedList_getNext.restype = vp
+        lib.LinkedList_getData.argtypes = [vp]
+        lib.LinkedList_getData.restype = vp
+        lib.LinkedList_destroyStatic.argtypes = [vp]
+        lib.LinkedList_destroyDeep.argtypes = [vp, vp]
+        lib.MmsValue_newFloat.argtypes = [ctypes.c_float]
+        lib.MmsValue_newFloat.restype = vp
+        lib.MmsValue_getDataAccessError.argtypes = [vp]
+        lib.MmsValue_getDataAccessError.restype = ctypes.c_int
+        lib.MmsConnection_writeMultipleVariables.argtypes = [
+            vp, ctypes.POINTER(ctypes.c_int), ctypes.c_char_p, vp, vp, ctypes.POINTER(vp)]
+        lib.MmsConnection_writeMultipleVariables.restype = None
+
+        self.lib = lib
+        self.value_delete = ctypes.cast(lib.MmsValue_delete, vp)
+
+    def write(self, connection, domain: str, items):
+        """
+        Write (item_id, value) pairs of one domain in a single MMS request
+
+        Returns:
+            List of per-item success flags, or None if the request failed
+        """
+        lib = self.lib
+        mms = lib.IedConnection_getMmsConnection(int(getattr(connection, "this", connection)))
+
+        names = [ctypes.c_char_p(item_id.encode()) for item_id, _ in items]  # Keep alive
+        name_list = lib.LinkedList_create()
+        value_list = lib.LinkedList_create()
+        for name, (_, value) in zip(names, items):
+            lib.LinkedList_add(name_list, ctypes.cast(name, ctypes.c_void_p))
+            lib.LinkedList_add(value_list, lib.MmsValue_newFloat(value))
+
+        error = ctypes.c_int(0)
+        results = ctypes.c_void_p()
+        try:
+            lib.MmsConnection_writeMultipleVariables(
+                mms, ctypes.byref(error), domain.encode(), name_list, value_list, ctypes.byref(results))
+        finally:
+            lib.LinkedList_destroyStatic(name_list)
+            lib.LinkedList_destroyDeep(value_list, self.value_delete)
+
+        if not results.value:
+            return None
+
+        flags = []
+        element = lib.LinkedList_getNext(results)
+        while element:
+            result = lib.LinkedList_getData(element)
+            flags.append(lib.MmsValue_getDataAccessError(result) == self.DATA_ACCESS_ERROR_SUCCESS)
+            element = lib.LinkedList_getNext(element)
+        lib.LinkedList_destroyDeep(results, self.value_delete)
+
+        if error.value != 0 or len(flags) != len(items):
+            return None
+        return flags
+
+
 class IEC61850Client:
     """
     IEC 61850 MMS client for communication with SIPROTEC relay
@@ -43,17 +136,68 @@ class IEC61850Client:
     Uses pyiec61850 library (Python wrapper for libiec61850)
     """
 
-    def __init__(self, host=None, port=None, logical_device=None):
+    def __init__(self, host=None, port=None, logical_device=None, tls=None):
         if not IEC61850_AVAILABLE:
             raise ImportError("pyiec61850 library not installed. Run: pip install pyiec61850")
 
+        self.tls = config.SIPROTEC_TLS_ENABLED if tls is None else tls
         self.host = host or config.SIPROTEC_IP
-        self.port = port or config.SIPROTEC_PORT
+        self.port = port or (config.SIPROTEC_TLS_PORT if self.tls else config.SIPROTEC_PORT)
         self.ld = logical_device or config.LOGICAL_DEVICE
         self.connection = None
         self.connected = False
         self.fc_default = getattr(iec61850, "IEC61850_FC_MX", None)
 
+        # The class API has no TLS constructor; TLS connections use the C-style API
+        self.use_class_api = USE_CLASS_API and not self.tls
+        self.tls_config = self._create_tls_config() if self.tls else None
+
+        # Connection statistics (handshake cost is visible in last_connect_ms)
+        self.total_connects = 0
+        self.last_connect_ms = None
+        self.total_write_requests = 0
+
+        self.batch_writer = None
+        if self.use_class_api and not hasattr(iec61850.IedConnection, "getConnection"):
+            logger.warning("IedConnection has no getConnection(), writing variables one by one")
+        else:
+            try:
+                self.batch_writer = MmsBatchWriter()
+            except (OSError, AttributeError) as e:
+                logger.warning(f"Batched MMS writes unavailable ({e}), writing variables one by one")
+
+    def _create_tls_config(self):
+        """
+        Build the TLS configuration shared by every connection of this client
+
+        Raises:
+            ImportError: If libiec61850 was built without TLS support
+            ValueError: If a certificate or key file cannot be loaded
+        """
+        if not hasattr(iec61850, "IedConnection_createWithTlsSupport"):
+            raise ImportError("pyiec61850 was built without TLS support (rebuild libiec61850 with mbedTLS)")
+
+        tls = iec61850.TLSConfiguration_create()
+        iec61850.TLSConfiguration_setChainValidation(tls, True)
+        iec61850.TLSConfiguration_setAllowOnlyKnownCertificates(tls, False)
+        iec61850.TLSConfiguration_setMinTlsVersion(tls, iec61850.TLS_VERSION_TLS_1_2)
+
+        if not iec61850.TLSConfiguration_addCACertificateFromFile(tls, config.SIPROTEC_TLS_CA_FILE):
+            raise ValueError(f"Cannot load CA certificate {config.SIPROTEC_TLS_CA_FILE}")
+        if not iec61850.TLSConfiguration_setOwnCertificateFromFile(tls, config.SIPROTEC_TLS_CERT_FILE):
+            raise ValueError(f"Cannot load client certificate {config.SIPROTEC_TLS_CERT_FILE}")
+        if not iec61850.TLSConfiguration_setOwnKeyFromFile(tls, config.SIPROTEC_TLS_KEY_FILE, None):
+            raise ValueError(f"Cannot load client key {config.SIPROTEC_TLS_KEY_FILE}")
+
+        # The saved session lives in the configuration, not in the connection
+        resumption = config.SIPROTEC_TLS_SESSION_RESUMPTION_SEC
+        iec61850.TLSConfiguration_enableSessionResumption(tls, resumption > 0)
+        if resumption > 0:
+            iec61850.TLSConfiguration_setSessionResumptionInterval(tls, resumption)
+        iec61850.TLSConfiguration_setRenegotiationTime(tls, config.SIPROTEC_TLS_RENEGOTIATION_MS)
+
+        return tls
+
     def _fc_from_code(self, code: str):
         code = (code or "MX").upper()
         if code == "MX":
@@ -98,18 +242,23 @@ class IEC61850Client:
         Raises:
             ConnectionError: If connection fails
         """
-        logger.info(f"Connecting to SIPROTEC at {self.host}:{self.port}...")
+        logger.info(f"Connecting to SIPROTEC at {self.host}:{self.port}{' (TLS)' if self.tls else ''}...")
 
         try:
             # Create IED connection object
-            if USE_CLASS_API:
+            start = time.perf_counter()
+            if self.use_class_api:
                 self.connection = iec61850.IedConnection()
                 error = self.connection.connect(self.host, self.port)
                 ok_code = iec61850.IedConnectionError.IED_ERROR_OK
             else:
-                self.connection = iec61850.IedConnection_create()
+                if self.tls:
+                    self.connection = iec61850.IedConnection_createWithTlsSupport(self.tls_config)
+                else:
+                    self.connection = iec61850.IedConnection_create()
                 error = iec61850.IedConnection_connect(self.connection, self.host, self.port)
                 ok_code = iec61850.IED_ERROR_OK
+            elapsed_ms = (time.perf_counter() - start) * 1000
 
             if error != ok_code:
                 error_msg = f"IEC 61850 connection failed: {error}"
@@ -117,7 +266,9 @@ class IEC61850Client:
                 raise ConnectionError(error_msg)
 
             self.connected = True
-            logger.info(f"✓ Connected to SIPROTEC at {self.host}:{self.port}")
+            self.total_connects += 1
+            self.last_connect_ms = elapsed_ms
+            logger.info(f"✓ Connected to SIPROTEC at {self.host}:{self.port} in {elapsed_ms:.1f} ms")
             logger.info(f"  Logical Device: {self.ld}")
 
             return True
@@ -128,10 +279,10 @@ class IEC61850Client:
             raise
 
     async def disconnect(self):
-        """Close MMS connection"""
+        """Close MMS connection (the TLS configuration is kept for resumption)"""
         if self.connection and self.connected:
             try:
-                if USE_CLASS_API:
+                if self.use_class_api:
                     self.connection.close()
                 else:
                     iec61850.IedConnection_close(self.connection)
@@ -141,6 +292,41 @@ class IEC61850Client:
                 logger.error(f"Error during disconnect: {e}")
             finally:
                 self.connected = False
+                self.connection = None
+
+    async def reconnect(self) -> bool:
+        """
+        Re-establish a lost association
+
+        Over TLS the handshake resumes the previous session if it is younger
+        than SIPROTEC_TLS_SESSION_RESUMPTION_SEC.
+
+        Returns:
+            True if connected again, False otherwise
+        """
+        if self.connection is not None and not self.use_class_api:
+            # Release the dead connection (close() already ran on the class API)
+            iec61850.IedConnection_destroy(self.connection)
+            self.connection = None
+        self.connected = False
+
+        try:
+            return await self.connect()
+        except Exception:
+            return False
+
+    def check_connection(self) -> bool:
+        """
+        Refresh the connected flag from the association state
+
+        Called after a failed write to tell a rejected value from a lost link.
+        """
+        if self.connected and self.connection is not None and not self.use_class_api:
+            state = iec61850.IedConnection_getState(self.connection)
+            if state != iec61850.IED_STATE_CONNECTED:
+                logger.warning(f"✗ MMS association to {self.host}:{self.port} lost (state {state})")
+                self.connected = False
+        return self.connected
 
     async def write_float(self, object_ref: str, value: float) -> bool:
         """
@@ -158,7 +344,7 @@ class IEC61850Client:
             return False
 
         try:
-            if USE_CLASS_API:
+            if self.use_class_api:
                 # Construct full MMS variable path
                 mms_var = f"{self.ld}/{object_ref}"
 
@@ -197,6 +383,68 @@ class IEC61850Client:
             logger.error(f"Exception writing float to {object_ref}: {e}")
             return False
 
+    def _connection_handle(self):
+        """C IedConnection of the association (wrapped by the class API object)"""
+        if self.connection is None:
+            return None
+        if self.use_class_api:
+            return self.connection.getConnection()
+        return self.connection
+
+    async def write_floats(self, items) -> bool:
+        """
+        Write many float values with as few MMS requests as possible
+
+        Items are grouped by logical device and sent MMS_WRITE_BATCH_SIZE at a
+        time in one Write request each. Falls back to one request per item
+        when batching is unavailable.
+
+        Args:
+            items: list of (MMS variable name, value), e.g. ("MMXU2$MX$TotW$mag$f", 250.0)
+
+        Returns:
+            True if every write succeeded, False otherwise
+        """
+        if not self.connected:
+            logger.error("Not connected to SIPROTEC")
+            return False
+
+        handle = self._connection_handle() if self.batch_writer else None
+        if handle is None:
+            success = True
+            for object_ref, value in items:
+                self.total_write_requests += 1
+                success &= await self.write_float(object_ref, value)
+            return success
+
+        # Group by MMS domain (logical device)
+        domains = {}
+        for object_ref, value in items:
+            domain, item_id = object_ref.split("/", 1) if "/" in object_ref else (self.ld, object_ref)
+            domains.setdefault(domain, []).append((item_id, float(value)))
+
+        success = True
+        size = max(1, config.MMS_WRITE_BATCH_SIZE)
+        try:
+            for domain, domain_items in domains.items():
+                for i in range(0, len(domain_items), size):
+                    chunk = domain_items[i:i + size]
+                    self.total_write_requests += 1
+                    flags = self.batch_writer.write(handle, domain, chunk)
+                    if flags is None:
+                        logger.error(f"Batched write of {len(chunk)} variables to {domain} failed")
+                        return False
+                    for (item_id, _), ok in zip(chunk, flags):
+                        if not ok:
+                            logger.error(f"Write rejected for {domain}/{item_id}")
+                            success = False
+        except Exception as e:
+            logger.error(f"Exception in batched write: {e}")
+            return False
+
+        logger.debug(f"✓ Wrote {len(items)} values to {len(domains)} logical device(s)")
+        return success
+
     async def write_timestamp(self, object_ref: str, unix_timestamp: int) -> bool:
         """
         Write timestamp to IEC 61850 data object
@@ -221,7 +469,7 @@ class IEC61850Client:
             NTP_UNIX_OFFSET = 2208988800
             ntp_timestamp = (unix_timestamp + NTP_UNIX_OFFSET) * 1000  # Convert to milliseconds
 
-            if USE_CLASS_API:
+            if self.use_class_api:
                 # Construct full MMS variable path
                 mms_var = f"{self.ld}/{object_ref}"
 
@@ -279,7 +527,7 @@ class IEC61850Client:
             return False
 
         try:
-            if USE_CLASS_API:
+            if self.use_class_api:
                 # Construct full MMS variable path
                 mms_var = f"{self.ld}/{object_ref}"
 
@@ -336,7 +584,7 @@ class IEC61850Client:
             return None
 
         try:
-            if USE_CLASS_API:
+            if self.use_class_api:
                 # Construct full MMS variable path
                 mms_var = f"{self.ld}/{object_ref}"
 
@@ -376,6 +624,54 @@ class IEC61850Client:
             logger.error(f"Exception reading from {object_ref}: {e}")
             return None
 
+    async def read_float(self, object_ref: str) -> Optional[float]:
+        """
+        Read float value from IEC 61850 data object
+
+        Args:
+            object_ref: MMS variable name (e.g., "MMXU1$MX$TotW$mag$f")
+
+        Returns:
+            Float value or None if read failed
+        """
+        if not self.connected:
+            logger.error("Not connected to SIPROTEC")
+            return None
+
+        try:
+            if self.use_class_api:
+                mms_var = f"{self.ld}/{object_ref}"
+                mms_value = self.connection.readValue(mms_var)
+
+                if not mms_value:
+                    logger.error(f"Read failed for {mms_var}")
+                    return None
+
+                value = iec61850.MmsValue_toFloat(mms_value)
+                iec61850.MmsValue_delete(mms_value)
+                return value
+
+            obj_ref, fc = self._parse_object_ref(object_ref)
+            if "/" not in obj_ref:
+                obj_ref = f"{self.ld}/{obj_ref}"
+            if fc is None:
+                logger.error(f"Unknown functional constraint for {object_ref}")
+                return None
+
+            result = iec61850.IedConnection_readFloatValue(self.connection, obj_ref, fc)
+            if isinstance(result, tuple):
+                value, error = result
+                if error != iec61850.IED_ERROR_OK:
+                    logger.error(f"Read failed for {obj_ref}: {error}")
+                    return None
+                return value
+
+            return result
+
+        except Exception as e:
+            logger.error(f"Exception reading from {object_ref}: {e}")
+            return None
+
     async def health_check(self) -> bool:
         """
         Verify connection is still alive
@@ -0,0 +1,283 @@
+"""
+RPI#2 Embedded IEC 61850 MMS Server Component
+
+Hosts a local libiec61850 server whose data model (MMXU1, MET1) mirrors the
+translated Modbus data. SCADA/HMI clients read values and subscribe to
+reports from RPI#2's memory instead of querying the SIPROTEC relay.
+
+Architecture:
+  Opta --[Modbus TCP:502]--> RPI#2 --[IEC 61850 MMS:102]--> SIPROTEC 7SX85
+                               |
+                               +--[IEC 61850 MMS:IEC61850_SERVER_PORT]--> SCADA / HMI (any number)
+
+Data model (LD = <IEC61850_SERVER_IED_NAME><IEC61850_SERVER_LD>):
+  LLN0
+    Mod, Beh                                 (ENS)
+    DataSet "Measurements"                   (all MX values below)
+    DataSet "Alarms"                         (all GGIO Ind below, if alarm rules are enabled)
+    urcbMeas01..NN, urcbAlarm01..NN          (unbuffered reports: dchg + integrity)
+  MMXU1..N                                   (one per controller, config.MODBUS_CONTROLLERS)
+    TotW        (MV)   P_ac [W]
+    PhV.phsA    (WYE)  V_dc [V]
+    A.phsA      (WYE)  I_dc [A]
+  MET1                                       (primary controller, MODBUS_UNIT_ID)
+    Irradiance  (MV)   G [W/m²]
+  GGIO1..N                                   (one per controller, config.ALARM_RULES)
+    Ind1..M     (SPS)  alarm rule 1..M active (alarm_engine.py)
+"""
+
+import logging
+import time
+
+try:
+    import iec61850
+    IEC61850_AVAILABLE = True
+except Exception as exc:
+    try:
+        import pyiec61850 as iec61850
+        IEC61850_AVAILABLE = True
+    except Exception as exc2:
+        IEC61850_AVAILABLE = False
+        logging.warning(
+            "pyiec61850 import failed (%s). IEC 61850 server disabled.",
+            exc2,
+        )
+
+import config
+
+logger = logging.getLogger(__name__)
+
+# Data objects hosted by the local server: (LN, DO, CDC)
+# MMXU1 entries are instantiated once per controller logical node
+MODEL_DATA_OBJECTS = [
+    ("MMXU1", "TotW", "MV"),
+    ("MMXU1", "PhV", "WYE"),
+    ("MMXU1", "A", "WYE"),
+    ("MET1", "Irradiance", "MV"),
+]
+
+DATASET_NAME = "Measurements"
+ALARM_DATASET_NAME = "Alarms"
+
+
+class IEC61850LocalServer:
+    """
+    Embedded IEC 61850 MMS server (libiec61850 dynamic model)
+
+    The protocol translator calls update() once per translated frame; values
+    are written into the model in place under the data model lock, and
+    libiec61850 serves reads and reports to all connected clients from memory.
+    """
+
+    def __init__(self, port=None, ied_name=None, logical_device=None, max_connections=None):
+        if not IEC61850_AVAILABLE:
+            raise ImportError("pyiec61850 library not installed. Run: pip install pyiec61850")
+
+        self.port = port or config.IEC61850_SERVER_PORT
+        self.ied_name = ied_name or config.IEC61850_SERVER_IED_NAME
+        self.ld = logical_device or config.IEC61850_SERVER_LD
+        self.max_connections = max_connections or config.IEC61850_SERVER_MAX_CONNECTIONS
+        self.model = None
+        self.server = None
+        self.running = False
+        self.total_updates = 0
+
+        # Controller logical nodes (MMXU1..N) and the one that also feeds MET1
+        self.controller_lns = list(dict.fromkeys(config.MODBUS_CONTROLLERS.values()))
+        self.primary_ln = config.MODBUS_CONTROLLERS.get(config.MODBUS_UNIT_ID, self.controller_lns[0])
+
+        # (controller LN, measurement name) -> (mag.f, q, t) data attributes
+        self.attributes = {}
+
+        # Alarm indications: GGIO<n> per controller, Ind<k> per alarm rule
+        self.alarm_count = len(config.ALARM_RULES) if config.ALARM_RULES_ENABLED else 0
+        self.alarm_lns = {ln: f"GGIO{n}" for n, ln in enumerate(self.controller_lns, 1)}
+        # (controller LN, rule index) -> (stVal, t) data attributes
+        self.alarm_attributes = {}
+
+    def _data_objects(self):
+        """MODEL_DATA_OBJECTS with the MMXU1 template expanded per controller"""
+        for ln_name, do_name, cdc in MODEL_DATA_OBJECTS:
+            if ln_name == "MMXU1":
+                for ln in self.controller_lns:
+                    yield ln, do_name, cdc
+            else:
+                yield ln_name, do_name, cdc
+
+    def _build_model(self):
+        """Create the dynamic data model (LLN0, MMXU1, MET1, dataset, report blocks)"""
+        self.model = iec61850.IedModel_create(self.ied_name)
+        ld = iec61850.LogicalDevice_create(self.ld, self.model)
+
+        lln0 = iec61850.LogicalNode_create("LLN0", ld)
+        iec61850.CDC_ENS_create("Mod", iec61850.toModelNode(lln0), 0)
+        iec61850.CDC_ENS_create("Beh", iec61850.toModelNode(lln0), 0)
+
+        nodes = {"LLN0": lln0}
+        for ln_name, do_name, cdc in self._data_objects():
+            if ln_name not in nodes:
+                nodes[ln_name] = iec61850.LogicalNode_create(ln_name, ld)
+            parent = iec61850.toModelNode(nodes[ln_name])
+            if cdc == "MV":
+                iec61850.CDC_MV_create(do_name, parent, 0, False)
+            else:
+                iec61850.CDC_WYE_create(do_name, parent, 0)
+
+        # Dataset with every measurement (FCD entries include mag, q and t)
+        dataset = iec61850.DataSet_create(DATASET_NAME, lln0)
+        for ln_name, do_name, cdc in self._data_objects():
+            fcd = f"{ln_name}$MX${do_name}" + ("$phsA" if cdc == "WYE" else "")
+            iec61850.DataSetEntry_create(dataset, fcd, -1, None)
+
+        # Alarm indications (stVal, q, t) per controller
+        if self.alarm_count:
+            alarms = iec61850.DataSet_create(ALARM_DATASET_NAME, lln0)
+            for ggio in self.alarm_lns.values():
+                parent = iec61850.toModelNode(iec61850.LogicalNode_create(ggio, ld))
+                for k in range(1, self.alarm_count + 1):
+                    iec61850.CDC_SPS_create(f"Ind{k}", parent, 0)
+                    iec61850.DataSetEntry_create(alarms, f"{ggio}$ST$Ind{k}", -1, None)
+
+        # One unbuffered report instance per expected client
+        trg_ops = iec61850.TRG_OPT_DATA_CHANGED | iec61850.TRG_OPT_INTEGRITY | iec61850.TRG_OPT_GI
+        options = (iec61850.RPT_OPT_SEQ_NUM | iec61850.RPT_OPT_TIME_STAMP
+                   | iec61850.RPT_OPT_REASON_FOR_INCLUSION | iec61850.RPT_OPT_DATA_SET)
+        for i in range(1, config.IEC61850_SERVER_REPORT_INSTANCES + 1):
+            iec61850.ReportControlBlock_create(
+                f"urcbMeas{i:02d}", lln0, "urcbMeas", False, DATASET_NAME,
+                1, trg_ops, options, 50, config.IEC61850_SERVER_INTEGRITY_PERIOD_MS,
+            )
+            if self.alarm_count:
+                iec61850.ReportControlBlock_create(
+                    f"urcbAlarm{i:02d}", lln0, "urcbAlarm", False, ALARM_DATASET_NAME,
+                    1, trg_ops, options, 0, config.IEC61850_SERVER_INTEGRITY_PERIOD_MS,
+                )
+
+    def _lookup(self, short_ref):
+        node = iec61850.IedModel_getModelNodeByShortObjectReference(self.model, short_ref)
+        if node is None:
+            raise RuntimeError(f"Model node not found: {short_ref}")
+        return iec61850.toDataAttribute(node)
+
+    def _resolve_attributes(self):
+        """Cache data attribute handles for every mapped measurement of every controller"""
+        for ln in self.controller_lns:
+            for name, do_ref in config.IEC61850_SERVER_MAPPING.items():
+                if do_ref.startswith("MMXU1."):
+                    do_ref = ln + do_ref[len("MMXU1"):]
+                elif ln != self.primary_ln:
+                    continue  # Shared LN (MET1): primary controller only
+                base = f"{self.ld}/{do_ref}"
+                mag = f"{base}.cVal.mag.f" if ".phs" in do_ref else f"{base}.mag.f"
+                self.attributes[(ln, name)] = (
+                    self._lookup(mag),
+                    self._lookup(f"{base}.q"),
+                    self._lookup(f"{base}.t"),
+                )
+
+        for ln, ggio in self.alarm_lns.items():
+            for k in range(self.alarm_count):
+                base = f"{self.ld}/{ggio}.Ind{k + 1}"
+                self.alarm_attributes[(ln, k)] = (
+                    self._lookup(f"{base}.stVal"),
+                    self._lookup(f"{base}.t"),
+                )
+
+    def start(self):
+        """Build the model and start serving MMS clients"""
+        logger.info(f"Starting embedded IEC 61850 server on port {self.port} "
+                    f"(LD {self.ied_name}{self.ld}, {', '.join(self.controller_lns)}, "
+                    f"max {self.max_connections} clients)")
+
+        self._build_model()
+        self._resolve_attributes()
+
+        server_config = iec61850.IedServerConfig_create()
+        iec61850.IedServerConfig_setMaxMmsConnections(server_config, self.max_connections)
+        self.server = iec61850.IedServer_createWithConfig(self.model, None, server_config)
+        iec61850.IedServerConfig_destroy(server_config)
+
+        iec61850.IedServer_start(self.server, self.port)
+        if not iec61850.IedServer_isRunning(self.server):
+            iec61850.IedServer_destroy(self.server)
+            iec61850.IedModel_destroy(self.model)
+            self.server = None
+            raise RuntimeError(f"IEC 61850 server failed to start on port {self.port} "
+                               f"(port in use or insufficient privileges?)")
+
+        self.running = True
+        logger.info(f"✓ IEC 61850 server running on port {self.port}")
+
+    def stop(self):
+        """Stop the server and release the model"""
+        if self.server is not None:
+            iec61850.IedServer_stop(self.server)
+            iec61850.IedServer_destroy(self.server)
+            iec61850.IedModel_destroy(self.model)
+            self.server = None
+            self.running = False
+            logger.info("Embedded IEC 61850 server stopped")
+
+    def update(self, values: dict, timestamp_ms=None, ln=None):
+        """
+        Write translated measurements into the model (one lock per frame)
+
+        Args:
+            values: measurement name -> float (keys of IEC61850_SERVER_MAPPING)
+            timestamp_ms: Unix time in ms for the .t attributes (default: now)
+            ln: controller logical node (default: primary controller)
+        """
+        if not self.running:
+            return
+
+        ln = ln or self.primary_ln
+        if timestamp_ms is None:
+            timestamp_ms = int(time.time() * 1000)
+
+        iec61850.IedServer_lockDataModel(self.server)
+        try:
+            for name, value in values.items():
+                attrs = self.attributes.get((ln, name))
+                if attrs is None:
+                    continue
+                mag, q, t = attrs
+                iec61850.IedServer_updateFloatAttributeValue(self.server, mag, float(value))
+                iec61850.IedServer_updateQuality(self.server, q, iec61850.QUALITY_VALIDITY_GOOD)
+                iec61850.IedServer_updateUTCTimeAttributeValue(self.server, t, timestamp_ms)
+        finally:
+            iec61850.IedServer_unlockDataModel(self.server)
+
+        self.total_updates += 1
+
+    def update_alarms(self, ln, changes, timestamp_ms=None):
+        """
+        Set alarm indications (GGIO<n>.Ind<k>.stVal) for one controller
+
+        Args:
+            ln: controller logical node
+            changes: list of (rule index, active) transitions from the alarm engine
+            timestamp_ms: Unix time in ms for the .t attributes (default: now)
+        """
+        if not self.running:
+            return
+
+        if timestamp_ms is None:
+            timestamp_ms = int(time.time() * 1000)
+
+        iec61850.IedServer_lockDataModel(self.server)
+        try:
+            for index, active in changes:
+                attrs = self.alarm_attributes.get((ln, index))
+                if attrs is None:
+                    continue
+                st_val, t = attrs
+                iec61850.IedServer_updateBooleanAttributeValue(self.server, st_val, bool(active))
+                iec61850.IedServer_updateUTCTimeAttributeValue(self.server, t, timestamp_ms)
+        finally:
+            iec61850.IedServer_unlockDataModel(self.server)
+
+    def client_count(self) -> int:
+        """Number of open MMS connections"""
+        if self.server is None:
+            return 0
+        return iec61850.IedServer_getNumberOfOpenConnections(self.server)
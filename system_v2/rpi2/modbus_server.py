@@ -2,6 +2,10 @@
 RPI#2 Modbus TCP Server Component
 
 Receives telemetry from Arduino Opta and triggers protocol translation to IEC 61850.
+
+Multi-controller: every unit id in config.MODBUS_CONTROLLERS gets its own
+datablock (same 5-register layout), so several Optas on a feeder can share
+one gateway. The translator maps each unit id to its own MMXU instance.
 """
 
 import asyncio
@@ -27,11 +31,13 @@ class GatewayDataBlock(ModbusSequentialDataBlock):
     Triggers callback when new data arrives for protocol translation.
     """
 
-    def __init__(self, address, values):
+    def __init__(self, address, values, unit_id=None):
         super().__init__(address, values)
+        self.unit_id = config.MODBUS_UNIT_ID if unit_id is None else unit_id
         self.on_update_callback = None
         self.total_received = 0
         self.last_update = None
+        self.last_values = {}
 
     def setValues(self, address, values):
         """
@@ -61,15 +67,16 @@ class GatewayDataBlock(ModbusSequentialDataBlock):
 
         self.total_received += 1
         self.last_update = datetime.now(timezone.utc)
+        self.last_values = {"P_ac": P_ac, "V_dc": V_dc, "I_dc": I_dc, "G": G}
 
         logger.info(
-            f"[RX FROM OPTA] P_ac={P_ac:.1f}W V_dc={V_dc:.2f}V I_dc={I_dc:.2f}A "
+            f"[RX FROM OPTA unit {self.unit_id}] P_ac={P_ac:.1f}W V_dc={V_dc:.2f}V I_dc={I_dc:.2f}A "
             f"G={G:.1f}W/m² | Total RX: {self.total_received}"
         )
 
         # Trigger protocol translation callback
         if self.on_update_callback:
-            self.on_update_callback(address, values)
+            self.on_update_callback(self.unit_id, address, values)
 
 
 class ModbusGatewayServer:
@@ -77,24 +84,34 @@ class ModbusGatewayServer:
     Modbus TCP server for receiving data from Arduino Opta
     """
 
-    def __init__(self):
-        self.datablock = GatewayDataBlock(0, [0] * 100)
+    def __init__(self, unit_ids=None):
+        unit_ids = unit_ids or list(config.MODBUS_CONTROLLERS)
+        self.datablocks = {uid: GatewayDataBlock(0, [0] * 100, uid) for uid in unit_ids}
+        # Primary controller (single-controller callers use this one)
+        self.datablock = self.datablocks.get(config.MODBUS_UNIT_ID, next(iter(self.datablocks.values())))
         self.context = None
         self.server_task = None
 
+    @property
+    def total_received(self):
+        """Frames received from all controllers"""
+        return sum(block.total_received for block in self.datablocks.values())
+
     def set_update_callback(self, callback):
-        """Register callback to be called when new data arrives"""
-        self.datablock.on_update_callback = callback
+        """Register callback(unit_id, address, values) called when new data arrives"""
+        for block in self.datablocks.values():
+            block.on_update_callback = callback
 
     async def start(self):
         """Start the Modbus TCP server"""
-        logger.info(f"Starting Modbus TCP server on {config.MODBUS_BIND_ADDRESS}:{config.MODBUS_BIND_PORT}")
+        logger.info(f"Starting Modbus TCP server on {config.MODBUS_BIND_ADDRESS}:{config.MODBUS_BIND_PORT} "
+                    f"(unit ids: {', '.join(str(uid) for uid in self.datablocks)})")
 
-        # Create device context
-        device = ModbusDeviceContext(hr=self.datablock)
+        # One device context per controller unit id
+        devices = {uid: ModbusDeviceContext(hr=block) for uid, block in self.datablocks.items()}
 
         # Create server context
-        self.context = ModbusServerContext(devices={config.MODBUS_UNIT_ID: device}, single=False)
+        self.context = ModbusServerContext(devices=devices, single=False)
 
         # Start server (this is a blocking call)
         await StartAsyncTcpServer(
@@ -102,6 +119,7 @@ class ModbusGatewayServer:
             address=(config.MODBUS_BIND_ADDRESS, config.MODBUS_BIND_PORT),
         )
 
-    def get_registers(self, address, count):
-        """Read registers from datablock"""
-        return self.datablock.getValues(address, count)
+    def get_registers(self, address, count, unit_id=None):
+        """Read registers from a controller's datablock (default: primary)"""
+        block = self.datablock if unit_id is None else self.datablocks[unit_id]
+        return block.getValues(address, count)
@@ -4,10 +4,17 @@ RPI#2 Protocol Translator
 Maps Modbus registers to IEC 61850 MMS data objects and handles periodic updates.
 
 Translation: Modbus TCP (from Opta) → IEC 61850 MMS (to SIPROTEC)
+                                     → embedded IEC 61850 server (local clients)
+
+Each controller (Opta unit id) maps to its own MMXU instance. Every cycle the
+controllers with a new frame are decoded one after another (a few register
+reads each) and their writes are sent to the relay as one aggregated batch
+(MMS_WRITE_BATCH_SIZE variables per request).
 """
 
 import asyncio
 import logging
+import time
 from datetime import datetime, timezone
 
 import config
@@ -22,14 +29,18 @@ class ProtocolTranslator:
     Runs as periodic async task, updating SIPROTEC at configured interval.
     """
 
-    def __init__(self, modbus_server, iec_client):
+    def __init__(self, modbus_server, iec_client, local_server=None):
         self.modbus = modbus_server
         self.iec = iec_client
+        self.local_server = local_server
         self.update_interval = config.TRANSLATION_INTERVAL_SEC
         self.running = False
         self.total_updates = 0
         self.total_errors = 0
         self.last_update = None
+        self.total_reconnects = 0
+        self._next_reconnect = 0.0
+        self._sent_frames = {}  # unit id -> datablock frame count last written
 
     async def run(self):
         """
@@ -57,79 +68,124 @@ class ProtocolTranslator:
 
     async def translate_and_send(self):
         """
-        Read Modbus registers, decode, and write to IEC 61850
+        Translate every controller with a new frame and write all of them to
+        IEC 61850 in one aggregated batch
 
-        Register Map (from Opta):
+        Register Map (per Opta unit id):
           0: P_ac (W)
           1: V_dc (V×10, scaled)
           2: I_dc (A×100, scaled)
           3: G (W/m²)
           4: Timestamp_low
 
-        IEC 61850 Mapping (to SIPROTEC):
-          P_ac   → MMXU1$MX$TotW$mag$f           (Total Active Power)
-          V_dc   → MMXU1$MX$PhV$phsA$cVal$mag$f  (Phase A Voltage)
-          I_dc   → MMXU1$MX$A$phsA$cVal$mag$f    (Phase A Current)
+        IEC 61850 Mapping (to SIPROTEC, MMXUn = config.MODBUS_CONTROLLERS[unit id]):
+          P_ac   → MMXUn$MX$TotW$mag$f           (Total Active Power)
+          V_dc   → MMXUn$MX$PhV$phsA$cVal$mag$f  (Phase A Voltage)
+          I_dc   → MMXUn$MX$A$phsA$cVal$mag$f    (Phase A Current)
           (Quality flags set to GOOD: 0x0000)
+
+        The embedded server (if enabled) is updated before the relay write,
+        so local clients keep receiving data while the relay is unreachable.
+        Controllers whose frame was not delivered stay pending for the next cycle.
         """
-        if not self.iec.connected:
+        frames = (self._translate_controller(uid, ln) for uid, ln in config.MODBUS_CONTROLLERS.items())
+        pending = [frame for frame in frames if frame is not None]
+        if not pending:
+            return
+
+        if not self.iec.connected and not await self._reconnect_relay():
             logger.warning("IEC 61850 client not connected, skipping update")
             return
 
-        # Read 5 registers from Modbus datablock
-        regs = self.modbus.get_registers(0, 5)
+        # One batch for all controllers of this cycle
+        writes = [item for frame in pending for item in frame["writes"]]
+        requests_before = self.iec.total_write_requests
+        success = await self.iec.write_floats(writes)
+        requests = self.iec.total_write_requests - requests_before
+
+        if success:
+            for frame in pending:
+                self._sent_frames[frame["unit_id"]] = frame["frame"]
+            self.total_updates += 1
+            self.last_update = datetime.now(timezone.utc)
+
+            logger.info(
+                f"[IEC 61850 UPDATE] {len(pending)} controller(s), {len(writes)} values "
+                f"in {requests} MMS request(s) | Total updates: {self.total_updates}"
+            )
+        else:
+            self.total_errors += 1
+            logger.error(f"IEC 61850 write failed | Total errors: {self.total_errors}")
+            self.iec.check_connection()
+
+    def _translate_controller(self, unit_id, ln):
+        """
+        Decode and validate one controller's block
+
+        Returns:
+            dict(unit_id, frame, writes) or None if there is nothing new to send
+        """
+        block = self.modbus.datablocks[unit_id]
+        frame = block.total_received
+        if frame == self._sent_frames.get(unit_id, 0):
+            return None
+
+        regs = self.modbus.get_registers(0, 5, unit_id)
 
         # Decode scaling factors
         P_ac = float(regs[0])            # W (no scaling)
         V_dc = float(regs[1]) / 10.0     # Decode: V × 10 → V
         I_dc = float(regs[2]) / 100.0    # Decode: A × 100 → A
         G = float(regs[3])               # W/m² (no scaling)
-        timestamp_low = regs[4]          # 16-bit timestamp (partial)
 
         # Validate data ranges (sanity check)
         if not self._validate_data(P_ac, V_dc, I_dc, G):
-            logger.warning("Data validation failed, skipping update")
+            logger.warning(f"Data validation failed for unit {unit_id} ({ln}), skipping update")
             self.total_errors += 1
-            return
+            self._sent_frames[unit_id] = frame
+            return None
 
-        # Write to IEC 61850 (using MMS variable names from config)
-        success = True
-
-        # Write P_ac (Active Power)
-        success &= await self.iec.write_float(
-            config.IEC61850_MAPPING["P_ac"],
-            P_ac
-        )
-
-        # Write V_dc (DC Voltage)
-        success &= await self.iec.write_float(
-            config.IEC61850_MAPPING["V_dc"],
-            V_dc
-        )
-
-        # Write I_dc (DC Current)
-        success &= await self.iec.write_float(
-            config.IEC61850_MAPPING["I_dc"],
-            I_dc
-        )
-
-        # Optionally write irradiance G (if SIPROTEC supports custom data object)
-        # success &= await self.iec.write_float(
-        #     config.IEC61850_MAPPING["G"],
-        #     G
-        # )
+        # Update embedded server model in place
+        if self.local_server:
+            self.local_server.update({"P_ac": P_ac, "V_dc": V_dc, "I_dc": I_dc, "G": G}, ln=ln)
 
-        if success:
-            self.total_updates += 1
-            self.last_update = datetime.now(timezone.utc)
+        logger.debug(f"[{ln}] unit {unit_id}: P_ac={P_ac:.1f}W V_dc={V_dc:.2f}V I_dc={I_dc:.2f}A")
 
-            logger.info(
-                f"[IEC 61850 UPDATE] P_ac={P_ac:.1f}W V_dc={V_dc:.2f}V I_dc={I_dc:.2f}A | "
-                f"Total updates: {self.total_updates}"
-            )
-        else:
-            self.total_errors += 1
-            logger.error(f"IEC 61850 write failed | Total errors: {self.total_errors}")
+        # Irradiance G is not written (SIPROTEC has no matching data object)
+        return {
+            "unit_id": unit_id,
+            "frame": frame,
+            "writes": [
+                (self._controller_ref(ln, "P_ac"), P_ac),
+                (self._controller_ref(ln, "V_dc"), V_dc),
+                (self._controller_ref(ln, "I_dc"), I_dc),
+            ],
+        }
+
+    @staticmethod
+    def _controller_ref(ln, measurement):
+        """MMS variable of a measurement in a controller's logical node (MMXU1$MX$... → MMXUn$MX$...)"""
+        ref = config.IEC61850_MAPPING[measurement]
+        return f"{ln}${ref.split('$', 1)[1]}"
+
+    async def _reconnect_relay(self):
+        """
+        Reconnect to SIPROTEC at most every CONNECTION_RETRY_DELAY_SEC
+
+        Returns:
+            True if the relay link is up again
+        """
+        now = time.monotonic()
+        if now < self._next_reconnect:
+            return False
+        self._next_reconnect = now + config.CONNECTION_RETRY_DELAY_SEC
+
+        if await self.iec.reconnect():
+            self.total_reconnects += 1
+            logger.info(f"✓ Relay link restored ({self.iec.last_connect_ms:.1f} ms) | "
+                        f"Reconnects: {self.total_reconnects}")
+            return True
+        return False
 
     def _validate_data(self, P_ac, V_dc, I_dc, G):
         """
@@ -179,5 +235,11 @@ class ProtocolTranslator:
             "total_updates": self.total_updates,
             "total_errors": self.total_errors,
             "last_update": self.last_update.isoformat() if self.last_update else None,
-            "update_interval": self.update_interval
+            "update_interval": self.update_interval,
+            "relay_reconnects": self.total_reconnects,
+            "relay_connect_ms": self.iec.last_connect_ms,
+            "mms_write_requests": self.iec.total_write_requests,
+            "controllers": len(config.MODBUS_CONTROLLERS),
+            "local_updates": self.local_server.total_updates if self.local_server else 0,
+            "local_clients": self.local_server.client_count() if self.local_server else 0,
         }
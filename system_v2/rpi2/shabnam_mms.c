@@ -1,5 +1,6 @@
 // Modbus (plain) -> MMS write (libiec61850) -> relay_mirror.json for dashboard
 // Relay IP fixed to: 192.168.1.21
+// RELAY_TLS 1: MMS over TLS (IEC 62351-3) with TLS session resumption on reconnect
  
 #include <stdio.h>
 #include <stdlib.h>
@@ -18,6 +19,23 @@
 #define RELAY_IP    "192.168.1.21"
 #define RELAY_PORT  102
  
+/* IEC 62351-3 TLS (libiec61850 must be built with mbedTLS) */
+#ifndef RELAY_TLS
+#define RELAY_TLS            0
+#endif
+#define RELAY_TLS_PORT       3782
+#define TLS_CA_FILE          "certs/relay_ca.pem"
+#define TLS_CERT_FILE        "certs/rpi2.pem"
+#define TLS_KEY_FILE         "certs/rpi2.key"
+#define TLS_RESUMPTION_S     3600     /* resume the session on reconnect within this window */
+#define TLS_RENEGOTIATION_MS 3600000  /* rekey the long-lived association */
+ 
+#if RELAY_TLS
+#define RELAY_MMS_PORT RELAY_TLS_PORT
+#else
+#define RELAY_MMS_PORT RELAY_PORT
+#endif
+ 
 #define SCALE 10.0f
 #define MIRROR_FILE "relay_mirror.json"
  
@@ -88,16 +106,57 @@ static int write_mirror(const char* ts,
     return 0;
 }
  
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+ 
+#if RELAY_TLS
+/* Created once: the saved TLS session lives here, so reconnects can resume it */
+static TLSConfiguration create_tls_config(void)
+{
+    TLSConfiguration tls = TLSConfiguration_create();
+ 
+    TLSConfiguration_setChainValidation(tls, true);
+    TLSConfiguration_setAllowOnlyKnownCertificates(tls, false);
+    TLSConfiguration_setMinTlsVersion(tls, TLS_VERSION_TLS_1_2);
+ 
+    if (!TLSConfiguration_addCACertificateFromFile(tls, TLS_CA_FILE) ||
+        !TLSConfiguration_setOwnCertificateFromFile(tls, TLS_CERT_FILE) ||
+        !TLSConfiguration_setOwnKeyFromFile(tls, TLS_KEY_FILE, NULL)) {
+        fprintf(stderr, "TLS: cannot load %s / %s / %s\n", TLS_CA_FILE, TLS_CERT_FILE, TLS_KEY_FILE);
+        TLSConfiguration_destroy(tls);
+        return NULL;
+    }
+ 
+    TLSConfiguration_enableSessionResumption(tls, true);
+    TLSConfiguration_setSessionResumptionInterval(tls, TLS_RESUMPTION_S);
+    TLSConfiguration_setRenegotiationTime(tls, TLS_RENEGOTIATION_MS);
+    return tls;
+}
+#endif
+ 
 static int ensure_mms_connected(IedConnection con, IedClientError* err)
 {
+    static int connects = 0;
+ 
     if (IedConnection_getState(con) == IED_STATE_CONNECTED)
         return 1;
  
-    IedConnection_connect(con, err, RELAY_IP, RELAY_PORT);
+    /* Same IedConnection (and TLS configuration) on every attempt */
+    double t0 = now_ms();
+    IedConnection_connect(con, err, RELAY_IP, RELAY_MMS_PORT);
     if (*err != IED_ERROR_OK)
         return 0;
  
-    return (IedConnection_getState(con) == IED_STATE_CONNECTED);
+    if (IedConnection_getState(con) != IED_STATE_CONNECTED)
+        return 0;
+ 
+    printf("MMS connected in %.1f ms (%s, connect #%d)\n",
+           now_ms() - t0, RELAY_TLS ? "TLS" : "plain", ++connects);
+    return 1;
 }
  
 static int mms_write_float_mx(IedConnection con, IedClientError* err,
@@ -134,14 +193,24 @@ int main(void)
         return 1;
     }
  
+#if RELAY_TLS
+    TLSConfiguration tls = create_tls_config();
+    if (!tls) {
+        modbus_close(mb);
+        modbus_free(mb);
+        return 1;
+    }
+    con = IedConnection_createWithTlsSupport(tls);
+#else
     con = IedConnection_create();
+#endif
     if (!ensure_mms_connected(con, &err)) {
         fprintf(stderr, "MMS connect failed initially (will keep trying): err=%d\n", err);
     }
  
     printf("Bridge running:\n");
     printf("  Modbus: %s:%d (unit %d)\n", MODBUS_HOST, MODBUS_PORT, MODBUS_UNIT);
-    printf("  MMS:    %s:%d\n", RELAY_IP, RELAY_PORT);
+    printf("  MMS:    %s:%d (%s)\n", RELAY_IP, RELAY_MMS_PORT, RELAY_TLS ? "TLS" : "plain");
     printf("  Mirror: %s\n", MIRROR_FILE);
  
     while (1) {
@@ -188,5 +257,8 @@ int main(void)
     modbus_close(mb);
     modbus_free(mb);
     IedConnection_destroy(con);
+#if RELAY_TLS
+    TLSConfiguration_destroy(tls);
+#endif
     return 0;
 }
\ No newline at end of file
@@ -5,6 +5,9 @@ Main orchestrator for protocol translation gateway:
   1. Modbus TCP server (receives from Opta)
   2. IEC 61850 MMS client (sends to SIPROTEC)
   3. Protocol translator (maps Modbus → IEC 61850)
+  4. Embedded IEC 61850 server (serves translated data to SCADA/HMI)
+  5. GOOSE publisher (alarm rule events on the Process Zone, optional)
+  6. Alarm engine (compiled rules, event log + GGIO alarms on the embedded server)
 
 Architecture:
   Opta --[Modbus TCP:502]--> RPI#2 --[IEC 61850 MMS:102]--> SIPROTEC 7SX85
@@ -21,6 +24,9 @@ Usage:
 
   Or with custom SIPROTEC IP:
   python3 substation_gateway.py --siprotec-ip 192.168.3.250
+
+  Read back the embedded IEC 61850 server with a local client:
+  python3 substation_gateway.py --test-local-server
 """
 
 import asyncio
@@ -32,6 +38,9 @@ import sys
 import config
 from modbus_server import ModbusGatewayServer
 from iec61850_client import IEC61850Client
+from iec61850_server import IEC61850LocalServer
+from goose_publisher import GooseEventPublisher
+from alarm_engine import AlarmEngine
 from protocol_translator import ProtocolTranslator
 
 # =============================================================================
@@ -73,6 +82,9 @@ class SubstationGateway:
         self.siprotec_ip = siprotec_ip or config.SIPROTEC_IP
         self.modbus_server = None
         self.iec_client = None
+        self.local_server = None
+        self.goose = None
+        self.alarms = None
         self.translator = None
 
     async def start(self):
@@ -86,15 +98,51 @@ class SubstationGateway:
         logger.info("")
         logger.info("Configuration:")
         logger.info(f"  Modbus Server: {config.MODBUS_BIND_ADDRESS}:{config.MODBUS_BIND_PORT}")
-        logger.info(f"  SIPROTEC IP: {self.siprotec_ip}:{config.SIPROTEC_PORT}")
+        logger.info("  Controllers: " + ", ".join(
+            f"unit {uid} → {ln}" for uid, ln in config.MODBUS_CONTROLLERS.items()))
+        relay_port = config.SIPROTEC_TLS_PORT if config.SIPROTEC_TLS_ENABLED else config.SIPROTEC_PORT
+        logger.info(f"  SIPROTEC IP: {self.siprotec_ip}:{relay_port}"
+                    f"{' (MMS over TLS)' if config.SIPROTEC_TLS_ENABLED else ''}")
         logger.info(f"  Logical Device: {config.LOGICAL_DEVICE}")
         logger.info(f"  Update Interval: {config.TRANSLATION_INTERVAL_SEC}s")
+        if config.IEC61850_SERVER_ENABLED:
+            logger.info(f"  Embedded IEC 61850 Server: port {config.IEC61850_SERVER_PORT}")
+        if config.GOOSE_ENABLED:
+            logger.info(f"  GOOSE Events: {config.GOOSE_INTERFACE} → {config.GOOSE_DST_MAC}")
+        if config.ALARM_RULES_ENABLED:
+            logger.info(f"  Alarm Rules: {len(config.ALARM_RULES)} "
+                        f"(event log: {config.ALARM_EVENT_LOG or 'off'})")
         logger.info("=" * 80)
 
         # Initialize Modbus server
         logger.info("1. Initializing Modbus TCP server...")
         self.modbus_server = ModbusGatewayServer()
 
+        # Start embedded IEC 61850 server (independent of the relay link)
+        if config.IEC61850_SERVER_ENABLED:
+            logger.info("1b. Starting embedded IEC 61850 server...")
+            self.local_server = IEC61850LocalServer()
+            self.local_server.start()
+
+        # Compile alarm rules (evaluated on every Modbus write, all controllers).
+        # GOOSE publishes the rule states, so it needs the engine even when the
+        # alarm outputs (event log, GGIO) are off.
+        if config.ALARM_RULES_ENABLED or config.GOOSE_ENABLED:
+            logger.info("1c. Compiling alarm rules...")
+            if config.ALARM_RULES_ENABLED:
+                self.alarms = AlarmEngine(local_server=self.local_server)
+            else:
+                self.alarms = AlarmEngine(event_log="")
+
+        # Start GOOSE publisher (alarm transitions of the primary controller)
+        if config.GOOSE_ENABLED:
+            logger.info("1d. Starting GOOSE event publisher...")
+            self.goose = GooseEventPublisher(self.alarms.rules)
+            self.goose.start()
+
+        if self.alarms:
+            self.modbus_server.set_update_callback(self._on_modbus_update)
+
         # Initialize IEC 61850 client
         logger.info("2. Initializing IEC 61850 MMS client...")
         self.iec_client = IEC61850Client(host=self.siprotec_ip)
@@ -110,14 +158,14 @@ class SubstationGateway:
             logger.error("  1. Verify SIPROTEC IP address is correct")
             logger.error("  2. Check network connectivity: ping " + self.siprotec_ip)
             logger.error("  3. Verify SIPROTEC MMS server is enabled (DIGSI)")
-            logger.error("  4. Check firewall allows port 102")
+            logger.error("  4. Check firewall allows port 102 (3782 with TLS)")
             logger.error("  5. Use IEDScout to test connection manually")
             logger.error("=" * 80)
             raise
 
         # Initialize protocol translator
         logger.info("4. Initializing protocol translator...")
-        self.translator = ProtocolTranslator(self.modbus_server, self.iec_client)
+        self.translator = ProtocolTranslator(self.modbus_server, self.iec_client, self.local_server)
 
         # Start protocol translator task
         logger.info("5. Starting protocol translator...")
@@ -147,6 +195,13 @@ class SubstationGateway:
         finally:
             await self.shutdown()
 
+    def _on_modbus_update(self, unit_id, address, values):
+        """Modbus write callback: evaluate alarm rules and publish GOOSE events without waiting for the translator"""
+        values = self.modbus_server.datablocks[unit_id].last_values
+        changes = self.alarms.evaluate(unit_id, values)
+        if changes and self.goose and unit_id == config.MODBUS_UNIT_ID:
+            self.goose.publish_changes(changes)
+
     async def _statistics_task(self):
         """Periodically report statistics"""
         while not shutdown_event.is_set():
@@ -155,11 +210,29 @@ class SubstationGateway:
             stats = self.translator.get_statistics()
             logger.info("=" * 80)
             logger.info("[STATISTICS]")
-            logger.info(f"  Modbus RX (from Opta): {self.modbus_server.datablock.total_received}")
-            logger.info(f"  IEC 61850 TX (to SIPROTEC): {stats['total_updates']}")
+            logger.info(f"  Modbus RX (from {stats['controllers']} Opta): {self.modbus_server.total_received}")
+            logger.info(f"  IEC 61850 TX (to SIPROTEC): {stats['total_updates']} cycles | "
+                        f"MMS write requests: {stats['mms_write_requests']}")
             logger.info(f"  Translation Errors: {stats['total_errors']}")
             logger.info(f"  Last Update: {stats['last_update']}")
-            logger.info(f"  IEC 61850 Connected: {'Yes' if self.iec_client.connected else 'No'}")
+            logger.info(f"  IEC 61850 Connected: {'Yes' if self.iec_client.connected else 'No'}"
+                        f"{' (TLS)' if self.iec_client.tls else ''} | "
+                        f"Reconnects: {stats['relay_reconnects']}")
+            if stats['relay_connect_ms'] is not None:
+                logger.info(f"  Last Relay Connect: {stats['relay_connect_ms']:.1f} ms")
+            if self.local_server:
+                logger.info(f"  Local Server Updates: {stats['local_updates']} | "
+                            f"Clients: {stats['local_clients']}")
+            if self.goose:
+                goose_stats = self.goose.get_statistics()
+                logger.info(f"  GOOSE Events: {goose_stats['events']} | "
+                            f"Messages: {goose_stats['messages']} | "
+                            f"Active: {', '.join(goose_stats['active']) or 'none'}")
+            if self.alarms:
+                alarm_stats = self.alarms.get_statistics()
+                logger.info(f"  Alarm Events: {alarm_stats['events']} | "
+                            f"Eval: {alarm_stats['mean_eval_us']:.1f} µs/frame ({alarm_stats['rules']} rules) | "
+                            f"Active: {', '.join(alarm_stats['active']) or 'none'}")
             logger.info("=" * 80)
 
     async def _shutdown_handler(self):
@@ -181,11 +254,23 @@ class SubstationGateway:
         if self.iec_client:
             await self.iec_client.disconnect()
 
+        # Stop embedded IEC 61850 server
+        if self.local_server:
+            self.local_server.stop()
+
+        # Stop GOOSE publisher
+        if self.goose:
+            self.goose.stop()
+
+        # Close alarm event log
+        if self.alarms:
+            self.alarms.close()
+
         # Print final statistics
         if self.translator and self.modbus_server:
             stats = self.translator.get_statistics()
             logger.info("Final Statistics:")
-            logger.info(f"  Total Modbus RX: {self.modbus_server.datablock.total_received}")
+            logger.info(f"  Total Modbus RX: {self.modbus_server.total_received}")
             logger.info(f"  Total IEC 61850 TX: {stats['total_updates']}")
             logger.info(f"  Total Errors: {stats['total_errors']}")
 
@@ -212,8 +297,32 @@ async def main():
         action="store_true",
         help="Test IEC 61850 connection and exit"
     )
+    parser.add_argument(
+        "--test-local-server",
+        action="store_true",
+        help="Read the embedded IEC 61850 server with a local client and exit"
+    )
     args = parser.parse_args()
 
+    # Local server test mode (gateway must be running)
+    if args.test_local_server:
+        ld = f"{config.IEC61850_SERVER_IED_NAME}{config.IEC61850_SERVER_LD}"
+        logger.info(f"Reading embedded IEC 61850 server at 127.0.0.1:{config.IEC61850_SERVER_PORT}...")
+        client = IEC61850Client(host="127.0.0.1", port=config.IEC61850_SERVER_PORT,
+                                logical_device=ld, tls=False)
+        try:
+            await client.connect()
+            for name, do_ref in config.IEC61850_SERVER_MAPPING.items():
+                ln, rest = do_ref.split(".", 1)
+                attr = "cVal$mag$f" if ".phs" in rest else "mag$f"
+                value = await client.read_float(f"{ln}$MX${rest.replace('.', '$')}${attr}")
+                logger.info(f"  {name:5s} {ld}/{do_ref}: {value}")
+            await client.disconnect()
+            return
+        except Exception as e:
+            logger.error(f"✗ Local server read failed: {e}")
+            sys.exit(1)
+
     # Test connection mode
     if args.test_connection:
         logger.info("Testing IEC 61850 connection to SIPROTEC...")
@@ -0,0 +1,103 @@
+"""
+system_v1 async replay (modbus_client_tls.run_async) against a lossy server
+
+A local Modbus/TLS stand-in answers FC16 writes but drops some responses or
+closes the connection; the run must still end and report the lost writes.
+
+  python3 -m unittest discover tests
+"""
+
+import asyncio
+import contextlib
+import io
+import os
+import re
+import ssl
+import struct
+import sys
+import unittest
+from unittest import mock
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+V1 = os.path.join(ROOT, "system_v1")
+sys.path.insert(0, V1)
+
+# The replay path needs none of the PV stack; stub what is not installed
+for name in ("pandas", "pvlib", "pymodbus"):
+    try:
+        __import__(name)
+    except ImportError:
+        for mod in (name, f"{name}.client", f"{name}.exceptions"):
+            sys.modules[mod] = mock.MagicMock()
+
+import modbus_client_tls as client  # noqa: E402
+
+MBAP = struct.Struct(">HHHB")
+
+
+class _Series:
+    async def registers_async(self, i):
+        return [i & 0xFFFF] * 8
+
+
+async def _serve(drop, close_after=None):
+    """Lossy FC16 server: drop(k) -> True skips the k-th response"""
+    sslctx = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+    sslctx.load_cert_chain(os.path.join(V1, "server.crt"), os.path.join(V1, "server.key"))
+
+    async def on_client(reader, writer):
+        k = 0
+        try:
+            while close_after is None or k < close_after:
+                header = await reader.readexactly(MBAP.size)
+                tid, _, length, unit = MBAP.unpack(header)
+                pdu = await reader.readexactly(length - 1)
+                if not drop(k):
+                    writer.write(MBAP.pack(tid, 0, 6, unit) + pdu[:5])
+                k += 1
+        except (asyncio.IncompleteReadError, ConnectionError):
+            pass
+        writer.close()
+
+    server = await asyncio.start_server(on_client, "127.0.0.1", 0, ssl=sslctx)
+    return server, server.sockets[0].getsockname()[1]
+
+
+def _run(drop, count, window, close_after=None):
+    async def main():
+        server, port = await _serve(drop, close_after)
+        sslctx = client.build_ssl_context()
+        out = io.StringIO()
+        with contextlib.redirect_stdout(out):
+            await asyncio.wait_for(
+                client.run_async(_Series(), "127.0.0.1", port, 1, 0.0, window, count,
+                                 True, sslctx, timeout=0.3),
+                timeout=10.0)
+        server.close()
+        return out.getvalue()
+
+    output = asyncio.run(main())
+    summary = re.search(r"Sent: (\d+)  OK: (\d+)  Errors: (\d+)  Lost: (\d+)", output)
+    return tuple(int(v) for v in summary.groups())
+
+
+class AsyncReplayTest(unittest.TestCase):
+
+    def test_dropped_responses_count_as_lost(self):
+        sent, ok, errors, lost = _run(lambda k: k % 5 == 0, count=100, window=4)
+        self.assertEqual((sent, ok, errors, lost), (100, 80, 0, 20))
+
+    def test_full_window_of_lost_responses_does_not_stall(self):
+        # Nothing answered after the first 10: the window fills with lost writes
+        sent, ok, errors, lost = _run(lambda k: k >= 10, count=30, window=8)
+        self.assertEqual((sent, ok, lost), (30, 10, 20))
+
+    def test_connection_drop_with_full_window_ends_run(self):
+        sent, ok, errors, lost = _run(lambda k: k >= 5, count=1000, window=8, close_after=20)
+        self.assertLess(sent, 1000)
+        self.assertEqual(ok, 5)
+        self.assertEqual(lost, sent - ok)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,121 @@
+"""
+RPI#2 GOOSE publisher driven by the alarm engine's transitions
+
+pyiec61850 is replaced by a stand-in that records dataset values, published
+frames and frees; rules come from a real AlarmEngine, so the GOOSE dataset
+follows the compiled rules (hysteresis, delay_s) rather than its own copy.
+
+  python3 -m unittest discover tests
+"""
+
+import os
+import sys
+import types
+import unittest
+from unittest import mock
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+sys.path.insert(0, os.path.join(ROOT, "system_v2", "rpi2"))
+
+
+class _MmsBoolean:
+    def __init__(self, value):
+        self.value = value
+        self.freed = False
+
+
+def _stand_in():
+    """GOOSE subset of pyiec61850; publish() records the dataset state"""
+    lib = types.SimpleNamespace(published=[], destroyed=[])
+    lib.CommParameters = types.SimpleNamespace
+    lib.CommParameters_setDstAddress = lambda params, *mac: None
+    lib.GoosePublisher_create = lambda params, interface: object()
+    lib.GoosePublisher_destroy = lambda publisher: None
+    for name in ("setGoCbRef", "setDataSetRef", "setGoID", "setConfRev",
+                 "setTimeAllowedToLive", "increaseStNum"):
+        setattr(lib, f"GoosePublisher_{name}", lambda publisher, value=None: None)
+    lib.GoosePublisher_publish = lambda publisher, dataset: (
+        lib.published.append([v.value for v in dataset]) or 0)
+    lib.LinkedList_create = list
+    lib.LinkedList_add = list.append
+    lib.LinkedList_destroyStatic = lib.destroyed.append
+    lib.MmsValue_newBoolean = _MmsBoolean
+    lib.MmsValue_setBoolean = lambda value, state: setattr(value, "value", state)
+    lib.MmsValue_delete = lambda value: setattr(value, "freed", True)
+    return lib
+
+
+sys.modules.setdefault("iec61850", types.ModuleType("iec61850"))
+
+import goose_publisher  # noqa: E402
+from alarm_engine import AlarmEngine  # noqa: E402
+
+RULES = [
+    {"name": "DcOverVoltage", "measurement": "V_dc", "op": ">", "limit": 58.0, "hysteresis": 1.0},
+    {"name": "DcOverCurrent", "measurement": "I_dc", "op": ">", "limit": 10.0, "delay_s": 2.0},
+    {"name": "LowYield", "measurement": "P_ac", "op": "<", "limit": 20.0},
+]
+
+
+def _frame(V_dc=48.0, I_dc=5.0, P_ac=250.0):
+    return {"P_ac": P_ac, "V_dc": V_dc, "I_dc": I_dc, "G": 800.0}
+
+
+class GooseEventsTest(unittest.TestCase):
+
+    def setUp(self):
+        self.lib = _stand_in()
+        patches = [
+            mock.patch.object(goose_publisher, "iec61850", self.lib, create=True),
+            mock.patch.object(goose_publisher, "IEC61850_AVAILABLE", True),
+            mock.patch.object(goose_publisher.config, "GOOSE_T_MAX_MS", 60000),
+        ]
+        for p in patches:
+            p.start()
+            self.addCleanup(p.stop)
+
+        self.engine = AlarmEngine(rules=RULES, controllers={1: "MMXU1"}, event_log="")
+        self.goose = goose_publisher.GooseEventPublisher(
+            self.engine.rules, interface="lo", alarms=["DcOverCurrent", "DcOverVoltage"])
+        self.goose.start()
+        self.addCleanup(self.goose.stop)
+
+    def feed(self, t, **values):
+        changes = self.engine.evaluate(1, _frame(**values), t=t)
+        if changes:
+            self.goose.publish_changes(changes)
+
+    def test_dataset_follows_engine_transitions(self):
+        self.assertEqual(self.lib.published, [[False, False]])
+        self.feed(0.0, V_dc=59.0)
+        self.feed(1.0, V_dc=57.5)      # inside the engine's hysteresis band: still active
+        self.feed(2.0, V_dc=56.5)
+        self.assertEqual(self.lib.published, [[False, False], [False, True], [False, False]])
+
+    def test_delay_comes_from_the_alarm_rule(self):
+        self.feed(0.0, I_dc=12.0)
+        self.feed(1.0, I_dc=12.0)
+        self.assertEqual(self.goose.total_events, 1)
+        self.feed(2.0, I_dc=12.0)
+        self.assertEqual(self.lib.published[-1], [True, False])
+        self.assertEqual(self.goose.get_statistics()["active"], ["DcOverCurrent"])
+
+    def test_rules_outside_goose_alarms_are_not_published(self):
+        self.feed(0.0, P_ac=5.0)
+        self.assertEqual(self.engine.get_statistics()["active"], ["LowYield@1"])
+        self.assertEqual(self.goose.total_events, 1)
+
+    def test_unknown_alarm_name_fails(self):
+        with self.assertRaises(ValueError):
+            goose_publisher.GooseEventPublisher(self.engine.rules, alarms=["OverPower"])
+
+    def test_stop_frees_each_value_then_the_list(self):
+        values = list(self.goose.values)
+        dataset = self.goose.dataset
+        self.goose.stop()
+        self.assertTrue(all(v.freed for v in values))
+        self.assertEqual(self.lib.destroyed, [dataset])
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,124 @@
+"""
+RPI#2 translator: MMS Write requests per cycle on the default (class API) path
+
+pyiec61850 is replaced by a stand-in whose IedConnection has the class API
+(connect, writeValue, getConnection); the ctypes batch writer is replaced by
+one that records each multi-variable request it would send.
+
+  python3 -m unittest discover tests
+"""
+
+import asyncio
+import os
+import sys
+import types
+import unittest
+from unittest import mock
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+sys.path.insert(0, os.path.join(ROOT, "system_v2", "rpi2"))
+
+
+class _IedConnection:
+    """Class API of pyiec61850; getConnection() returns the C handle"""
+
+    def __init__(self):
+        self.single_writes = 0
+
+    def connect(self, host, port):
+        return 0
+
+    def getConnection(self):
+        return 0x1000
+
+    def writeValue(self, ref, value):
+        self.single_writes += 1
+        return 0
+
+    def close(self):
+        pass
+
+
+iec61850 = types.ModuleType("iec61850")
+iec61850.IedConnection = _IedConnection
+iec61850.IedConnectionError = types.SimpleNamespace(IED_ERROR_OK=0)
+iec61850.IEC61850_FC_MX = 1
+iec61850.MmsValue_newFloat = lambda value: value
+iec61850.MmsValue_delete = lambda value: None
+sys.modules["iec61850"] = iec61850
+
+import config  # noqa: E402
+import iec61850_client  # noqa: E402
+from protocol_translator import ProtocolTranslator  # noqa: E402
+
+
+class _BatchWriter:
+    def __init__(self):
+        self.requests = []
+
+    def write(self, connection, domain, items):
+        self.requests.append((connection, domain, len(items)))
+        return [True] * len(items)
+
+
+class _Block:
+    def __init__(self):
+        self.total_received = 0
+
+
+class _Modbus:
+    def __init__(self, unit_ids):
+        self.datablocks = {uid: _Block() for uid in unit_ids}
+
+    def get_registers(self, address, count, unit_id=None):
+        return [250, 480, 520, 800, 0][:count]   # 250 W, 48.0 V, 5.20 A, 800 W/m²
+
+
+class MmsBatchingTest(unittest.TestCase):
+
+    def setUp(self):
+        controllers = {uid: f"MMXU{uid}" for uid in range(1, 9)}
+        patches = [
+            mock.patch.object(config, "MODBUS_CONTROLLERS", controllers),
+            mock.patch.object(config, "SIPROTEC_TLS_ENABLED", False),
+            mock.patch.object(iec61850_client, "MmsBatchWriter", _BatchWriter),
+        ]
+        for p in patches:
+            p.start()
+            self.addCleanup(p.stop)
+
+        self.modbus = _Modbus(controllers)
+        self.iec = iec61850_client.IEC61850Client()
+        asyncio.run(self.iec.connect())
+        self.translator = ProtocolTranslator(self.modbus, self.iec)
+
+    def cycle(self):
+        for block in self.modbus.datablocks.values():
+            block.total_received += 1
+        before = self.iec.total_write_requests
+        asyncio.run(self.translator.translate_and_send())
+        return self.iec.total_write_requests - before
+
+    def test_default_path_is_class_api(self):
+        self.assertTrue(self.iec.use_class_api)
+        self.assertIsNotNone(self.iec.batch_writer)
+
+    def test_one_request_per_cycle(self):
+        # 8 controllers x 3 values = 24 variables <= MMS_WRITE_BATCH_SIZE
+        self.assertEqual(self.cycle(), 1)
+        self.assertEqual(self.iec.batch_writer.requests, [(0x1000, config.LOGICAL_DEVICE, 24)])
+        self.assertEqual(self.iec.connection.single_writes, 0)
+
+    def test_batch_size_splits_requests(self):
+        with mock.patch.object(config, "MMS_WRITE_BATCH_SIZE", 10):
+            self.assertEqual(self.cycle(), 3)
+        self.assertEqual([n for _, _, n in self.iec.batch_writer.requests], [10, 10, 4])
+
+    def test_no_new_frames_no_requests(self):
+        self.cycle()
+        asyncio.run(self.translator.translate_and_send())
+        self.assertEqual(self.iec.total_write_requests, 1)
+
+
+if __name__ == "__main__":
+    unittest.main()